@@ -6,6 +6,7 @@
 #include "Storage.hpp"     // Storageクラスを使うため
 #include "WifiManager.hpp" // WifiManagerクラスを使うため (scanNetworks)
 #include "config.hpp"
+#include "FixedString.hpp"
 
 class APConfigPortal {
 public:
@@ -27,6 +28,25 @@ private:
     bool portalActive;            // APポータル動作中フラグ
     bool credentialsSavedFlag;    // 認証情報が保存されたか
 
+    // ルートページを少しずつ書く (チャンク転送のコールバックから read() を呼ぶ。書き終えたら 0)
+    // スキャン結果の1件分だけを固定長の行に組み立て、残りは文字列リテラルをそのまま写す
+    class RootPageWriter {
+    public:
+        explicit RootPageWriter(WifiManager& wifiManager);
+        size_t read(uint8_t* buffer, size_t maxLength);
+
+    private:
+        WifiManager& wifiManager;
+        int networkCount;        // 書き始めたときのスキャン結果の数 (途中で再スキャンされても形を崩さない)
+        int step;                // 0: 前半, 1..n: ネットワーク (無ければ案内), その次: 後半
+        FixedString<256> line;   // ネットワーク1件分の行
+        const char* source;      // いま写している部分
+        size_t sourceLength;
+        size_t position;
+
+        bool nextPart();
+    };
+
     // --- Webサーバーリクエストハンドラ (private) ---
     void handleRootRequest(AsyncWebServerRequest *request);
     void handleScanRequest(AsyncWebServerRequest *request);
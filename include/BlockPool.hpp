@@ -0,0 +1,99 @@
+#ifndef BLOCK_POOL_HPP
+#define BLOCK_POOL_HPP
+
+#include <stdint.h>
+#include <cstddef>
+#include <new>
+
+// 同じ大きさのブロックを決まった数だけ持つプール
+// 領域はオブジェクトの中に持ち (グローバル変数やメンバーとして置けばヒープを使わない)、空きブロックを単方向リストでつなぐ
+// 同じ大きさのものを作っては捨てる処理で malloc / free を繰り返し、ヒープに穴を空けないために使う
+// ロックは取らないので、1つのタスクの中だけで使うこと。Arduino API に依存しない
+template <size_t BlockSize, size_t BlockCount>
+class BlockPool {
+public:
+    static const size_t BLOCK_SIZE = BlockSize;
+
+    BlockPool() : freeList(nullptr), freeCount(0), exhausted(0) {
+        for (size_t i = BlockCount; i > 0; i--) {
+            blocks[i - 1].next = freeList;
+            freeList = &blocks[i - 1];
+        }
+        freeCount = BlockCount;
+    }
+
+    // 空きがなければ nullptr
+    void* allocate() {
+        Block* block = freeList;
+        if (block == nullptr) {
+            exhausted++;
+            return nullptr;
+        }
+        freeList = block->next;
+        freeCount--;
+        return block->data;
+    }
+    void release(void* pointer) {
+        Block* block = reinterpret_cast<Block*>(pointer);
+        block->next = freeList;
+        freeList = block;
+        freeCount++;
+    }
+    bool owns(const void* pointer) const {
+        const unsigned char* p = static_cast<const unsigned char*>(pointer);
+        return p >= reinterpret_cast<const unsigned char*>(blocks) &&
+               p < reinterpret_cast<const unsigned char*>(blocks + BlockCount);
+    }
+
+    size_t getAvailable() const { return freeCount; }
+    uint32_t getExhausted() const { return exhausted; } // 空きがなくて断った回数
+
+private:
+    union Block {
+        Block* next;
+        alignas(std::max_align_t) unsigned char data[BlockSize];
+    };
+    Block blocks[BlockCount];
+    Block* freeList;
+    size_t freeCount;
+    uint32_t exhausted;
+};
+
+// BlockPool から取る標準アロケーター (std::allocate_shared などに渡す)
+// 1個ずつで、ブロックに収まる型だけプールから取る。それ以外とプールが空のときはヒープから取る (処理は止めない)
+template <typename T, typename Pool>
+class PoolAllocator {
+public:
+    typedef T value_type;
+
+    explicit PoolAllocator(Pool& pool) : pool(&pool) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, Pool>& other) : pool(other.pool) {}
+
+    T* allocate(size_t count) {
+        if (count == 1 && sizeof(T) <= Pool::BLOCK_SIZE) {
+            void* block = pool->allocate();
+            if (block != nullptr)
+                return static_cast<T*>(block);
+        }
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+    void deallocate(T* pointer, size_t) {
+        if (pool->owns(pointer))
+            pool->release(pointer);
+        else
+            ::operator delete(pointer);
+    }
+
+    template <typename U>
+    bool operator==(const PoolAllocator<U, Pool>& other) const { return pool == other.pool; }
+    template <typename U>
+    bool operator!=(const PoolAllocator<U, Pool>& other) const { return pool != other.pool; }
+
+private:
+    template <typename U, typename P>
+    friend class PoolAllocator;
+    Pool* pool;
+};
+
+#endif // BLOCK_POOL_HPP
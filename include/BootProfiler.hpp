@@ -0,0 +1,30 @@
+#ifndef BOOT_PROFILER_HPP
+#define BOOT_PROFILER_HPP
+
+#include <Arduino.h>
+
+// 起動の段階 (並べた順に出力する)
+enum class BootPhase : uint8_t {
+    SETUP_START,    // setup() に入った
+    PCNT_READY,     // パルスを数え始めた (NVS に入力チャンネルの写しがあれば SD を待たない)
+    DISPLAY_READY,  // LCD とスプライトの初期化が終わった
+    STORAGE_READY,  // SD のマウントと config.json の読み込みが終わった
+    WIFI_READY,     // Wi-Fi を起動し、自動接続を始めた
+    CHANNELS_READY, // 各チャンネルの計算ができた (累積データの読み込みを含む)
+    TASKS_STARTED,  // タスクを起動した (setup() の終わり)
+    COUNT
+};
+
+// 起動の各段階に達した時刻 (esp_timer の µs。アプリの起動から。ブートローダーの時間は含まない)
+// 記録は RTC メモリ (RTC_NOINIT_ATTR) に置くので、ディープスリープやソフトウェアリセット (起動中のパニックを含む) の後も前回の分が読める
+// 段階ごとに別の語へ書くだけなので、起動時の初期化タスクのどれからでも mark() できる
+class BootProfiler {
+public:
+    static void begin();                    // setup() の最初で呼ぶ。前回の記録を取っておき、今回の分を空にする
+    static void mark(BootPhase phase);      // その段階に達した (同じ段階をもう一度 mark すると上書き)
+    static uint32_t getUs(BootPhase phase); // 今回の起動 (0=まだ)
+    static uint32_t getPreviousUs(BootPhase phase); // 前回の起動 (0=記録なし)
+    static void print();                    // 今回と前回の時刻 (ms) を1行ずつログに出す
+};
+
+#endif // BOOT_PROFILER_HPP
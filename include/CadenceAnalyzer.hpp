@@ -0,0 +1,63 @@
+#ifndef CADENCE_ANALYZER_HPP
+#define CADENCE_ANALYZER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.hpp"
+
+// セッション中のケイデンスの集計結果 (画面表示・セッション要約用)
+struct CadenceAnalysis {
+    uint32_t zoneMs[CADENCE_ZONE_COUNT] = {}; // ゾーンごとの時間 (タイマー動作中のみ。合計はセッション時間と同じ)
+    uint16_t boundaries = 0;       // 検出した変化点の数
+    uint16_t workIntervals = 0;    // 運動区間の数 (休み→運動の切り替わり。最初の区間が運動なら1から)
+    bool working = false;          // 今の区間が運動か
+    uint8_t currentZone = 0;       // 直近の値のゾーン
+    uint64_t segmentStartMs = 0;   // 今の区間の始まり (推定した変化点)
+    uint32_t segmentMilliRpm = 0;  // 今の区間の平均 (1/1000 rpm)
+};
+
+// RPM を流し込み、ゾーン別の時間と、運動/休みの区間の切れ目をその場で求める
+// ・ゾーン: 区間の長さで重み付けした固定ビンのヒストグラム
+// ・変化点: 今の区間の平均に対する上向き・下向きの CUSUM (Page の累積和検定)。
+//   累積和が最後に0だった時点を変化点とし、その後の値だけから新しい区間の平均を始める
+// 持つのは合計と累積和だけなので、メモリも1回の計算量も一定。Arduino API に依存しない
+class CadenceAnalyzer {
+public:
+    CadenceAnalyzer();
+    void reset(uint64_t startMs); // セッション開始
+    // 計算した1区間分 (nowMs は区間の終わり)。active はタイマー動作中か (止まっている間は0rpmを入れる)
+    void add(uint64_t nowMs, uint32_t intervalMs, uint32_t milliRpm, bool active);
+    const CadenceAnalysis& getAnalysis() const;
+
+    static uint8_t zoneOf(uint32_t milliRpm);
+
+private:
+    // 区間の平均を出すための合計
+    struct Sums {
+        uint64_t milliRpmMs;
+        uint64_t ms;
+        void clear() { milliRpmMs = 0; ms = 0; }
+        void add(uint32_t milliRpm, uint32_t intervalMs) { milliRpmMs += (uint64_t)milliRpm * intervalMs; ms += intervalMs; }
+        uint32_t mean() const { return ms > 0 ? (uint32_t)(milliRpmMs / ms) : 0; }
+    };
+    // 片側の CUSUM。累積和が最後に0になった時刻と、それ以降の合計を持つ
+    struct Detector {
+        int64_t sum;          // 1/1000 rpm × ms
+        uint64_t startMs;     // 変化点の候補
+        Sums since;
+    };
+
+    CadenceAnalysis analysis;
+    Sums segment;
+    Detector up;
+    Detector down;
+    bool lastSegmentWorking;  // 閉じた直前の区間が運動だったか
+    bool hasClosedSegment;
+    uint16_t closedWorkIntervals; // 閉じた区間のうち、運動区間の始まりだった数
+
+    static void updateDetector(Detector& detector, int64_t deviation, uint64_t nowMs, uint32_t milliRpm, uint32_t intervalMs);
+    void startSegment(const Detector& detector, uint64_t nowMs);
+    void updateWorking();
+};
+
+#endif // CADENCE_ANALYZER_HPP
@@ -0,0 +1,59 @@
+#ifndef CADENCE_ESTIMATOR_HPP
+#define CADENCE_ESTIMATOR_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.hpp"
+
+// ケイデンス推定の設定 (config.json の "cadence")
+struct CadenceConfig {
+    bool enabled = true;                              // false なら従来どおり区間のパルス数からRPMを出す
+    uint8_t window = CADENCE_WINDOW_DEFAULT;          // 外れ値判定に使う直近の間隔数 (3〜CADENCE_MAX_WINDOW)
+    uint32_t responseMs = CADENCE_RESPONSE_MS_DEFAULT; // 平滑化の時定数 (小さいほど追従が速く、揺れも大きい)
+    float hampelK = CADENCE_HAMPEL_K_DEFAULT;         // 中央値から MAD×k 以上離れた間隔を外れ値とする
+};
+
+// パルス間隔からケイデンス (RPM) を推定する
+// 1. 物理的にあり得ない短い間隔 (MAX_RPM 超え) はノイズパルスとして捨て、間隔を次のパルスへ繋ぐ
+// 2. 直近 window 個の間隔の中央値と MAD で外れ値を判定し (Hampel フィルタ)、外れ値は中央値に置き換える
+// 3. 間隔の長さに応じた重みの指数移動平均で平滑化する (パルスの速さによらず時定数が responseMs になる)
+// 1パルスあたりの計算量は window (上限 CADENCE_MAX_WINDOW) だけで決まり、履歴の長さによらない。
+// Arduino API に依存しないので、ホスト上でも同じ入力列を流して確かめられる
+class CadenceEstimator {
+public:
+    CadenceEstimator();
+    // minPeriodUs 未満の間隔は捨てる。maxPeriodUs を超える間隔は休止とみなして推定をやり直す
+    void begin(const CadenceConfig& config, uint32_t pulsesPerRev, uint32_t minPeriodUs, uint32_t maxPeriodUs);
+    void reset(); // 推定をやり直す (設定はそのまま)
+
+    // 1パルス分の間隔 (us, 0=直前のパルスが無い) を入れる
+    // 戻り値: このパルスを数えてよいか (false=ノイズとして捨てた。距離・カロリーにも入れない)
+    bool addPeriod(uint32_t periodUs);
+    // 推定RPM (1/1000 rpm)。最後のパルスから推定中の間隔より長く空いたら、その空きから決まる上限まで下げる
+    uint32_t getMilliRpm(uint64_t usSinceLastPulse) const;
+    bool isEnabled() const;
+
+    uint32_t getRejectedCount() const; // ノイズとして捨てたパルス数
+    uint32_t getOutlierCount() const;  // 中央値に置き換えた間隔数
+
+private:
+    CadenceConfig config;
+    uint32_t pulsesPerRev;
+    uint32_t minPeriodUs;
+    uint32_t maxPeriodUs;
+
+    uint32_t periods[CADENCE_MAX_WINDOW]; // 直近の間隔 (リング)
+    size_t periodCount;
+    size_t nextIndex;
+    uint32_t carryUs;        // 捨てたパルスの分の間隔 (次の間隔に足す)
+    uint32_t lastPeriodUs;   // 最後に採用した間隔
+    float smoothedRpm;
+    bool hasEstimate;
+    uint32_t rejectedCount;
+    uint32_t outlierCount;
+
+    void push(uint32_t periodUs);
+    uint32_t median(uint32_t* values, size_t count) const; // values は並べ替える
+};
+
+#endif // CADENCE_ESTIMATOR_HPP
@@ -0,0 +1,18 @@
+#ifndef CHAIR_MODEL_HPP
+#define CHAIR_MODEL_HPP
+
+#include <stdint.h>
+#include "config.hpp"
+
+// 機種ごとの物理定数 (BasicMetricsCalculator / MetricsAccumulator のテンプレート引数)
+// 係数はコンパイル時に決まるので、計算の中では定数に畳み込まれる。
+// 別の機種に対応するときは同じ名前の定数を持つ構造体を追加し、MetricsCalculator.cpp で明示的実体化する
+struct DefaultChairModel {
+    static constexpr uint32_t PULSES_PER_REV = PULSES_PER_REVOLUTION;
+    static constexpr uint32_t REV_DISTANCE_UM = DISTANCE_PER_REV_UM;   // 1回転の距離 (µm)
+    static constexpr uint32_t CALORIES_K1_E8 = CALORIES_RPM_K1_E8;     // kcal/s/rpm × 10^8
+    static constexpr uint32_t MAX_RPM = MAX_VALID_RPM;                 // これを超えるRPMは異常値
+    static constexpr float KMH_PER_RPM = DISTANCE_PER_REV_M * 60.0f / 1000.0f; // RPM × これ = km/h
+};
+
+#endif // CHAIR_MODEL_HPP
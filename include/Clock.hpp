@@ -0,0 +1,39 @@
+#ifndef CLOCK_HPP
+#define CLOCK_HPP
+
+#include <stdint.h>
+#include <atomic>
+
+// 単調増加する64bitの時刻源
+// millis() は32bitなので約49日で一周し、「後の時刻 > 前の時刻」の比較が壊れる。
+// 時刻は全てここから取り、64bitのまま比較・保持する (一周するのは約5億年後)
+class Clock {
+public:
+    virtual ~Clock() {}
+    virtual uint64_t nowUs() const = 0; // 起動からの経過時間 (us)
+    uint64_t nowMs() const { return nowUs() / 1000; }
+};
+
+// 実機用: esp_timer (起動からのus, 64bit) を使う
+// PulseCounter のISRも esp_timer_get_time() で時刻を取るので、パルス時刻と同じ時間軸になる
+class SystemClock : public Clock {
+public:
+    uint64_t nowUs() const override;
+};
+
+// 試験用: 時刻を外から進める時計
+// ホスト上で数週間分の稼働を一瞬で流したり、一周の境界をまたぐ状況を作ったりできる
+class VirtualClock : public Clock {
+public:
+    explicit VirtualClock(uint64_t startUs = 0) : currentUs(startUs) {}
+    uint64_t nowUs() const override { return currentUs.load(std::memory_order_relaxed); }
+    void setUs(uint64_t us) { currentUs.store(us, std::memory_order_relaxed); }
+    void setMs(uint64_t ms) { setUs(ms * 1000); }
+    void advanceUs(uint64_t us) { currentUs.fetch_add(us, std::memory_order_relaxed); }
+    void advanceMs(uint64_t ms) { advanceUs(ms * 1000); }
+
+private:
+    std::atomic<uint64_t> currentUs;
+};
+
+#endif // CLOCK_HPP
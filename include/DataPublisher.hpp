@@ -4,26 +4,106 @@
 #include <Arduino.h>
 #include <WiFi.h> // WiFi ライブラリ
 #include <HTTPClient.h> // HTTPClient ライブラリ
+#include <vector>
+#include <deque>
+#include <memory>
+#include <limits.h>
 #include "config.hpp"
 #include "TrackerData.hpp"
+#include "Storage.hpp"     // EndpointConfig
 #include "WifiManager.hpp" // WifiManagerクラスの前方宣言またはインクルード
+#include "PublishScheduler.hpp"
+#include "EndpointHealth.hpp"
+#include "UdpTelemetry.hpp"
+#include "ParsedUrl.hpp"
+#include "HostResolver.hpp"
+#include "Clock.hpp"
+#include "SessionSummary.hpp"
+#include "BlockPool.hpp"
+
+// 1回の送信にかかった時間の内訳 (マイクロ秒)
+// HTTPSではTCP接続もTLSハンドシェイクと同じ呼び出しの中で行われるので、connectUs は0で tlsUs に含まれる
+struct PublishTiming {
+    uint32_t dnsUs = 0;       // アドレス取得 (キャッシュ済みならほぼ0)
+    uint32_t connectUs = 0;   // TCP接続
+    uint32_t tlsUs = 0;       // TLSハンドシェイク (HTTPSのみ)
+    uint32_t sendUs = 0;      // リクエスト送信から応答ヘッダー受信まで
+    uint32_t responseUs = 0;  // 応答ボディの読み出し
+};
 
 class DataPublisher {
 public:
-    // コンストラクタ: WifiManagerへの参照を受け取る
-    DataPublisher(WifiManager& wifi);
-    // 送信先URLを設定するメソッド
-    void begin(const String& url, DriveType type);
-    // 必要に応じてデータを送信するメソッド
-    bool publishIfNeeded(const TrackerData& data);
+    // コンストラクタ: WifiManagerと時刻源への参照を受け取る
+    DataPublisher(WifiManager& wifi, Clock& clock);
+    // 送信先一覧を設定するメソッド
+    void begin(const std::vector<EndpointConfig>& endpoints, DriveType type);
+    // 必要に応じてデータを送信するメソッド (force=true でスケジューラを無視して送信)
+    // いずれかの送信先に届いたら true
+    bool publishIfNeeded(const TrackerData& data, bool force = false);
+    // 複数チャンネル分を1つのペイロードにまとめて送る (送信間隔は全チャンネルの合計の動きで決める)
+    bool publishIfNeeded(const TrackerData* channels, size_t channelCount, bool force = false);
+    // 終わったセッションの要約を全送信先に送る (送信間隔によらず即座にキューへ積む。StatsD の送信先は除く)
+    // いずれかの送信先に届いたら true。届かなかった分はキューに残り、以降の publishIfNeeded() で再送される
+    bool publishSessionSummary(const SessionSummary& summary);
+    // Wi-Fi接続中に毎ループ呼ぶ。送信先ホスト名の解決を非同期で進める (送信処理ではDNSを待たない)
+    void maintain(uint64_t nowMs);
+    // 次に publishIfNeeded() で何か送れる時刻までの残りms (送るものが無ければ ULONG_MAX)
+    // newData=false なら送信時期は見ず、送り残し・試験送信・UDPの期限だけを見る (EVENT駆動で新しい計算結果が無いとき)
+    // アドレス未解決・遮断中の送信先は、送れるようになるまでの時間を返す (送信時期が来ていても 0 にはしない)
+    unsigned long msUntilNextWork(uint64_t nowMs, bool newData = true) const;
+
+    size_t getTargetCount() const;
+    const PublishScheduler& getScheduler(size_t index) const;
+    const EndpointHealth& getHealth(size_t index) const;
+    const PublishTiming& getLastTiming(size_t index) const;
 
 private:
+    // 送信先ごとの状態。スケジューラ・死活管理・送信待ちキューを独立に持つので、
+    // 1つの送信先が落ちていても他の送信先の送信間隔やバックオフには影響しない
+    struct Target {
+        EndpointConfig config;
+        ParsedUrl url;                                    // begin時に1回だけ解析したURL
+        bool useHttps = false;
+        bool draining = false;                            // キューに残りがあり続けて送るべきか
+        PublishScheduler scheduler;
+        EndpointHealth health;
+        std::deque<std::shared_ptr<const String>> queue;  // 送信待ちペイロード (形式が同じ送信先間で共有)
+        // 送信待ちのセッション要約。1回しか作らないので、サンプルの古いもの捨てに巻き込まれないよう別に持ち、サンプルより先に送る
+        std::deque<std::shared_ptr<const String>> sessionQueue;
+        uint32_t droppedPayloads = 0;                     // キューあふれで捨てた数
+        uint32_t droppedSessions = 0;                     // セッション要約のキューあふれで捨てた数 (SDには残っている)
+        std::unique_ptr<HostResolver> resolver;           // DNSコールバックが this を持つのでヒープに置く
+        std::unique_ptr<UdpTelemetry> udp;                // udp:// の送信先ならHTTPの代わりにこれで送る
+        PublishTiming lastTiming;                         // 直近の送信の所要時間内訳
+    };
+
+    // 送信待ちペイロードの入れ物 (shared_ptr の制御ブロックと String 本体) を取るプール
+    // 送信のたびに make_shared で小さなブロックを取っては捨てないように、送信タスクの中だけで使う
+    // 大きさは String 本体 + 制御ブロック (vtable・参照カウント2つ・アロケーター) の分。足りなければヒープから取る
+    static const size_t PAYLOAD_HOLDER_BYTES = sizeof(String) + 32;
+    typedef BlockPool<PAYLOAD_HOLDER_BYTES, PUBLISH_PAYLOAD_POOL_SIZE> PayloadPool;
+
     WifiManager& wifiManager;       // Wi-Fi接続状態確認用
-    String endpointUrl;             // 送信先URL
-    unsigned long lastPublishTimeMs; // 最終送信時刻 (送信間隔制御用)
+    Clock& clock;                   // 送信間隔・所要時間の計測用
+    PayloadPool payloadPool;        // targets のキューより先に作り、後に壊す
+    std::vector<Target> targets;    // 送信先一覧
+    size_t nextTargetIndex;         // 送信順のラウンドロビン開始位置
     DriveType drive_type;
+    String rootCA;                  // HTTPS用ルートCA (begin時にSDから1回だけ読む)
+    char deviceId[18];              // チップIDから作る端末ID
 
-    // 埋め込み用の証明書変数は削除済み
+    bool loadRootCA();
+    std::shared_ptr<String> newPayload(); // プールから取った空のペイロード (PUBLISH_PAYLOAD_RESERVE_BYTES 確保済み)
+    void enqueue(Target& target, const std::shared_ptr<const String>& payload);
+    void enqueueSession(Target& target, const std::shared_ptr<const String>& payload);
+    // 次に送るものが入っているキュー (セッション要約が先)。どちらも空なら nullptr
+    static std::deque<std::shared_ptr<const String>>* nextQueue(Target& target);
+    static bool hasQueued(const Target& target) { return !target.queue.empty() || !target.sessionQueue.empty(); }
+    // HTTP送信先が今は送れない (アドレス未解決・遮断中) なら true。retryMs に送れるようになるまでの残りを入れる
+    bool isBlocked(const Target& target, uint64_t nowMs, unsigned long& retryMs) const;
+    bool deliverQueued(uint64_t currentMillis, const bool* enqueued); // 送信先ごとに最大1件送る
+    int postPayload(Target& target, const IPAddress& address, const String& payload, unsigned long& elapsedMs);
+    void logHealthChange(const Target& target, EndpointHealth::State before, uint64_t nowMs); // 死活状態が変わったらログ出力
 };
 
-#endif // DATA_PUBLISHER_HPP
\ No newline at end of file
+#endif // DATA_PUBLISHER_HPP
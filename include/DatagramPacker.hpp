@@ -0,0 +1,33 @@
+#ifndef DATAGRAM_PACKER_HPP
+#define DATAGRAM_PACKER_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+// 改行区切りのテキスト (line protocol / StatsD) を1つのデータグラムに詰め込むバッファ
+// ネットワークAPIに依存しないので、ホスト上でも同じものが使える
+class DatagramPacker {
+public:
+    // 1500(イーサネットMTU) - 20(IPヘッダー) - 8(UDPヘッダー)
+    static const size_t MAX_DATAGRAM_SIZE = 1472;
+
+    DatagramPacker();
+    void begin(size_t maxSize); // 1データグラムの上限 (MAX_DATAGRAM_SIZE 以下)
+    // 1サンプル分のテキストを追加する。入りきらなければ何もせず false
+    bool append(const char* text, size_t len);
+    bool fits(size_t len) const; // 追加できる長さか
+    void clear();
+
+    const char* data() const;
+    size_t size() const;
+    size_t getSampleCount() const; // 詰め込まれているサンプル数
+    bool empty() const;
+
+private:
+    char buffer[MAX_DATAGRAM_SIZE];
+    size_t maxSize;
+    size_t length;
+    size_t sampleCount;
+};
+
+#endif // DATAGRAM_PACKER_HPP
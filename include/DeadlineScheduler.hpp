@@ -0,0 +1,44 @@
+#ifndef DEADLINE_SCHEDULER_HPP
+#define DEADLINE_SCHEDULER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits.h>
+
+// タスクが抱える複数のタイマーから「次に起きるべき時刻」を求める
+// タスクは期限を登録して prepareSleep() の時間だけ眠り (途中で通知が来れば早く起きる)、起きたら onWake() を呼ぶ。
+// Arduino API に依存しないので、時刻を外から与えればホスト上でもそのまま動く
+// 時刻は Clock の64bit ms (一周しないので大小比較でよい)。残り時間は unsigned long で返す
+class DeadlineScheduler {
+public:
+    static const size_t MAX_TIMERS = 8;
+    static const unsigned long NO_DEADLINE = ULONG_MAX;
+
+    DeadlineScheduler();
+    void set(size_t id, uint64_t dueMs);                               // 期限を設定 (上書き)
+    void setAfter(size_t id, uint64_t nowMs, unsigned long delayMs);
+    void clear(size_t id);
+    bool isArmed(size_t id) const;
+    bool isDue(size_t id, uint64_t nowMs) const;                       // 期限を過ぎているか
+    unsigned long msUntilNext(uint64_t nowMs) const;                   // 最も近い期限までの残り (無ければ NO_DEADLINE)
+
+    // 眠る直前に呼ぶ: 眠るべき時間を返し、期限どおりに起きられたかの統計用に予定時刻を覚える
+    unsigned long prepareSleep(uint64_t nowMs);
+    // 起きた直後に呼ぶ: byEvent は通知 (割り込みなど) で起こされたとき true
+    void onWake(uint64_t nowMs, bool byEvent);
+
+    uint32_t getWakeups() const;        // 起きた回数
+    uint32_t getEventWakeups() const;   // そのうち通知で起きた回数
+    unsigned long getMaxLatenessMs() const; // 期限で起きたときの最大遅れ
+
+private:
+    uint64_t due[MAX_TIMERS];
+    bool armed[MAX_TIMERS];
+    uint64_t plannedWakeMs;
+    bool hasPlannedWake;
+    uint32_t wakeups;
+    uint32_t eventWakeups;
+    unsigned long maxLatenessMs;
+};
+
+#endif // DEADLINE_SCHEDULER_HPP
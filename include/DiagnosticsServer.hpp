@@ -0,0 +1,35 @@
+#ifndef DIAGNOSTICS_SERVER_HPP
+#define DIAGNOSTICS_SERVER_HPP
+
+#include <ESPAsyncWebServer.h>
+#include "config.hpp"
+#include "TimeSeriesStore.hpp"
+
+// ステーションモードで動く診断用のHTTPサーバー (DIAGNOSTICS_HTTP_PORT)
+// 要求は AsyncTCP のタスクで処理されるので、計測・画面・送信の各タスクは止まらない
+//   GET /metrics          機器の内部状態 (Prometheus のテキスト形式。MetricRegistry の一覧をそのまま流す)
+//   GET /history?tier=minute&from=<ms>&to=<ms>
+//                         RPM・速度の履歴 (CSV。tier は second/minute/hour、from/to は省略すると全部)
+//                         時刻の軸は X-Time-Base ヘッダー (unix-ms = NTP で合わせた時刻, uptime-ms = 起動からのms)
+//   GET /profile          処理時間のヒストグラム (FIT2GO_PROFILING のビルドのみ)
+//   GET /profile?reset=1  読んだ後にヒストグラムを空にする
+class DiagnosticsServer {
+public:
+    DiagnosticsServer();
+    typedef bool (*WallClockCheck)();
+    // Wi-Fi の初期化後に1回呼ぶ (接続前でもよい。接続されれば応答する)
+    // historyQuery は /history の問い合わせ (ロックは関数の側で取る)、wallClock は履歴の時刻が UNIX 時刻か
+    void begin(SeriesCsvWriter::Query historyQuery, WallClockCheck wallClock);
+
+private:
+    AsyncWebServer server;
+    bool started;
+    SeriesCsvWriter::Query historyQuery;
+    WallClockCheck wallClock;
+
+    void handleMetrics(AsyncWebServerRequest* request);
+    void handleHistory(AsyncWebServerRequest* request);
+    void handleProfile(AsyncWebServerRequest* request);
+};
+
+#endif // DIAGNOSTICS_SERVER_HPP
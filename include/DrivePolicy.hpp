@@ -0,0 +1,28 @@
+#ifndef DRIVE_POLICY_HPP
+#define DRIVE_POLICY_HPP
+
+#include <stdint.h>
+#include "config.hpp"
+
+// メトリクスを計算するタイミング (BasicMetricsCalculator のテンプレート引数)
+// config.json の drive_type は起動時に1回だけ見て、どちらの実体を使うかを選ぶ
+
+// 一定周期 (METRICS_CALC_INTERVAL_MS) ごとに計算する
+struct TimerDrive {
+    static constexpr DriveType TYPE = DriveType::TIMER_DRIVEN;
+    static constexpr bool HAS_CALC_INTERVAL = true; // 停止中も周期で起きて計算する
+    static bool shouldCalculate(uint64_t nowMs, uint64_t lastCalcMs, unsigned long /*pulseTotal*/, unsigned long /*lastPulseTotal*/) {
+        return nowMs - lastCalcMs >= METRICS_CALC_INTERVAL_MS;
+    }
+};
+
+// 新しいパルスが来たときだけ計算する
+struct EventDrive {
+    static constexpr DriveType TYPE = DriveType::EVENT_DRIVEN;
+    static constexpr bool HAS_CALC_INTERVAL = false;
+    static bool shouldCalculate(uint64_t /*nowMs*/, uint64_t /*lastCalcMs*/, unsigned long pulseTotal, unsigned long lastPulseTotal) {
+        return pulseTotal > lastPulseTotal;
+    }
+};
+
+#endif // DRIVE_POLICY_HPP
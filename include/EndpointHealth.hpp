@@ -0,0 +1,92 @@
+#ifndef ENDPOINT_HEALTH_HPP
+#define ENDPOINT_HEALTH_HPP
+
+#include <stdint.h>
+
+// 送信先ごとの死活管理 (サーキットブレーカー)
+//   CLOSED    : 通常送信
+//   OPEN      : 連続失敗により遮断中。バックオフ期間が明けるまで一切接続しない
+//   HALF_OPEN : バックオフ明けの試験送信 (1回) 中。成功でCLOSED、失敗で再度OPEN
+// PublishScheduler と同じく時刻 (Clock の64bit ms) は引数で受け取るので、ホスト上でも動かせる
+class EndpointHealth {
+public:
+    enum class State : uint8_t {
+        CLOSED,
+        OPEN,
+        HALF_OPEN
+    };
+
+    EndpointHealth();
+    // 遮断までの連続失敗回数, バックオフの初期値/上限, ジッタ用乱数シード
+    void begin(uint16_t failureThreshold, unsigned long baseBackoffMs, unsigned long maxBackoffMs, uint32_t seed);
+    // 今接続を試みてよいか (OPEN→HALF_OPEN の遷移もここで行う)
+    bool allowRequest(uint64_t nowMs);
+    void recordSuccess(uint64_t nowMs);
+    void recordFailure(uint64_t nowMs);
+
+    State getState() const;
+    uint16_t getConsecutiveFailures() const;
+    uint32_t getTotalFailures() const;
+    uint32_t getTotalSuccesses() const;
+    uint32_t getOpenCount() const;                    // OPENに遷移した回数
+    unsigned long getRetryInMs(uint64_t nowMs) const;      // 次の試験送信までの残り時間
+    static const char* stateName(State state);
+
+private:
+    uint16_t failureThreshold;
+    unsigned long baseBackoffMs;
+    unsigned long maxBackoffMs;
+
+    State state;
+    uint16_t consecutiveFailures;
+    uint16_t backoffExponent;  // OPENが連続した回数 (バックオフの指数)
+    uint32_t totalFailures;
+    uint32_t totalSuccesses;
+    uint32_t openCount;
+    uint64_t retryAtMs;        // OPEN中: 次に試験送信してよい時刻
+    uint32_t rngState;         // ジッタ用 xorshift32
+
+    void open(uint64_t nowMs);
+    uint32_t nextRandom();
+};
+
+// 送信待ちの先頭を1件送った結果
+struct SendOutcome {
+    bool attempted = false; // 送った (遮断中・送信時期でなければ false)
+    int httpCode = 0;       // HTTP ステータス (接続できなければ負のエラーコード)
+    bool delivered = false; // 2xx
+};
+
+// 送信待ちの先頭を1件、遮断状態に従って送る (DataPublisher::deliverQueued の送信先1つ分)
+// 送信そのものは post(先頭のペイロード, 終了時刻の出力) に任せ、HTTP ステータスか負のエラーを返させる。
+// 通信に依存しないので、ホスト上では偽のサーバーを post に渡して試せる
+//   - OPEN でバックオフ中なら接続すらしない。明けたら HALF_OPEN で1回だけ試す (送信時期は問わない)
+//   - CLOSED なら due (送信時期が来た・送り残しがある) のときだけ送る
+//   - 2xx は成功。4xx もサーバーが応答している = 生きている。どちらもキューから外す (4xx は再送しても通らない)
+//   - 5xx と接続失敗だけを障害として数え、キューに残して後で再送する
+template <class Queue, class Post>
+SendOutcome sendThroughBreaker(EndpointHealth& health, Queue& queue, uint64_t nowMs, bool due, Post post) {
+    SendOutcome outcome;
+    if (queue.empty())
+        return outcome;
+    EndpointHealth::State before = health.getState();
+    if (!health.allowRequest(nowMs))
+        return outcome;
+    if (before == EndpointHealth::State::CLOSED && !due)
+        return outcome;
+
+    uint64_t doneMs = nowMs;
+    outcome.attempted = true;
+    outcome.httpCode = post(queue.front(), doneMs);
+    if (outcome.httpCode > 0 && outcome.httpCode < 500) {
+        health.recordSuccess(doneMs);
+    } else {
+        health.recordFailure(doneMs);
+    }
+    outcome.delivered = outcome.httpCode >= 200 && outcome.httpCode < 300;
+    if (outcome.delivered || (outcome.httpCode >= 400 && outcome.httpCode < 500))
+        queue.pop_front();
+    return outcome;
+}
+
+#endif // ENDPOINT_HEALTH_HPP
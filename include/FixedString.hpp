@@ -0,0 +1,93 @@
+#ifndef FIXED_STRING_HPP
+#define FIXED_STRING_HPP
+
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+// 容量固定の文字列 (中身はオブジェクトの中に持ち、ヒープを使わない)
+// 表示用の短い文字列や状態メッセージを、String の連結 (+ や +=。そのたびに malloc / realloc が走る) の代わりに組み立てる
+// 入りきらない分は切り捨てる。N は終端の '\0' を含むバイト数。Arduino API に依存しない
+template <size_t N>
+class FixedString {
+public:
+    static_assert(N > 1, "FixedString needs room for at least one character");
+    static const size_t CAPACITY = N - 1; // 入る最大の長さ
+
+    FixedString() : used(0) { text[0] = '\0'; }
+    FixedString(const char* value) : used(0) {
+        text[0] = '\0';
+        append(value);
+    }
+
+    FixedString& operator=(const char* value) {
+        clear();
+        return append(value);
+    }
+
+    void clear() {
+        used = 0;
+        text[0] = '\0';
+    }
+
+    FixedString& append(const char* value) {
+        return value != nullptr ? append(value, strlen(value)) : *this;
+    }
+    FixedString& append(const char* value, size_t valueLength) {
+        if (valueLength > CAPACITY - used)
+            valueLength = CAPACITY - used;
+        memmove(text + used, value, valueLength);
+        used += valueLength;
+        text[used] = '\0';
+        return *this;
+    }
+    FixedString& append(char c) {
+        return append(&c, 1);
+    }
+    // printf と同じ書式で後ろに足す
+    FixedString& appendf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        va_list args;
+        va_start(args, fmt);
+        vappendf(fmt, args);
+        va_end(args);
+        return *this;
+    }
+    // 中身を書式の結果で置き換える
+    FixedString& assignf(const char* fmt, ...) __attribute__((format(printf, 2, 3))) {
+        clear();
+        va_list args;
+        va_start(args, fmt);
+        vappendf(fmt, args);
+        va_end(args);
+        return *this;
+    }
+
+    // 長さを newLength 以下にする (長くはしない)
+    void truncate(size_t newLength) {
+        if (newLength < used) {
+            used = newLength;
+            text[used] = '\0';
+        }
+    }
+
+    const char* c_str() const { return text; }
+    size_t length() const { return used; }
+    bool isEmpty() const { return used == 0; }
+    bool contains(const char* part) const { return strstr(text, part) != nullptr; }
+    bool operator==(const char* other) const { return strcmp(text, other) == 0; }
+    bool operator!=(const char* other) const { return strcmp(text, other) != 0; }
+
+private:
+    char text[N];
+    size_t used;
+
+    void vappendf(const char* fmt, va_list args) {
+        int written = vsnprintf(text + used, N - used, fmt, args);
+        if (written > 0)
+            used += (size_t)written < CAPACITY - used ? (size_t)written : CAPACITY - used;
+        text[used] = '\0';
+    }
+};
+
+#endif // FIXED_STRING_HPP
@@ -0,0 +1,40 @@
+#ifndef HEAP_STATS_HPP
+#define HEAP_STATS_HPP
+
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "config.hpp"
+
+class TaskStats;
+
+// ヒープの状態と、タスクごとの割り当て回数
+// malloc / calloc / realloc をリンカーの --wrap で包み (platformio.ini の build_flags)、呼んだタスクの TaskStats に数える
+// タスクがそのまま処理の単位 (sensing: 計測, network: 送信・Wi-Fi, ui: 画面・状態遷移, storage: SD, log: ログ) になる
+// 登録していないタスク (setup, AsyncTCP のHTTP処理, Wi-Fi/lwIP など) の分は "other" にまとめる
+// 数えるのは回数とバイト数だけで、割り当てごとの記録は持たない。--wrap が無いビルドでは回数は 0 のまま
+// 回数が増え続けるなら、そのタスクの定常処理のどこかで String などを作っている
+class HeapStats {
+public:
+    // /metrics の名前と説明 (TaskStats と共通)
+    static constexpr const char* ALLOCATIONS_METRIC = "fit2go_heap_allocations_total";
+    static constexpr const char* ALLOCATIONS_HELP = "Heap allocations (malloc, calloc, realloc) made by each task.";
+    static constexpr const char* BYTES_METRIC = "fit2go_heap_allocated_bytes_total";
+    static constexpr const char* BYTES_HELP = "Bytes requested from the heap by each task.";
+
+    // タスクの割り当てをその TaskStats に数える (TaskStats::attach() から呼ばれる)
+    static void registerTask(TaskHandle_t handle, TaskStats& stats);
+    // 包んだ malloc などから呼ぶ
+    static void countAllocation(size_t size);
+
+    static uint32_t getOtherAllocations();
+    static void print(); // 空き・最大ブロック・最小空き・登録外タスクの割り当て回数を1行でログに出す
+
+private:
+    static TaskHandle_t tasks[HEAP_MAX_TASKS];
+    static TaskStats* taskStats[HEAP_MAX_TASKS];
+    static std::atomic<size_t> taskCount;
+};
+
+#endif // HEAP_STATS_HPP
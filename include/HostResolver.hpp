@@ -0,0 +1,47 @@
+#ifndef HOST_RESOLVER_HPP
+#define HOST_RESOLVER_HPP
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include "lwip/dns.h"
+
+// 送信先ホスト名の非同期解決とキャッシュ
+// lwIP の dns_gethostbyname をコールバック付きで呼ぶので、解決待ちでブロックしない。
+// キャッシュの期限が切れても、再解決できるまでは最後に成功したアドレスを使い続ける
+class HostResolver {
+public:
+    HostResolver();
+    void begin(const String& host, unsigned long ttlMs);
+    // Wi-Fi接続中に毎ループ呼ぶ。未解決か期限切れなら非同期で解決を開始し、結果を取り込む
+    void update(uint64_t nowMs);
+    // 接続失敗時などに呼ぶ。アドレスは保持したまま、次の update で再解決させる
+    void invalidate();
+    // 使えるアドレスを返す。一度も解決できていなければ false (ブロックはしない)
+    bool getAddress(IPAddress& out) const;
+    // アドレスが無いとき、次の解決の試み (または結果の取り込み) までの残りms。アドレスがあれば0
+    unsigned long getRetryInMs(uint64_t nowMs) const;
+
+    const String& getHost() const;
+    uint32_t getLookupCount() const;   // 解決を開始した回数
+    uint32_t getFailureCount() const;  // 解決に失敗した回数
+
+private:
+    String host;
+    unsigned long ttlMs;
+    IPAddress address;          // 最後に解決できたアドレス
+    bool hasAddress;
+    bool expired;
+    uint64_t resolvedAtMs;
+    uint64_t lastAttemptMs;
+    uint32_t lookupCount;
+    uint32_t failureCount;
+
+    // lwIP(tcpip)タスクのコールバックから書かれる
+    volatile bool lookupInFlight;
+    volatile bool lookupDone;
+    volatile uint32_t lookupResult; // 0 なら失敗
+
+    static void onDnsFound(const char* name, const ip_addr_t* ipaddr, void* arg);
+};
+
+#endif // HOST_RESOLVER_HPP
@@ -0,0 +1,51 @@
+#ifndef LATENCY_HISTOGRAM_HPP
+#define LATENCY_HISTOGRAM_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// 処理時間 (CPUサイクル数) の対数目盛りヒストグラム
+// 2倍ごとの区間をさらに4つに分けた固定のビンに数えるだけなので、1件の記録は数命令で済み、メモリも一定
+// 百分位はビンの上端で返す (誤差は最大で約2割。最大値だけは正確に持つ)
+// 記録は割り込みや複数のタスクから同時に行ってよい。読み出しは止めずに行うので、読んでいる間の記録は入ったり入らなかったりする
+// Arduino API に依存しない
+class LatencyHistogram {
+public:
+    static const uint32_t SUB_BUCKET_BITS = 2;                       // 1オクターブを 2^2 = 4 分割
+    static const uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = (32 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS; // 32bit の値すべてを覆う
+
+    LatencyHistogram();
+    // ISRからも呼ぶので必ず展開させる (IRAM外の関数を呼ばない)
+    inline __attribute__((always_inline)) void record(uint32_t value) {
+        buckets[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        count.fetch_add(1, std::memory_order_relaxed);
+        uint32_t current = max.load(std::memory_order_relaxed);
+        while (value > current && !max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+        }
+    }
+    void reset();
+
+    uint32_t getCount() const;
+    uint32_t getMax() const;
+    // 千分率で指定した百分位 (500 = 中央値, 990 = p99)。記録が無ければ0
+    uint32_t percentile(uint32_t permille) const;
+
+    // 値 → ビン番号。SUB_BUCKETS 未満はそのまま、それ以上は最上位ビットの位置と続く2ビットで決める
+    static inline __attribute__((always_inline)) size_t bucketOf(uint32_t value) {
+        if (value < SUB_BUCKETS)
+            return value;
+        uint32_t msb = 31 - __builtin_clz(value);
+        uint32_t sub = (value >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return (msb - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+    }
+    static uint32_t bucketUpper(size_t index); // ビンに入る最大の値
+
+private:
+    std::atomic<uint32_t> buckets[BUCKET_COUNT];
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> max;
+};
+
+#endif // LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,87 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <Arduino.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "config.hpp"
+#include "LogBuffer.hpp"
+
+// 遅延出力のログ
+// 呼び出し側は時刻と引数をリングに詰めるだけで戻る (UARTの送信を待たない)。書式化とシリアル出力はログタスクが行う
+// 呼び出し箇所ごとに間引き、リングが一杯なら捨てて数える。どちらの数も出力に残す
+// 書式文字列は文字列リテラルにすること (後で読むので)。末尾の改行は不要
+class Log {
+public:
+    template <typename... Args>
+    static inline void write(LogLevel level, LogRateLimiter& site, const char* format, const Args&... args) {
+        uint32_t nowMs = (uint32_t)(esp_timer_get_time() / 1000);
+        uint16_t suppressed = 0;
+        if (!site.allow(nowMs, suppressed))
+            return;
+        if (buffer.push(nowMs, level, suppressed, format, args...))
+            wakeDrainTask();
+    }
+    // 書式と引数の型を printf と同じくコンパイル時に確かめるためだけのもの (呼ばれることはない)
+    static inline void checkFormat(const char*, ...) __attribute__((format(printf, 1, 2))) {}
+
+    // --- ログタスク用 ---
+    // 溜まっている分をすべて out に出す。出した件数を返す
+    static size_t drain(Print& out);
+
+    // 次のメッセージが来るまで眠る (ログタスクから呼ぶ)
+    static void waitForMessages();
+
+    // ログタスクが溜まった分を出し終えるまで待つ (ディープスリープ・再起動の直前に。ログタスク以外から呼ぶ)
+    static void flush(uint32_t timeoutMs);
+
+private:
+    static LogBuffer buffer;
+    static TaskHandle_t drainTask;
+    static std::atomic<bool> drainWaiting;  // ログタスクが空にして眠っている
+    static uint32_t reportedDropped;        // 最後に出力した「捨てた数」
+
+    static inline void wakeDrainTask() {
+        // 眠っているときだけ起こす (続けて書くときは通知しない)
+        if (drainWaiting.load(std::memory_order_relaxed) && drainWaiting.exchange(false, std::memory_order_acq_rel))
+            xTaskNotifyGive(drainTask);
+    }
+};
+
+// 呼び出し箇所ごとに間引きの状態を持つ
+#define LOG_AT(level, format, ...) do { \
+        static LogRateLimiter logSite_; \
+        if (0) \
+            Log::checkFormat(format, ##__VA_ARGS__); \
+        Log::write(level, logSite_, format, ##__VA_ARGS__); \
+    } while (0)
+// 無効なレベル: 引数は型チェックだけして評価しない (ログにしか使わない変数で未使用の警告が出ないように)
+#define LOG_DISCARD(format, ...) do { \
+        if (0) \
+            Log::checkFormat(format, ##__VA_ARGS__); \
+    } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(format, ...) LOG_AT(LogLevel::ERROR, format, ##__VA_ARGS__)
+#else
+#define LOG_E(format, ...) LOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(format, ...) LOG_AT(LogLevel::WARN, format, ##__VA_ARGS__)
+#else
+#define LOG_W(format, ...) LOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(format, ...) LOG_AT(LogLevel::INFO, format, ##__VA_ARGS__)
+#else
+#define LOG_I(format, ...) LOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(format, ...) LOG_AT(LogLevel::DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOG_D(format, ...) LOG_DISCARD(format, ##__VA_ARGS__)
+#endif
+
+#endif // LOG_HPP
@@ -0,0 +1,157 @@
+#ifndef LOG_BUFFER_HPP
+#define LOG_BUFFER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <type_traits>
+#include "config.hpp"
+
+enum class LogLevel : uint8_t {
+    ERROR = LOG_LEVEL_ERROR,
+    WARN = LOG_LEVEL_WARN,
+    INFO = LOG_LEVEL_INFO,
+    DEBUG = LOG_LEVEL_DEBUG
+};
+
+// 1件分。書式文字列はリテラルを指すだけで、引数は型の印を付けて args に詰める (書式化は取り出す側で行う)
+static_assert(LOG_ARG_BYTES <= 255, "LOG_ARG_BYTES must fit in LogRecord::argBytes");
+struct LogRecord {
+    uint32_t timeMs;      // 起動からのms (下位32bit)
+    const char* format;   // 文字列リテラル (呼び出し元の寿命に依存しない)
+    uint8_t level;        // LogLevel
+    uint8_t argBytes;     // args の使用バイト数
+    uint16_t suppressed;  // この呼び出し箇所で直前に間引いた数
+    uint8_t args[LOG_ARG_BYTES];
+};
+
+// 引数を型の印 + 値の形で詰める。文字列は中身をコピーする (String::c_str() などの一時的な文字列も渡せる)
+// 入りきらない引数は捨て、書式化のときに "?" になる。長い文字列は入るところまでで切る
+class LogArgWriter {
+public:
+    enum Tag : uint8_t {
+        TAG_INT32,
+        TAG_UINT32,
+        TAG_INT64,
+        TAG_UINT64,
+        TAG_DOUBLE,
+        TAG_STRING,           // 長さ (u8) + 中身 (終端なし)
+        TAG_STRING_TRUNCATED  // 同上、途中で切った
+    };
+
+    LogArgWriter(uint8_t* data, size_t capacity) : data(data), capacity(capacity), length(0), full(false) {}
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type put(T value) {
+        if (sizeof(T) <= 4) {
+            if (std::is_signed<T>::value)
+                putScalar(TAG_INT32, (int32_t)value);
+            else
+                putScalar(TAG_UINT32, (uint32_t)value);
+        } else {
+            if (std::is_signed<T>::value)
+                putScalar(TAG_INT64, (int64_t)value);
+            else
+                putScalar(TAG_UINT64, (uint64_t)value);
+        }
+    }
+    void put(double value) { putScalar(TAG_DOUBLE, value); }
+    void put(const char* value) { putString(value != nullptr ? value : "(null)"); }
+    void put(const void* value) { putScalar(TAG_UINT32, (uint32_t)(uintptr_t)value); }
+
+    size_t getLength() const { return length; }
+
+    // 可変長引数をまとめて詰める
+    void putAll() {}
+    template <typename T, typename... Rest>
+    void putAll(const T& first, const Rest&... rest) {
+        put(first);
+        putAll(rest...);
+    }
+
+private:
+    uint8_t* data;
+    size_t capacity;
+    size_t length;
+    bool full; // 入りきらない引数があった (以降の引数も入れない。順番がずれないように)
+
+    template <typename T>
+    void putScalar(Tag tag, T value) {
+        if (full || length + 1 + sizeof(T) > capacity) {
+            full = true;
+            return;
+        }
+        data[length++] = tag;
+        memcpy(data + length, &value, sizeof(T));
+        length += sizeof(T);
+    }
+    void putString(const char* value);
+};
+
+// 呼び出し箇所ごとの間引き (LOG_RATE_WINDOW_MS ごとに LOG_RATE_BURST 件まで通す)
+// 各箇所の static 変数として置く。定数で初期化できるので、初回呼び出し時の初期化処理は入らない
+// 同じ箇所を複数のタスクが同時に通ると数がずれることがあるが、ログの間引きなので許容する
+class LogRateLimiter {
+public:
+    constexpr LogRateLimiter() : windowStartMs(0), passed(0), suppressed(0) {}
+    // 通してよければ true。suppressedOut に前回通した後に間引いた数を返す
+    bool allow(uint32_t nowMs, uint16_t& suppressedOut);
+
+private:
+    uint32_t windowStartMs;
+    uint16_t passed;
+    uint16_t suppressed;
+};
+
+// 固定長のメッセージの待ち行列 (書き手は複数、読み手は1つ)
+// 書き手は枠を1つ予約して中身を詰め、番号を進めて公開する。ロックを取らず、待たない
+// 一杯なら新しいメッセージを捨てて数える (出力が追いつかなくても書き手は止まらない)
+// 各枠の番号で空き・使用中を見分ける有界キュー (Vyukov の方式)。Arduino API に依存しない
+class LogBuffer {
+public:
+    static const size_t CAPACITY = LOG_RING_SIZE;
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+    LogBuffer();
+
+    template <typename... Args>
+    bool push(uint32_t timeMs, LogLevel level, uint16_t suppressed, const char* format, const Args&... args) {
+        uint32_t position;
+        Slot* slot = reserve(position);
+        if (slot == nullptr)
+            return false;
+        LogRecord& record = slot->record;
+        record.timeMs = timeMs;
+        record.format = format;
+        record.level = (uint8_t)level;
+        record.suppressed = suppressed;
+        LogArgWriter writer(record.args, sizeof(record.args));
+        writer.putAll(args...);
+        record.argBytes = (uint8_t)writer.getLength();
+        slot->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 読み手 (1つだけ): 最も古い1件を取り出す。空なら false
+    bool pop(LogRecord& out);
+    bool isEmpty() const; // どのタスクから呼んでもよい
+    uint32_t getDropped() const; // 一杯で捨てた総数
+
+    // 1件を1行の文字列にする (末尾の改行は付けない)。書いた長さを返す
+    static size_t format(const LogRecord& record, char* out, size_t size);
+
+private:
+    struct Slot {
+        std::atomic<uint32_t> sequence; // position なら空き、position + 1 なら読める
+        LogRecord record;
+    };
+    Slot slots[CAPACITY];
+    std::atomic<uint32_t> enqueuePosition;
+    std::atomic<uint32_t> dequeuePosition; // 進めるのは読み手だけ (isEmpty() は他のタスクからも呼ぶ)
+    std::atomic<uint32_t> dropped;
+
+    Slot* reserve(uint32_t& position);
+};
+
+#endif // LOG_BUFFER_HPP
@@ -0,0 +1,116 @@
+#ifndef METRIC_REGISTRY_HPP
+#define METRIC_REGISTRY_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// 機器の内部状態を Prometheus のテキスト形式で出すためのカウンター・ゲージ・ヒストグラム
+// 各値は作ったときに一覧 (MetricRegistry) へ自分を繋ぐ。グローバル変数として置くか、タスク起動前に new する
+// (一覧を読むのは HTTP のタスクなので、タスクが動き出した後には増やさない)
+// 値の更新はアトミック操作だけなので、どのタスクからでも (カウンターは ISR からも) 呼べる。Arduino API に依存しない
+
+enum class MetricType : uint8_t {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM
+};
+
+class Metric {
+public:
+    const char* getName() const { return name; }
+
+protected:
+    // labels は波括弧の中身 (例: "task=\"ui\"")。なければ nullptr
+    Metric(MetricType type, const char* name, const char* help, const char* labels);
+    ~Metric() {} // 一覧から外す手段はないので、作ったものは最後まで残す
+
+private:
+    friend class MetricRegistry;
+    friend class MetricWriter;
+    MetricType type;
+    const char* name;
+    const char* help;
+    const char* labels;
+    Metric* next;
+};
+
+// 増えるだけの値 (32bit。一周すると Prometheus 側ではリセットと同じに見える)
+class MetricCounter : public Metric {
+public:
+    MetricCounter(const char* name, const char* help, const char* labels = nullptr);
+    inline __attribute__((always_inline)) void increment(uint32_t amount = 1) {
+        value.fetch_add(amount, std::memory_order_relaxed);
+    }
+    void set(uint32_t newValue); // 起動時に前回からの値を引き継ぐときだけ
+    uint32_t get() const;
+
+private:
+    std::atomic<uint32_t> value;
+};
+
+// 上下する値。set() で入れるか、読み出しのたびに呼ぶ関数を渡す (ヒープ残量など)
+class MetricGauge : public Metric {
+public:
+    typedef float (*Reader)();
+    MetricGauge(const char* name, const char* help, const char* labels = nullptr);
+    MetricGauge(const char* name, const char* help, Reader reader, const char* labels = nullptr);
+    void set(float newValue);
+    float get() const;
+
+private:
+    std::atomic<float> value;
+    Reader reader;
+};
+
+// µs で観測し、秒で出すヒストグラム。区切り (上限、昇順) は呼び出し側の定数配列を指す
+class MetricHistogram : public Metric {
+public:
+    static const size_t MAX_BOUNDS = 12;
+    MetricHistogram(const char* name, const char* help, const uint32_t* boundsUs, size_t boundCount,
+                    const char* labels = nullptr);
+    void observeUs(uint32_t us);
+
+private:
+    friend class MetricWriter;
+    const uint32_t* boundsUs;
+    size_t boundCount;
+    std::atomic<uint32_t> counts[MAX_BOUNDS + 1]; // 最後は +Inf (どの区切りも超えた)
+    std::atomic<uint64_t> sumUs;
+};
+
+// 登録済みの値の一覧 (同じ名前のものは並べて置く。HELP と TYPE を1回だけ出すため)
+class MetricRegistry {
+public:
+    static void add(Metric* metric);
+    static const Metric* first();
+
+private:
+    static Metric* head;
+};
+
+// 一覧を先頭から順にテキスト形式にする。出すのは1行分ずつなので、全体を入れる大きな文字列は作らない
+// read() を呼ぶたびに続きを書き、全部書き終えたら 0 を返す (チャンク転送のコールバックからそのまま呼べる)
+class MetricWriter {
+public:
+    MetricWriter();
+    size_t read(uint8_t* buffer, size_t maxLength);
+
+private:
+    enum Step : uint8_t { STEP_HELP, STEP_TYPE, STEP_VALUE, STEP_BUCKET, STEP_SUM, STEP_COUNT, STEP_NEXT };
+
+    const Metric* metric;
+    const Metric* previous;  // 直前に出したもの (同じ名前なら HELP と TYPE を省く)
+    Step step;
+    size_t bucket;
+    uint64_t cumulative;     // ヒストグラムの累積 (バケットを1つずつ読んで足す。+Inf と _count はこの合計)
+    char line[192];
+    size_t lineLength;
+    size_t linePosition;
+
+    bool nextLine();
+    void beginMetric();
+    void formatLabels(char* out, size_t size, const char* extraName, const char* extraValue) const;
+};
+
+#endif // METRIC_REGISTRY_HPP
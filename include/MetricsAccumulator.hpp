@@ -0,0 +1,117 @@
+#ifndef METRICS_ACCUMULATOR_HPP
+#define METRICS_ACCUMULATOR_HPP
+
+#include <stdint.h>
+
+// 距離・カロリー・時間を64bit整数で積算する計算の中核
+// float の累積値に1区間分を足すと、合計が大きくなったとき増分が丸めで消える (数千kmに対して4.4mは float の分解能以下)。
+// また ESP32 のFPUは単精度のみで double はソフトウェア演算になる。
+// そこで µm / mcal / ms の整数で積算し、割り切れない端数は次の区間へ繰り越す。float は表示・送信用に整数から作るだけ。
+// 機種ごとの係数は ChairModel のテンプレート引数で与えるので、計算の中では定数に畳み込まれる。
+// Arduino API に依存しないので、ホスト上でもそのまま動く
+class MetricsAccumulator {
+public:
+    struct Totals {
+        uint64_t distanceUm = 0;   // 距離 (µm)
+        uint64_t caloriesMcal = 0; // カロリー (mcal = 10^-6 kcal)
+        uint64_t timeMs = 0;       // タイマー動作中の時間 (ms)
+    };
+
+    MetricsAccumulator();
+    void restoreCumulative(const Totals& totals); // 保存済みの累積値から再開 (セッションは0から)
+    void resetSession();                          // セッション分だけ0に戻す (累積と端数はそのまま)
+
+    // 1区間分のパルス数と長さからRPMを求め、距離とカロリーをセッション・累積の両方に加算する
+    // RPMが上限を超えたら直前の有効値を使う。戻り値はこの区間のRPM (1/1000 rpm)
+    template <class Chair>
+    uint32_t addInterval(uint32_t pulses, uint32_t intervalMs);
+    // RPMを外から与える版 (CadenceEstimator の推定値を使うとき)。距離はパルス数、カロリーは与えたRPMで計算する
+    template <class Chair>
+    void addIntervalAtRpm(uint32_t pulses, uint32_t intervalMs, uint32_t milliRpm);
+    void addActiveTime(uint32_t ms);              // タイマー動作中の時間を加算
+
+    const Totals& session() const;
+    const Totals& cumulative() const;
+    uint32_t getMilliRpm() const;                 // 直近の区間のRPM (1/1000 rpm)
+    bool wasRpmSubstituted() const;               // 直近の区間で異常値を直前の値に置き換えたか
+
+    static float toKm(uint64_t distanceUm);
+    static float toKcal(uint64_t caloriesMcal);
+    static uint64_t fromKm(float km);             // 整数値を持たない古い保存データの読み込み用
+    static uint64_t fromKcal(float kcal);
+
+private:
+    static const uint64_t CALORIE_SCALE = 100000000ULL; // 10^-8 mcal → mcal
+    static const uint32_t CALORIE_CHUNK_MS = 1UL << 28;  // 係数×RPM×時間 が64bitに収まるよう長い区間は分けて掛ける
+
+    Totals sessionTotals;
+    Totals cumulativeTotals;
+    uint32_t milliRpm;
+    uint32_t lastValidMilliRpm;
+    bool rpmSubstituted;
+    uint32_t distanceRemainder; // 距離の端数 (µm × PULSES_PER_REV 単位、PULSES_PER_REV 未満)
+    uint64_t calorieRemainder;  // カロリーの端数 (10^-8 mcal 単位、10^8 未満)
+
+    template <class Chair>
+    void accumulate(uint32_t pulses, uint32_t intervalMs); // milliRpm が決まった後の距離・カロリー計算
+    void add(uint64_t distanceUm, uint64_t caloriesMcal);
+};
+
+template <class Chair>
+uint32_t MetricsAccumulator::addInterval(uint32_t pulses, uint32_t intervalMs) {
+    static_assert(Chair::PULSES_PER_REV > 0, "PULSES_PER_REV must be positive");
+    const uint32_t maxMilliRpm = Chair::MAX_RPM * 1000;
+
+    rpmSubstituted = false;
+    // RPM (1/1000 rpm) = パルス数 / PULSES_PER_REV × 60000 / 区間ms × 1000 (四捨五入)
+    if (intervalMs > 0) {
+        uint64_t denominator = (uint64_t)Chair::PULSES_PER_REV * intervalMs;
+        uint64_t rpm = ((uint64_t)pulses * 60000000ULL + denominator / 2) / denominator;
+        if (rpm > maxMilliRpm) {
+            milliRpm = lastValidMilliRpm; // 異常値補正
+            rpmSubstituted = true;
+        } else {
+            milliRpm = (uint32_t)rpm;
+        }
+    } else {
+        milliRpm = lastValidMilliRpm;
+    }
+    lastValidMilliRpm = milliRpm;
+
+    accumulate<Chair>(pulses, intervalMs);
+    return milliRpm;
+}
+
+template <class Chair>
+void MetricsAccumulator::addIntervalAtRpm(uint32_t pulses, uint32_t intervalMs, uint32_t rpm) {
+    rpmSubstituted = false;
+    milliRpm = rpm;
+    lastValidMilliRpm = rpm;
+    accumulate<Chair>(pulses, intervalMs);
+}
+
+template <class Chair>
+void MetricsAccumulator::accumulate(uint32_t pulses, uint32_t intervalMs) {
+    // 距離: パルス数 × 1回転の距離 / PULSES_PER_REV。割り切れない分は次回へ (1パルス1回転なら割り算は消える)
+    uint64_t distanceNumerator = (uint64_t)pulses * Chair::REV_DISTANCE_UM + distanceRemainder;
+    uint64_t distanceUm = distanceNumerator / Chair::PULSES_PER_REV;
+    distanceRemainder = (uint32_t)(distanceNumerator % Chair::PULSES_PER_REV);
+
+    // カロリー: 係数(10^-8 kcal/s/rpm) × RPM(10^-3) × 時間(10^-3 s) = 10^-14 kcal = 10^-8 mcal 単位
+    uint64_t caloriesMcal = 0;
+    uint64_t ratePerMs = (uint64_t)Chair::CALORIES_K1_E8 * milliRpm;
+    uint32_t remainingMs = intervalMs;
+    while (remainingMs > 0) {
+        uint32_t chunkMs = remainingMs;
+        if (chunkMs > CALORIE_CHUNK_MS)
+            chunkMs = CALORIE_CHUNK_MS;
+        uint64_t calorieNumerator = ratePerMs * chunkMs + calorieRemainder;
+        caloriesMcal += calorieNumerator / CALORIE_SCALE;
+        calorieRemainder = calorieNumerator % CALORIE_SCALE;
+        remainingMs -= chunkMs;
+    }
+
+    add(distanceUm, caloriesMcal);
+}
+
+#endif // METRICS_ACCUMULATOR_HPP
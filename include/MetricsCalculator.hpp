@@ -6,39 +6,115 @@
 #include "TrackerData.hpp"
 #include "PulseCounter.hpp"
 #include "Storage.hpp"
+#include "Clock.hpp"
+#include "MetricsAccumulator.hpp"
+#include "CadenceEstimator.hpp"
+#include "SessionSummary.hpp"
+#include "CadenceAnalyzer.hpp"
+#include "DrivePolicy.hpp"
+#include "ChairModel.hpp"
+#include <limits.h>
+#include <memory>
 
+// 計測タスクから他のタスクへ渡す計測結果のコピー
+// 他のタスクは MetricsCalculator を直接触らず、これだけを読む
+struct MetricsSnapshot {
+    TrackerData data;
+    bool moving = false;
+    bool timerRunning = false;
+    uint64_t lastPulseObservedMs = 0;
+    unsigned long pulseCount = 0;     // PulseCounter の累積カウント (デバッグ表示用)
+    uint32_t updateSequence = 0;      // update() が true を返すたびに増える (EVENT駆動の送信判定用)
+    CadenceAnalysis cadence;          // セッション中のゾーン別時間と運動/休みの区間
+    // 入力チャンネルごとの計測値 (channels[0] は data と同じ)
+    // 上の状態 (moving など) は全チャンネルをまとめたもの。cadence と pulseCount はチャンネル0のもの
+    uint8_t channelCount = 1;
+    TrackerData channels[PULSE_MAX_CHANNELS];
+};
+
+// 駆動方式・機種によらない部分 (移動/停止の判定、セッション管理、スナップショット)
+// 実体は BasicMetricsCalculator<駆動方式, 機種>。どれを使うかは create() で起動時に1回だけ選ぶ
 class MetricsCalculator {
 public:
-    MetricsCalculator(PulseCounter& pc, Storage& storage);
-    void begin(DriveType type); // 初期化 (累積データロード含む)
-    bool update(unsigned long currentMillis); // メトリクス更新処理
+    virtual ~MetricsCalculator() {}
+    // config.json の drive_type に合った実体を作る
+    static std::unique_ptr<MetricsCalculator> create(DriveType type, PulseCounter& pc, Storage& storage, Clock& clock);
+
+    void begin(); // 初期化 (累積データロード含む)
+    virtual bool update(uint64_t currentMillis) = 0; // メトリクス更新処理 (時刻は clock.nowMs())
+    virtual DriveType getDriveType() const = 0;
     void resetSession(); // 現在のセッションデータのみリセット
     const TrackerData& getData() const; // 計算済みデータを取得
     bool isMoving() const; // SLEEP_TIMEOUT_MS 以内か (活動中か)
     bool isTimerRunning() const; // ★ 追加: TIMER_STOP_DELAY_MS 以内か (タイマー動作中か) ★
     void saveCumulativeData(); // (現状未使用) NVSへの累積データ保存用だった名残
-    unsigned long getLastPulseObservedMs() const; // 最後にパルスを観測した時刻
+    uint64_t getLastPulseObservedMs() const; // 最後にパルスを観測した時刻
+    uint32_t getUpdateSequence() const; // update() が true を返した回数
     void stoppingDataUpdate();
+    void fillSnapshot(MetricsSnapshot& out) const; // 現在の状態をスナップショットにコピー
+    // 終わったセッションの要約があれば取り出す (計測タスクが update() の後に呼ぶ)
+    bool takeFinishedSession(SessionSummary& out);
+    // 次に update() を呼ぶべき時刻までの残りms (計算周期・タイマー停止・移動停止のうち最も近いもの)
+    // パルスが来なければ状態が変わらない場合は NO_DEADLINE
+    virtual unsigned long msUntilNextDeadline(uint64_t currentMillis) const = 0;
+    static const unsigned long NO_DEADLINE = ULONG_MAX;
+
+protected:
+    // pulsesPerRev / minPulsePeriodUs は機種 (ChairModel) から決まる値。ケイデンス推定の設定に使う
+    MetricsCalculator(PulseCounter& pc, Storage& storage, Clock& clock, uint32_t pulsesPerRev, uint32_t minPulsePeriodUs);
 
-private:
     PulseCounter& pulseCounter; // パルスカウンターへの参照
     Storage& storage;           // ストレージへの参照
+    Clock& clock;               // 時刻源 (計算開始時刻の基準)
     TrackerData data;           // 計測データ保持用
+    MetricsAccumulator accumulator; // 距離・カロリー・時間の整数積算 (data の積算値はここから作る)
+    CadenceEstimator cadence;       // パルス間隔からのRPM推定 (ノイズパルスの除去も行う)
+    const uint32_t pulsesPerRev;
+    const uint32_t minPulsePeriodUs; // これより短いパルス間隔はあり得ない (MAX_RPM 相当)
+    unsigned long rejectedPulses;    // ノイズとして捨てたが、まだ区間のパルス数から引いていない数
+    unsigned long bootPulses;        // begin() までに数えたパルス (起動中の分。最初のセッションの距離に入れる)
+    SessionSummaryBuilder sessionBuilder; // 進行中のセッションの要約
+    CadenceAnalyzer cadenceAnalyzer;      // 進行中のセッションのゾーン・区間
+    SessionSummary finishedSession;       // 終わったが、まだ取り出されていない要約
+    bool hasFinishedSession;
 
-    unsigned long lastCalcTimeMs;       // 前回計算した時刻
-    unsigned long lastPulseObservedMs;  // 最後にパルスを検出した時刻
+    uint64_t lastCalcTimeMs;            // 前回計算した時刻
+    uint64_t lastPulseObservedMs;       // 最後にパルスを検出した時刻
     unsigned long lastTotalPulseCount;  // 前回の計算時の累積パルス数 (リセット後からの)
 
     bool moving;        // SLEEP_TIMEOUT_MS 以内にパルスがあったか
     bool timer_running; // TIMER_STOP_DELAY_MS 以内にパルスがあったか
-    DriveType drive_type;
 
-    float lastValidRpm;
     float lastValidSpeedKmh;
     float lastValidMets;
+    uint32_t updateSequence;
 
     // 内部計算用メソッド
-    void calculateMetrics(unsigned long intervalPulses, unsigned long intervalMs);
+    void trackMovement(const PulseSnapshot& pulse, uint64_t currentMillis); // 動き出し・タイマー停止・移動停止の判定
+    void drainPulsePeriods(); // ISRが記録したパルス間隔をすべてケイデンス推定に入れる
+    unsigned long takeValidPulses(unsigned long intervalPulses); // 区間のパルス数からノイズの分を引く
+    unsigned long takeIntervalPulses(unsigned long currentPulseTotal) const; // 前回計算からのパルス数
+    void finishInterval(unsigned long currentPulseTotal, uint64_t currentMillis); // 計算した区間を締める
+    unsigned long msUntilMovementDeadline(uint64_t currentMillis) const; // タイマー停止・移動停止までの残り
+    static unsigned long msUntil(uint64_t deadlineMs, uint64_t currentMillis);
+    void syncTotals(); // 整数の積算値を data に写し、表示・送信用の float を作る
+    void closeSession(uint64_t endMs); // 進行中のセッションを要約にして閉じる
+    void updateMets(); // 速度から METs を決める
+};
+
+// 駆動方式 (TimerDrive / EventDrive) と機種 (ChairModel) を固定した計算器
+// 判定と係数がコンパイル時に決まるので、update() の中に実行時の分岐や浮動小数点の係数計算が残らない
+// 実体化は MetricsCalculator.cpp で明示的に行う
+template <class Drive, class Chair>
+class BasicMetricsCalculator final : public MetricsCalculator {
+public:
+    BasicMetricsCalculator(PulseCounter& pc, Storage& storage, Clock& clock);
+    bool update(uint64_t currentMillis) override;
+    DriveType getDriveType() const override;
+    unsigned long msUntilNextDeadline(uint64_t currentMillis) const override;
+
+private:
+    void calculateMetrics(unsigned long intervalPulses, unsigned long intervalMs, uint64_t usSinceLastPulse);
 };
 
 #endif // METRICS_CALCULATOR_HPP
\ No newline at end of file
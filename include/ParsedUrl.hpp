@@ -0,0 +1,18 @@
+#ifndef PARSED_URL_HPP
+#define PARSED_URL_HPP
+
+#include <Arduino.h>
+
+// 送信先URLを分解したもの (begin時に1回だけ解析し、送信のたびには解析しない)
+struct ParsedUrl {
+    String scheme;      // "http" / "https" / "udp"
+    String host;        // ホスト名 (またはIPアドレス文字列)
+    uint16_t port = 0;  // 省略時は scheme の既定ポート
+    String path = "/";  // パス + クエリ
+
+    // "scheme://host[:port][/path]" を解析する。失敗したら false
+    bool parse(const String& url);
+    bool isHttps() const;
+};
+
+#endif // PARSED_URL_HPP
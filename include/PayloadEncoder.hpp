@@ -0,0 +1,40 @@
+#ifndef PAYLOAD_ENCODER_HPP
+#define PAYLOAD_ENCODER_HPP
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "config.hpp"
+#include "TrackerData.hpp"
+#include "SessionSummary.hpp"
+
+// TrackerData を送信用ペイロードに変換する
+// 1サンプルにつき形式ごとに1回だけ呼び、結果を全送信先で共有する
+class PayloadEncoder {
+public:
+    // 指定形式でエンコード (out は上書き)
+    static void encode(PayloadFormat format, const TrackerData& data, uint64_t timestampMs,
+                       const char* deviceId, String& out);
+    // 複数チャンネル分をまとめて1つのペイロードにする (1チャンネルなら encode() と同じ従来の形)
+    static void encodeBatch(PayloadFormat format, const TrackerData* channels, size_t channelCount,
+                            uint64_t timestampMs, const char* deviceId, String& out);
+    // 従来のJSONペイロード
+    static void encodeJson(const TrackerData& data, uint64_t timestampMs, const char* deviceId, String& out);
+    // InfluxDB line protocol (1行, 改行なし, タイムスタンプはms精度)
+    // channel が0以上なら channel タグを付ける。戻り値は書き込んだ文字数 (バッファ不足なら0)
+    static size_t encodeLineProtocol(const TrackerData& data, uint64_t timestampMs, const char* deviceId,
+                                     char* buf, size_t bufSize, int channel = -1);
+    // StatsD ゲージ (1メトリクス1行, 改行区切り)。channel が0以上なら名前に ch<n> を挟む
+    static size_t encodeStatsd(const TrackerData& data, const char* deviceId, char* buf, size_t bufSize, int channel = -1);
+    // 終わったセッションの要約 (session_end イベント)。out は上書き。StatsD では送らないので空になる
+    // deviceId が nullptr なら device_id を入れない (SDの /sessions.jsonl 用)
+    static void encodeSession(PayloadFormat format, const SessionSummary& summary, const char* deviceId, String& out);
+    static void encodeSessionJson(const SessionSummary& summary, const char* deviceId, String& out);
+    static size_t encodeSessionLineProtocol(const SessionSummary& summary, const char* deviceId, char* buf, size_t bufSize);
+    // HTTPのContent-Type
+    static const char* contentType(PayloadFormat format);
+
+private:
+    static void fillJson(JsonObject obj, const TrackerData& data); // 1チャンネル分の計測値
+};
+
+#endif // PAYLOAD_ENCODER_HPP
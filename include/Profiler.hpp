@@ -0,0 +1,95 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include "config.hpp"
+
+// 処理時間を計る区間 (ヒストグラムは区間ごとに1つ)
+enum class ProfileStage : uint8_t {
+    PULSE_ISR,              // PCNT 割り込み (全チャンネル共通のISR 1回分)
+    METRICS_UPDATE,         // MetricsCalculator::update() (1チャンネル分)
+    STATE_IDLE,             // UIタスクの状態別ハンドラ
+    STATE_TRACKING,
+    STATE_STOPPING,
+    STATE_WIFI_SETUP,
+    STATE_WIFI_CONNECTING,
+    STATE_WIFI_SCANNING,
+    STATE_AP_CONFIG,
+    DISPLAY_UPDATE,         // Display::update()
+    PUBLISH_DNS,            // 送信の各段階 (PublishTiming と同じ区切り)
+    PUBLISH_CONNECT,
+    PUBLISH_TLS,
+    PUBLISH_SEND,
+    PUBLISH_RESPONSE,
+    SD_WRITE,               // SDへの書き込み1件
+    COUNT
+};
+
+#if FIT2GO_PROFILING
+
+#include <Arduino.h>
+#include "LatencyHistogram.hpp"
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// CPUのサイクルカウンタ (Xtensa の CCOUNT)。コアごとのカウンタなので、計る区間は同じコアで始めて終える
+// (タスクはすべてコア固定)。電源管理でクロックが下がっている間はサイクルが遅く進むので、
+// 待ちを含む区間 (送信など) は実時間より短く出る
+static inline __attribute__((always_inline)) uint32_t profileCycles() {
+#if defined(__XTENSA__)
+    uint32_t cycles;
+    __asm__ __volatile__("rsr %0, ccount" : "=a"(cycles));
+    return cycles;
+#elif defined(__x86_64__) || defined(__i386__)
+    return (uint32_t)__rdtsc(); // ホストでのテスト用
+#else
+    return 0;
+#endif
+}
+
+// 区間ごとのヒストグラムを持ち、シリアルやHTTPへ表にして出す
+// 記録も読み出しも止めずに行う (計測中に読んでもよい)
+class Profiler {
+public:
+    static inline __attribute__((always_inline)) void record(ProfileStage stage, uint32_t cycles) {
+        histograms[(size_t)stage].record(cycles);
+    }
+    static void reset();
+    static const LatencyHistogram& get(ProfileStage stage);
+    static const char* stageName(ProfileStage stage);
+    // 記録のある区間を1行ずつ: 件数、p50 / p99 / 最大 (µs)
+    static void report(Print& out);
+
+private:
+    static LatencyHistogram histograms[(size_t)ProfileStage::COUNT];
+};
+
+// 生成から破棄までを1件として記録する
+class ProfileScope {
+public:
+    explicit inline __attribute__((always_inline)) ProfileScope(ProfileStage stage) : stage(stage), start(profileCycles()) {}
+    inline __attribute__((always_inline)) ~ProfileScope() { Profiler::record(stage, profileCycles() - start); }
+
+private:
+    ProfileStage stage;
+    uint32_t start;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// ブロックの終わりまでを計る
+#define PROFILE_SCOPE(stage) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(stage)
+// 始点と終点が別のブロックにある場合
+#define PROFILE_BEGIN(name) uint32_t name = profileCycles()
+#define PROFILE_END(stage, name) Profiler::record(stage, profileCycles() - (name))
+
+#else // FIT2GO_PROFILING
+
+// 無効時は何も残さない
+#define PROFILE_SCOPE(stage) do {} while (0)
+#define PROFILE_BEGIN(name) do {} while (0)
+#define PROFILE_END(stage, name) do {} while (0)
+
+#endif // FIT2GO_PROFILING
+
+#endif // PROFILER_HPP
@@ -0,0 +1,47 @@
+#ifndef PUBLISH_SCHEDULER_HPP
+#define PUBLISH_SCHEDULER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 送信タイミングを決める適応スケジューラ
+// Arduino API に依存しないので、時刻 (Clock の64bit ms) を外から与えればホスト上でもそのまま動く
+class PublishScheduler {
+public:
+    PublishScheduler();
+    // 最短間隔, ハートビート間隔(定常時), 帯域予算(bytes/s) を設定
+    void begin(unsigned long minIntervalMs, unsigned long heartbeatMs, uint32_t budgetBytesPerSec);
+    // 最新のRPM/速度を観測して変化率を更新
+    void observe(uint64_t nowMs, float rpm, float speedKmh);
+    // 今送信すべきか
+    bool shouldPublish(uint64_t nowMs);
+    // 次に shouldPublish() が true になりうるまでの残りms (0=今すぐ)
+    unsigned long msUntilDue(uint64_t nowMs) const;
+    // 送信結果をフィードバック (ペイロードサイズ, 往復時間)
+    void onPublished(uint64_t nowMs, size_t payloadBytes, unsigned long rttMs);
+
+    unsigned long getTargetIntervalMs() const; // 現在の目標送信間隔
+    unsigned long getSmoothedRttMs() const;    // 平滑化済みRTT
+    float getActivity() const;                 // 変化の大きさ (0.0=定常 .. 1.0=急変)
+
+private:
+    unsigned long minIntervalMs;
+    unsigned long heartbeatMs;
+    uint32_t budgetBytesPerSec;
+
+    uint64_t lastObserveMs;
+    uint64_t lastPublishMs;
+    uint64_t lastRefillMs;
+    float lastRpm;
+    float lastSpeedKmh;
+    float activity;        // 正規化した変化率のEMA
+    float smoothedRttMs;   // RTTのEMA
+    float avgPayloadBytes; // ペイロードサイズのEMA
+    float tokens;          // 帯域予算のトークンバケット (bytes)
+    bool hasObservation;
+    bool hasPublished;
+
+    void refillTokens(uint64_t nowMs);
+};
+
+#endif // PUBLISH_SCHEDULER_HPP
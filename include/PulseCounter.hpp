@@ -4,30 +4,90 @@
 #include "driver/pcnt.h"
 #include "driver/gpio.h"
 #include "config.hpp"
+#include "SeqLock.hpp"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <atomic>
 
+// ISRが更新するパルス情報の一貫したコピー
+struct PulseSnapshot {
+    unsigned long count = 0;        // 累積パルス数
+    uint64_t lastPulseMs = 0;       // 最後のパルスの時刻 (SystemClock と同じ時間軸のms, 0=まだ無い)
+    uint32_t periodUs = 0;          // 直前2パルスの間隔 (us, 0=まだ1パルスしか無い)
+};
+
+// 1チャンネル (椅子1台) 分の入力設定 (config.json の "channels" の要素)
+struct PulseChannelConfig {
+    int pin = PULSE_INPUT_PIN;
+    uint16_t filter = PCNT_FILTER_VALUE; // PCNTノイズフィルタ値 (APBクロック数, 最大1023)
+
+    bool operator==(const PulseChannelConfig& other) const { return pin == other.pin && filter == other.filter; }
+    bool operator!=(const PulseChannelConfig& other) const { return !(*this == other); }
+};
+
+// 1チャンネル分のパルスカウンタ。チャンネル n は PCNT ユニット PCNT_UNIT + n を使う
+// 割り込みは全チャンネルで1つのISRを共有し、割り込み状態のビットが立っているユニットだけを処理する
+// (止まっている椅子がいくつあっても、ISRの処理量はパルスが来たチャンネルの数だけで決まる)
 class PulseCounter {
 public:
-    PulseCounter(int pulse_pin);
+    PulseCounter(int pulse_pin, uint8_t channel = 0, uint16_t filter = PCNT_FILTER_VALUE);
     bool begin();
+    // 数えるのをやめ、ISRがこのユニットを見ないようにする (設定を変えて作り直す前に呼ぶ)
+    // ソフトウェアのカウントと、取り出していないパルス間隔も捨てる
+    void end();
+    uint8_t getChannel() const;
+    int getPin() const;
+    // カウント・時刻・パルス間隔を同じパルスの時点でまとめて取得する
+    // 割り込みを止めずに読み、途中でISRが割り込んだら読み直す (どちらのコアからでも呼べる)
+    PulseSnapshot snapshot() const;
+    // パルスのたびにISRから通知 (xTaskNotifyGive 相当) を送るタスクを設定 (NULLで解除。全チャンネル共通)
+    static void setNotifyTask(TaskHandle_t task);
     // ソフトウェアで保持している累積カウント数を返す
     unsigned long getPulseCount();
     // 最後にパルスを検出した時刻(ms)を返す
-    unsigned long getLastPulseTime();
+    uint64_t getLastPulseTime();
     // ソフトウェアカウントをリセット (セッション開始時など)
     void resetPulseCount();
+    // ISRが記録したパルス間隔を古い順に1つ取り出す (us, 0=直前のパルスが無い)。無ければ false
+    // 取り出すのは計測タスクだけ (ISRが書き、1つのタスクが読む待ち行列)
+    bool popPeriod(uint32_t& periodUs);
+    uint32_t getPeriodOverruns() const; // 待ち行列が一杯で捨てた間隔の数
 
 private:
+    // ISRとタスクで共有する1チャンネル分の状態
+    // 書き込みはISRとリセットだけ (writeMux で排他)。読み出しは seqLock によるシーケンスロック
+    struct ChannelState {
+        SeqLock seqLock;
+        std::atomic<uint32_t> pulseCountSoftware;
+        SplitUint64 lastPulseMs;
+        std::atomic<uint32_t> lastPulsePeriodUs;
+        int64_t lastPulseUs;                      // 書き手だけが触る
+        // パルスごとの間隔 (ISR → 計測タスク)。snapshot() は最新の1つしか見えないので、全パルス分をここに並べる
+        uint32_t periodRing[PULSE_PERIOD_RING_SIZE];
+        std::atomic<uint32_t> periodHead;         // ISRが書く位置 (ISRだけが進める)
+        std::atomic<uint32_t> periodTail;         // 次に読む位置 (計測タスクだけが進める)
+        std::atomic<uint32_t> periodOverruns;
+    };
+
     int pulsePin;
+    uint8_t channel;
+    uint16_t filterValue;
     pcnt_unit_t pcntUnit;
     pcnt_channel_t pcntChannel;
 
-    // ISRからアクセスされるためstatic volatile
-    static volatile unsigned long pulseCountSoftware;
-    static volatile unsigned long lastPulseTimestamp;
+    // ISRからアクセスされるためstatic (PCNTユニットの番号で引く)
+    static ChannelState channels[PULSE_MAX_CHANNELS];
+    static std::atomic<uint32_t> activeUnitMask;      // begin() 済みのユニット (ISRはこのビットだけを見る)
+    static pcnt_isr_handle_t isrHandle;               // 共有ISR (最初の begin() で1回だけ登録)
+    static portMUX_TYPE writeMux;
+    static TaskHandle_t volatile notifyTask;          // パルスを知らせる先 (計測タスク)
     static volatile bool led_state;
 
-    // ISR本体 (static)
+    ChannelState& state() const { return channels[channel]; }
+
+    // ISR本体 (static)。割り込み状態のビットから、パルスが来たユニットだけを処理する
     static void IRAM_ATTR pcnt_intr_handler(void *arg);
+    static void IRAM_ATTR recordPulse(ChannelState& ch, int64_t nowUs);
 };
 
 #endif // PULSE_COUNTER_HPP
\ No newline at end of file
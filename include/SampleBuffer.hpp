@@ -0,0 +1,114 @@
+#ifndef SAMPLE_BUFFER_HPP
+#define SAMPLE_BUFFER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.hpp"
+
+// 1秒ごとのサンプル (送信するまで端末内に残す)
+struct Sample {
+    uint64_t timestampMs = 0; // Clock と同じ起動からのms
+    uint16_t rpm = 0;         // RPM (整数)
+    uint16_t speed = 0;       // km/h × 100 (丸めた RPM から求めた値)
+    uint32_t pulses = 0;      // セッションのパルス数
+
+    // 計算結果からサンプルを作る。RPM は整数に丸める: 推定値の1rpm未満の揺れは雑音で、0.01rpm で持つと
+    // 1サンプルの大半のビットがそれに使われる。速度は丸めた RPM × kmhPerRpm にして、RPM と比例したままにする
+    // (比例していれば速度の列はほぼ1bit/件)
+    static Sample fromMetrics(uint64_t timestampMs, float rpm, float kmhPerRpm, uint32_t pulses) {
+        Sample sample;
+        sample.timestampMs = timestampMs;
+        sample.rpm = rpm < (float)UINT16_MAX ? (uint16_t)(rpm + 0.5f) : UINT16_MAX;
+        float speed = sample.rpm * kmhPerRpm * 100.0f + 0.5f;
+        sample.speed = speed < (float)UINT16_MAX ? (uint16_t)speed : UINT16_MAX;
+        sample.pulses = pulses;
+        return sample;
+    }
+};
+
+// サンプルを圧縮して溜めるバッファ (Gorilla 方式の変形)
+// 固定長のブロックを SAMPLE_BUFFER_BLOCKS 個リングで持ち、ブロックの先頭だけ生の値を置き、以降は列ごとに
+//   時刻・パルス数: 差分の差分 (一定間隔・一定ケイデンスなら0)
+//   RPM: 前のサンプルとの差分
+//   速度: 「前のサンプルの 速度/RPM 比 × 今のRPM」からのずれ (速度はRPMに比例するので普段は0)
+// を zigzag 符号化し、列ごとに直近の値の大きさに合わせた Rice 符号 (0が続く列なら1bit) で書く。
+// ブロックは互いに独立していて、どのブロックからでも頭から順に復号できる。送信済みのブロックは先頭から解放する。
+// 一杯になったら最も古いブロックを捨てる。Arduino API に依存しない (スレッドセーフではない)
+class SampleBuffer {
+public:
+    // 列ごとの Rice 符号のパラメータ (直近の値の平均から k を決める)
+    struct RiceState {
+        uint32_t sum = 4;
+        uint16_t count = 1;
+        uint8_t k() const;
+        void update(uint64_t zigzag);
+    };
+    enum Column : uint8_t { COLUMN_TIME, COLUMN_PULSES, COLUMN_RPM, COLUMN_SPEED, COLUMN_COUNT };
+
+    SampleBuffer();
+    void clear();
+    void append(const Sample& sample);
+
+    // 古い順に1つずつ復号する読み手
+    // 読み手は使い捨て: 作ってから使い終えるまでの間に append() や releaseOldestBlock() を呼ばないこと
+    // (append() も一杯のときは古いブロックを捨てるため。別タスクから使うなら呼び出し側で排他する)
+    class Reader {
+    public:
+        explicit Reader(const SampleBuffer& buffer);
+        bool next(Sample& out);
+        size_t blocksFinished() const { return blocksDone; } // 読み終えたブロック数 (解放してよい数)
+
+    private:
+        const SampleBuffer& buffer;
+        size_t blockOffset;     // 最も古いブロックから何番目を読んでいるか
+        size_t blocksDone;
+        uint16_t sampleInBlock;
+        uint32_t bitPos;
+        Sample previous;
+        int64_t previousTimeDelta;
+        int64_t previousPulseDelta;
+        RiceState rice[COLUMN_COUNT];
+    };
+
+    size_t releaseOldestBlock(); // 最も古いブロックを解放し、入っていたサンプル数を返す
+
+    uint32_t getSampleCount() const;   // 残っているサンプル数
+    size_t getBlockCount() const;
+    size_t getBytesUsed() const;       // 使っているビット列の大きさ (バイト)
+    uint32_t getDroppedSamples() const; // 一杯で捨てたサンプル数
+
+private:
+    struct BlockInfo {
+        uint16_t sampleCount;
+        uint16_t bitLength;
+    };
+    static const uint32_t BLOCK_BITS = SAMPLE_BUFFER_BLOCK_BYTES * 8;
+    static const uint8_t RICE_ESCAPE = 24;           // unary がこの長さになったら値をそのまま書く
+    static const uint32_t RICE_SUM_CAP = 1UL << 20;
+    static const uint16_t RICE_RESET_COUNT = 32;
+    static const uint32_t MAX_SAMPLE_BITS = COLUMN_COUNT * (RICE_ESCAPE + 64); // 1サンプルの最悪値
+
+    uint8_t blocks[SAMPLE_BUFFER_BLOCKS][SAMPLE_BUFFER_BLOCK_BYTES];
+    BlockInfo info[SAMPLE_BUFFER_BLOCKS];
+    size_t oldestBlock;
+    size_t blockCount;
+    uint32_t sampleCount;
+    uint32_t droppedSamples;
+
+    // 書き込み中のブロックの符号化状態
+    Sample last;
+    int64_t lastTimeDelta;
+    int64_t lastPulseDelta;
+    RiceState rice[COLUMN_COUNT];
+
+    size_t blockIndex(size_t offset) const { return (oldestBlock + offset) % SAMPLE_BUFFER_BLOCKS; }
+    void startBlock(const Sample& sample);
+
+    static uint16_t predictSpeed(const Sample& previous, uint16_t rpm);
+    static void writeBits(uint8_t* data, uint32_t& bitPos, uint64_t value, uint8_t width);
+    static uint64_t readBits(const uint8_t* data, uint32_t& bitPos, uint8_t width);
+    static void writeRice(uint8_t* data, uint32_t& bitPos, int64_t value, RiceState& state);
+    static int64_t readRice(const uint8_t* data, uint32_t& bitPos, RiceState& state);
+};
+
+#endif // SAMPLE_BUFFER_HPP
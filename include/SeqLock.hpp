@@ -0,0 +1,57 @@
+#ifndef SEQ_LOCK_HPP
+#define SEQ_LOCK_HPP
+
+#include <atomic>
+#include <stdint.h>
+
+// シーケンスロック: 読み手は書き手を止めず、途中で書き換わったら読み直す
+// 書き手同士の排他は呼び出し側で行う (PulseCounter では writeMux)。ISRからも使えるよう常にインライン展開する
+// Arduino API に依存しないので、ホスト上でも std::thread で試せる
+//
+//   書き手: lock.beginWrite(); ...値を書く...; lock.endWrite();
+//   読み手: do { s = lock.beginRead(); ...値を読む...; } while (lock.retryRead(s));
+class SeqLock {
+public:
+    constexpr SeqLock() : sequence(0) {}
+
+    inline __attribute__((always_inline)) void beginWrite() {
+        sequence.fetch_add(1, std::memory_order_relaxed); // 奇数: 書き込み中
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+    inline __attribute__((always_inline)) void endWrite() {
+        sequence.fetch_add(1, std::memory_order_release); // 偶数: 書き込み完了
+    }
+
+    inline __attribute__((always_inline)) uint32_t beginRead() const {
+        return sequence.load(std::memory_order_acquire);
+    }
+    // 読んだ値を捨てて読み直すべきなら true (読み始めが書き込み中 or 読んでいる間に書き換わった)
+    inline __attribute__((always_inline)) bool retryRead(uint32_t start) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return (start & 1) != 0 || sequence.load(std::memory_order_relaxed) != start;
+    }
+
+private:
+    std::atomic<uint32_t> sequence;
+};
+
+// 64bit値を32bitの atomic 2語で持つ (ESP32 では64bitの atomic がロックフリーでないため)
+// 2語がそろって見えるのは SeqLock の中で読み書きしたときだけ
+class SplitUint64 {
+public:
+    constexpr SplitUint64() : low(0), high(0) {}
+
+    inline __attribute__((always_inline)) void store(uint64_t value) {
+        low.store((uint32_t)value, std::memory_order_relaxed);
+        high.store((uint32_t)(value >> 32), std::memory_order_relaxed);
+    }
+    inline __attribute__((always_inline)) uint64_t load() const {
+        return ((uint64_t)high.load(std::memory_order_relaxed) << 32) | low.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint32_t> low;
+    std::atomic<uint32_t> high;
+};
+
+#endif // SEQ_LOCK_HPP
@@ -0,0 +1,51 @@
+#ifndef SESSION_SUMMARY_HPP
+#define SESSION_SUMMARY_HPP
+
+#include <stdint.h>
+#include "MetricsAccumulator.hpp"
+#include "CadenceAnalyzer.hpp"
+
+// 終わったセッション1件分の要約 (SDの /sessions.jsonl と送信先の session_end イベントに使う)
+struct SessionSummary {
+    uint8_t channel = 0;           // 入力チャンネル (椅子)
+    uint64_t startMs = 0;          // 開始 (Clock の起動からのms)
+    uint64_t endMs = 0;            // 終了 = 最後のパルス (タイマーが動いていた時間がそれより長ければ、その終わり)
+    uint64_t startWallMs = 0;      // 開始の時刻 (NTP同期済みならUNIXエポックms、未同期なら起動からのms)
+    uint64_t endWallMs = 0;
+    bool wallClockSynced = false;  // startWallMs / endWallMs がエポックmsか
+    uint64_t activeTimeMs = 0;     // タイマー動作中の時間
+    uint64_t distanceUm = 0;
+    uint64_t caloriesMcal = 0;
+    uint32_t pulses = 0;
+    float avgRpm = 0.0f;           // 計算ごとのRPMの単純平均 (タイマー動作中の区間)
+    float maxRpm = 0.0f;
+    float timeWeightedRpm = 0.0f;  // 区間の長さで重み付けした平均
+    uint32_t zoneMs[CADENCE_ZONE_COUNT] = {}; // ケイデンスのゾーンごとの時間
+    uint16_t workIntervals = 0;    // 運動区間の数
+    uint16_t boundaries = 0;       // 検出した変化点の数
+};
+
+// セッション中に区間ごとの値を足していき、終了時に要約を作る
+// 持つのは合計と最大値だけなので、セッションの長さによらずメモリは一定。Arduino API に依存しない
+class SessionSummaryBuilder {
+public:
+    SessionSummaryBuilder();
+    void start(uint64_t startMs);
+    bool isOpen() const;
+    // 計算した1区間分。active はタイマー動作中か (停止中の区間はRPMの平均に入れない)
+    void addInterval(uint32_t intervalMs, uint32_t milliRpm, uint32_t pulses, bool active);
+    // 距離・カロリー・時間はセッションの積算値、ゾーンと区間は CadenceAnalyzer から取る。要約を返して閉じる
+    SessionSummary finish(uint64_t endMs, const MetricsAccumulator::Totals& sessionTotals, const CadenceAnalysis& cadence);
+
+private:
+    bool open;
+    uint64_t startMs;
+    uint32_t pulses;
+    uint32_t rpmSamples;
+    uint64_t milliRpmSum;       // 単純平均用
+    uint64_t milliRpmMsSum;     // 時間重み付き平均用 (1/1000 rpm × ms)
+    uint64_t weightedMs;
+    uint32_t maxMilliRpm;
+};
+
+#endif // SESSION_SUMMARY_HPP
@@ -6,15 +6,29 @@
 #include <FS.h>
 #include "config.hpp"
 #include "TrackerData.hpp"
+#include "CadenceEstimator.hpp"
+#include "SessionSummary.hpp"
+#include "PulseCounter.hpp" // PulseChannelConfig
 #include <ArduinoJson.h> // ★ ArduinoJson をインクルード ★
 #include <vector>       // ★ vector をインクルード ★
 #include <utility>      // ★ pair をインクルード ★
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
 
 // ★ JSONドキュメント容量定義 ★
-#define JSON_CONFIG_CAPACITY 1024    // 設定ファイル用
+#define JSON_CONFIG_CAPACITY 2048    // 設定ファイル用 (endpoints 配列を含む)
 #define JSON_LATEST_CAPACITY 256     // 最新累積データ用
 #define JSON_HISTORY_ENTRY_CAPACITY 256 // 履歴データ(1行分)用
 
+// ★ 送信先1件分の設定 (config.json の endpoints 配列の要素) ★
+struct EndpointConfig {
+    String url;                                         // 送信先URL (http://, https://, udp://)
+    PayloadFormat format = PayloadFormat::JSON;         // ペイロード形式
+    unsigned long minIntervalMs = PUBLISH_MIN_INTERVAL_MS; // この送信先への最短送信間隔
+    String authHeader;                                  // Authorization ヘッダー値 (空なら付けない)
+};
+
 class Storage {
 public:
     Storage();
@@ -23,18 +37,38 @@ public:
     // --- 設定ファイル (JSON) 関連 ---
     bool loadConfigFromJson(); // ★ JSONファイルを読み込みパース ★
     bool getWifiCredential(int index, String& ssid, String& pass); // パース結果からWiFi情報を取得
-    String getEndpointUrl(); // パース結果からURLを取得
+    const std::vector<EndpointConfig>& getEndpoints() const; // パース結果から送信先一覧を取得
     int getWifiCredentialCount(); // パース結果のWiFi情報数を取得
     DriveType getDriveType();
+    const CadenceConfig& getCadenceConfig() const; // ケイデンス推定の設定 (無ければ既定値)
+    const std::vector<PulseChannelConfig>& getPulseChannels() const; // 入力チャンネル (無ければ PULSE_INPUT_PIN の1つ)
 
     // --- NVS 関連 (WiFi用) ---
     bool loadCredentialsFromNVS(String& ssid, String& pass); // ★ NVSからのみ読み込み ★
     bool saveWiFiCredentialsToNVS(const String& ssid, const String& pass); // ★ NVSへ保存 ★
+    // 入力チャンネルの写し (起動直後、SD より先に PCNT を始めるために使う)
+    bool loadPulseChannelsFromNVS(std::vector<PulseChannelConfig>& channels); // 無ければ false
+    bool savePulseChannelsToNVS(const std::vector<PulseChannelConfig>& channels);
 
     // --- 累積データ関連 (SDカード - JSON形式) ---
-    bool loadCumulativeDataFromSD(TrackerData& data);     // cumulative_latest.json からロード
-    bool saveLatestDataToSD(const TrackerData& data);     // cumulative_latest.json へ保存 (上書き)
-    bool appendHistoryDataToSD(const TrackerData& data);  // cumulative_history.jsonl へ追記
+    // channel はチャンネル番号。0 は従来どおり cumulative_latest.json、1以降は cumulative_latest_ch<n>.json
+    bool loadCumulativeDataFromSD(TrackerData& data, uint8_t channel = 0);     // cumulative_latest.json からロード
+    bool saveLatestDataToSD(const TrackerData& data, uint8_t channel = 0);     // cumulative_latest.json へ保存 (上書き)
+    bool appendHistoryDataToSD(const TrackerData& data, uint8_t channel = 0);  // cumulative_history.jsonl へ追記 (1以降は "channel" 付き)
+    bool appendSessionToSD(const SessionSummary& summary); // sessions.jsonl へ1セッション1行で追記
+    bool saveTraceToSD(); // イベントトレースを TRACE_DUMP_PATH へ書き出す (上書き。FIT2GO_TRACING 無効なら false)
+
+    // ★ 書き込み要求の受付 (待たずに戻る。実際の書き込みはストレージタスクが行う) ★
+    bool requestSaveLatest(const TrackerData& data, uint8_t channel = 0);
+    // キューが一杯なら1件だけ預かり、retryPendingSession() で積み直す (計測タスク専用)
+    bool requestAppendSession(const SessionSummary& summary);
+    // 預かっているセッション要約をキューへ積み直す。預かりが無くなれば true
+    bool retryPendingSession();
+    bool hasPendingSession() const; // 積み直し待ちのセッション要約があるか
+    // ストレージタスクから呼ぶ: 要求が来るまで待つ (取り出しはしない)。来たら true
+    bool waitForPendingWrites(TickType_t waitTicks);
+    // ストレージタスクから呼ぶ: 溜まっている要求をすべて処理し、処理した件数を返す
+    size_t processPendingWrites();
 
     // ★★★ ファイル読み込みヘルパー ★★★
     String readFileContent(const char* path);
@@ -46,9 +80,27 @@ private: // ★★★ private セクション ★★★
 
     // ★ JSONパース結果保持用 ★
     bool configLoaded; // 設定ファイルがロード・パースされたか
-    String endpointUrlFromJson; // JSONから読み込んだURL
+    std::vector<EndpointConfig> endpoints; // JSONから読み込んだ送信先 (endpoint_url / endpoints)
     std::vector<std::pair<String, String>> wifiCredentials; // SSIDとPasswordのペアを格納
     DriveType drive_type;
+    CadenceConfig cadenceConfig;
+    std::vector<PulseChannelConfig> pulseChannels;
+
+    // ★ SD書き込み要求キュー (計測タスクをSDの遅延から切り離す) ★
+    enum class WriteType : uint8_t { SAVE_LATEST, APPEND_SESSION };
+    struct WriteRequest {
+        WriteType type;
+        uint8_t channel;         // SAVE_LATEST
+        TrackerData data;        // SAVE_LATEST
+        SessionSummary session;  // APPEND_SESSION
+    };
+    QueueHandle_t writeQueue;
+    uint32_t droppedWrites; // キュー満杯で捨てた要求数
+    // キュー満杯で積めなかったセッション要約 (1件だけ。計測タスクだけが触る)
+    SessionSummary pendingSession;
+    std::atomic<bool> pendingSessionHeld;
+
+    static void latestDataPath(uint8_t channel, char* path, size_t size);
 };
 
 #endif // STORAGE_HPP
\ No newline at end of file
@@ -0,0 +1,49 @@
+#ifndef TASK_STATS_HPP
+#define TASK_STATS_HPP
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "MetricRegistry.hpp"
+
+// タスク1周あたりの処理時間とスタック残量の統計
+// 書き込みは持ち主のタスクだけが行い、他のタスクからは表示用に読むだけ (32bit値なので読み出しは分断されない)
+// 1周の処理時間は /metrics の fit2go_loop_duration_seconds{task="名前"} にも入れる
+// ヒープの割り当て回数は HeapStats が数える (attach() で登録する。他のタスクからも書くのでアトミック)
+class TaskStats {
+public:
+    TaskStats(const char* name);
+    void attach(TaskHandle_t handle);   // xTaskCreate 後に呼ぶ
+    void beginIteration();              // 1周の処理の先頭で呼ぶ
+    void endIteration();                // 1周の処理の最後で呼ぶ (待ち時間は含めない)
+    void resetWindow();                 // 最大値・平均の集計区間をリセット
+
+    const char* getName() const;
+    uint32_t getIterations() const;
+    uint32_t getLastUs() const;
+    uint32_t getMaxUs() const;          // 集計区間内の最大処理時間
+    uint32_t getAverageUs() const;      // 集計区間内の平均処理時間
+    uint32_t getStackHighWaterMark() const; // これまでで最も減ったときのスタック残量 (バイト)
+    uint32_t getHeapAllocations() const;    // このタスクが malloc / calloc / realloc した回数
+    inline void countAllocation(size_t size) {
+        heapAllocations.increment();
+        heapAllocatedBytes.increment((uint32_t)size);
+    }
+    void print() const;                 // 1行でログに出す
+
+private:
+    const char* name;
+    TaskHandle_t handle;
+    uint32_t startUs;
+    uint32_t iterations;
+    uint32_t lastUs;
+    uint32_t maxUs;
+    uint32_t windowSumUs;
+    uint32_t windowCount;
+    char metricLabels[24];              // task="名前"
+    MetricHistogram loopDuration;
+    MetricCounter heapAllocations;
+    MetricCounter heapAllocatedBytes;
+};
+
+#endif // TASK_STATS_HPP
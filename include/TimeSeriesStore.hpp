@@ -0,0 +1,140 @@
+#ifndef TIME_SERIES_STORE_HPP
+#define TIME_SERIES_STORE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include "config.hpp"
+
+// 時系列の分解能 (段)
+enum class SeriesTier : uint8_t {
+    SECONDS, // 1秒ごと (直近 SERIES_SECONDS_CAPACITY 秒)
+    MINUTES, // 1分ごと (直近 SERIES_MINUTES_CAPACITY 分)
+    HOURS    // 1時間ごと (直近 SERIES_HOURS_CAPACITY 時間)
+};
+
+// 1区間分の集計 (RPM・速度とも 1/100 単位の固定小数点)
+// count == 0 はその区間にサンプルが無いことを表す
+struct SeriesBucket {
+    uint16_t count = 0;    // 区間内のサンプル数 (65535 で頭打ち)
+    uint16_t rpmMin = 0;
+    uint16_t rpmMax = 0;
+    uint16_t rpmMean = 0;
+    uint16_t speedMin = 0; // km/h × 100
+    uint16_t speedMax = 0;
+    uint16_t speedMean = 0;
+};
+
+// 範囲問い合わせの結果1件
+struct SeriesPoint {
+    uint64_t startMs;      // 区間の開始時刻 (append() に渡した時刻と同じ軸)
+    SeriesBucket bucket;
+};
+
+// セッション中の RPM・速度の履歴を 秒 / 分 / 時 の3段のリングで持つ
+// サンプルを足すたびに3段すべての「いま開いている区間」の集計 (最小・最大・平均・件数) を更新するので、
+// 上の段を作り直すための再集計は要らない。メモリは配列の大きさ (config.hpp) だけでコンパイル時に決まる。
+// 追加は O(1)。ただし長い空白の後の最初の追加だけは、空白になった区間を空にする (各段の容量が上限)。
+// 時刻の軸は呼び出し側が決める (起動からのms でも UNIX 時刻のms でもよい)。軸を変えるときは rebase() でずらす。
+// 分・時の段は save() / restore() でバイト列にして、ディープスリープの間も残せる。
+// スレッドセーフではない (書き手と読み手が別タスクなら呼び出し側で排他する)。Arduino API に依存しない
+class TimeSeriesStore {
+public:
+    TimeSeriesStore();
+    void clear();
+
+    // nowMs 時点のサンプルを1つ追加する。nowMs が前回より戻った場合は捨てる
+    void append(uint64_t nowMs, float rpm, float speedKmh);
+
+    // tier の区間のうち [fromMs, toMs) に重なり、サンプルがあるものを古い順に out へ書く (最大 maxCount 件)
+    // 戻り値は書いた件数。表示・HTTP API・送信の再送が同じ問い合わせを使う
+    size_t query(SeriesTier tier, uint64_t fromMs, uint64_t toMs, SeriesPoint* out, size_t maxCount) const;
+    // 最新の区間 (まだ開いている区間を含む)。サンプルが無ければ false
+    bool latest(SeriesTier tier, SeriesPoint& out) const;
+
+    // 時刻の軸を deltaMs だけずらす (起動からのms → UNIX 時刻 など)。溜まっている区間はそのまま新しい時刻で読める
+    // ずらす量は段ごとに区間の長さへ丸める (時の段は最大30分ずれる)
+    void rebase(int64_t deltaMs);
+
+    // 分・時の段 (と開いている区間の集計) を out に書く。out は retainedBytes() バイト
+    void save(uint8_t* out) const;
+    // save() で書いたものを読み戻す。壊れている・大きさが違う (容量を変えた) ときは何もせず false。秒の段は空のまま
+    bool restore(const uint8_t* in);
+    static constexpr size_t retainedBytes() {
+        return 2 * sizeof(uint32_t) + 2 * TIER_STATE_BYTES +
+               (SERIES_MINUTES_CAPACITY + SERIES_HOURS_CAPACITY) * sizeof(SeriesBucket);
+    }
+
+    static uint32_t resolutionMs(SeriesTier tier);
+    static size_t capacity(SeriesTier tier);
+    static const char* tierName(SeriesTier tier); // "second" / "minute" / "hour"
+    static bool parseTier(const char* name, SeriesTier& out);
+    static float toRpm(uint16_t fixed) { return fixed * 0.01f; }
+    static float toKmh(uint16_t fixed) { return fixed * 0.01f; }
+
+private:
+    // 開いている区間の集計 (平均のため合計を持つ)
+    struct Accumulator {
+        uint32_t count;
+        uint32_t rpmSum;
+        uint32_t speedSum;
+        uint16_t rpmMin, rpmMax;
+        uint16_t speedMin, speedMax;
+    };
+    struct Tier {
+        SeriesBucket* slots;
+        size_t capacity;
+        uint32_t resolutionMs;
+        uint64_t newestIndex; // 最新の区間番号 (時刻 / resolutionMs)
+        uint32_t slotShift;   // 区間番号 i の区間は slots[(i + slotShift) % capacity] (rebase() で番号だけ変えるため)
+        bool hasData;
+        Accumulator open;
+    };
+    // save() で書く1段分の状態 (newestIndex, slotShift, hasData, open)
+    static constexpr size_t TIER_STATE_BYTES = sizeof(uint64_t) + sizeof(uint32_t) + 1 + sizeof(Accumulator);
+    static const uint32_t RETAINED_MAGIC = 0x54535331; // "TSS1"
+
+    SeriesBucket secondSlots[SERIES_SECONDS_CAPACITY];
+    SeriesBucket minuteSlots[SERIES_MINUTES_CAPACITY];
+    SeriesBucket hourSlots[SERIES_HOURS_CAPACITY];
+    Tier tiers[3];
+
+    static void add(Tier& tier, uint64_t nowMs, uint16_t rpm, uint16_t speed);
+    static void clearTier(Tier& tier);
+    static SeriesBucket& slotAt(const Tier& tier, uint64_t index) {
+        return tier.slots[(index + tier.slotShift) % tier.capacity];
+    }
+    static uint32_t checksum(const uint8_t* data, size_t length);
+    static uint16_t toFixed(float value);
+    const Tier& tierFor(SeriesTier tier) const { return tiers[(size_t)tier]; }
+};
+
+// 範囲問い合わせの結果を CSV にする (1行1区間。先頭に見出しの行)
+// 問い合わせは SeriesCsvWriter::PAGE_POINTS 件ずつ、読み進めるたびに行う (全体を入れる大きな文字列は作らない)
+// read() を呼ぶたびに続きを書き、全部書き終えたら 0 を返す (チャンク転送のコールバックからそのまま呼べる)
+class SeriesCsvWriter {
+public:
+    // 問い合わせ関数 (TimeSeriesStore::query と同じ引数。ロックは関数の側で取る)
+    typedef size_t (*Query)(SeriesTier tier, uint64_t fromMs, uint64_t toMs, SeriesPoint* out, size_t maxCount);
+    static const size_t PAGE_POINTS = 16;
+
+    SeriesCsvWriter(Query query, SeriesTier tier, uint64_t fromMs, uint64_t toMs);
+    size_t read(uint8_t* buffer, size_t maxLength);
+
+private:
+    Query query;
+    SeriesTier tier;
+    uint64_t nextFromMs; // 次の問い合わせの開始 (最後に出した区間の次)
+    uint64_t toMs;
+    SeriesPoint page[PAGE_POINTS];
+    size_t pageCount;
+    size_t pagePosition;
+    bool headerDone;
+    bool finished;
+    char line[96];
+    size_t lineLength;
+    size_t linePosition;
+
+    bool nextLine();
+};
+
+#endif // TIME_SERIES_STORE_HPP
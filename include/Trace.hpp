@@ -0,0 +1,111 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "config.hpp"
+#include "TraceBuffer.hpp"
+
+// 記録するイベント (番号は書き出しファイルに名前と一緒に入るので、途中に追加してもよい)
+enum class TraceEvent : uint16_t {
+    PULSE,              // PCNT 割り込み (arg = 割り込みの立っていたユニットのビット)
+    STATE,              // AppState の遷移 (arg = 前の状態 << 8 | 新しい状態)
+    METRICS_UPDATE,     // MetricsCalculator::update() (arg = チャンネル)
+    DISPLAY_UPDATE,     // Display::update()
+    PUBLISH,            // 1件の送信全体 (arg = 送信先の番号。END の arg = HTTPステータス)
+    PUBLISH_DNS,        // 送信の各段階
+    PUBLISH_CONNECT,
+    PUBLISH_TLS,
+    PUBLISH_SEND,
+    PUBLISH_RESPONSE,
+    SD_WRITE,           // SDへの書き込み1件 (arg = SdWriteKind)
+    NTP_SYNC,           // NTP同期の待ち (END の arg = 1 なら成功)
+    WIFI_LINK,          // Wi-Fiの接続・切断 (arg = 1 なら接続)
+    SESSION_END,        // セッション要約ができた (arg = チャンネル)
+    COUNT
+};
+
+// SD_WRITE の arg
+enum class SdWriteKind : uint32_t {
+    LATEST,
+    HISTORY,
+    SESSION
+};
+
+#if FIT2GO_TRACING
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+// リングへの記録と書き出し
+// 書き出し形式 (リトルエンディアン):
+//   "F2GT", 版(1), 1件のバイト数(12), イベント名の数(u16), 記録の総数(u32)
+//   イベント名 × 数 (長さ u8 + 文字列), トラック数 (u8), トラック (番号 u8, 長さ u8, 名前) × 数
+//   TraceRecord × n, 終端 (event = 0xFFFF, arg = 書き出し中に上書きされて失った件数)
+class Trace {
+public:
+    static const uint8_t TRACK_OTHER = 0;   // 登録していないタスク (AsyncTCP など)
+    static const uint8_t TRACK_ISR = 0x80;  // | コア番号
+
+    // タスクに名前を付ける (xTaskCreate の後に呼ぶ)。トラック番号は登録順に1から
+    static void registerTask(TaskHandle_t handle, const char* name);
+
+    static inline void record(TraceEvent event, TracePhase phase, uint32_t arg) {
+        buffer.record((uint32_t)esp_timer_get_time(), (uint16_t)event, phase, currentTrack(), arg);
+    }
+    // ISRから (タスクを調べず、コア番号をトラックにする)
+    static inline __attribute__((always_inline)) void recordFromIsr(TraceEvent event, uint32_t arg) {
+        buffer.record((uint32_t)esp_timer_get_time(), (uint16_t)event, TracePhase::INSTANT,
+                      (uint8_t)(TRACK_ISR | xPortGetCoreID()), arg);
+    }
+
+    static void dump(Print& out);     // バイナリのまま (SDのファイルなど)
+    static void dumpHex(Print& out);  // シリアル向け: 開始行・16進の行・終了行で囲む
+    static const char* eventName(TraceEvent event);
+
+private:
+    static TraceBuffer buffer;
+    static TaskHandle_t tasks[TRACE_MAX_TASKS];
+    static const char* taskNames[TRACE_MAX_TASKS];
+    static size_t taskCount;
+
+    static uint8_t currentTrack();
+};
+
+// 生成から破棄までを1区間として記録する
+class TraceSpan {
+public:
+    inline TraceSpan(TraceEvent event, uint32_t arg = 0) : event(event), endArg(0) {
+        Trace::record(event, TracePhase::BEGIN, arg);
+    }
+    inline ~TraceSpan() { Trace::record(event, TracePhase::END, endArg); }
+    void setEndArg(uint32_t arg) { endArg = arg; }
+
+private:
+    TraceEvent event;
+    uint32_t endArg;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_INSTANT(event, arg) Trace::record(event, TracePhase::INSTANT, (uint32_t)(arg))
+#define TRACE_ISR(event, arg) Trace::recordFromIsr(event, (uint32_t)(arg))
+// ブロックの終わりまでを1区間にする
+#define TRACE_SPAN(event, arg) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(event, (uint32_t)(arg))
+// 始点と終点が別のブロックにある場合
+#define TRACE_BEGIN(event, arg) Trace::record(event, TracePhase::BEGIN, (uint32_t)(arg))
+#define TRACE_END(event, arg) Trace::record(event, TracePhase::END, (uint32_t)(arg))
+#define TRACE_REGISTER_TASK(handle, name) Trace::registerTask(handle, name)
+
+#else // FIT2GO_TRACING
+
+#define TRACE_INSTANT(event, arg) do {} while (0)
+#define TRACE_ISR(event, arg) do {} while (0)
+#define TRACE_SPAN(event, arg) do {} while (0)
+#define TRACE_BEGIN(event, arg) do {} while (0)
+#define TRACE_END(event, arg) do {} while (0)
+#define TRACE_REGISTER_TASK(handle, name) do {} while (0)
+
+#endif // FIT2GO_TRACING
+
+#endif // TRACE_HPP
@@ -0,0 +1,65 @@
+#ifndef TRACE_BUFFER_HPP
+#define TRACE_BUFFER_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include "config.hpp"
+
+// イベントの種類 (Chrome trace の ph に対応)
+enum class TracePhase : uint8_t {
+    INSTANT, // 一瞬の出来事
+    BEGIN,   // 区間の始まり (同じトラックの END と対になる)
+    END
+};
+
+// 1件分 (書き出すときもこの12バイトをそのまま並べる)
+struct TraceRecord {
+    uint32_t timeUs;   // 起動からのµsの下位32bit (約71分で一周。変換ツールが順に見て繋ぐ)
+    uint16_t event;
+    uint8_t phase;     // TracePhase
+    uint8_t track;     // 記録したタスク (ISRなら 0x80 | コア番号)
+    uint32_t arg;
+};
+
+// 固定長のリングにイベントを記録する。書き込みは添字を1回 fetch_add するだけで、ロックを取らない
+// (ISR・複数のタスクから同時に書いてよい)。一杯になったら最も古いものから上書きする
+// 読み出しは書き込みを止めずに1件ずつ行い、途中で上書きされた分は捨てる
+// 各枠は書き込み中に番号を無効値にし、書き終えてから番号を入れるので、読み手は前後の番号を比べて書きかけを見分ける
+// Arduino API に依存しない
+class TraceBuffer {
+public:
+    static const size_t CAPACITY = TRACE_RING_SIZE;
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+
+    TraceBuffer();
+    // ISRからも呼ぶので必ず展開させる
+    inline __attribute__((always_inline)) void record(uint32_t timeUs, uint16_t event, TracePhase phase, uint8_t track, uint32_t arg) {
+        uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+        Slot& slot = slots[index & (CAPACITY - 1)];
+        slot.sequence.store(EMPTY, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.record.timeUs = timeUs;
+        slot.record.event = event;
+        slot.record.phase = (uint8_t)phase;
+        slot.record.track = track;
+        slot.record.arg = arg;
+        slot.sequence.store(index, std::memory_order_release);
+    }
+
+    uint32_t getWritten() const;  // これまでに記録した総数 (一周すると0に戻る)
+    uint32_t getOldest() const;   // まだ残っている最も古い番号
+    // index 番のイベントを読む。上書き済みか書きかけなら false
+    bool read(uint32_t index, TraceRecord& out) const;
+
+private:
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+    struct Slot {
+        std::atomic<uint32_t> sequence; // このイベントの番号 (書き込み中は EMPTY)
+        TraceRecord record;
+    };
+    Slot slots[CAPACITY];
+    std::atomic<uint32_t> head;
+};
+
+#endif // TRACE_BUFFER_HPP
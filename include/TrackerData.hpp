@@ -6,11 +6,13 @@
 // データの入れ物
 struct TrackerData {
     // 現在のセッションデータ
-    unsigned long sessionStartTimeMs = 0; // ★ 名前変更
+    uint64_t sessionStartTimeMs = 0; // ★ 名前変更 (Clock の時刻)
     unsigned long sessionElapsedTimeMs = 0;
     float sessionDistanceKm = 0.0f;
     float sessionCaloriesKcal = 0.0f;
     unsigned long sessionPulseCount = 0;
+    uint64_t sessionDistanceUm = 0;    // 積算は整数で行い、上の float は表示・送信用にここから作る
+    uint64_t sessionCaloriesMcal = 0;
 
     // 瞬間的なデータ / 計算値
     float currentRpm = 0.0f;
@@ -21,6 +23,30 @@ struct TrackerData {
     uint64_t cumulativeTimeMs = 0;
     float cumulativeDistanceKm = 0.0f;
     float cumulativeCaloriesKcal = 0.0f;
+    uint64_t cumulativeDistanceUm = 0;  // 同上 (保存もこちらを正とする)
+    uint64_t cumulativeCaloriesMcal = 0;
+
+    // 表示内容が変わったかの判定用
+    bool operator==(const TrackerData& other) const {
+        return sessionStartTimeMs == other.sessionStartTimeMs &&
+               sessionElapsedTimeMs == other.sessionElapsedTimeMs &&
+               sessionDistanceKm == other.sessionDistanceKm &&
+               sessionCaloriesKcal == other.sessionCaloriesKcal &&
+               sessionPulseCount == other.sessionPulseCount &&
+               sessionDistanceUm == other.sessionDistanceUm &&
+               sessionCaloriesMcal == other.sessionCaloriesMcal &&
+               currentRpm == other.currentRpm &&
+               currentSpeedKmh == other.currentSpeedKmh &&
+               currentMets == other.currentMets &&
+               cumulativeTimeMs == other.cumulativeTimeMs &&
+               cumulativeDistanceKm == other.cumulativeDistanceKm &&
+               cumulativeCaloriesKcal == other.cumulativeCaloriesKcal &&
+               cumulativeDistanceUm == other.cumulativeDistanceUm &&
+               cumulativeCaloriesMcal == other.cumulativeCaloriesMcal;
+    }
+    bool operator!=(const TrackerData& other) const {
+        return !(*this == other);
+    }
 
     // ゼロクリア（セッション開始/リセット時）
     void resetSession() {
@@ -29,6 +55,8 @@ struct TrackerData {
         sessionDistanceKm = 0.0f;
         sessionCaloriesKcal = 0.0f;
         sessionPulseCount = 0;
+        sessionDistanceUm = 0;
+        sessionCaloriesMcal = 0;
         currentRpm = 0.0f;
         currentSpeedKmh = 0.0f;
         currentMets = 1.0f;
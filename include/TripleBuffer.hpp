@@ -0,0 +1,52 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+#include <stdint.h>
+
+// 書き手1・読み手1のロックフリー三重バッファ
+// 書き手は自分専用のバッファを丸ごと書いてから commit() で公開し、
+// 読み手は acquire() で最新の公開済みバッファと自分のバッファを交換する。
+// どちらも待たず、読み手が見るバッファは書き手が二度と触らないので、全フィールドが同じ commit のものになる。
+// 読み手が複数いる場合は読み手ごとに1つ用意する
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : writeIndex(0), middle(1), readIndex(2) {}
+
+    // --- 書き手側 ---
+    // 次に公開するバッファ (commit まで読み手からは見えない)
+    T& writeBuffer() {
+        return buffers[writeIndex];
+    }
+    // writeBuffer() の内容を公開し、書き手は空いたバッファに移る
+    void commit() {
+        uint8_t previous = middle.exchange(writeIndex | FRESH_BIT, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // --- 読み手側 ---
+    // 新しい commit があれば取り込む。取り込んだら true
+    bool acquire() {
+        if ((middle.load(std::memory_order_relaxed) & FRESH_BIT) == 0)
+            return false;
+        uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+    // 最後に acquire() したバッファ (次の acquire() まで内容は変わらない)
+    const T& read() const {
+        return buffers[readIndex];
+    }
+
+private:
+    static const uint8_t INDEX_MASK = 0x03;
+    static const uint8_t FRESH_BIT = 0x04; // 中央のバッファが読み手未取得の commit か
+
+    T buffers[3];
+    uint8_t writeIndex;           // 書き手だけが触る
+    std::atomic<uint8_t> middle;  // 書き手と読み手の受け渡し場所 (インデックス + FRESH_BIT)
+    uint8_t readIndex;            // 読み手だけが触る
+};
+
+#endif // TRIPLE_BUFFER_HPP
@@ -0,0 +1,41 @@
+#ifndef UDP_TELEMETRY_HPP
+#define UDP_TELEMETRY_HPP
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <limits.h>
+#include "config.hpp"
+#include "DatagramPacker.hpp"
+#include "ParsedUrl.hpp"
+#include "HostResolver.hpp"
+
+// UDP送信先 (udp://host:port) への投げっぱなし送信
+// 複数サンプルをMTUまで1つのデータグラムに詰めて送る。応答は待たない
+class UdpTelemetry {
+public:
+    UdpTelemetry();
+    // 解析済みURLと名前解決器を受け取る (名前解決は DataPublisher 側で非同期に行う)
+    bool begin(const ParsedUrl& url, HostResolver& resolver);
+    // 1サンプル分のテキストを追加 (入りきらなければ先に溜まっている分を送る)
+    void add(const String& text, uint64_t nowMs);
+    // 最初のサンプルを積んでから UDP_FLUSH_INTERVAL_MS たっていれば送る
+    void flushIfDue(uint64_t nowMs);
+    void flush(); // 溜まっている分を今すぐ送る
+    // flushIfDue() で送るべき時刻までの残りms (溜まっていなければ ULONG_MAX)
+    unsigned long msUntilFlush(uint64_t nowMs) const;
+
+    uint32_t getDatagramsSent() const;
+    uint32_t getSendErrors() const;
+
+private:
+    WiFiUDP udp;
+    uint16_t port;
+    HostResolver* resolver;  // 送信先アドレスの取得元
+    DatagramPacker packer;
+    uint64_t firstPendingMs;      // 未送信の先頭サンプルを積んだ時刻
+    uint32_t datagramsSent;
+    uint32_t sendErrors;
+};
+
+#endif // UDP_TELEMETRY_HPP
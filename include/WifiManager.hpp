@@ -4,26 +4,27 @@
 #include <WiFi.h>
 #include "Storage.hpp"
 #include "config.hpp"
-#include <vector> // ★ vector を使うためにインクルード ★
+#include "Clock.hpp"
+#include "FixedString.hpp"
 // #include <ESPAsyncWebServer.h> // 削除
 // #include <DNSServer.h>         // 削除
 
 // ★ スキャン結果を保持する構造体 ★
 struct WiFiScanInfo {
-    String ssid;
+    FixedString<33> ssid; // SSID は最大32バイト
     int32_t rssi;
     wifi_auth_mode_t encryptionType;
 };
 
 class WifiManager {
 public:
-    WifiManager(Storage& storage);
-    void begin();
+    WifiManager(Storage& storage, Clock& clock);
+    void begin(); // 無線を STA で起動する (Storage を使わないので SD の初期化と並行してよい)
     bool connect(); // 自動接続 (NVS優先、次にYAMLの最初の設定で接続試行)
     bool connectFromYaml(int index = 0); // ★ YAMLの指定indexで接続試行 ★
     void disconnect();
     bool isConnected();
-    String getStatusMessage(); // 現在の状態メッセージ取得
+    const char* getStatusMessage(); // 現在の状態メッセージ取得 (次に状態が変わるまで有効)
     void updateStatus(); // 接続状態などを更新
     IPAddress getLocalIP();
     bool isAttemptingConnection() const; // 接続試行中か
@@ -31,23 +32,28 @@ public:
     // ★★★ Wi-Fiスキャン関連メソッド ★★★
     int scanNetworks(); // スキャン実行
     int getScanResultCount() const; // スキャン結果数を取得
-    WiFiScanInfo getScanResult(int index) const; // 個別のスキャン結果を取得
+    const WiFiScanInfo& getScanResult(int index) const; // 個別のスキャン結果を取得
 
     // --- APモード関連メソッドは削除 ---
 
 private:
     Storage& storage;
-    String currentSSID; // 現在接続中または接続試行中のSSID
-    String currentStatus; // 表示用のステータスメッセージ
+    Clock& clock; // 接続タイムアウト判定用
+    // 状態メッセージは画面の毎フレームで読み、状態確認のたびに書き換えるので、String ではなく固定長で持つ
+    FixedString<33> currentSSID; // 現在接続中または接続試行中のSSID
+    FixedString<96> currentStatus; // 表示用のステータスメッセージ
     wl_status_t lastStatus; // 前回のWiFiステータス
-    unsigned long connectAttemptTime; // 接続試行開始時刻
+    uint64_t connectAttemptTime; // 接続試行開始時刻
     bool isConnecting; // 現在接続試行中か
 
     // ★★★ スキャン結果を保持するメンバ変数 ★★★
-    std::vector<WiFiScanInfo> scanResults; // スキャン結果リスト
-    unsigned long lastScanTime = 0; // 最終スキャン時刻（連続スキャン防止用）
+    WiFiScanInfo scanResults[WIFI_SCAN_MAX_RESULTS]; // スキャン結果リスト (スキャンのたびに上書き)
+    int scanResultCount = 0;
+    uint64_t lastScanTime = 0; // 最終スキャン時刻（連続スキャン防止用）
     bool scanning = false; // スキャン実行中フラグ
 
+    void setConnectedStatus();
+
     // --- APモード関連メンバーは削除 ---
 };
 
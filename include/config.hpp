@@ -1,39 +1,171 @@
 #ifndef CONFIG_HPP
 #define CONFIG_HPP
 
+#ifdef ARDUINO
 #include "driver/pcnt.h"
+#endif
 #include <stdint.h>
+#include <stddef.h>
 
 // --- ハードウェア設定 ---
-const int PULSE_INPUT_PIN = 36;
-const pcnt_unit_t PCNT_UNIT = PCNT_UNIT_0;
+const int PULSE_INPUT_PIN = 36;                    // チャンネル0 (本体の椅子) の入力。ディープスリープからの復帰もこのピン
+#ifdef ARDUINO // ホストテスト (pio test -e native) では PCNT ドライバが無い
+const pcnt_unit_t PCNT_UNIT = PCNT_UNIT_0;         // チャンネル0のPCNTユニット (チャンネルnは PCNT_UNIT + n)
 const pcnt_channel_t PCNT_CHANNEL = PCNT_CHANNEL_0;
+#endif
+const size_t PULSE_MAX_CHANNELS = 8;               // 椅子の最大数 (ESP32 のPCNTユニット数)
 const int DEBUG_LED_PIN = 2;
+const int SPI_SCK_PIN = 18;                        // LCD と SD で共有する SPI バス
+const int SPI_MISO_PIN = 19;
+const int SPI_MOSI_PIN = 23;
 
 // --- 動作設定 ---
 const int PULSES_PER_REVOLUTION = 1;
 const unsigned long TIMER_STOP_DELAY_MS = 3000; // 3秒
 const unsigned long SLEEP_TIMEOUT_MS = 63000; // 63秒
 const unsigned long WIFI_CONNECT_TIMEOUT_MS = 15000;
-const unsigned long DATA_PUBLISH_INTERVAL_MS = 500; // 10秒
+const size_t WIFI_SCAN_MAX_RESULTS = 16;                // Wi-Fiスキャン結果を保持する数 (超えた分は捨てる)
+const unsigned long PUBLISH_MIN_INTERVAL_MS = 250;      // 急変時の最短送信間隔
+const unsigned long PUBLISH_HEARTBEAT_MS = 10000;       // 定常時の送信間隔 (ハートビート)
+const uint32_t PUBLISH_BUDGET_BYTES_PER_SEC = 1024;     // 1台あたりの送信帯域予算 (0=無制限)
+const int32_t PUBLISH_CONNECT_TIMEOUT_MS = 2000;        // 接続タイムアウト
+const uint16_t PUBLISH_RESPONSE_TIMEOUT_MS = 3000;      // 応答タイムアウト
+const uint16_t BREAKER_FAILURE_THRESHOLD = 3;           // 連続失敗この回数で送信先を遮断
+const unsigned long BREAKER_BASE_BACKOFF_MS = 2000;     // 遮断時のバックオフ初期値
+const unsigned long BREAKER_MAX_BACKOFF_MS = 300000;    // バックオフ上限 (5分)
+const size_t PUBLISH_QUEUE_DEPTH = 4;                   // 送信先ごとの未送信ペイロード保持数
+const size_t PUBLISH_SESSION_QUEUE_DEPTH = 4;           // 送信先ごとの未送信セッション要約 (サンプルとは別のキュー)
+const size_t MAX_ENDPOINTS = 4;                         // config.json で指定できる送信先の最大数
+const size_t PUBLISH_PAYLOAD_POOL_SIZE = MAX_ENDPOINTS * (PUBLISH_QUEUE_DEPTH + PUBLISH_SESSION_QUEUE_DEPTH) + 3; // 送信待ちペイロードの入れ物の数 (全キュー + 形式ごとの作りかけ)
+const size_t PUBLISH_PAYLOAD_RESERVE_BYTES = 512;       // ペイロード1件に最初から確保する長さ (エンコード中に realloc しない。1チャンネルなら収まる)
+const size_t UDP_MAX_DATAGRAM_SIZE = 1472;              // UDP送信時の1データグラム上限 (MTU 1500 - IP/UDPヘッダー)
+const unsigned long UDP_FLUSH_INTERVAL_MS = 2000;       // UDP送信: 溜めたサンプルをこの時間内に必ず送る
+const unsigned long DNS_CACHE_TTL_MS = 300000;          // 送信先ホスト名の解決結果を使い回す時間 (5分)
 const unsigned long METRICS_CALC_INTERVAL_MS = 1000; // 1秒
 const uint16_t PCNT_FILTER_VALUE = 1023; // PCNTノイズフィルタ値
 const int16_t PCNT_EVENT_THRESHOLD = 1;  // PCNTイベントしきい値
+const size_t PULSE_PERIOD_RING_SIZE = 32;         // ISRから計測タスクへ渡すパルス間隔の待ち行列 (2のべき乗)
+
+// --- ケイデンス推定 (config.json の "cadence" で上書き可) ---
+const size_t CADENCE_MAX_WINDOW = 15;             // 外れ値判定に使う間隔数の上限
+const uint8_t CADENCE_WINDOW_DEFAULT = 5;         // 外れ値判定に使う直近の間隔数
+const uint32_t CADENCE_RESPONSE_MS_DEFAULT = 1500; // 平滑化の時定数
+const float CADENCE_HAMPEL_K_DEFAULT = 3.0f;      // 外れ値とみなす MAD の倍数
+const uint32_t CADENCE_MAX_PERIOD_MS = 6000;      // これより長い間隔は休止とみなす (10rpm 未満)
+
+// --- ケイデンスのゾーンと区間検出 (CadenceAnalyzer) ---
+const size_t CADENCE_ZONE_COUNT = 6;              // ゾーン数 (上限の RPM は下の配列、最後のゾーンは上限なし)
+const uint16_t CADENCE_ZONE_UPPER_RPM[CADENCE_ZONE_COUNT - 1] = { 20, 40, 60, 80, 100 };
+const uint32_t CADENCE_CPD_DRIFT_RPM = 6;          // 区間の平均からこれ以内のずれは変化とみなさない
+const uint32_t CADENCE_CPD_THRESHOLD_RPM_S = 90;  // ずれの積算 (rpm×秒) がこれを超えたら変化点 (30rpm の段差なら約4秒で検出)
+const uint32_t CADENCE_MIN_SEGMENT_MS = 20000;    // これより短い区間は次の区間にまとめる (加減速の途中で区切らない)
+const uint32_t CADENCE_WORK_RPM = 30;             // 区間の平均がこれ以上なら運動、未満なら休み
+
+// --- RPM・速度の履歴 (TimeSeriesStore)。1区間14バイト ---
+// 分・時の段はディープスリープの間 RTC メモリ (8KB) に写して残すので、2段で約5KBに収める
+const size_t SERIES_SECONDS_CAPACITY = 600;       // 1秒ごと × 10分 (約8KB。起動中だけ)
+const size_t SERIES_MINUTES_CAPACITY = 180;       // 1分ごと × 3時間
+const size_t SERIES_HOURS_CAPACITY = 168;         // 1時間ごと × 1週間
+
+// --- 送信待ちサンプルの圧縮バッファ (SampleBuffer) ---
+const size_t SAMPLE_BUFFER_BLOCK_BYTES = 1024;    // 1ブロックの大きさ (解放の単位)
+const size_t SAMPLE_BUFFER_BLOCKS = 32;           // ブロック数 (合計 32KB。1日分のペダリングは約 75KB、32KB で約10時間)
+
+// --- タスク設定 (FreeRTOS) ---
+// 計測は最優先、通信はコア0 (Wi-Fi/lwIPと同じコア)、画面とSD書き込みは低優先度で動かす
+const uint32_t SENSING_TASK_STACK = 4096;
+const uint32_t NETWORK_TASK_STACK = 8192;   // HTTPS (mbedTLS) のため大きめ
+const uint32_t UI_TASK_STACK = 8192;
+const uint32_t STORAGE_TASK_STACK = 6144;   // ArduinoJson + SD
+const uint32_t LOG_TASK_STACK = 3072;       // ログの書式化 (vsnprintf) とシリアル出力
+const uint8_t SENSING_TASK_PRIORITY = 5;
+const uint8_t NETWORK_TASK_PRIORITY = 3;
+const uint8_t UI_TASK_PRIORITY = 2;
+const uint8_t STORAGE_TASK_PRIORITY = 1;
+const uint8_t LOG_TASK_PRIORITY = 1;
+const int SENSING_TASK_CORE = 1;
+const int NETWORK_TASK_CORE = 0;
+const int UI_TASK_CORE = 1;
+const int STORAGE_TASK_CORE = 1;
+const int LOG_TASK_CORE = 0;                // UARTの出力待ちで計測・UIのコアを使わない
+const unsigned long NETWORK_LINK_CHECK_INTERVAL_MS = 1000; // 通信タスク: 送るものが無いときのWi-Fi/NTP/DNS確認間隔
+const unsigned long UI_TASK_PERIOD_MS = 10;       // ボタン押下中などのポーリング周期
+const unsigned long UI_ACTIVE_POLL_MS = 200;      // ボタン操作・計測更新の後、短周期ポーリングを続ける時間
+const unsigned long DISPLAY_REFRESH_INTERVAL_MS = 500; // Wi-Fi設定/AP画面の再描画間隔 (計測画面は変化時のみ)
+const size_t STORAGE_QUEUE_DEPTH = 4;              // SD書き込み要求の待ち行列の長さ
+const unsigned long STORAGE_SESSION_RETRY_MS = 50; // キュー満杯で預かったセッション要約を積み直す間隔
+const size_t SESSION_EVENT_QUEUE_DEPTH = 4;        // 送信待ちのセッション要約 (Wi-Fi未接続の間に溜める数)
+const unsigned long SESSION_EVENT_FLUSH_TIMEOUT_MS = 5000; // ディープスリープ前にセッション要約の送信を待つ最大時間
+const unsigned long TASK_STATS_PRINT_INTERVAL_MS = 10000; // タスク統計のシリアル出力間隔
+
+// --- 処理時間の計測 (プロファイラ) ---
+// 1 にすると各処理の所要サイクル数をヒストグラムに取る (platformio.ini の profiling 環境で有効)。0 なら計測コードは一切入らない
+#ifndef FIT2GO_PROFILING
+#define FIT2GO_PROFILING 0
+#endif
+const uint16_t DIAGNOSTICS_HTTP_PORT = 8080;      // 診断用HTTPサーバー (APモードのポータルの80番と重ならないように)
+const uint32_t PROFILE_CPU_MHZ = 240;             // サイクル数→µs の換算に使うCPUクロック (電源管理の最大値)
+
+// --- イベントトレース ---
+// 1 なら状態遷移・パルス・送信の各段階などをRAM上のリングに記録する (シリアルの "trace" / "trace sd" で取り出す)
+#ifndef FIT2GO_TRACING
+#define FIT2GO_TRACING 1
+#endif
+const size_t TRACE_RING_SIZE = 1024;              // 記録できるイベント数 (2のべき乗。1件16バイト)
+const size_t TRACE_MAX_TASKS = 8;                 // 名前を付けて区別するタスクの数
+
+// --- ヒープの使用状況 (HeapStats) ---
+// malloc / calloc / realloc を呼んだタスクごとに回数を数える (platformio.ini の -Wl,--wrap が必要)
+const size_t HEAP_MAX_TASKS = 8;                  // 分けて数えるタスクの数 (それ以外は "other")
+
+// --- /metrics (Prometheus のテキスト形式、DIAGNOSTICS_HTTP_PORT) ---
+// 処理時間のヒストグラムの区切り (µs、昇順。最大 MetricHistogram::MAX_BOUNDS 個。出力では秒になる)
+const size_t METRIC_LOOP_BUCKET_COUNT = 8;
+const uint32_t METRIC_LOOP_BUCKETS_US[METRIC_LOOP_BUCKET_COUNT] = { 100, 500, 1000, 5000, 10000, 50000, 100000, 500000 };
+const size_t METRIC_PUBLISH_BUCKET_COUNT = 8;
+const uint32_t METRIC_PUBLISH_BUCKETS_US[METRIC_PUBLISH_BUCKET_COUNT] = { 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000 };
+const size_t METRIC_SD_WRITE_BUCKET_COUNT = 9;
+const uint32_t METRIC_SD_WRITE_BUCKETS_US[METRIC_SD_WRITE_BUCKET_COUNT] = { 1000, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000 };
+
+// --- ログ ---
+// LOG_E / LOG_W / LOG_I / LOG_D は引数をリングに詰めるだけで、書式化とシリアル出力はログタスクが後で行う
+// LOG_LEVEL より詳しいレベルの呼び出しはコンパイル時に消える (引数も評価しない)
+#define LOG_LEVEL_NONE  0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN  2
+#define LOG_LEVEL_INFO  3
+#define LOG_LEVEL_DEBUG 4
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+const size_t LOG_RING_SIZE = 64;                  // 出力待ちにできるメッセージ数 (2のべき乗。一杯なら新しいものを捨てて数える)
+const size_t LOG_ARG_BYTES = 96;                  // 1件の引数に使えるバイト数 (文字列はここに収まるよう切り詰める)
+const uint32_t LOG_RATE_WINDOW_MS = 1000;         // 呼び出し箇所ごとの間引き: この時間に
+const uint16_t LOG_RATE_BURST = 5;                // この件数まで出し、残りは数だけ数えて次に出す1件に付ける
+const uint32_t LOG_FLUSH_TIMEOUT_MS = 500;        // ディープスリープ・再起動の前にログを出し切るのを待つ最大時間
 
 // --- 計算用定数 ---
-const float DISTANCE_PER_REV_M = 4.4466f; // 1回転あたりの距離 (m)
-const float CALORIES_RPM_K1_FACTOR = 0.00113889f; // カロリー計算係数 (RPM to kcal/sec)
+constexpr float DISTANCE_PER_REV_M = 4.4466f; // 1回転あたりの距離 (m)
+constexpr float CALORIES_RPM_K1_FACTOR = 0.00113889f; // カロリー計算係数 (RPM to kcal/sec)
+// 積算用の整数版 (上の2つと同じ値)。float に足し込むと合計が大きくなったとき増分が丸めで消えるので、積算は整数で行う
+const uint32_t DISTANCE_PER_REV_UM = 4446600;    // 1回転あたりの距離 (µm)
+const uint32_t CALORIES_RPM_K1_E8 = 113889;      // CALORIES_RPM_K1_FACTOR × 10^8
+const uint32_t MAX_VALID_RPM = 300;              // これを超えるRPMは異常値として直前の値を使う
 
 // --- 設定ファイルパス (SDカード) ---
 extern const char* CONFIG_JSON_PATH;          // Wi-Fi設定, Endpoint URL用
 extern const char* LATEST_DATA_JSON_PATH;   // 最新累積データ用 (.json)
+extern const char* LATEST_DATA_CHANNEL_JSON_PATH_FORMAT; // 同上、チャンネル1以降 (%u にチャンネル番号)
 extern const char* HISTORY_DATA_JSONL_PATH; // 履歴データ用 (.jsonl)
+extern const char* SESSIONS_JSONL_PATH;     // セッション要約用 (.jsonl)
+extern const char* TRACE_DUMP_PATH;         // イベントトレースの書き出し先 (バイナリ)
 extern const char* ROOT_CA_PEM_PATH;        // ★ ルートCA証明書ファイルパス ★
 
 // --- NVS 設定 (WiFi認証情報用) ---
 extern const char* NVS_NAMESPACE;           // NVS名前空間
 extern const char* NVS_KEY_WIFI_SSID;       // NVSキー (SSID)
 extern const char* NVS_KEY_WIFI_PASS;       // NVSキー (Password)
+extern const char* NVS_KEY_PULSE_CHANNELS;  // NVSキー (入力チャンネル。起動直後に SD を待たずに PCNT を始めるための写し)
 
 // --- APモード設定 ---
 extern const char* AP_SETUP_SSID;           // APモード時のSSID
@@ -63,4 +195,11 @@ enum class DriveType {
     EVENT_DRIVEN
 };
 
+// --- 送信ペイロード形式 ---
+enum class PayloadFormat {
+    JSON,          // 従来のJSON (application/json)
+    INFLUX_LINE,   // InfluxDB line protocol (text/plain)
+    STATSD         // StatsD ゲージ (UDP送信先向け)
+};
+
 #endif // CONFIG_HPP
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "APConfigPortal.hpp"
 #include <M5Stack.h>
 #include <ArduinoJson.h> // JSON用
+#include <memory>
 
 // コンストラクタ
 APConfigPortal::APConfigPortal(Storage& storageRef, WifiManager& wifiManagerRef) :
@@ -85,31 +86,20 @@ void APConfigPortal::resetCredentialsSavedFlag(){
 // --- Webハンドラ ---
 
 // ★★★ ルート ("/") ハンドラ修正: スキャン結果をHTMLに埋め込む ★★★
+// ページはチャンク転送で、送信バッファが空くたびに続きを書く (全体を String の += で組み立てない)
 void APConfigPortal::handleRootRequest(AsyncWebServerRequest *request) {
     Serial.println("[AP Portal] Serving root page with embedded scan results...");
+    std::shared_ptr<RootPageWriter> writer(new RootPageWriter(wifiManager));
+    AsyncWebServerResponse* response = request->beginChunkedResponse("text/html",
+        [writer](uint8_t* buffer, size_t maxLength, size_t index) -> size_t {
+            return writer->read(buffer, maxLength);
+        });
+    request->send(response);
+}
 
-    // WifiManagerから最新のスキャン結果を取得
-    String scanResultHtml = "Networks Found:<br>";
-    int n = wifiManager.getScanResultCount();
-    if (n > 0) {
-        for (int i = 0; i < n; i++) {
-            WiFiScanInfo info = wifiManager.getScanResult(i);
-            // Escape single quotes in SSID for the onclick handler
-            String escapedSsid = info.ssid;
-            escapedSsid.replace("'", "\\'");
-            escapedSsid.replace("\"", "&quot;"); // Also escape double quotes
-
-            scanResultHtml += "<div class=\"network\" onclick=\"document.getElementById('ssid').value='" + escapedSsid + "'; document.getElementById('pass').value='';\">"; // ★ パスワードもクリア ★
-            scanResultHtml += info.ssid + " (" + String(info.rssi) + "dBm) " + (info.encryptionType == WIFI_AUTH_OPEN ? "" : "*");
-            scanResultHtml += "</div>";
-        }
-    } else {
-        scanResultHtml += "No networks found. (Scan on M5Stack first if needed)";
-    }
-
-    // ベースとなるHTML (ファイルから読む代わりにここで定義、ScanボタンとJS削除)
-    // SDカードから読む場合は storage.readFileContent(WIFI_CONFIG_HTML_PATH) を使う
-    String htmlBase = R"rawliteral(
+// ベースとなるHTML (ファイルから読む代わりにここで定義、ScanボタンとJS削除)
+// SDカードから読む場合は storage.readFileContent(WIFI_CONFIG_HTML_PATH) を使う
+static const char ROOT_PAGE_HEAD[] = R"rawliteral(
 <!DOCTYPE html><html><head><meta charset="utf-8"><meta name="viewport" content="width=device-width, initial-scale=1"><title>M5Stack WiFi Setup</title>
 <style>body{font-family:sans-serif;background-color:#f4f4f4;color:#333;margin:15px;}h1{text-align:center;color:#007bff;}
 #scanResults{margin-top:15px;max-height:200px;overflow-y:auto;border:1px solid #ccc;padding:10px;background-color:#fff;}
@@ -119,11 +109,9 @@ button{padding:10px 15px;background-color:#007bff;color:#fff;border:none;border-
 button:hover{background-color:#0056b3;}
 </style></head><body><h1>WiFi Configuration</h1>
 <div id="scanResults">
-)rawliteral"; // ここまでが前半
-
-    htmlBase += scanResultHtml; // スキャン結果を挿入
+Networks Found:<br>)rawliteral"; // ここまでが前半 (この後にスキャン結果)
 
-    htmlBase += R"rawliteral(
+static const char ROOT_PAGE_TAIL[] = R"rawliteral(
 </div>
 <form method="POST" action="/save">
 <label for="ssid">Network Name (SSID):</label><input type="text" id="ssid" name="ssid" required>
@@ -133,18 +121,67 @@ button:hover{background-color:#0056b3;}
 </body></html>
 )rawliteral"; // ここからが後半
 
-    // ファイル読み込みを優先する場合:
-    // String htmlContent = storage.readFileContent(WIFI_CONFIG_HTML_PATH);
-    // if (htmlContent.length() > 0) {
-    //    // TODO: htmlContent 内のプレースホルダを scanResultHtml で置き換える処理が必要
-    //    request->send(200, "text/html", htmlContent);
-    // } else {
-    //     Serial.println("[AP Portal] Error: Failed to read wifi_config.html from SD card! Using fallback HTML.");
-    //     request->send(200, "text/html", htmlBase); // フォールバックとして埋め込みHTMLを使用
-    // }
-    // 現状は埋め込みHTMLを直接使用
-    request->send(200, "text/html", htmlBase);
+APConfigPortal::RootPageWriter::RootPageWriter(WifiManager& wifiManager) :
+    wifiManager(wifiManager),
+    networkCount(wifiManager.getScanResultCount()),
+    step(0),
+    source(ROOT_PAGE_HEAD),
+    sourceLength(sizeof(ROOT_PAGE_HEAD) - 1),
+    position(0)
+{}
 
+size_t APConfigPortal::RootPageWriter::read(uint8_t* buffer, size_t maxLength) {
+    size_t written = 0;
+    while (written < maxLength) {
+        if (position == sourceLength) {
+            if (!nextPart())
+                break; // 終わった後は何度呼ばれても 0 を返す
+            position = 0;
+        }
+        size_t chunk = sourceLength - position;
+        if (chunk > maxLength - written)
+            chunk = maxLength - written;
+        memcpy(buffer + written, source + position, chunk);
+        position += chunk;
+        written += chunk;
+    }
+    return written;
+}
+
+// 前半 → ネットワーク1件ずつ (無ければ案内) → 後半 の順に出す
+bool APConfigPortal::RootPageWriter::nextPart() {
+    step++;
+    if (networkCount == 0 && step == 1) {
+        source = "No networks found. (Scan on M5Stack first if needed)";
+        sourceLength = strlen(source);
+        return true;
+    }
+    int network = step - 1;
+    if (network < networkCount) {
+        const WiFiScanInfo& info = wifiManager.getScanResult(network);
+        line = "<div class=\"network\" onclick=\"document.getElementById('ssid').value='";
+        // onclick の中に入れるので、引用符をエスケープする
+        for (const char* c = info.ssid.c_str(); *c != '\0'; c++) {
+            if (*c == '\'')
+                line.append("\\'");
+            else if (*c == '"')
+                line.append("&quot;");
+            else
+                line.append(*c);
+        }
+        line.appendf("'; document.getElementById('pass').value='';\">%s (%ddBm) %s</div>", // ★ パスワードもクリア ★
+                     info.ssid.c_str(), (int)info.rssi, info.encryptionType == WIFI_AUTH_OPEN ? "" : "*");
+        source = line.c_str();
+        sourceLength = line.length();
+        return true;
+    }
+    int tailStep = networkCount == 0 ? 2 : networkCount + 1;
+    if (step == tailStep) {
+        source = ROOT_PAGE_TAIL;
+        sourceLength = sizeof(ROOT_PAGE_TAIL) - 1;
+        return true;
+    }
+    return false;
 }
 
 
@@ -163,13 +200,12 @@ void APConfigPortal::handleSaveRequest(AsyncWebServerRequest *request) {
     if (request->hasParam("pass", true)) pass = request->getParam("pass", true)->value();
 
     if (ssid.length() > 0) {
-        Serial.println("[AP Portal] Received SSID: " + ssid);
+        Serial.printf("[AP Portal] Received SSID: %s\n", ssid.c_str());
         // ★ storage のメソッドでNVSに保存 ★
         if (storage.saveWiFiCredentialsToNVS(ssid, pass)) {
             Serial.println("[AP Portal] Credentials saved to NVS successfully.");
             credentialsSavedFlag = true; // 保存成功フラグを立てる
-            String html = "<html><body><h1>Configuration Saved!</h1><p>The device will restart shortly.</p></body></html>";
-            request->send(200, "text/html", html);
+            request->send(200, "text/html", "<html><body><h1>Configuration Saved!</h1><p>The device will restart shortly.</p></body></html>");
             // 再起動は main loop 側でフラグを見て行う
         } else {
             Serial.println("[AP Portal] Failed to save credentials to NVS!");
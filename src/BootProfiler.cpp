@@ -0,0 +1,71 @@
+#include "BootProfiler.hpp"
+#include "Log.hpp"
+#include "esp_attr.h"
+#include "esp_timer.h"
+
+namespace {
+
+const size_t PHASE_COUNT = (size_t)BootPhase::COUNT;
+const uint32_t TIMELINE_MAGIC = 0xB0071AE5; // 電源投入直後 (中身は不定) と区別する
+
+struct BootTimeline {
+    uint32_t magic;
+    volatile uint32_t phaseUs[PHASE_COUNT];
+};
+
+// RTC_NOINIT_ATTR: ディープスリープからの復帰に加えて、ソフトウェアリセットでも初期化されない
+RTC_NOINIT_ATTR BootTimeline current;
+BootTimeline previous; // begin() で current から写す (RAM。起動のたびに空から始まる)
+
+// ms で出す (0 はその段階に達していない)
+inline unsigned toMs(const BootTimeline& timeline, BootPhase phase) {
+    return (unsigned)(timeline.phaseUs[(size_t)phase] / 1000);
+}
+
+// 1行の書式 (ログの引数は数値で渡す。文字列にまとめると LOG_ARG_BYTES で切れる)
+#define BOOT_TIMELINE_FORMAT "setup:%ums pcnt:%ums display:%ums storage:%ums wifi:%ums channels:%ums tasks:%ums"
+#define BOOT_TIMELINE_ARGS(t) \
+    toMs(t, BootPhase::SETUP_START), toMs(t, BootPhase::PCNT_READY), toMs(t, BootPhase::DISPLAY_READY), \
+    toMs(t, BootPhase::STORAGE_READY), toMs(t, BootPhase::WIFI_READY), toMs(t, BootPhase::CHANNELS_READY), \
+    toMs(t, BootPhase::TASKS_STARTED)
+
+} // namespace
+
+void BootProfiler::begin() {
+    if (current.magic == TIMELINE_MAGIC) {
+        previous.magic = TIMELINE_MAGIC;
+        for (size_t i = 0; i < PHASE_COUNT; i++)
+            previous.phaseUs[i] = current.phaseUs[i];
+    }
+    current.magic = TIMELINE_MAGIC;
+    for (size_t i = 0; i < PHASE_COUNT; i++)
+        current.phaseUs[i] = 0;
+    mark(BootPhase::SETUP_START);
+}
+
+void BootProfiler::mark(BootPhase phase) {
+    uint32_t us = (uint32_t)esp_timer_get_time();
+    current.phaseUs[(size_t)phase] = us > 0 ? us : 1; // 0 は「まだ」に使う
+}
+
+uint32_t BootProfiler::getUs(BootPhase phase) {
+    return current.phaseUs[(size_t)phase];
+}
+
+uint32_t BootProfiler::getPreviousUs(BootPhase phase) {
+    return previous.magic == TIMELINE_MAGIC ? previous.phaseUs[(size_t)phase] : 0;
+}
+
+void BootProfiler::print() {
+    static_assert(PHASE_COUNT == 7, "update BOOT_TIMELINE_FORMAT when adding a boot phase");
+    LOG_I("[Boot] " BOOT_TIMELINE_FORMAT, BOOT_TIMELINE_ARGS(current));
+    if (previous.magic == TIMELINE_MAGIC)
+        LOG_I("[Boot] previous: " BOOT_TIMELINE_FORMAT, BOOT_TIMELINE_ARGS(previous));
+    // 以前の順序では PCNT は LCD と SD (config.json) の両方を終えてから始めていた。その時点との差を出す
+    uint32_t pcntUs = current.phaseUs[(size_t)BootPhase::PCNT_READY];
+    uint32_t displayUs = current.phaseUs[(size_t)BootPhase::DISPLAY_READY];
+    uint32_t storageUs = current.phaseUs[(size_t)BootPhase::STORAGE_READY];
+    uint32_t serialOrderUs = displayUs > storageUs ? displayUs : storageUs;
+    if (pcntUs != 0 && displayUs != 0 && storageUs != 0 && serialOrderUs > pcntUs)
+        LOG_I("[Boot] pcnt started %ums before display+storage were ready", (unsigned)((serialOrderUs - pcntUs) / 1000));
+}
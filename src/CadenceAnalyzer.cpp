@@ -0,0 +1,97 @@
+#include "CadenceAnalyzer.hpp"
+
+// 判定に使う値 (1/1000 rpm と ms の単位にそろえる)
+static const int64_t DRIFT_MILLI_RPM = (int64_t)CADENCE_CPD_DRIFT_RPM * 1000;
+static const int64_t THRESHOLD_MILLI_RPM_MS = (int64_t)CADENCE_CPD_THRESHOLD_RPM_S * 1000 * 1000;
+static const uint32_t WORK_MILLI_RPM = CADENCE_WORK_RPM * 1000;
+
+CadenceAnalyzer::CadenceAnalyzer() {
+    reset(0);
+}
+
+void CadenceAnalyzer::reset(uint64_t startMs) {
+    analysis = CadenceAnalysis();
+    analysis.segmentStartMs = startMs;
+    segment.clear();
+    up.sum = 0;
+    up.startMs = startMs;
+    up.since.clear();
+    down = up;
+    lastSegmentWorking = false;
+    hasClosedSegment = false;
+    closedWorkIntervals = 0;
+}
+
+void CadenceAnalyzer::add(uint64_t nowMs, uint32_t intervalMs, uint32_t milliRpm, bool active) {
+    if (intervalMs == 0)
+        return;
+    uint8_t zone = zoneOf(milliRpm);
+    analysis.currentZone = zone;
+    if (active)
+        analysis.zoneMs[zone] += intervalMs;
+
+    // 今の区間の平均からのずれを上下それぞれ積算する (区間の最初の値はずれ0)
+    int64_t mean = segment.ms > 0 ? (int64_t)segment.mean() : (int64_t)milliRpm;
+    int64_t deviation = (int64_t)milliRpm - mean;
+    updateDetector(up, deviation - DRIFT_MILLI_RPM, nowMs, milliRpm, intervalMs);
+    updateDetector(down, -deviation - DRIFT_MILLI_RPM, nowMs, milliRpm, intervalMs);
+
+    if (up.sum > THRESHOLD_MILLI_RPM_MS) {
+        startSegment(up, nowMs);
+    } else if (down.sum > THRESHOLD_MILLI_RPM_MS) {
+        startSegment(down, nowMs);
+    } else {
+        segment.add(milliRpm, intervalMs);
+    }
+    analysis.segmentMilliRpm = segment.mean();
+    updateWorking();
+}
+
+// 累積和が0以下に戻ったら、そこを次の変化点の候補にする
+void CadenceAnalyzer::updateDetector(Detector& detector, int64_t deviation, uint64_t nowMs, uint32_t milliRpm, uint32_t intervalMs) {
+    detector.sum += deviation * (int64_t)intervalMs;
+    if (detector.sum <= 0) {
+        detector.sum = 0;
+        detector.startMs = nowMs;
+        detector.since.clear();
+    } else {
+        detector.since.add(milliRpm, intervalMs);
+    }
+}
+
+// 変化を検出した: 候補の時刻で区間を切り、その後の値で新しい区間を始める
+// 今の区間が短すぎれば (加減速の途中で一度検出した場合など) 切らずに、区間の始まりはそのままで平均だけやり直す
+void CadenceAnalyzer::startSegment(const Detector& detector, uint64_t nowMs) {
+    bool merge = detector.startMs < analysis.segmentStartMs + CADENCE_MIN_SEGMENT_MS;
+    if (!merge) {
+        if (analysis.working && (!hasClosedSegment || !lastSegmentWorking))
+            closedWorkIntervals++;
+        lastSegmentWorking = analysis.working;
+        hasClosedSegment = true;
+        analysis.boundaries++;
+        analysis.segmentStartMs = detector.startMs;
+    }
+    segment = detector.since;
+    up.sum = 0;
+    up.startMs = nowMs;
+    up.since.clear();
+    down = up;
+}
+
+// 運動区間の数は閉じた区間の分に、今の区間が新しい運動区間ならその1つを足す
+void CadenceAnalyzer::updateWorking() {
+    analysis.working = segment.mean() >= WORK_MILLI_RPM;
+    bool newWork = analysis.working && (!hasClosedSegment || !lastSegmentWorking);
+    analysis.workIntervals = (uint16_t)(closedWorkIntervals + (newWork ? 1 : 0));
+}
+
+const CadenceAnalysis& CadenceAnalyzer::getAnalysis() const {
+    return analysis;
+}
+
+uint8_t CadenceAnalyzer::zoneOf(uint32_t milliRpm) {
+    uint8_t zone = 0;
+    while (zone < CADENCE_ZONE_COUNT - 1 && milliRpm >= (uint32_t)CADENCE_ZONE_UPPER_RPM[zone] * 1000)
+        zone++;
+    return zone;
+}
@@ -0,0 +1,144 @@
+#include "CadenceEstimator.hpp"
+
+CadenceEstimator::CadenceEstimator() :
+    pulsesPerRev(1),
+    minPeriodUs(0),
+    maxPeriodUs(UINT32_MAX),
+    periodCount(0),
+    nextIndex(0),
+    carryUs(0),
+    lastPeriodUs(0),
+    smoothedRpm(0.0f),
+    hasEstimate(false),
+    rejectedCount(0),
+    outlierCount(0)
+{}
+
+void CadenceEstimator::begin(const CadenceConfig& cfg, uint32_t ppr, uint32_t minUs, uint32_t maxUs) {
+    config = cfg;
+    // 中央値が1つに決まるよう奇数にそろえ、範囲に収める
+    if (config.window < 3)
+        config.window = 3;
+    if (config.window > CADENCE_MAX_WINDOW)
+        config.window = CADENCE_MAX_WINDOW;
+    if ((config.window & 1) == 0)
+        config.window--;
+    if (config.hampelK <= 0.0f)
+        config.hampelK = CADENCE_HAMPEL_K_DEFAULT;
+    pulsesPerRev = ppr > 0 ? ppr : 1;
+    minPeriodUs = minUs;
+    maxPeriodUs = maxUs;
+    reset();
+}
+
+void CadenceEstimator::reset() {
+    periodCount = 0;
+    nextIndex = 0;
+    carryUs = 0;
+    lastPeriodUs = 0;
+    smoothedRpm = 0.0f;
+    hasEstimate = false;
+}
+
+bool CadenceEstimator::addPeriod(uint32_t periodUs) {
+    if (periodUs == 0)
+        return true; // 休止明けの最初のパルス (間隔はまだ無い)
+
+    // 捨てたパルスがあれば、その前のパルスからの間隔に戻す
+    uint64_t joinedUs = (uint64_t)periodUs + carryUs;
+    if (joinedUs < minPeriodUs) {
+        // MAX_RPM を超える速さはあり得ない → ノイズ。次の間隔に繋げる
+        carryUs = (uint32_t)joinedUs;
+        rejectedCount++;
+        return false;
+    }
+    carryUs = 0;
+    if (joinedUs > maxPeriodUs) {
+        reset(); // 長い休止: 前の推定は使わず、次の間隔からやり直す
+        return true;
+    }
+    uint32_t period = (uint32_t)joinedUs;
+
+    // Hampel フィルタ: 直近の中央値から MAD×k 以上離れていたら中央値に置き換える
+    // 判定には置き換え前の値を残すので、ペースが本当に変わったときは window の半分ほどで中央値が追いつく
+    uint32_t accepted = period;
+    if (periodCount >= 3) {
+        uint32_t sorted[CADENCE_MAX_WINDOW];
+        for (size_t i = 0; i < periodCount; i++)
+            sorted[i] = periods[i];
+        uint32_t med = median(sorted, periodCount);
+        for (size_t i = 0; i < periodCount; i++)
+            sorted[i] = periods[i] > med ? periods[i] - med : med - periods[i];
+        uint32_t mad = median(sorted, periodCount);
+        // 間隔が揃いすぎて MAD が0のときでも、わずかな揺れで外れ値にしないよう下限を設ける
+        if (mad < med / 32)
+            mad = med / 32;
+        uint32_t deviation = period > med ? period - med : med - period;
+        // 1.4826 × MAD が正規分布の標準偏差に相当する
+        if ((float)deviation > config.hampelK * 1.4826f * (float)mad) {
+            accepted = med;
+            outlierCount++;
+        }
+    }
+    push(period);
+
+    // 指数移動平均: 重みを 間隔/(間隔+時定数) にすると、パルスの速さによらず時間で見た応答が同じになる
+    float rpm = 60000000.0f / ((float)pulsesPerRev * (float)accepted);
+    if (!hasEstimate) {
+        smoothedRpm = rpm;
+        hasEstimate = true;
+    } else {
+        float alpha = (float)accepted / ((float)accepted + (float)config.responseMs * 1000.0f);
+        smoothedRpm += alpha * (rpm - smoothedRpm);
+    }
+    lastPeriodUs = accepted;
+    return true;
+}
+
+uint32_t CadenceEstimator::getMilliRpm(uint64_t usSinceLastPulse) const {
+    if (!hasEstimate || usSinceLastPulse > maxPeriodUs)
+        return 0;
+    float rpm = smoothedRpm;
+    // 次のパルスが遅れているなら、少なくともその分は遅くなっている
+    if (usSinceLastPulse > lastPeriodUs) {
+        float upperBound = 60000000.0f / ((float)pulsesPerRev * (float)usSinceLastPulse);
+        if (upperBound < rpm)
+            rpm = upperBound;
+    }
+    return (uint32_t)(rpm * 1000.0f + 0.5f);
+}
+
+bool CadenceEstimator::isEnabled() const {
+    return config.enabled;
+}
+
+uint32_t CadenceEstimator::getRejectedCount() const {
+    return rejectedCount;
+}
+
+uint32_t CadenceEstimator::getOutlierCount() const {
+    return outlierCount;
+}
+
+void CadenceEstimator::push(uint32_t periodUs) {
+    periods[nextIndex] = periodUs;
+    nextIndex = (nextIndex + 1) % config.window;
+    if (periodCount < config.window)
+        periodCount++;
+}
+
+// 挿入ソートで並べて中央値を返す (要素数は window 以下なので十分速い)
+uint32_t CadenceEstimator::median(uint32_t* values, size_t count) const {
+    for (size_t i = 1; i < count; i++) {
+        uint32_t v = values[i];
+        size_t j = i;
+        while (j > 0 && values[j - 1] > v) {
+            values[j] = values[j - 1];
+            j--;
+        }
+        values[j] = v;
+    }
+    if (count & 1)
+        return values[count / 2];
+    return (uint32_t)(((uint64_t)values[count / 2 - 1] + values[count / 2]) / 2);
+}
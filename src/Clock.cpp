@@ -0,0 +1,6 @@
+#include "Clock.hpp"
+#include "esp_timer.h"
+
+uint64_t SystemClock::nowUs() const {
+    return (uint64_t)esp_timer_get_time();
+}
@@ -1,5 +1,9 @@
 #include "DataPublisher.hpp"
-#include <ArduinoJson.h>
+#include "PayloadEncoder.hpp"
+#include "MetricRegistry.hpp"
+#include "Profiler.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h> // ★ WiFiClientSecureヘッダー ★
 #include <SD.h>              // ★ SDカードアクセス用ヘッダー ★
@@ -8,137 +12,461 @@
 // ★ getCurrentTimestampMs 関数のプロトタイプ宣言 (main.cpp で定義) ★
 extern uint64_t getCurrentTimestampMs();
 
+static const size_t PAYLOAD_FORMAT_COUNT = 3; // PayloadFormat の要素数
+
+// /metrics 用 (HTTP(S) の送信先すべての合計。UDP は送った時点で結果がわからないので含めない)
+static MetricCounter publishSucceeded("fit2go_publish_total", "HTTP(S) publish attempts by result.", "result=\"success\"");
+static MetricCounter publishFailed("fit2go_publish_total", "HTTP(S) publish attempts by result.", "result=\"failure\"");
+static MetricHistogram publishDuration("fit2go_publish_duration_seconds", "Time for one HTTP(S) publish (connect, send and response).",
+                                       METRIC_PUBLISH_BUCKETS_US, METRIC_PUBLISH_BUCKET_COUNT);
+
 // コンストラクタ
-DataPublisher::DataPublisher(WifiManager& wifi) :
-    wifiManager(wifi), lastPublishTimeMs(0)
-{}
+DataPublisher::DataPublisher(WifiManager& wifi, Clock& clock) :
+    wifiManager(wifi), clock(clock), nextTargetIndex(0), drive_type(DriveType::TIMER_DRIVEN)
+{
+    deviceId[0] = '\0';
+}
 
-// 送信先URLを設定
-void DataPublisher::begin(const String& url, DriveType type) {
+// 送信先一覧を設定
+void DataPublisher::begin(const std::vector<EndpointConfig>& endpoints, DriveType type) {
     drive_type = type;
-    endpointUrl = url;
-     if (endpointUrl.length() == 0) {
-        Serial.println("Warning: Data Publisher initialized with empty URL.");
-    } else {
-        Serial.printf("Data Publisher initialized with URL: %s\n", endpointUrl.c_str());
+    targets.clear();
+    nextTargetIndex = 0;
+
+    uint64_t chipid = ESP.getEfuseMac();
+    snprintf(deviceId, sizeof(deviceId), "%04X%08X", (uint16_t)(chipid>>32), (uint32_t)chipid);
+
+    bool needsRootCA = false;
+    for (const EndpointConfig& endpoint : endpoints) {
+        if (endpoint.url.length() == 0)
+            continue;
+        Target target;
+        target.config = endpoint;
+        if (!target.url.parse(endpoint.url)) {
+            Serial.printf("Warning: Invalid endpoint URL skipped: %s\n", endpoint.url.c_str());
+            continue;
+        }
+        target.useHttps = target.url.isHttps();
+        target.resolver.reset(new HostResolver());
+        target.resolver->begin(target.url.host, DNS_CACHE_TTL_MS);
+        if (target.url.scheme == "udp") {
+            // UDPは応答を返さない line protocol / StatsD 専用
+            if (target.config.format == PayloadFormat::JSON)
+                target.config.format = PayloadFormat::INFLUX_LINE;
+            target.udp.reset(new UdpTelemetry());
+            if (!target.udp->begin(target.url, *target.resolver))
+                continue;
+        } else if (target.url.scheme != "http" && target.url.scheme != "https") {
+            Serial.printf("Warning: Unsupported scheme skipped: %s\n", endpoint.url.c_str());
+            continue;
+        } else if (target.config.format == PayloadFormat::STATSD) {
+            Serial.printf("Warning: statsd format requires a udp:// URL. Using json for %s\n", endpoint.url.c_str());
+            target.config.format = PayloadFormat::JSON;
+        }
+        unsigned long heartbeat = endpoint.minIntervalMs > PUBLISH_HEARTBEAT_MS ? endpoint.minIntervalMs : PUBLISH_HEARTBEAT_MS;
+        target.scheduler.begin(endpoint.minIntervalMs, heartbeat, PUBLISH_BUDGET_BYTES_PER_SEC);
+        target.health.begin(BREAKER_FAILURE_THRESHOLD, BREAKER_BASE_BACKOFF_MS, BREAKER_MAX_BACKOFF_MS, esp_random());
+        needsRootCA |= target.useHttps;
+        targets.push_back(std::move(target));
+        Serial.printf("Data Publisher target %d: %s\n", (int)targets.size() - 1, endpoint.url.c_str());
     }
-}
 
-// 必要に応じてデータを送信
-bool DataPublisher::publishIfNeeded(const TrackerData& data) {
-    unsigned long currentMillis = millis();
+    if (targets.empty()) {
+        Serial.println("Warning: Data Publisher initialized without endpoints.");
+    }
+    if (needsRootCA) {
+        loadRootCA();
+    }
+}
 
-    if (endpointUrl.length() == 0)
+// HTTPS用のルートCAをSDから読み込む (送信のたびに読まないようにキャッシュ)
+bool DataPublisher::loadRootCA() {
+    rootCA = "";
+    File rootCAFile = SD.open(ROOT_CA_PEM_PATH, FILE_READ);
+    if (!rootCAFile || rootCAFile.isDirectory()) {
+        Serial.printf("Error: Failed to open Root CA file: %s\n", ROOT_CA_PEM_PATH);
+        if(rootCAFile) rootCAFile.close();
         return false;
-    if (drive_type == DriveType::TIMER_DRIVEN)
-        if (!wifiManager.isConnected() || (currentMillis - lastPublishTimeMs < DATA_PUBLISH_INTERVAL_MS)) {
-            // Serial.printf("Wait for publish interval.\n");
-            return false;
-        }
+    }
+    Serial.printf("Loading Root CA from %s\n", ROOT_CA_PEM_PATH);
 
-    bool useHttps = endpointUrl.startsWith("https");
-    if (useHttps) {
-        Serial.printf("[%lu] Attempting to publish data via HTTPS...\n", currentMillis);
+    size_t fileSize = rootCAFile.size();
+    if (fileSize == 0) {
+         Serial.println("Error: Root CA file is empty!");
+         rootCAFile.close();
+         return false;
     }
-    else {
-        Serial.printf("[%lu] Attempting to publish data via HTTP...\n", currentMillis);
+
+    rootCA.reserve(fileSize);
+    rootCA = rootCAFile.readString();
+    rootCAFile.close();
+
+    if (rootCA.length() == 0) {
+         Serial.println("Error: Failed to read Root CA file content!");
+         return false;
     }
+    return true;
+}
 
-    WiFiClient* clientPtr;
-    WiFiClientSecure clientSecure;
-    WiFiClient clientHttp;
+// 送信先ホスト名の解決を進める (Wi-Fi接続直後に呼べば、最初の送信までに解決が済む)
+void DataPublisher::maintain(uint64_t nowMs) {
+    if (!wifiManager.isConnected())
+        return;
+    for (Target& target : targets) {
+        target.resolver->update(nowMs);
+    }
+}
 
-    if (useHttps) {
-        File rootCAFile = SD.open(ROOT_CA_PEM_PATH, FILE_READ);
-        if (!rootCAFile || rootCAFile.isDirectory()) {
-            Serial.printf("Error: Failed to open Root CA file: %s\n", ROOT_CA_PEM_PATH);
-            if(rootCAFile) rootCAFile.close();
-            return false;
+// 送信先ごとの「次に送れる時刻」のうち最も近いもの
+// 送れない送信先に 0 を返すと、送信されないまま通信タスクが眠らずに回り続けるので、送れるようになる時刻を返す
+unsigned long DataPublisher::msUntilNextWork(uint64_t nowMs, bool newData) const {
+    unsigned long remaining = ULONG_MAX;
+    for (const Target& target : targets) {
+        unsigned long ms = ULONG_MAX;
+        if (isBlocked(target, nowMs, ms)) {
+            // アドレスが解決できるか、試験送信の時刻まで待つ
+        } else {
+            if (newData)
+                ms = target.scheduler.msUntilDue(nowMs);
+            if (target.udp) {
+                unsigned long flushMs = target.udp->msUntilFlush(nowMs);
+                if (flushMs < ms)
+                    ms = flushMs;
+            } else if (hasQueued(target) &&
+                       (target.draining || target.health.getState() == EndpointHealth::State::OPEN)) {
+                ms = 0; // 送り残し、または試験送信の時刻が来た
+            }
         }
-        Serial.printf("Loading Root CA from %s\n", ROOT_CA_PEM_PATH);
+        if (ms < remaining)
+            remaining = ms;
+    }
+    return remaining;
+}
+
+bool DataPublisher::isBlocked(const Target& target, uint64_t nowMs, unsigned long& retryMs) const {
+    if (target.udp)
+        return false;
+    IPAddress address;
+    if (!target.resolver->getAddress(address)) {
+        retryMs = target.resolver->getRetryInMs(nowMs);
+        return true;
+    }
+    if (target.health.getState() == EndpointHealth::State::OPEN) {
+        retryMs = target.health.getRetryInMs(nowMs);
+        return retryMs > 0;
+    }
+    return false;
+}
+
+// 必要に応じてデータを送信
+bool DataPublisher::publishIfNeeded(const TrackerData& data, bool force) {
+    return publishIfNeeded(&data, 1, force);
+}
+
+bool DataPublisher::publishIfNeeded(const TrackerData* channels, size_t channelCount, bool force) {
+    uint64_t currentMillis = clock.nowMs();
 
-        size_t fileSize = rootCAFile.size();
-        if (fileSize == 0) {
-             Serial.println("Error: Root CA file is empty!");
-             rootCAFile.close();
-             return false;
+    if (targets.empty() || channelCount == 0)
+        return false;
+    // TIMER/EVENT どちらの駆動でも、送信間隔は送信先ごとのスケジューラが決める
+    // 複数チャンネルなら合計の変化で見る
+    float rpm = 0.0f;
+    float speedKmh = 0.0f;
+    for (size_t i = 0; i < channelCount; i++) {
+        rpm += channels[i].currentRpm;
+        speedKmh += channels[i].currentSpeedKmh;
+    }
+    for (Target& target : targets) {
+        target.scheduler.observe(currentMillis, rpm, speedKmh);
+    }
+    if (!wifiManager.isConnected())
+        return false;
+
+    // --- 1. 送信時期が来た送信先のキューに積む (シリアライズは形式ごとに1回だけ) ---
+    std::shared_ptr<const String> encoded[PAYLOAD_FORMAT_COUNT];
+    uint64_t timestampMs = 0;
+    bool enqueued[MAX_ENDPOINTS] = {};
+    for (size_t i = 0; i < targets.size(); i++) {
+        Target& target = targets[i];
+        // 送れない送信先には作らない (送信時期の判定もしない。キューにも積まないので、古い送り残しを押し出さない)
+        // force (停止イベント) だけは積んでおき、送れるようになったら送る
+        unsigned long retryMs;
+        if (!force && isBlocked(target, currentMillis, retryMs))
+            continue;
+        if (!force && !target.scheduler.shouldPublish(currentMillis))
+            continue;
+
+        size_t formatIndex = (size_t)target.config.format;
+        if (!encoded[formatIndex]) {
+            if (timestampMs == 0)
+                timestampMs = getCurrentTimestampMs();
+            std::shared_ptr<String> payload = newPayload();
+            PayloadEncoder::encodeBatch(target.config.format, channels, channelCount, timestampMs, deviceId, *payload);
+            encoded[formatIndex] = payload;
         }
+        if (target.udp) {
+            // UDPはデータグラムに詰めるだけ (満杯か一定時間で送信)。RTTは無いので0
+            target.udp->add(*encoded[formatIndex], currentMillis);
+            target.scheduler.onPublished(currentMillis, encoded[formatIndex]->length(), 0);
+            continue;
+        }
+        enqueue(target, encoded[formatIndex]);
+        enqueued[i] = true;
+    }
+
+    // UDP送信先: 溜まったサンプルを送る (停止イベントなど force の場合は即送信)
+    for (Target& target : targets) {
+        if (!target.udp)
+            continue;
+        if (force)
+            target.udp->flush();
+        else
+            target.udp->flushIfDue(currentMillis);
+    }
 
-        String rootCAData;
-        rootCAData.reserve(fileSize);
-        rootCAData = rootCAFile.readString();
-        rootCAFile.close();
+    // --- 2. 送信先ごとに最大1件送る ---
+    return deliverQueued(currentMillis, enqueued);
+}
 
-        if (rootCAData.length() > 0) {
-             clientSecure.setCACert(rootCAData.c_str());
-             Serial.println("Root CA certificate pointer set. Validation occurs during connection.");
-        } else {
-             Serial.println("Error: Failed to read Root CA file content!");
-             return false;
+// 終わったセッションの要約を送る
+bool DataPublisher::publishSessionSummary(const SessionSummary& summary) {
+    if (targets.empty() || !wifiManager.isConnected())
+        return false;
+    uint64_t currentMillis = clock.nowMs();
+
+    std::shared_ptr<const String> encoded[PAYLOAD_FORMAT_COUNT];
+    bool enqueued[MAX_ENDPOINTS] = {};
+    for (size_t i = 0; i < targets.size(); i++) {
+        Target& target = targets[i];
+        size_t formatIndex = (size_t)target.config.format;
+        if (!encoded[formatIndex]) {
+            std::shared_ptr<String> payload = newPayload();
+            PayloadEncoder::encodeSession(target.config.format, summary, deviceId, *payload);
+            encoded[formatIndex] = payload;
         }
-        clientPtr = &clientSecure;
-    } else {
-        clientPtr = &clientHttp;
+        if (encoded[formatIndex]->length() == 0)
+            continue; // この形式では送らない (StatsD)
+        if (target.udp) {
+            target.udp->add(*encoded[formatIndex], currentMillis);
+            target.udp->flush(); // 1セッションに1回だけなので、溜めずに送る
+            continue;
+        }
+        enqueueSession(target, encoded[formatIndex]);
+        enqueued[i] = true;
+    }
+    return deliverQueued(currentMillis, enqueued);
+}
+
+std::shared_ptr<String> DataPublisher::newPayload() {
+    std::shared_ptr<String> payload = std::allocate_shared<String>(PoolAllocator<String, PayloadPool>(payloadPool));
+    payload->reserve(PUBLISH_PAYLOAD_RESERVE_BYTES); // エンコード中に少しずつ伸ばさない (毎回同じ大きさなので、空いた穴にそのまま収まる)
+    return payload;
+}
+
+// 送信待ちキューに積む (一杯なら古いものから捨てる)
+void DataPublisher::enqueue(Target& target, const std::shared_ptr<const String>& payload) {
+    if (target.queue.size() >= PUBLISH_QUEUE_DEPTH) {
+        target.queue.pop_front();
+        target.droppedPayloads++;
+    }
+    target.queue.push_back(payload);
+}
+
+// セッション要約のキューに積む (サンプルのキューとは別なので、送信が止まっている間のサンプルには押し出されない)
+// 一杯になるのは要約がここまで溜まるほど長く送れないときだけ。そのときは古い要約から捨てる (SDには残っている)
+void DataPublisher::enqueueSession(Target& target, const std::shared_ptr<const String>& payload) {
+    if (target.sessionQueue.size() >= PUBLISH_SESSION_QUEUE_DEPTH) {
+        target.sessionQueue.pop_front();
+        target.droppedSessions++;
+        LOG_W("Session summary queue full for %s. Oldest summary dropped (kept on SD).", target.config.url.c_str());
     }
+    target.sessionQueue.push_back(payload);
+}
+
+std::deque<std::shared_ptr<const String>>* DataPublisher::nextQueue(Target& target) {
+    if (!target.sessionQueue.empty())
+        return &target.sessionQueue;
+    if (!target.queue.empty())
+        return &target.queue;
+    return nullptr;
+}
+
+// 送信先ごとに最大1件送る (開始位置を毎回ずらし、遅い送信先が常に先頭に来ないようにする)
+// enqueued[i] は今回 i 番目の送信先に積んだか (送信時期が来たか)
+bool DataPublisher::deliverQueued(uint64_t currentMillis, const bool* enqueued) {
+    bool delivered = false;
+    for (size_t n = 0; n < targets.size(); n++) {
+        size_t i = (nextTargetIndex + n) % targets.size();
+        Target& target = targets[i];
+        std::deque<std::shared_ptr<const String>>* queue = nextQueue(target);
+        if (queue == nullptr)
+            continue;
+
+        // アドレスが一度も解決できていなければ送らない (DNSの失敗は送信先の障害として数えない)
+        uint64_t dnsStartUs = clock.nowUs();
+        PROFILE_BEGIN(dnsStart);
+        IPAddress address;
+        if (!target.resolver->getAddress(address))
+            continue;
+        PROFILE_END(ProfileStage::PUBLISH_DNS, dnsStart);
+        uint32_t dnsUs = (uint32_t)(clock.nowUs() - dnsStartUs);
+
+        // 遮断中なら接続すら試みない (force でも同じ)。結果の扱い (4xx は生きている扱いで捨てる等) も sendThroughBreaker で決める
+        EndpointHealth::State before = EndpointHealth::State::CLOSED; // 送る直前の状態 (試験送信なら HALF_OPEN)
+        SendOutcome outcome = sendThroughBreaker(target.health, *queue, currentMillis, enqueued[i] || target.draining,
+            [&](const std::shared_ptr<const String>& queued, uint64_t& doneMillis) {
+                before = target.health.getState();
+                target.lastTiming = PublishTiming();
+                target.lastTiming.dnsUs = dnsUs;
+                TRACE_INSTANT(TraceEvent::PUBLISH_DNS, dnsUs); // 解決済みのアドレスを読むだけなので区間にはしない (arg = µs)
+                const String& payload = *queued;
+                unsigned long elapsedMs = 0;
+                TRACE_BEGIN(TraceEvent::PUBLISH, i);
+                uint64_t publishStartUs = clock.nowUs();
+                int httpCode = postPayload(target, address, payload, elapsedMs);
+                publishDuration.observeUs((uint32_t)(clock.nowUs() - publishStartUs));
+                TRACE_END(TraceEvent::PUBLISH, httpCode);
+                doneMillis = clock.nowMs();
+                // 失敗時もRTTと使用帯域は記録する (リンクが詰まっているなら間隔が広がる)
+                target.scheduler.onPublished(doneMillis, payload.length(), elapsedMs);
+                return httpCode;
+            });
+        if (!outcome.attempted)
+            continue;
+        logHealthChange(target, before, clock.nowMs());
 
+        (outcome.delivered ? publishSucceeded : publishFailed).increment();
+        target.draining = outcome.delivered && hasQueued(target);
+        delivered |= outcome.delivered;
+    }
+    nextTargetIndex = (nextTargetIndex + 1) % targets.size();
+
+    return delivered;
+}
+
+// 1件のペイロードを解決済みアドレスへPOSTし、HTTPステータス (失敗時は負のエラーコード) を返す
+int DataPublisher::postPayload(Target& target, const IPAddress& address, const String& payload, unsigned long& elapsedMs) {
+    uint64_t startMillis = clock.nowMs();
+    bool useHttps = target.useHttps;
+    PublishTiming& timing = target.lastTiming;
+    LOG_D("[%llu] Attempting to publish data via HTTP%s to %s...", (unsigned long long)startMillis, useHttps ? "S" : "",
+          target.config.url.c_str());
+
+    WiFiClient client;
+    WiFiClientSecure clientSecure;
     HTTPClient http;
-    String serverUrl = endpointUrl;
-    bool connectionOpened = false;
+    http.setConnectTimeout(PUBLISH_CONNECT_TIMEOUT_MS);
+    http.setTimeout(PUBLISH_RESPONSE_TIMEOUT_MS);
 
+    // 接続は解決済みのIPアドレスに対して自前で行う (HTTPClientに任せると毎回名前解決が走る)
+    uint64_t phaseStartUs = clock.nowUs();
+    PROFILE_BEGIN(connectStart);
+    TRACE_BEGIN(useHttps ? TraceEvent::PUBLISH_TLS : TraceEvent::PUBLISH_CONNECT, 0);
+    bool connected = false;
     if (useHttps) {
-        connectionOpened = http.begin(*clientPtr, serverUrl);
+        if (rootCA.length() == 0) {
+            // 証明書が無ければ送れないので、障害と同様にバックオフさせる
+            LOG_E("Error: Root CA is not loaded. Cannot publish via HTTPS.");
+            TRACE_END(TraceEvent::PUBLISH_TLS, 0);
+            elapsedMs = (unsigned long)(clock.nowMs() - startMillis);
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        clientSecure.setHandshakeTimeout((PUBLISH_CONNECT_TIMEOUT_MS + 999) / 1000);
+        // SNIと証明書検証のためホスト名も渡す
+        connected = clientSecure.connect(address, target.url.port, target.url.host.c_str(), rootCA.c_str(), NULL, NULL) == 1;
+        timing.tlsUs = (uint32_t)(clock.nowUs() - phaseStartUs);
+        PROFILE_END(ProfileStage::PUBLISH_TLS, connectStart);
+        TRACE_END(TraceEvent::PUBLISH_TLS, connected);
     } else {
-        connectionOpened = http.begin(serverUrl);
-    }
-
-    if (connectionOpened) {
-        http.addHeader("Content-Type", "application/json");
-
-        StaticJsonDocument<1024> doc;
-        doc["timestamp_ms"] = getCurrentTimestampMs();
-        doc["session_time_s"] = data.sessionElapsedTimeMs / 1000.0;
-        doc["session_dist_km"] = data.sessionDistanceKm;
-        doc["session_cal_kcal"] = data.sessionCaloriesKcal;
-        doc["rpm"] = data.currentRpm;
-        doc["speed_kmh"] = data.currentSpeedKmh;
-        doc["mets"] = data.currentMets;
-        doc["total_time_s"] = (double)data.cumulativeTimeMs / 1000.0;
-        doc["total_dist_km"] = data.cumulativeDistanceKm;
-        doc["total_cal_kcal"] = data.cumulativeCaloriesKcal;
-        uint64_t chipid = ESP.getEfuseMac();
-        char chipid_str[18];
-        snprintf(chipid_str, sizeof(chipid_str), "%04X%08X", (uint16_t)(chipid>>32), (uint32_t)chipid);
-        doc["device_id"] = chipid_str;
-
-        String jsonBuffer;
-        serializeJson(doc, jsonBuffer);
-
-        Serial.println("JSON Payload:");
-        Serial.println(jsonBuffer);
-
-        int httpCode = http.POST(jsonBuffer);
-
-        if (httpCode > 0) {
-            Serial.printf("[HTTP%s] POST... code: %d\n", useHttps ? "S" : "", httpCode);
-            if (httpCode >= 200 && httpCode < 300) {
-                String payload = http.getString();
-                Serial.println("[HTTP] Response:");
-                Serial.println(payload);
-                lastPublishTimeMs = currentMillis;
-                http.end();
-                return true;
-            } else {
-                 String payload = http.getString();
-                 Serial.printf("[HTTP%s] POST failed with code %d, Response: %s\n", useHttps ? "S" : "", httpCode, payload.c_str());
-            }
+        connected = client.connect(address, target.url.port, PUBLISH_CONNECT_TIMEOUT_MS) == 1;
+        timing.connectUs = (uint32_t)(clock.nowUs() - phaseStartUs);
+        PROFILE_END(ProfileStage::PUBLISH_CONNECT, connectStart);
+        TRACE_END(TraceEvent::PUBLISH_CONNECT, connected);
+    }
+    if (!connected) {
+        LOG_W("[HTTP%s] Unable to connect to %s (%s)", useHttps ? "S" : "", target.url.host.c_str(), address.toString().c_str());
+        target.resolver->invalidate(); // アドレスが変わった可能性があるので再解決させる
+        elapsedMs = (unsigned long)(clock.nowMs() - startMillis);
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    // 接続済みのクライアントを渡すと、HTTPClient はそのまま使い回す
+    WiFiClient& transport = useHttps ? (WiFiClient&)clientSecure : client;
+    if (!http.begin(transport, target.url.host, target.url.port, target.url.path, useHttps)) {
+        LOG_W("[HTTP%s] Unable to begin connection to %s", useHttps ? "S" : "", target.config.url.c_str());
+        transport.stop();
+        elapsedMs = (unsigned long)(clock.nowMs() - startMillis);
+        return HTTPC_ERROR_CONNECTION_REFUSED;
+    }
+
+    http.addHeader("Content-Type", PayloadEncoder::contentType(target.config.format));
+    if (target.config.authHeader.length() > 0) {
+        http.addHeader("Authorization", target.config.authHeader);
+    }
+
+    // 長いペイロードはログのリングに入るところまで
+    LOG_D("Payload: %s", payload.c_str());
+
+    phaseStartUs = clock.nowUs();
+    PROFILE_BEGIN(sendStart);
+    TRACE_BEGIN(TraceEvent::PUBLISH_SEND, payload.length());
+    int httpCode = http.POST(payload);
+    timing.sendUs = (uint32_t)(clock.nowUs() - phaseStartUs);
+    PROFILE_END(ProfileStage::PUBLISH_SEND, sendStart);
+    TRACE_END(TraceEvent::PUBLISH_SEND, httpCode);
+
+    if (httpCode > 0) {
+        LOG_I("[HTTP%s] POST... code: %d", useHttps ? "S" : "", httpCode);
+        phaseStartUs = clock.nowUs();
+        PROFILE_BEGIN(responseStart);
+        TRACE_BEGIN(TraceEvent::PUBLISH_RESPONSE, 0);
+        String response = http.getString();
+        timing.responseUs = (uint32_t)(clock.nowUs() - phaseStartUs);
+        PROFILE_END(ProfileStage::PUBLISH_RESPONSE, responseStart);
+        TRACE_END(TraceEvent::PUBLISH_RESPONSE, response.length());
+        if (httpCode >= 200 && httpCode < 300) {
+            LOG_D("[HTTP] Response: %s", response.c_str());
         } else {
-            Serial.printf("[HTTP%s] POST... failed, error: %s\n", useHttps ? "S" : "", http.errorToString(httpCode).c_str());
+            LOG_W("[HTTP%s] POST failed with code %d, Response: %s", useHttps ? "S" : "", httpCode, response.c_str());
         }
-        http.end();
-
     } else {
-        Serial.printf("[HTTP%s] Unable to begin connection to %s\n", useHttps ? "S" : "", serverUrl.c_str());
+        LOG_W("[HTTP%s] POST... failed, error: %s", useHttps ? "S" : "", http.errorToString(httpCode).c_str());
     }
+    http.end();
+    elapsedMs = (unsigned long)(clock.nowMs() - startMillis);
+    LOG_D("[HTTP%s] Timing (us): dns=%u connect=%u tls=%u send=%u response=%u", useHttps ? "S" : "",
+          timing.dnsUs, timing.connectUs, timing.tlsUs, timing.sendUs, timing.responseUs);
+    return httpCode;
+}
 
-    return false;
-}
\ No newline at end of file
+size_t DataPublisher::getTargetCount() const {
+    return targets.size();
+}
+
+// スケジューラの状態を取得 (デバッグ表示用)
+const PublishScheduler& DataPublisher::getScheduler(size_t index) const {
+    return targets[index].scheduler;
+}
+
+// 送信先の死活状態を取得 (デバッグ表示用)
+const EndpointHealth& DataPublisher::getHealth(size_t index) const {
+    return targets[index].health;
+}
+
+// 直近の送信の所要時間内訳を取得 (デバッグ表示用)
+const PublishTiming& DataPublisher::getLastTiming(size_t index) const {
+    return targets[index].lastTiming;
+}
+
+// 送信結果でサーキットブレーカーの状態が変わったときだけログを出す (記録は sendThroughBreaker で済んでいる)
+void DataPublisher::logHealthChange(const Target& target, EndpointHealth::State before, uint64_t nowMs) {
+    EndpointHealth::State after = target.health.getState();
+    if (after == EndpointHealth::State::OPEN) {
+        LOG_W("[Publisher] Endpoint %s %s (failures: %u, retry in %lu ms)",
+              target.config.url.c_str(),
+              before == EndpointHealth::State::HALF_OPEN ? "still down" : "marked down",
+              target.health.getConsecutiveFailures(), target.health.getRetryInMs(nowMs));
+    } else if (before != EndpointHealth::State::CLOSED && after == EndpointHealth::State::CLOSED) {
+        LOG_I("[Publisher] Endpoint %s recovered.", target.config.url.c_str());
+    }
+}
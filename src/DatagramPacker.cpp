@@ -0,0 +1,54 @@
+#include "DatagramPacker.hpp"
+#include <string.h>
+
+DatagramPacker::DatagramPacker() :
+    maxSize(MAX_DATAGRAM_SIZE),
+    length(0),
+    sampleCount(0)
+{}
+
+void DatagramPacker::begin(size_t size) {
+    maxSize = (size > 0 && size <= MAX_DATAGRAM_SIZE) ? size : MAX_DATAGRAM_SIZE;
+    clear();
+}
+
+bool DatagramPacker::fits(size_t len) const {
+    // 2件目以降は区切りの改行が1文字増える
+    size_t needed = len + (length > 0 ? 1 : 0);
+    return len > 0 && length + needed <= maxSize;
+}
+
+bool DatagramPacker::append(const char* text, size_t len) {
+    // 末尾の改行は区切りとしてこちらで付けるので落とす
+    while (len > 0 && text[len - 1] == '\n')
+        len--;
+    if (!fits(len))
+        return false;
+    if (length > 0)
+        buffer[length++] = '\n';
+    memcpy(buffer + length, text, len);
+    length += len;
+    sampleCount++;
+    return true;
+}
+
+void DatagramPacker::clear() {
+    length = 0;
+    sampleCount = 0;
+}
+
+const char* DatagramPacker::data() const {
+    return buffer;
+}
+
+size_t DatagramPacker::size() const {
+    return length;
+}
+
+size_t DatagramPacker::getSampleCount() const {
+    return sampleCount;
+}
+
+bool DatagramPacker::empty() const {
+    return length == 0;
+}
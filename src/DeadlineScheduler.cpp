@@ -0,0 +1,81 @@
+#include "DeadlineScheduler.hpp"
+
+DeadlineScheduler::DeadlineScheduler() :
+    plannedWakeMs(0),
+    hasPlannedWake(false),
+    wakeups(0),
+    eventWakeups(0),
+    maxLatenessMs(0)
+{
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        due[i] = 0;
+        armed[i] = false;
+    }
+}
+
+void DeadlineScheduler::set(size_t id, uint64_t dueMs) {
+    if (id >= MAX_TIMERS)
+        return;
+    due[id] = dueMs;
+    armed[id] = true;
+}
+
+void DeadlineScheduler::setAfter(size_t id, uint64_t nowMs, unsigned long delayMs) {
+    set(id, nowMs + delayMs);
+}
+
+void DeadlineScheduler::clear(size_t id) {
+    if (id < MAX_TIMERS)
+        armed[id] = false;
+}
+
+bool DeadlineScheduler::isArmed(size_t id) const {
+    return id < MAX_TIMERS && armed[id];
+}
+
+bool DeadlineScheduler::isDue(size_t id, uint64_t nowMs) const {
+    return isArmed(id) && nowMs >= due[id];
+}
+
+unsigned long DeadlineScheduler::msUntilNext(uint64_t nowMs) const {
+    uint64_t remaining = NO_DEADLINE;
+    for (size_t i = 0; i < MAX_TIMERS; i++) {
+        if (!armed[i])
+            continue;
+        uint64_t ms = due[i] > nowMs ? due[i] - nowMs : 0;
+        if (ms < remaining)
+            remaining = ms;
+    }
+    return (unsigned long)remaining;
+}
+
+unsigned long DeadlineScheduler::prepareSleep(uint64_t nowMs) {
+    unsigned long remaining = msUntilNext(nowMs);
+    hasPlannedWake = remaining != NO_DEADLINE;
+    plannedWakeMs = nowMs + remaining;
+    return remaining;
+}
+
+void DeadlineScheduler::onWake(uint64_t nowMs, bool byEvent) {
+    wakeups++;
+    if (byEvent) {
+        eventWakeups++;
+    } else if (hasPlannedWake && nowMs > plannedWakeMs) {
+        unsigned long lateness = (unsigned long)(nowMs - plannedWakeMs);
+        if (lateness > maxLatenessMs)
+            maxLatenessMs = lateness;
+    }
+    hasPlannedWake = false;
+}
+
+uint32_t DeadlineScheduler::getWakeups() const {
+    return wakeups;
+}
+
+uint32_t DeadlineScheduler::getEventWakeups() const {
+    return eventWakeups;
+}
+
+unsigned long DeadlineScheduler::getMaxLatenessMs() const {
+    return maxLatenessMs;
+}
@@ -0,0 +1,78 @@
+#include "DiagnosticsServer.hpp"
+#include "MetricRegistry.hpp"
+#include "Profiler.hpp"
+#include "Log.hpp"
+#include <memory>
+#include <stdlib.h>
+
+DiagnosticsServer::DiagnosticsServer() :
+    server(DIAGNOSTICS_HTTP_PORT),
+    started(false),
+    historyQuery(nullptr),
+    wallClock(nullptr)
+{}
+
+void DiagnosticsServer::begin(SeriesCsvWriter::Query query, WallClockCheck wallClockCheck) {
+    if (started)
+        return;
+    historyQuery = query;
+    wallClock = wallClockCheck;
+    server.on("/metrics", HTTP_GET, std::bind(&DiagnosticsServer::handleMetrics, this, std::placeholders::_1));
+    server.on("/history", HTTP_GET, std::bind(&DiagnosticsServer::handleHistory, this, std::placeholders::_1));
+#if FIT2GO_PROFILING
+    server.on("/profile", HTTP_GET, std::bind(&DiagnosticsServer::handleProfile, this, std::placeholders::_1));
+#endif
+    server.onNotFound([](AsyncWebServerRequest* request) {
+        request->send(404, "text/plain", "Not found");
+    });
+    server.begin();
+    started = true;
+    LOG_I("[Diagnostics] HTTP server started on port %u", DIAGNOSTICS_HTTP_PORT);
+}
+
+// チャンク転送で、送信バッファが空くたびに続きの行を書く (全体を String に組み立てない)
+void DiagnosticsServer::handleMetrics(AsyncWebServerRequest* request) {
+    std::shared_ptr<MetricWriter> writer(new MetricWriter());
+    AsyncWebServerResponse* response = request->beginChunkedResponse("text/plain; version=0.0.4",
+        [writer](uint8_t* buffer, size_t maxLength, size_t /*index*/) -> size_t {
+            return writer->read(buffer, maxLength);
+        });
+    request->send(response);
+}
+
+// /metrics と同じくチャンク転送。問い合わせは送信バッファが空くたびに数件ずつ行う
+void DiagnosticsServer::handleHistory(AsyncWebServerRequest* request) {
+    SeriesTier tier = SeriesTier::MINUTES;
+    if (request->hasParam("tier") && !TimeSeriesStore::parseTier(request->getParam("tier")->value().c_str(), tier)) {
+        request->send(400, "text/plain", "tier must be second, minute or hour");
+        return;
+    }
+    uint64_t fromMs = 0;
+    uint64_t toMs = UINT64_MAX;
+    if (request->hasParam("from"))
+        fromMs = strtoull(request->getParam("from")->value().c_str(), nullptr, 10);
+    if (request->hasParam("to"))
+        toMs = strtoull(request->getParam("to")->value().c_str(), nullptr, 10);
+
+    std::shared_ptr<SeriesCsvWriter> writer(new SeriesCsvWriter(historyQuery, tier, fromMs, toMs));
+    AsyncWebServerResponse* response = request->beginChunkedResponse("text/csv",
+        [writer](uint8_t* buffer, size_t maxLength, size_t /*index*/) -> size_t {
+            return writer->read(buffer, maxLength);
+        });
+    response->addHeader("X-Time-Base", wallClock != nullptr && wallClock() ? "unix-ms" : "uptime-ms");
+    request->send(response);
+}
+
+void DiagnosticsServer::handleProfile(AsyncWebServerRequest* request) {
+#if FIT2GO_PROFILING
+    AsyncResponseStream* response = request->beginResponseStream("text/plain");
+    Profiler::report(*response);
+    if (request->hasParam("reset")) {
+        Profiler::reset();
+        response->print("(reset)\n");
+    }
+    request->send(response);
+#else
+    request->send(404, "text/plain", "Profiling is disabled in this build");
+#endif
+}
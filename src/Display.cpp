@@ -28,7 +28,7 @@ void Display::clear() {
 }
 
 // メッセージを画面中央に表示
-void Display::showMessage(const String& msg, int size, bool clearScreen) {
+void Display::showMessage(const char* msg, int size, bool clearScreen) {
     if (clearScreen) sprite.fillSprite(BLACK); // 必要なら画面クリア
     sprite.setTextSize(size);         // 指定された文字サイズ
     sprite.setTextDatum(MC_DATUM);    // 文字基準位置を中央(Middle Center)に
@@ -39,40 +39,40 @@ void Display::showMessage(const String& msg, int size, bool clearScreen) {
 }
 
 // ミリ秒を HH:MM:SS 形式の文字列に変換
-String Display::formatTime(unsigned long ms) {
+FixedString<12> Display::formatTime(unsigned long ms) {
     unsigned long seconds = ms / 1000;
     int h = seconds / 3600;
     int m = (seconds % 3600) / 60;
     int s = seconds % 60;
-    char buf[10];
-    snprintf(buf, sizeof(buf), "%02d:%02d:%02d", h, m, s); // ゼロ埋め2桁
-    return String(buf);
+    FixedString<12> text;
+    text.assignf("%02d:%02d:%02d", h, m, s); // ゼロ埋め2桁
+    return text;
 }
 
 // ミリ秒を累積時間表示 (Xd Yh Zm または Yh Zm) 形式の文字列に変換
-String Display::formatCumulativeTime(uint64_t ms) {
+FixedString<24> Display::formatCumulativeTime(uint64_t ms) {
     unsigned long seconds = ms / 1000;
     int d = seconds / 86400;           // 日数
     int h = (seconds % 86400) / 3600;  // 時間
     int m = (seconds % 3600) / 60;     // 分
-    char buf[20];
+    FixedString<24> text;
     if (d > 0) { // 1日以上の場合
-        snprintf(buf, sizeof(buf), "%dd %dh %dm", d, h, m);
+        text.assignf("%dd %dh %dm", d, h, m);
     } else {     // 1日未満の場合
-        snprintf(buf, sizeof(buf), "%dh %dm", h, m);
+        text.assignf("%dh %dm", h, m);
     }
-    return String(buf);
+    return text;
 }
 
 
 // ★★★ updateメソッドに STOPPING ケースを追加 ★★★
-void Display::update(const TrackerData& data, AppState state, WifiManager& wifiManager, APConfigPortal& apPortal) {
+void Display::update(const TrackerData& data, const CadenceAnalysis& cadence, AppState state, WifiManager& wifiManager, APConfigPortal& apPortal) {
     // if (sprite.width() == 0) return; // beginで確保済み想定
 
     switch(state) {
-        case AppState::TRACKING_DISPLAY: displayTrackingScreen(data, wifiManager); break;
+        case AppState::TRACKING_DISPLAY: displayTrackingScreen(data, cadence, wifiManager); break;
         case AppState::IDLE_DISPLAY:     displayIdleScreen(data, wifiManager); break;
-        case AppState::STOPPING:         displayStoppingScreen(data, wifiManager); break; // ★ STOPPING画面表示呼び出し ★
+        case AppState::STOPPING:         displayStoppingScreen(data, cadence, wifiManager); break; // ★ STOPPING画面表示呼び出し ★
         case AppState::WIFI_CONNECTING:  displayWifiScreen(wifiManager); break;
         case AppState::WIFI_SETUP:       displayWifiScreen(wifiManager); break;
         case AppState::WIFI_SCANNING:    displayScanResultsScreen(wifiManager); break;
@@ -89,7 +89,7 @@ void Display::update(const TrackerData& data, AppState state, WifiManager& wifiM
 }
 
 // トラッキング中の画面描画
-void Display::displayTrackingScreen(const TrackerData& data, WifiManager& wifiManager) {
+void Display::displayTrackingScreen(const TrackerData& data, const CadenceAnalysis& cadence, WifiManager& wifiManager) {
     sprite.fillSprite(BLACK);
     sprite.setTextDatum(TL_DATUM); // 左上基準に戻す
     sprite.setTextSize(1); sprite.setTextColor(TFT_WHITE, TFT_BLACK); sprite.setTextFont(2);
@@ -106,7 +106,7 @@ void Display::displayTrackingScreen(const TrackerData& data, WifiManager& wifiMa
     // --- メトリクス表示 ---
     int row1_y = 30; int row2_y = 80; int row3_y = 130; int col1_x = 10; int col2_x = 170; int label_y_offset = 28;
     // Time
-    sprite.setCursor(col1_x, row1_y); sprite.setTextSize(2); sprite.print(formatTime(data.sessionElapsedTimeMs));
+    sprite.setCursor(col1_x, row1_y); sprite.setTextSize(2); sprite.print(formatTime(data.sessionElapsedTimeMs).c_str());
     sprite.setTextSize(1); sprite.setCursor(col1_x, row1_y + label_y_offset); sprite.print("Time");
     // RPM
     sprite.setCursor(col2_x, row1_y); sprite.setTextSize(2); sprite.printf("%.0f", data.currentRpm);
@@ -120,6 +120,9 @@ void Display::displayTrackingScreen(const TrackerData& data, WifiManager& wifiMa
     // Calories
     sprite.setCursor(col1_x, row3_y); sprite.setTextSize(2); sprite.printf("%.1f", data.sessionCaloriesKcal);
     sprite.setTextSize(1); sprite.setCursor(col1_x, row3_y + label_y_offset); sprite.print("Cal kcal");
+    // ケイデンスのゾーン (Z1〜) と運動区間の数
+    sprite.setCursor(col2_x, row3_y); sprite.setTextSize(2); sprite.printf("Z%u #%u", cadence.currentZone + 1, cadence.workIntervals);
+    sprite.setTextSize(1); sprite.setCursor(col2_x, row3_y + label_y_offset); sprite.print("Zone / Sets");
     // METs (Optional)
     // sprite.setCursor(col2_x, row3_y); sprite.setTextSize(2); sprite.printf("%.1f", data.currentMets);
     // sprite.setTextSize(1); sprite.setCursor(col2_x, row3_y + label_y_offset); sprite.print("METs");
@@ -154,7 +157,7 @@ void Display::displayIdleScreen(const TrackerData& data, WifiManager& wifiManage
 
     // --- 累積データ表示 ---
     sprite.setCursor(10, 60); sprite.println("Cumulative Stats:");
-    sprite.setCursor(10, 90); sprite.print("Total Time: " + formatCumulativeTime(data.cumulativeTimeMs));
+    sprite.setCursor(10, 90); sprite.printf("Total Time: %s", formatCumulativeTime(data.cumulativeTimeMs).c_str());
     sprite.setCursor(10, 120); sprite.printf("Total Dist: %.1f Km", data.cumulativeDistanceKm);
     sprite.setCursor(10, 150); sprite.printf("Total Cal: %.0f Kcal", data.cumulativeCaloriesKcal);
 
@@ -167,7 +170,7 @@ void Display::displayIdleScreen(const TrackerData& data, WifiManager& wifiManage
 }
 
 // ★★★ STOPPING 状態の画面表示関数 ★★★
-void Display::displayStoppingScreen(const TrackerData& data, WifiManager& wifiManager) {
+void Display::displayStoppingScreen(const TrackerData& data, const CadenceAnalysis& cadence, WifiManager& wifiManager) {
     sprite.fillSprite(TFT_DARKGREY); // 背景色を少し変える (例: ダークグレー)
     sprite.setTextDatum(TL_DATUM); // 左上基準に戻す
     sprite.setTextSize(1); sprite.setTextColor(TFT_YELLOW, TFT_DARKGREY); sprite.setTextFont(2);
@@ -185,9 +188,10 @@ void Display::displayStoppingScreen(const TrackerData& data, WifiManager& wifiMa
     int y_start = 40;
     int line_h = 30;
     sprite.setCursor(10, y_start); sprite.print("Session Summary:");
-    sprite.setCursor(10, y_start + line_h * 1); sprite.print(" Time: " + formatTime(data.sessionElapsedTimeMs)); // 停止した時間
+    sprite.setCursor(10, y_start + line_h * 1); sprite.printf(" Time: %s", formatTime(data.sessionElapsedTimeMs).c_str()); // 停止した時間
     sprite.setCursor(10, y_start + line_h * 2); sprite.printf(" Dist: %.2f Km", data.sessionDistanceKm);
     sprite.setCursor(10, y_start + line_h * 3); sprite.printf(" Cal : %.1f Kcal", data.sessionCaloriesKcal);
+    sprite.setCursor(10, y_start + line_h * 4); sprite.printf(" Sets: %u", cadence.workIntervals);
 
     // --- フッター ---
     sprite.setTextDatum(MC_DATUM); // 中央揃え
@@ -237,24 +241,26 @@ void Display::displayScanResultsScreen(WifiManager& wifiManager) {
         int maxLines = (sprite.height() - yPos - 30) / lineHeight; // 表示可能な最大行数 (フッター考慮)
 
         for (int i = 0; i < networkCount && i < maxLines; ++i) {
-            WiFiScanInfo info = wifiManager.getScanResult(i);
+            const WiFiScanInfo& info = wifiManager.getScanResult(i);
             sprite.setCursor(5, yPos + i * lineHeight);
             // 暗号化タイプ表示 (* または スペース)
             sprite.print((info.encryptionType == WIFI_AUTH_OPEN) ? "  " : "* ");
             // SSID表示 (長すぎる場合は省略)
-            String ssid = info.ssid;
+            FixedString<36> ssid(info.ssid.c_str());
             int maxSsidPixelWidth = sprite.width() - 5 - sprite.textWidth("* ") - sprite.textWidth("-100dBm") - 10; // SSID表示幅計算
-            while(sprite.textWidth(ssid) > maxSsidPixelWidth && ssid.length() > 2) {
-                 ssid = ssid.substring(0, ssid.length() - 1);
+            while(sprite.textWidth(ssid.c_str()) > maxSsidPixelWidth && ssid.length() > 2) {
+                 ssid.truncate(ssid.length() - 1);
             }
-            if (sprite.textWidth(ssid) > maxSsidPixelWidth && ssid.length() > 2) { // さらに短縮が必要なら ".." 付与
-                 ssid = ssid.substring(0, ssid.length() - 2) + "..";
+            if (sprite.textWidth(ssid.c_str()) > maxSsidPixelWidth && ssid.length() > 2) { // さらに短縮が必要なら ".." 付与
+                 ssid.truncate(ssid.length() - 2);
+                 ssid.append("..");
             }
-            sprite.print(ssid);
+            sprite.print(ssid.c_str());
             // RSSI表示 (右寄せ)
-            String rssiStr = String(info.rssi) + "dBm";
+            FixedString<12> rssiStr;
+            rssiStr.assignf("%ddBm", (int)info.rssi);
             sprite.setTextDatum(TR_DATUM); // 右上基準 (座標は右上を指定)
-            sprite.drawString(rssiStr, sprite.width() - 5, yPos + i * lineHeight);
+            sprite.drawString(rssiStr.c_str(), sprite.width() - 5, yPos + i * lineHeight);
             sprite.setTextDatum(TL_DATUM); // 左上基準に戻す
         }
         // 全件表示しきれない場合
@@ -0,0 +1,123 @@
+#include "EndpointHealth.hpp"
+
+EndpointHealth::EndpointHealth() :
+    failureThreshold(1),
+    baseBackoffMs(1000),
+    maxBackoffMs(1000),
+    state(State::CLOSED),
+    consecutiveFailures(0),
+    backoffExponent(0),
+    totalFailures(0),
+    totalSuccesses(0),
+    openCount(0),
+    retryAtMs(0),
+    rngState(1)
+{}
+
+void EndpointHealth::begin(uint16_t threshold, unsigned long baseBackoff, unsigned long maxBackoff, uint32_t seed) {
+    failureThreshold = threshold > 0 ? threshold : 1;
+    baseBackoffMs = baseBackoff;
+    maxBackoffMs = maxBackoff > baseBackoff ? maxBackoff : baseBackoff;
+    rngState = seed != 0 ? seed : 1; // xorshiftは0を種にできない
+    state = State::CLOSED;
+    consecutiveFailures = 0;
+    backoffExponent = 0;
+}
+
+bool EndpointHealth::allowRequest(uint64_t nowMs) {
+    switch (state) {
+        case State::CLOSED:
+            return true;
+        case State::OPEN:
+            if (nowMs >= retryAtMs) {
+                state = State::HALF_OPEN; // 試験送信を1回だけ許可
+                return true;
+            }
+            return false;
+        case State::HALF_OPEN:
+        default:
+            return false; // 試験送信の結果待ち
+    }
+}
+
+void EndpointHealth::recordSuccess(uint64_t nowMs) {
+    (void)nowMs;
+    totalSuccesses++;
+    consecutiveFailures = 0;
+    backoffExponent = 0;
+    state = State::CLOSED;
+}
+
+void EndpointHealth::recordFailure(uint64_t nowMs) {
+    totalFailures++;
+    if (consecutiveFailures < UINT16_MAX)
+        consecutiveFailures++;
+    // 試験送信の失敗、または連続失敗がしきい値に達したら遮断
+    if (state == State::HALF_OPEN || consecutiveFailures >= failureThreshold) {
+        open(nowMs);
+    }
+}
+
+void EndpointHealth::open(uint64_t nowMs) {
+    // バックオフ = base * 2^n (上限あり)
+    unsigned long backoff = baseBackoffMs;
+    for (uint16_t i = 0; i < backoffExponent && backoff < maxBackoffMs; i++) {
+        backoff *= 2;
+    }
+    if (backoff > maxBackoffMs)
+        backoff = maxBackoffMs;
+    if (backoffExponent < 16)
+        backoffExponent++;
+
+    // ジッタ: [backoff/2, backoff] の範囲でばらつかせ、複数台の再接続が揃わないようにする
+    unsigned long half = backoff / 2;
+    unsigned long delayMs = half + (half > 0 ? nextRandom() % (half + 1) : 0);
+
+    retryAtMs = nowMs + delayMs;
+    state = State::OPEN;
+    openCount++;
+}
+
+uint32_t EndpointHealth::nextRandom() {
+    uint32_t x = rngState;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    rngState = x;
+    return x;
+}
+
+EndpointHealth::State EndpointHealth::getState() const {
+    return state;
+}
+
+uint16_t EndpointHealth::getConsecutiveFailures() const {
+    return consecutiveFailures;
+}
+
+uint32_t EndpointHealth::getTotalFailures() const {
+    return totalFailures;
+}
+
+uint32_t EndpointHealth::getTotalSuccesses() const {
+    return totalSuccesses;
+}
+
+uint32_t EndpointHealth::getOpenCount() const {
+    return openCount;
+}
+
+unsigned long EndpointHealth::getRetryInMs(uint64_t nowMs) const {
+    if (state != State::OPEN || nowMs >= retryAtMs)
+        return 0;
+    return (unsigned long)(retryAtMs - nowMs);
+}
+
+const char* EndpointHealth::stateName(State state) {
+    switch (state) {
+        case State::CLOSED:    return "CLOSED";
+        case State::OPEN:      return "OPEN";
+        case State::HALF_OPEN: return "HALF_OPEN";
+        default:               return "?";
+    }
+}
@@ -0,0 +1,89 @@
+#include "HeapStats.hpp"
+#include "TaskStats.hpp"
+#include "MetricRegistry.hpp"
+#include "Log.hpp"
+#include "esp_heap_caps.h"
+
+TaskHandle_t HeapStats::tasks[HEAP_MAX_TASKS] = {};
+TaskStats* HeapStats::taskStats[HEAP_MAX_TASKS] = {};
+std::atomic<size_t> HeapStats::taskCount(0);
+
+// /metrics 用
+static float readFreeHeap() { return (float)heap_caps_get_free_size(MALLOC_CAP_8BIT); }
+static float readMinFreeHeap() { return (float)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT); }
+static float readLargestFreeBlock() { return (float)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT); }
+static MetricGauge heapFree("fit2go_heap_free_bytes", "Free heap.", readFreeHeap);
+static MetricGauge heapMinFree("fit2go_heap_min_free_bytes", "Lowest free heap since boot.", readMinFreeHeap);
+static MetricGauge heapLargestBlock("fit2go_heap_largest_free_block_bytes", "Largest allocatable heap block (fragmentation).", readLargestFreeBlock);
+// 登録外のタスクの分 (静的初期化より前の割り当ては数えない)
+static MetricCounter otherAllocations(HeapStats::ALLOCATIONS_METRIC, HeapStats::ALLOCATIONS_HELP, "task=\"other\"");
+static MetricCounter otherBytes(HeapStats::BYTES_METRIC, HeapStats::BYTES_HELP, "task=\"other\"");
+
+void HeapStats::registerTask(TaskHandle_t handle, TaskStats& stats) {
+    size_t count = taskCount.load(std::memory_order_relaxed);
+    if (handle == nullptr || count >= HEAP_MAX_TASKS)
+        return;
+    tasks[count] = handle;
+    taskStats[count] = &stats;
+    taskCount.store(count + 1, std::memory_order_release); // 書いてから数を増やす (読み手は数までしか見ない)
+}
+
+void HeapStats::countAllocation(size_t size) {
+    TaskHandle_t current = xTaskGetCurrentTaskHandle(); // スケジューラ開始前は NULL ("other" になる)
+    size_t count = taskCount.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; i++) {
+        if (tasks[i] == current) {
+            taskStats[i]->countAllocation(size);
+            return;
+        }
+    }
+    otherAllocations.increment();
+    otherBytes.increment((uint32_t)size);
+}
+
+uint32_t HeapStats::getOtherAllocations() {
+    return otherAllocations.get();
+}
+
+void HeapStats::print() {
+    LOG_I("[Heap] free:%uB largest:%uB minFree:%uB otherAllocs:%u",
+          (unsigned)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+          (unsigned)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT),
+          (unsigned)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+          otherAllocations.get());
+}
+
+
+// --- リンカーの --wrap で差し替える割り当て関数 ---
+// -Wl,--wrap=malloc などを付けると、リンクするすべてのオブジェクト (フレームワークのライブラリを含む) の
+// malloc 呼び出しが __wrap_malloc に、__real_malloc が本来の malloc になる
+// free は数えない (割り当てた数の増え方だけを見る)
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    void* result = __real_malloc(size);
+    if (result != nullptr)
+        HeapStats::countAllocation(size);
+    return result;
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    void* result = __real_calloc(count, size);
+    if (result != nullptr)
+        HeapStats::countAllocation(count * size);
+    return result;
+}
+
+// String の連結で伸ばすたびに呼ばれる。移動しなくても1回と数える (断片化の元になる呼び出しの数を見たいので)
+void* __wrap_realloc(void* pointer, size_t size) {
+    void* result = __real_realloc(pointer, size);
+    if (result != nullptr && size > 0)
+        HeapStats::countAllocation(size);
+    return result;
+}
+
+} // extern "C"
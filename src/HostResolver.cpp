@@ -0,0 +1,116 @@
+#include "HostResolver.hpp"
+#include "Log.hpp"
+
+static const unsigned long DNS_RETRY_INTERVAL_MS = 5000; // 失敗後の再試行間隔
+
+HostResolver::HostResolver() :
+    ttlMs(0),
+    hasAddress(false),
+    expired(true),
+    resolvedAtMs(0),
+    lastAttemptMs(0),
+    lookupCount(0),
+    failureCount(0),
+    lookupInFlight(false),
+    lookupDone(false),
+    lookupResult(0)
+{}
+
+void HostResolver::begin(const String& hostName, unsigned long ttl) {
+    host = hostName;
+    ttlMs = ttl;
+    hasAddress = false;
+    expired = true;
+    // IPアドレス直書きなら解決不要
+    IPAddress literal;
+    if (literal.fromString(host.c_str())) {
+        address = literal;
+        hasAddress = true;
+        expired = false;
+        ttlMs = 0; // 期限なし
+    }
+}
+
+// lwIP(tcpip)タスクから呼ばれる。結果を置くだけで、取り込みは update() で行う
+void HostResolver::onDnsFound(const char* name, const ip_addr_t* ipaddr, void* arg) {
+    HostResolver* self = static_cast<HostResolver*>(arg);
+    self->lookupResult = (ipaddr != nullptr && IP_IS_V4(ipaddr)) ? ip4_addr_get_u32(ip_2_ip4(ipaddr)) : 0;
+    self->lookupDone = true;
+}
+
+void HostResolver::update(uint64_t nowMs) {
+    // 前回の解決結果を取り込む
+    if (lookupDone) {
+        lookupDone = false;
+        lookupInFlight = false;
+        if (lookupResult != 0) {
+            IPAddress resolved(lookupResult);
+            if (!hasAddress || resolved != address) {
+                LOG_I("[DNS] %s -> %s", host.c_str(), resolved.toString().c_str());
+            }
+            address = resolved;
+            hasAddress = true;
+            expired = false;
+            resolvedAtMs = nowMs;
+        } else {
+            failureCount++;
+            LOG_W("[DNS] Failed to resolve %s%s", host.c_str(), hasAddress ? " (keeping last known address)" : "");
+        }
+    }
+
+    if (ttlMs > 0 && hasAddress && !expired && nowMs - resolvedAtMs >= ttlMs) {
+        expired = true;
+    }
+    if (!expired || lookupInFlight || host.length() == 0)
+        return;
+    if (lookupCount > 0 && nowMs - lastAttemptMs < DNS_RETRY_INTERVAL_MS)
+        return;
+
+    // 非同期で解決開始 (lwIPのキャッシュにあれば即時に返る)
+    lastAttemptMs = nowMs;
+    lookupCount++;
+    ip_addr_t cached;
+    lookupInFlight = true;
+    err_t err = dns_gethostbyname(host.c_str(), &cached, &HostResolver::onDnsFound, this);
+    if (err == ERR_OK) {
+        lookupResult = ip4_addr_get_u32(ip_2_ip4(&cached));
+        lookupDone = true;
+    } else if (err != ERR_INPROGRESS) {
+        lookupResult = 0;
+        lookupDone = true;
+    }
+}
+
+void HostResolver::invalidate() {
+    if (ttlMs > 0)
+        expired = true;
+}
+
+bool HostResolver::getAddress(IPAddress& out) const {
+    if (!hasAddress)
+        return false;
+    out = address;
+    return true;
+}
+
+unsigned long HostResolver::getRetryInMs(uint64_t nowMs) const {
+    if (hasAddress)
+        return 0;
+    // 解決中・ホスト名なし・初回の開始前は、再試行間隔を上限として待つ (結果は次の update() で取り込む)
+    if (lookupInFlight || lookupDone || lookupCount == 0)
+        return DNS_RETRY_INTERVAL_MS;
+    uint64_t retryAtMs = lastAttemptMs + DNS_RETRY_INTERVAL_MS;
+    return nowMs < retryAtMs ? (unsigned long)(retryAtMs - nowMs) : DNS_RETRY_INTERVAL_MS;
+}
+
+const String& HostResolver::getHost() const {
+    return host;
+}
+
+uint32_t HostResolver::getLookupCount() const {
+    return lookupCount;
+}
+
+uint32_t HostResolver::getFailureCount() const {
+    return failureCount;
+}
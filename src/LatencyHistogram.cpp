@@ -0,0 +1,54 @@
+#include "LatencyHistogram.hpp"
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+void LatencyHistogram::reset() {
+    for (std::atomic<uint32_t>& bucket : buckets)
+        bucket.store(0, std::memory_order_relaxed);
+    count.store(0, std::memory_order_relaxed);
+    max.store(0, std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::getCount() const {
+    return count.load(std::memory_order_relaxed);
+}
+
+uint32_t LatencyHistogram::getMax() const {
+    return max.load(std::memory_order_relaxed);
+}
+
+// 小さい方から数えて、指定の割合に達したビンを探す
+// 記録中に読むと count とビンの合計がずれることがあるので、count ではなくビンの合計を母数にする
+uint32_t LatencyHistogram::percentile(uint32_t permille) const {
+    uint64_t total = 0;
+    for (const std::atomic<uint32_t>& bucket : buckets)
+        total += bucket.load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+    uint64_t rank = (total * permille + 999) / 1000; // 切り上げ (1件目から数える)
+    if (rank == 0)
+        rank = 1;
+    uint64_t seen = 0;
+    uint32_t maxValue = getMax();
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint32_t upper = bucketUpper(i);
+            return upper < maxValue ? upper : maxValue; // 最大値のビンなら正確な値を返せる
+        }
+    }
+    return maxValue;
+}
+
+uint32_t LatencyHistogram::bucketUpper(size_t index) {
+    if (index < SUB_BUCKETS)
+        return (uint32_t)index;
+    uint32_t msb = (uint32_t)(index / SUB_BUCKETS) + SUB_BUCKET_BITS - 1;
+    uint32_t sub = (uint32_t)(index % SUB_BUCKETS);
+    uint32_t width = 1UL << (msb - SUB_BUCKET_BITS);
+    uint64_t lower = (uint64_t)(SUB_BUCKETS + sub) * width;
+    uint64_t upper = lower + width - 1;
+    return upper > UINT32_MAX ? UINT32_MAX : (uint32_t)upper;
+}
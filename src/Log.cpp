@@ -0,0 +1,47 @@
+#include "Log.hpp"
+
+LogBuffer Log::buffer;
+TaskHandle_t Log::drainTask = NULL;
+std::atomic<bool> Log::drainWaiting(false);
+uint32_t Log::reportedDropped = 0;
+
+static const char LEVEL_LETTERS[] = "?EWID";
+
+size_t Log::drain(Print& out) {
+    static LogRecord record;   // ログタスク専用 (スタックに置くには大きい)
+    static char line[192];
+    size_t count = 0;
+    while (buffer.pop(record)) {
+        char level = record.level < sizeof(LEVEL_LETTERS) - 1 ? LEVEL_LETTERS[record.level] : '?';
+        int prefix = snprintf(line, sizeof(line), "[%lu] %c ", (unsigned long)record.timeMs, level);
+        size_t length = (size_t)prefix + LogBuffer::format(record, line + prefix, sizeof(line) - prefix);
+        if (record.suppressed > 0 && length < sizeof(line))
+            snprintf(line + length, sizeof(line) - length, " (+%u suppressed)", (unsigned)record.suppressed);
+        out.println(line);
+        count++;
+    }
+    uint32_t dropped = buffer.getDropped();
+    if (dropped != reportedDropped) {
+        out.printf("[Log] %lu messages dropped (ring full)\n", (unsigned long)(dropped - reportedDropped));
+        reportedDropped = dropped;
+    }
+    return count;
+}
+
+void Log::waitForMessages() {
+    drainTask = xTaskGetCurrentTaskHandle();
+    drainWaiting.store(true, std::memory_order_release);
+    // 眠ると決めた直後に書かれた分は通知が来ないので、もう一度見てから眠る
+    if (!buffer.isEmpty()) {
+        drainWaiting.store(false, std::memory_order_relaxed);
+        return;
+    }
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
+void Log::flush(uint32_t timeoutMs) {
+    uint32_t startMs = millis();
+    while (!(buffer.isEmpty() && drainWaiting.load(std::memory_order_acquire)) && millis() - startMs < timeoutMs)
+        vTaskDelay(1);
+    Serial.flush();
+}
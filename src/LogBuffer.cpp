@@ -0,0 +1,294 @@
+#include "LogBuffer.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+
+void LogArgWriter::putString(const char* value) {
+    if (full || length + 2 > capacity) {
+        full = true;
+        return;
+    }
+    size_t room = capacity - length - 2;
+    if (room > 255)
+        room = 255;
+    size_t textLength = strlen(value);
+    bool truncated = textLength > room;
+    if (truncated)
+        textLength = room;
+    data[length++] = truncated ? TAG_STRING_TRUNCATED : TAG_STRING;
+    data[length++] = (uint8_t)textLength;
+    memcpy(data + length, value, textLength);
+    length += textLength;
+}
+
+
+bool LogRateLimiter::allow(uint32_t nowMs, uint16_t& suppressedOut) {
+    if (nowMs - windowStartMs >= LOG_RATE_WINDOW_MS) {
+        windowStartMs = nowMs;
+        passed = 0;
+    }
+    if (passed >= LOG_RATE_BURST) {
+        if (suppressed < UINT16_MAX)
+            suppressed++;
+        return false;
+    }
+    passed++;
+    suppressedOut = suppressed;
+    suppressed = 0;
+    return true;
+}
+
+
+LogBuffer::LogBuffer() :
+    enqueuePosition(0),
+    dequeuePosition(0),
+    dropped(0)
+{
+    for (size_t i = 0; i < CAPACITY; i++)
+        slots[i].sequence.store((uint32_t)i, std::memory_order_relaxed);
+}
+
+// 空いている枠を1つ予約する。枠の番号が書き込み位置と同じなら空き、小さければ一杯
+LogBuffer::Slot* LogBuffer::reserve(uint32_t& position) {
+    position = enqueuePosition.load(std::memory_order_relaxed);
+    while (true) {
+        Slot& slot = slots[position & (CAPACITY - 1)];
+        int32_t diff = (int32_t)(slot.sequence.load(std::memory_order_acquire) - position);
+        if (diff == 0) {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                return &slot;
+            // 他の書き手に取られた (position は最新の値になっている)
+        } else if (diff < 0) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        } else {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+bool LogBuffer::pop(LogRecord& out) {
+    uint32_t position = dequeuePosition.load(std::memory_order_relaxed);
+    Slot& slot = slots[position & (CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+        return false; // 空 (または書き手が詰めている途中)
+    out.timeMs = slot.record.timeMs;
+    out.format = slot.record.format;
+    out.level = slot.record.level;
+    out.argBytes = slot.record.argBytes;
+    out.suppressed = slot.record.suppressed;
+    memcpy(out.args, slot.record.args, slot.record.argBytes);
+    // 1周後の書き込み位置を入れて、枠を空きに戻す
+    slot.sequence.store(position + (uint32_t)CAPACITY, std::memory_order_release);
+    dequeuePosition.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+bool LogBuffer::isEmpty() const {
+    // 予約済みで詰めている途中のものも「まだある」に数える
+    return enqueuePosition.load(std::memory_order_acquire) == dequeuePosition.load(std::memory_order_acquire);
+}
+
+uint32_t LogBuffer::getDropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+
+// --- 書式化 ---
+
+namespace {
+
+// 詰めた引数を先頭から1つずつ読む
+class LogArgReader {
+public:
+    LogArgReader(const uint8_t* data, size_t length) : data(data), length(length), position(0) {}
+
+    bool next(uint8_t& tag, int64_t& integer, double& real, const char*& text, size_t& textLength) {
+        if (position >= length)
+            return false;
+        tag = data[position++];
+        switch (tag) {
+            case LogArgWriter::TAG_INT32:  { int32_t v;  if (!take(v)) return false; integer = v; return true; }
+            case LogArgWriter::TAG_UINT32: { uint32_t v; if (!take(v)) return false; integer = v; return true; }
+            case LogArgWriter::TAG_INT64:  { int64_t v;  if (!take(v)) return false; integer = v; return true; }
+            case LogArgWriter::TAG_UINT64: { uint64_t v; if (!take(v)) return false; integer = (int64_t)v; return true; }
+            case LogArgWriter::TAG_DOUBLE: return take(real);
+            case LogArgWriter::TAG_STRING:
+            case LogArgWriter::TAG_STRING_TRUNCATED:
+                if (position >= length)
+                    return false;
+                textLength = data[position++];
+                if (position + textLength > length)
+                    return false;
+                text = (const char*)data + position;
+                position += textLength;
+                return true;
+            default:
+                position = length;
+                return false;
+        }
+    }
+
+private:
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+
+    template <typename T>
+    bool take(T& value) {
+        if (position + sizeof(T) > length) {
+            position = length;
+            return false;
+        }
+        memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return true;
+    }
+};
+
+// out に追記する (入りきらなければ切る)
+class LineWriter {
+public:
+    LineWriter(char* out, size_t size) : out(out), size(size), length(0) {
+        if (size > 0)
+            out[0] = '\0';
+    }
+    void append(const char* text, size_t textLength) {
+        if (length + 1 >= size)
+            return;
+        size_t room = size - 1 - length;
+        if (textLength > room)
+            textLength = room;
+        memcpy(out + length, text, textLength);
+        length += textLength;
+        out[length] = '\0';
+    }
+    template <typename... T>
+    void appendFormatted(const char* spec, T... values) {
+        if (length + 1 >= size)
+            return;
+        int written = snprintf(out + length, size - length, spec, values...);
+        if (written > 0)
+            length += (size_t)written < size - length ? (size_t)written : size - length - 1;
+    }
+    size_t getLength() const { return length; }
+
+private:
+    char* out;
+    size_t size;
+    size_t length;
+};
+
+bool isConversion(char c) {
+    return strchr("diouxXcsfFeEgGaAp", c) != nullptr;
+}
+bool isLengthModifier(char c) {
+    return strchr("hlLqjzt", c) != nullptr;
+}
+
+} // namespace
+
+// 書式文字列を順に見て、変換指定ごとに詰めた引数を1つ取り出して snprintf する
+// 長さ修飾子 (l, ll など) は引数の実際の型に合わせて付け直すので、書式と型が多少ずれても崩れない
+size_t LogBuffer::format(const LogRecord& record, char* out, size_t size) {
+    LineWriter line(out, size);
+    LogArgReader args(record.args, record.argBytes);
+    const char* p = record.format;
+    while (*p != '\0') {
+        const char* percent = strchr(p, '%');
+        if (percent == nullptr) {
+            line.append(p, strlen(p));
+            break;
+        }
+        line.append(p, (size_t)(percent - p));
+        p = percent + 1;
+        if (*p == '%') {
+            line.append("%", 1);
+            p++;
+            continue;
+        }
+
+        // フラグ・幅・精度はそのまま写し、長さ修飾子は飛ばす。'*' は次の引数の値に置き換える
+        char spec[24] = "%";
+        size_t specLength = 1;
+        while (*p != '\0' && !isConversion(*p)) {
+            if (*p == '*') {
+                uint8_t tag;
+                int64_t value = 0;
+                double real;
+                const char* text;
+                size_t textLength;
+                args.next(tag, value, real, text, textLength);
+                if (value < 0 && spec[specLength - 1] == '.')
+                    specLength--; // 負の精度は「精度なし」
+                else if (specLength < sizeof(spec) - 16)
+                    specLength += (size_t)snprintf(spec + specLength, sizeof(spec) - specLength, "%d", (int)value);
+            } else if (!isLengthModifier(*p) && specLength < sizeof(spec) - 4) {
+                spec[specLength++] = *p;
+            }
+            p++;
+        }
+        if (*p == '\0')
+            break;
+        char conversion = *p++;
+
+        uint8_t tag;
+        int64_t integer = 0;
+        double real = 0;
+        const char* text = nullptr;
+        size_t textLength = 0;
+        if (!args.next(tag, integer, real, text, textLength)) {
+            line.append("?", 1);
+            continue;
+        }
+        spec[specLength] = '\0';
+        if (tag == LogArgWriter::TAG_STRING || tag == LogArgWriter::TAG_STRING_TRUNCATED) {
+            // 終端がないので、長さを精度にして %.*s で出す (書式に精度があれば短い方)
+            int precision = (int)textLength;
+            char* dot = strchr(spec, '.');
+            if (dot != nullptr) {
+                int given = atoi(dot + 1);
+                if (given < precision)
+                    precision = given;
+                specLength = (size_t)(dot - spec);
+            }
+            strcpy(spec + specLength, ".*s");
+            line.appendFormatted(spec, precision, text);
+            if (tag == LogArgWriter::TAG_STRING_TRUNCATED)
+                line.append("...", 3);
+            continue;
+        }
+        bool isReal = tag == LogArgWriter::TAG_DOUBLE;
+        long long whole = isReal ? (long long)real : (long long)integer;
+        switch (conversion) {
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                spec[specLength] = conversion;
+                spec[specLength + 1] = '\0';
+                line.appendFormatted(spec, isReal ? real : (double)integer);
+                break;
+            case 'c':
+                strcpy(spec + specLength, "c");
+                line.appendFormatted(spec, (int)whole);
+                break;
+            case 's': // 数値を %s で出そうとした: 10進で出す
+                strcpy(spec + specLength, tag == LogArgWriter::TAG_UINT64 ? "llu" : "lld");
+                line.appendFormatted(spec, whole);
+                break;
+            case 'p':
+                line.append("0x", 2);
+                strcpy(spec + specLength, "llx");
+                line.appendFormatted(spec, whole);
+                break;
+            default: // d i o u x X
+                // 負の32bit値を符号なしで出すときは printf と同じく32bitで見る
+                if (tag == LogArgWriter::TAG_INT32 && conversion != 'd' && conversion != 'i')
+                    whole = (long long)(uint32_t)whole;
+                spec[specLength] = 'l';
+                spec[specLength + 1] = 'l';
+                spec[specLength + 2] = conversion;
+                spec[specLength + 3] = '\0';
+                line.appendFormatted(spec, whole);
+                break;
+        }
+    }
+    return line.getLength();
+}
@@ -0,0 +1,219 @@
+#include "MetricRegistry.hpp"
+#include <stdio.h>
+#include <string.h>
+
+Metric* MetricRegistry::head = nullptr;
+
+Metric::Metric(MetricType type, const char* name, const char* help, const char* labels) :
+    type(type),
+    name(name),
+    help(help),
+    labels(labels),
+    next(nullptr)
+{
+    MetricRegistry::add(this);
+}
+
+MetricCounter::MetricCounter(const char* name, const char* help, const char* labels) :
+    Metric(MetricType::COUNTER, name, help, labels),
+    value(0)
+{}
+
+void MetricCounter::set(uint32_t newValue) {
+    value.store(newValue, std::memory_order_relaxed);
+}
+
+uint32_t MetricCounter::get() const {
+    return value.load(std::memory_order_relaxed);
+}
+
+MetricGauge::MetricGauge(const char* name, const char* help, const char* labels) :
+    Metric(MetricType::GAUGE, name, help, labels),
+    value(0.0f),
+    reader(nullptr)
+{}
+
+MetricGauge::MetricGauge(const char* name, const char* help, Reader reader, const char* labels) :
+    Metric(MetricType::GAUGE, name, help, labels),
+    value(0.0f),
+    reader(reader)
+{}
+
+void MetricGauge::set(float newValue) {
+    value.store(newValue, std::memory_order_relaxed);
+}
+
+float MetricGauge::get() const {
+    return reader != nullptr ? reader() : value.load(std::memory_order_relaxed);
+}
+
+MetricHistogram::MetricHistogram(const char* name, const char* help, const uint32_t* boundsUs, size_t boundCount,
+                                 const char* labels) :
+    Metric(MetricType::HISTOGRAM, name, help, labels),
+    boundsUs(boundsUs),
+    boundCount(boundCount < MAX_BOUNDS ? boundCount : MAX_BOUNDS),
+    sumUs(0)
+{
+    for (std::atomic<uint32_t>& count : counts)
+        count.store(0, std::memory_order_relaxed);
+}
+
+void MetricHistogram::observeUs(uint32_t us) {
+    size_t index = 0;
+    while (index < boundCount && us > boundsUs[index])
+        index++;
+    counts[index].fetch_add(1, std::memory_order_relaxed);
+    sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+
+// 同じ名前の最後のものの後ろに繋ぐ (なければ末尾)
+void MetricRegistry::add(Metric* metric) {
+    if (head == nullptr) {
+        head = metric;
+        return;
+    }
+    Metric* insertAfter = nullptr;
+    Metric* last = head;
+    for (Metric* m = head; m != nullptr; m = m->next) {
+        if (strcmp(m->name, metric->name) == 0)
+            insertAfter = m;
+        last = m;
+    }
+    if (insertAfter == nullptr)
+        insertAfter = last;
+    metric->next = insertAfter->next;
+    insertAfter->next = metric;
+}
+
+const Metric* MetricRegistry::first() {
+    return head;
+}
+
+
+// --- テキスト形式 ---
+
+MetricWriter::MetricWriter() :
+    metric(MetricRegistry::first()),
+    previous(nullptr),
+    step(STEP_HELP),
+    bucket(0),
+    cumulative(0),
+    lineLength(0),
+    linePosition(0)
+{
+    line[0] = '\0';
+    if (metric != nullptr)
+        beginMetric();
+}
+
+size_t MetricWriter::read(uint8_t* buffer, size_t maxLength) {
+    size_t written = 0;
+    while (written < maxLength) {
+        if (linePosition == lineLength && !nextLine())
+            break;
+        size_t chunk = lineLength - linePosition;
+        if (chunk > maxLength - written)
+            chunk = maxLength - written; // 入りきらない分は次の呼び出しで
+        memcpy(buffer + written, line + linePosition, chunk);
+        linePosition += chunk;
+        written += chunk;
+    }
+    return written;
+}
+
+// 直前と同じ名前なら HELP と TYPE は出さない
+void MetricWriter::beginMetric() {
+    bool sameName = previous != nullptr && strcmp(previous->name, metric->name) == 0;
+    step = sameName ? (metric->type == MetricType::HISTOGRAM ? STEP_BUCKET : STEP_VALUE) : STEP_HELP;
+    bucket = 0;
+    cumulative = 0;
+}
+
+// {labels,extra="value"} の形にする (どちらも無ければ空)
+void MetricWriter::formatLabels(char* out, size_t size, const char* extraName, const char* extraValue) const {
+    bool hasLabels = metric->labels != nullptr && metric->labels[0] != '\0';
+    if (!hasLabels && extraName == nullptr) {
+        out[0] = '\0';
+    } else if (extraName == nullptr) {
+        snprintf(out, size, "{%s}", metric->labels);
+    } else if (!hasLabels) {
+        snprintf(out, size, "{%s=\"%s\"}", extraName, extraValue);
+    } else {
+        snprintf(out, size, "{%s,%s=\"%s\"}", metric->labels, extraName, extraValue);
+    }
+}
+
+bool MetricWriter::nextLine() {
+    if (step == STEP_NEXT && metric != nullptr) {
+        previous = metric;
+        metric = metric->next;
+        if (metric != nullptr)
+            beginMetric();
+    }
+    if (metric == nullptr)
+        return false;
+    static const char* const TYPE_NAMES[] = { "counter", "gauge", "histogram" };
+    char labels[96];
+    int length = 0;
+    switch (step) {
+        case STEP_HELP:
+            length = snprintf(line, sizeof(line), "# HELP %s %s\n", metric->name, metric->help);
+            step = STEP_TYPE;
+            break;
+        case STEP_TYPE:
+            length = snprintf(line, sizeof(line), "# TYPE %s %s\n", metric->name, TYPE_NAMES[(size_t)metric->type]);
+            step = metric->type == MetricType::HISTOGRAM ? STEP_BUCKET : STEP_VALUE;
+            break;
+        case STEP_VALUE:
+            formatLabels(labels, sizeof(labels), nullptr, nullptr);
+            if (metric->type == MetricType::COUNTER) {
+                length = snprintf(line, sizeof(line), "%s%s %u\n", metric->name, labels,
+                                  (unsigned)static_cast<const MetricCounter*>(metric)->get());
+            } else {
+                length = snprintf(line, sizeof(line), "%s%s %.9g\n", metric->name, labels,
+                                  (double)static_cast<const MetricGauge*>(metric)->get());
+            }
+            step = STEP_NEXT;
+            break;
+        case STEP_BUCKET: {
+            const MetricHistogram* histogram = static_cast<const MetricHistogram*>(metric);
+            char bound[24];
+            cumulative += histogram->counts[bucket].load(std::memory_order_relaxed);
+            if (bucket < histogram->boundCount) {
+                snprintf(bound, sizeof(bound), "%g", histogram->boundsUs[bucket] / 1e6);
+            } else {
+                strcpy(bound, "+Inf");
+            }
+            formatLabels(labels, sizeof(labels), "le", bound);
+            length = snprintf(line, sizeof(line), "%s_bucket%s %llu\n", metric->name, labels, (unsigned long long)cumulative);
+            if (++bucket > histogram->boundCount)
+                step = STEP_SUM;
+            break;
+        }
+        case STEP_SUM: {
+            const MetricHistogram* histogram = static_cast<const MetricHistogram*>(metric);
+            formatLabels(labels, sizeof(labels), nullptr, nullptr);
+            length = snprintf(line, sizeof(line), "%s_sum%s %.6f\n", metric->name, labels,
+                              histogram->sumUs.load(std::memory_order_relaxed) / 1e6);
+            step = STEP_COUNT;
+            break;
+        }
+        case STEP_COUNT:
+            formatLabels(labels, sizeof(labels), nullptr, nullptr);
+            length = snprintf(line, sizeof(line), "%s_count%s %llu\n", metric->name, labels, (unsigned long long)cumulative);
+            step = STEP_NEXT;
+            break;
+        case STEP_NEXT:
+            break;
+    }
+    if (length < 0)
+        length = 0;
+    if ((size_t)length >= sizeof(line)) { // 長すぎる行は切って改行で終える
+        length = sizeof(line) - 1;
+        line[length - 1] = '\n';
+    }
+    lineLength = (size_t)length;
+    linePosition = 0;
+    return true;
+}
@@ -0,0 +1,65 @@
+#include "MetricsAccumulator.hpp"
+
+MetricsAccumulator::MetricsAccumulator() :
+    milliRpm(0),
+    lastValidMilliRpm(0),
+    rpmSubstituted(false),
+    distanceRemainder(0),
+    calorieRemainder(0)
+{}
+
+void MetricsAccumulator::restoreCumulative(const Totals& totals) {
+    cumulativeTotals = totals;
+    sessionTotals = Totals();
+    distanceRemainder = 0;
+    calorieRemainder = 0;
+}
+
+void MetricsAccumulator::resetSession() {
+    sessionTotals = Totals();
+}
+
+void MetricsAccumulator::addActiveTime(uint32_t ms) {
+    sessionTotals.timeMs += ms;
+    cumulativeTotals.timeMs += ms;
+}
+
+void MetricsAccumulator::add(uint64_t distanceUm, uint64_t caloriesMcal) {
+    sessionTotals.distanceUm += distanceUm;
+    sessionTotals.caloriesMcal += caloriesMcal;
+    cumulativeTotals.distanceUm += distanceUm;
+    cumulativeTotals.caloriesMcal += caloriesMcal;
+}
+
+const MetricsAccumulator::Totals& MetricsAccumulator::session() const {
+    return sessionTotals;
+}
+
+const MetricsAccumulator::Totals& MetricsAccumulator::cumulative() const {
+    return cumulativeTotals;
+}
+
+uint32_t MetricsAccumulator::getMilliRpm() const {
+    return milliRpm;
+}
+
+bool MetricsAccumulator::wasRpmSubstituted() const {
+    return rpmSubstituted;
+}
+
+// 整数で mm / cal まで落としてから float にする (double を使わない)
+float MetricsAccumulator::toKm(uint64_t distanceUm) {
+    return (float)(distanceUm / 1000) * 1e-6f;
+}
+
+float MetricsAccumulator::toKcal(uint64_t caloriesMcal) {
+    return (float)(caloriesMcal / 1000) * 1e-3f;
+}
+
+uint64_t MetricsAccumulator::fromKm(float km) {
+    return km > 0.0f ? (uint64_t)((double)km * 1e9 + 0.5) : 0;
+}
+
+uint64_t MetricsAccumulator::fromKcal(float kcal) {
+    return kcal > 0.0f ? (uint64_t)((double)kcal * 1e6 + 0.5) : 0;
+}
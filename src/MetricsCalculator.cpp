@@ -1,42 +1,59 @@
 #include "MetricsCalculator.hpp"
 #include <M5Stack.h>
+#include "Log.hpp"
 
-MetricsCalculator::MetricsCalculator(PulseCounter& pc, Storage& storage) :
+MetricsCalculator::MetricsCalculator(PulseCounter& pc, Storage& storage, Clock& clock, uint32_t pulsesPerRev, uint32_t minPulsePeriodUs) :
     pulseCounter(pc),
     storage(storage),
+    clock(clock),
     // データメンバーは TrackerData 構造体のデフォルト値で初期化される
+    pulsesPerRev(pulsesPerRev),
+    minPulsePeriodUs(minPulsePeriodUs),
+    rejectedPulses(0),
+    bootPulses(0),
+    hasFinishedSession(false),
     lastCalcTimeMs(0),
     lastPulseObservedMs(0),
     lastTotalPulseCount(0),
     moving(false),
     timer_running(false),
-    lastValidRpm(0.0f),
     lastValidSpeedKmh(0.0f),
-    lastValidMets(1.0f)
+    lastValidMets(1.0f),
+    updateSequence(0)
 {}
 
-void MetricsCalculator::begin(DriveType type) {
-    drive_type = type;
-
+void MetricsCalculator::begin() {
     // SDカードから累積データを読み込む
-    if (!storage.loadCumulativeDataFromSD(data)) {
+    if (!storage.loadCumulativeDataFromSD(data, pulseCounter.getChannel())) {
         Serial.println("Failed to load cumulative data from SD on begin. Starting from zero.");
         // 読み込み失敗またはファイルなしの場合、ゼロから開始 (data構造体のデフォルト値)
         data.cumulativeTimeMs = 0;
         data.cumulativeDistanceKm = 0.0f;
         data.cumulativeCaloriesKcal = 0.0f;
+        data.cumulativeDistanceUm = 0;
+        data.cumulativeCaloriesMcal = 0;
     }
+    MetricsAccumulator::Totals saved;
+    saved.distanceUm = data.cumulativeDistanceUm;
+    saved.caloriesMcal = data.cumulativeCaloriesMcal;
+    saved.timeMs = data.cumulativeTimeMs;
+    accumulator.restoreCumulative(saved);
+    cadence.begin(storage.getCadenceConfig(), pulsesPerRev, minPulsePeriodUs, CADENCE_MAX_PERIOD_MS * 1000);
     resetSession(); // セッションデータはリセット
-    lastCalcTimeMs = millis(); // 初回計算時刻の基準
+    // PCNT は計算を作る前 (SD や LCD を待つ間) から数えている。その分は最初のセッションの始まりに足す
+    bootPulses = pulseCounter.getPulseCount();
+    if (bootPulses > 0)
+        LOG_I("%lu pulses counted during boot (ch %u). Carried into the first session.", bootPulses, pulseCounter.getChannel());
+    lastCalcTimeMs = clock.nowMs(); // 初回計算時刻の基準
 }
 
 // セッションデータのみをリセットする
 void MetricsCalculator::resetSession() {
-    Serial.println("Resetting session data...");
+    LOG_I("Resetting session data...");
+    closeSession(lastPulseObservedMs); // 手動リセットでも、それまでの分は1セッションとして残す
     data.sessionStartTimeMs = 0;
-    data.sessionElapsedTimeMs = 0;
-    data.sessionDistanceKm = 0.0f;
-    data.sessionCaloriesKcal = 0.0f;
+    accumulator.resetSession();
+    syncTotals(); // セッションの時間・距離・カロリーも0になる
     data.currentRpm = 0.0f;
     data.currentSpeedKmh = 0.0f;
     data.sessionPulseCount = 0; // セッションパルスもリセット
@@ -48,23 +65,27 @@ void MetricsCalculator::resetSession() {
 
     // ★★★ pulseCounter.resetPulseCount(); を削除した状態 ★★★
 
+    cadence.reset();
+    rejectedPulses = 0;
+    bootPulses = 0; // 手動リセットの後は起動中の分を足さない
+
     lastPulseObservedMs = 0; // 最後に観測した時刻もリセット
     moving = false;          // 移動状態フラグもリセット
     timer_running = false;   // タイマー状態フラグもリセット
 }
 
 
-bool MetricsCalculator::update(unsigned long currentMillis) {
-    // 最新のパルスカウントと最終パルス時刻を取得
-    unsigned long currentPulseTotal = pulseCounter.getPulseCount();
-    unsigned long currentLastPulseTime = pulseCounter.getLastPulseTime();
+// 動き出し・タイマー停止・移動停止の判定 (駆動方式によらず毎回行う)
+void MetricsCalculator::trackMovement(const PulseSnapshot& pulse, uint64_t currentMillis) {
+    unsigned long currentPulseTotal = pulse.count;
+    uint64_t currentLastPulseTime = pulse.lastPulseMs; // 64bitなので一周を気にせず大小比較できる
 
     // 動き出し判定
     bool hadRecentPulse = false;
     if (lastPulseObservedMs == 0) { // まだ一度も観測していない or リセット直後
         if (currentLastPulseTime > 0) { 
             hadRecentPulse = true; 
-            Serial.println("First pulse detected after reset/idle.");
+            LOG_I("First pulse detected after reset/idle.");
         }
     } else { // すでに観測履歴がある場合
         if (currentLastPulseTime > lastPulseObservedMs) { 
@@ -80,14 +101,17 @@ bool MetricsCalculator::update(unsigned long currentMillis) {
             timer_running = true; // タイマー動作中フラグON
             if (data.sessionStartTimeMs == 0) { // 完全な新規セッション開始
                  data.sessionStartTimeMs = currentMillis; // セッション開始時刻
-                 data.sessionElapsedTimeMs = 0;          // 経過時間はリセット
-                 data.sessionDistanceKm = 0.0f;          // セッション距離リセット
-                 data.sessionCaloriesKcal = 0.0f;        // セッションカロリーリセット
+                 sessionBuilder.start(currentMillis);
+                 cadenceAnalyzer.reset(currentMillis);
+                 accumulator.resetSession();             // 経過時間・距離・カロリーをリセット
+                 syncTotals();
                  data.sessionPulseCount = 0;             // セッションパルスカウントリセット
                  // ★ 新セッション開始時の前回のカウントは現在の値を使う ★
-                 lastTotalPulseCount = currentPulseTotal;
+                 // 起動中に数えた分だけは最初の区間のパルスとして距離に入れる (1回だけ)
+                 lastTotalPulseCount = currentPulseTotal - (bootPulses < currentPulseTotal ? bootPulses : currentPulseTotal);
+                 bootPulses = 0;
             }
-            Serial.println("Movement started / resumed.");
+            LOG_I("Movement started / resumed.");
             M5.Speaker.tone(440, 100); // 開始音
         } else {
             // すでに移動中の場合（タイマーが止まっていた場合も含む）
@@ -101,119 +125,71 @@ bool MetricsCalculator::update(unsigned long currentMillis) {
     } else { // 最近のパルスがない場合
         if (moving) { // 直前まで動いていた場合 (moving==true)
             // タイマー停止判定 (TIMER_STOP_DELAY_MS: 3秒)
-            if (timer_running && lastPulseObservedMs > 0 && (currentMillis - lastPulseObservedMs > TIMER_STOP_DELAY_MS)) {
+            // パルス時刻が currentMillis より後のこともあるので、引き算ではなく足し算で比べる
+            if (timer_running && lastPulseObservedMs > 0 && (currentMillis > lastPulseObservedMs + TIMER_STOP_DELAY_MS)) {
                 if (timer_running) {
                     timer_running = false;
-                    Serial.println("Timer stopped (3s inactivity).");
-                    storage.saveLatestDataToSD(data);
+                    LOG_I("Timer stopped (3s inactivity).");
+                    storage.requestSaveLatest(data, pulseCounter.getChannel());
                 }
             }
             // 移動停止判定（スリープタイムアウト） (SLEEP_TIMEOUT_MS: 63秒)
-            if (lastPulseObservedMs > 0 && (currentMillis - lastPulseObservedMs > SLEEP_TIMEOUT_MS)) {
+            if (lastPulseObservedMs > 0 && (currentMillis > lastPulseObservedMs + SLEEP_TIMEOUT_MS)) {
                 if (moving) {
                     moving = false;
                     timer_running = false;
-                    Serial.println("Movement stopped (Sleep timeout).");
+                    LOG_I("Movement stopped (Sleep timeout).");
                     data.currentRpm = 0.0f;
                     data.currentSpeedKmh = 0.0f;
-                    storage.saveLatestDataToSD(data); // 最新の累積データ（時間含む）を保存
+                    storage.requestSaveLatest(data, pulseCounter.getChannel()); // 最新の累積データ（時間含む）を保存
+                    closeSession(lastPulseObservedMs); // セッションの終わりは最後のパルス
                     data.sessionStartTimeMs = 0; // 次回の新規セッション判定のため
                 }
             }
         }
     }
+}
 
-    // --- メトリクス計算 ---
-    bool calc_metrics = false;
-    if (drive_type == DriveType::TIMER_DRIVEN && currentMillis - lastCalcTimeMs >= METRICS_CALC_INTERVAL_MS){
-        calc_metrics = true;
+// パルス間隔の待ち行列を空にする (パルスごとに通知で起きるので、普段は1つずつ)
+void MetricsCalculator::drainPulsePeriods() {
+    uint32_t periodUs;
+    while (pulseCounter.popPeriod(periodUs)) {
+        if (!cadence.addPeriod(periodUs))
+            rejectedPulses++;
     }
-    else if (drive_type == DriveType::EVENT_DRIVEN && currentPulseTotal > lastTotalPulseCount){ // 改善対象; もっといい方法があると思う.
-            calc_metrics = true;
-    }
-    if (calc_metrics){
-        unsigned long intervalMs = currentMillis - lastCalcTimeMs;
-        unsigned long intervalPulses = 0;
-        // 差分を計算 (現在のカウント - 前回の計算時のカウント)
-        if (currentPulseTotal >= lastTotalPulseCount) {
-            intervalPulses = currentPulseTotal - lastTotalPulseCount;
-        } else {
-            // カウンタが一周した or リセットされた場合などは差分が負になる
-            // 本来は一周を考慮すべきだが、ここでは無視して0とする
-            if (currentPulseTotal != 0) {
-                Serial.printf("Warning: Pulse count decreased? C:%lu L:%lu\n", currentPulseTotal, lastTotalPulseCount);
-            }
-            intervalPulses = 0;
-        }
+}
 
-        // 計算実行条件
-        if (timer_running || intervalPulses > 0) {
-            calculateMetrics(intervalPulses, intervalMs); // RPM, Speed, Dist(S/C), Cal(S/C) 更新
-            // ★★★ タイマー動作中にセッション時間と累積時間の両方を加算 ★★★
-            if (timer_running && data.sessionStartTimeMs > 0) {
-                data.sessionElapsedTimeMs += intervalMs;
-                data.cumulativeTimeMs += intervalMs; // 累積時間もここで加算！
-            }
-        } else if (moving) { // STOPPING 状態
-            data.currentRpm = 0.0f;
-            data.currentSpeedKmh = 0.0f;
-        } else { // IDLE 状態
-            data.currentRpm = 0.0f;
-            data.currentSpeedKmh = 0.0f;
-        }
+// ノイズとして捨てたパルスを区間のパルス数から引く (引ききれない分は次の区間へ)
+unsigned long MetricsCalculator::takeValidPulses(unsigned long intervalPulses) {
+    unsigned long removed = rejectedPulses < intervalPulses ? rejectedPulses : intervalPulses;
+    rejectedPulses -= removed;
+    return intervalPulses - removed;
+}
 
-        // ★ 次回計算のために今回のカウントを保存 ★
-        lastTotalPulseCount = currentPulseTotal;
-        lastCalcTimeMs = currentMillis;
-        
-        calc_metrics = false;
-        // Serial.printf("Data updated!\n");
-        return true;
+// 前回計算してからのパルス数
+unsigned long MetricsCalculator::takeIntervalPulses(unsigned long currentPulseTotal) const {
+    // 差分を計算 (現在のカウント - 前回の計算時のカウント)
+    if (currentPulseTotal >= lastTotalPulseCount) {
+        return currentPulseTotal - lastTotalPulseCount;
     }
-
-    return false;
+    // カウンタが一周した or リセットされた場合などは差分が負になる
+    // 本来は一周を考慮すべきだが、ここでは無視して0とする
+    if (currentPulseTotal != 0) {
+        LOG_W("Warning: Pulse count decreased? C:%lu L:%lu", currentPulseTotal, lastTotalPulseCount);
+    }
+    return 0;
 }
 
-// calculateMetrics
-void MetricsCalculator::calculateMetrics(unsigned long intervalPulses, unsigned long intervalMs) {
-     if (intervalMs == 0 && intervalPulses == 0)
-        return; // 何もなければ計算しない
-
-     float currentRpm = 0.0;
-     // RPM calculation
-     if (intervalMs > 0) {
-          double intervalSeconds = (double)intervalMs / 1000.0;
-          double revolutions = (double)intervalPulses / PULSES_PER_REVOLUTION; // 1パルス=1回転と仮定
-          currentRpm = (float)(revolutions / intervalSeconds * 60.0); 
-          data.currentRpm = currentRpm;
-          if (currentRpm > 300 || currentRpm < 0){
-            Serial.println("[MetricsCalc] Use last valid value.");
-            data.currentRpm = lastValidRpm; // 異常値補正
-          }
-     } else {
-        data.currentRpm = lastValidRpm;
-    }
+// 計算した区間を締める
+void MetricsCalculator::finishInterval(unsigned long currentPulseTotal, uint64_t currentMillis) {
+    // ★ 次回計算のために今回のカウントを保存 ★
+    lastTotalPulseCount = currentPulseTotal;
+    lastCalcTimeMs = currentMillis;
+    updateSequence++;
+}
 
-     // Speed calculation
-     data.currentSpeedKmh = data.currentRpm / 60.0f * DISTANCE_PER_REV_M * 3.6f;
-
-     // Distance calculation
-     double intervalRevolutions = (double)intervalPulses / PULSES_PER_REVOLUTION;
-     double intervalDistanceKm = intervalRevolutions * DISTANCE_PER_REV_M / 1000.0;
-     data.sessionDistanceKm += (float)intervalDistanceKm;
-     data.cumulativeDistanceKm += (float)intervalDistanceKm; // ★ 累積距離はここで加算 ★
-
-     // Calorie calculation
-     if (intervalMs > 0) {
-         double intervalSeconds = (double)intervalMs / 1000.0;
-         double calorieRate = CALORIES_RPM_K1_FACTOR * data.currentRpm; // カロリー/秒
-         if (calorieRate < 0.0)
-            calorieRate = 0.0; // マイナスにならないように
-         double intervalCalories = calorieRate * intervalSeconds;
-         data.sessionCaloriesKcal += (float)intervalCalories;
-         data.cumulativeCaloriesKcal += (float)intervalCalories; // ★ 累積カロリーはここで加算 ★
-     }
-     // METs calculation
+// METs calculation
+void MetricsCalculator::updateMets() {
      if (data.currentSpeedKmh < 1)
         data.currentMets = 1.0f;
      else if (data.currentSpeedKmh < 10)
@@ -222,12 +198,50 @@ void MetricsCalculator::calculateMetrics(unsigned long intervalPulses, unsigned
         data.currentMets = 4.0f;
      else
         data.currentMets = 6.0f;
-    
-     lastValidRpm = data.currentRpm;
+
      lastValidSpeedKmh = data.currentSpeedKmh;
      lastValidMets = data.currentMets;
 }
 
+// syncTotals
+void MetricsCalculator::syncTotals() {
+    const MetricsAccumulator::Totals& session = accumulator.session();
+    const MetricsAccumulator::Totals& cumulative = accumulator.cumulative();
+    data.sessionElapsedTimeMs = (unsigned long)session.timeMs;
+    data.sessionDistanceUm = session.distanceUm;
+    data.sessionCaloriesMcal = session.caloriesMcal;
+    data.sessionDistanceKm = MetricsAccumulator::toKm(session.distanceUm);
+    data.sessionCaloriesKcal = MetricsAccumulator::toKcal(session.caloriesMcal);
+    data.cumulativeTimeMs = cumulative.timeMs;
+    data.cumulativeDistanceUm = cumulative.distanceUm;
+    data.cumulativeCaloriesMcal = cumulative.caloriesMcal;
+    data.cumulativeDistanceKm = MetricsAccumulator::toKm(cumulative.distanceUm);
+    data.cumulativeCaloriesKcal = MetricsAccumulator::toKcal(cumulative.caloriesMcal);
+}
+
+// セッションを閉じて要約を残す (タイマーが一度も動かなかったものは残さない)
+void MetricsCalculator::closeSession(uint64_t endMs) {
+    if (!sessionBuilder.isOpen())
+        return;
+    SessionSummary summary = sessionBuilder.finish(endMs, accumulator.session(), cadenceAnalyzer.getAnalysis());
+    if (summary.activeTimeMs == 0)
+        return;
+    summary.channel = pulseCounter.getChannel();
+    finishedSession = summary;
+    hasFinishedSession = true;
+    LOG_I("Session closed (ch %u): %llu ms active, %.3f km, %.1f kcal, rpm avg %.1f / max %.1f / tw %.1f",
+          summary.channel, (unsigned long long)summary.activeTimeMs, MetricsAccumulator::toKm(summary.distanceUm),
+          MetricsAccumulator::toKcal(summary.caloriesMcal), summary.avgRpm, summary.maxRpm, summary.timeWeightedRpm);
+}
+
+bool MetricsCalculator::takeFinishedSession(SessionSummary& out) {
+    if (!hasFinishedSession)
+        return false;
+    out = finishedSession;
+    hasFinishedSession = false;
+    return true;
+}
+
 // getData
 const TrackerData& MetricsCalculator::getData() const {
     return data;
@@ -239,7 +253,7 @@ bool MetricsCalculator::isMoving() const {
 }
 
 // getLastPulseObservedMs
-unsigned long MetricsCalculator::getLastPulseObservedMs() const {
+uint64_t MetricsCalculator::getLastPulseObservedMs() const {
     return lastPulseObservedMs;
 }
 
@@ -250,10 +264,141 @@ bool MetricsCalculator::isTimerRunning() const {
 
 // saveCumulativeData (現状未使用)
 void MetricsCalculator::saveCumulativeData() {
-     Serial.println("[MetricsCalculator] saveCumulativeData called - Deprecated (Data is saved to SD)");
+     LOG_I("[MetricsCalculator] saveCumulativeData called - Deprecated (Data is saved to SD)");
 }
 
 void MetricsCalculator::stoppingDataUpdate(){
     data.currentRpm = 0.0f;
     data.currentSpeedKmh = 0.0f;
-}
\ No newline at end of file
+}
+
+unsigned long MetricsCalculator::msUntil(uint64_t deadlineMs, uint64_t currentMillis) {
+    uint64_t ms = deadlineMs > currentMillis ? deadlineMs - currentMillis : 0;
+    return ms < NO_DEADLINE ? (unsigned long)ms : NO_DEADLINE;
+}
+
+// タイマー停止・移動停止までの残り時間
+unsigned long MetricsCalculator::msUntilMovementDeadline(uint64_t currentMillis) const {
+    unsigned long remaining = NO_DEADLINE;
+    // 判定は「しきい値を超えたら」なので1ms後に起きる
+    if (timer_running && lastPulseObservedMs > 0) {
+        remaining = min(remaining, msUntil(lastPulseObservedMs + TIMER_STOP_DELAY_MS + 1, currentMillis));
+    }
+    if (moving && lastPulseObservedMs > 0) {
+        remaining = min(remaining, msUntil(lastPulseObservedMs + SLEEP_TIMEOUT_MS + 1, currentMillis));
+    }
+    return remaining;
+}
+
+// スナップショットを作る (計測タスクから呼ぶ)
+uint32_t MetricsCalculator::getUpdateSequence() const {
+    return updateSequence;
+}
+
+void MetricsCalculator::fillSnapshot(MetricsSnapshot& out) const {
+    out.data = data;
+    out.moving = moving;
+    out.timerRunning = timer_running;
+    out.lastPulseObservedMs = lastPulseObservedMs;
+    out.pulseCount = pulseCounter.getPulseCount();
+    out.updateSequence = updateSequence;
+    out.cadence = cadenceAnalyzer.getAnalysis();
+}
+
+
+// --- 駆動方式・機種ごとの実体 ---
+
+template <class Drive, class Chair>
+BasicMetricsCalculator<Drive, Chair>::BasicMetricsCalculator(PulseCounter& pc, Storage& storage, Clock& clock) :
+    MetricsCalculator(pc, storage, clock, Chair::PULSES_PER_REV, 60000000UL / (Chair::MAX_RPM * Chair::PULSES_PER_REV))
+{}
+
+template <class Drive, class Chair>
+bool BasicMetricsCalculator<Drive, Chair>::update(uint64_t currentMillis) {
+    // 先に間隔を取り出す (ISRはカウントを増やしてから間隔を積むので、取り出した分は必ず下のカウントに含まれる)
+    drainPulsePeriods();
+    // 最新のパルスカウントと最終パルス時刻を取得 (同じパルス時点の組として読む)
+    PulseSnapshot pulse = pulseCounter.snapshot();
+    trackMovement(pulse, currentMillis);
+
+    // --- メトリクス計算 --- (TIMER: 周期ごと / EVENT: 新しいパルスがあったとき)
+    // 計測タスクはパルスの割り込み通知で起きるので、EVENT駆動ではパルス直後にここへ来る
+    if (!Drive::shouldCalculate(currentMillis, lastCalcTimeMs, pulse.count, lastTotalPulseCount))
+        return false;
+
+    unsigned long intervalMs = (unsigned long)(currentMillis - lastCalcTimeMs);
+    unsigned long intervalPulses = takeIntervalPulses(pulse.count);
+
+    // 計算実行条件
+    if (timer_running || intervalPulses > 0) {
+        uint64_t usSinceLastPulse = currentMillis > pulse.lastPulseMs ? (currentMillis - pulse.lastPulseMs) * 1000 : 0;
+        calculateMetrics(intervalPulses, intervalMs, usSinceLastPulse); // RPM, Speed, Dist(S/C), Cal(S/C) 更新
+        // ★★★ タイマー動作中にセッション時間と累積時間の両方を加算 ★★★
+        bool active = timer_running && data.sessionStartTimeMs > 0;
+        if (active) {
+            accumulator.addActiveTime(intervalMs); // 累積時間もここで加算！
+        }
+        sessionBuilder.addInterval(intervalMs, accumulator.getMilliRpm(), intervalPulses, active);
+        if (data.sessionStartTimeMs > 0)
+            cadenceAnalyzer.add(currentMillis, intervalMs, accumulator.getMilliRpm(), active);
+        syncTotals();
+    } else { // STOPPING / IDLE 状態
+        data.currentRpm = 0.0f;
+        data.currentSpeedKmh = 0.0f;
+        // 止まっている間も 0rpm として区間検出に入れる (休みの区間になる)
+        if (data.sessionStartTimeMs > 0)
+            cadenceAnalyzer.add(currentMillis, intervalMs, 0, false);
+    }
+
+    finishInterval(pulse.count, currentMillis);
+    return true;
+}
+
+// calculateMetrics
+// RPM・距離・カロリーは MetricsAccumulator が整数で計算する。ここでは表示用の float と METs を作るだけ
+template <class Drive, class Chair>
+void BasicMetricsCalculator<Drive, Chair>::calculateMetrics(unsigned long intervalPulses, unsigned long intervalMs, uint64_t usSinceLastPulse) {
+     if (intervalMs == 0 && intervalPulses == 0)
+        return; // 何もなければ計算しない
+
+     uint32_t milliRpm;
+     if (cadence.isEnabled()) {
+         // RPMはパルス間隔からの推定値。ノイズとして捨てたパルスは距離にも入れない
+         milliRpm = cadence.getMilliRpm(usSinceLastPulse);
+         accumulator.addIntervalAtRpm<Chair>(takeValidPulses(intervalPulses), intervalMs, milliRpm);
+     } else {
+         milliRpm = accumulator.addInterval<Chair>(intervalPulses, intervalMs);
+         if (accumulator.wasRpmSubstituted()) {
+             LOG_W("[MetricsCalc] Use last valid value.");
+         }
+     }
+     data.currentRpm = milliRpm * 0.001f;
+     data.currentSpeedKmh = data.currentRpm * Chair::KMH_PER_RPM; // 係数はコンパイル時に計算済み
+     updateMets();
+}
+
+template <class Drive, class Chair>
+DriveType BasicMetricsCalculator<Drive, Chair>::getDriveType() const {
+    return Drive::TYPE;
+}
+
+// 次の期限までの残り時間
+template <class Drive, class Chair>
+unsigned long BasicMetricsCalculator<Drive, Chair>::msUntilNextDeadline(uint64_t currentMillis) const {
+    unsigned long remaining = msUntilMovementDeadline(currentMillis);
+    // TIMER駆動は停止中も一定周期で計算する (動き出したときの計算区間を周期以内に保つため)
+    if (Drive::HAS_CALC_INTERVAL) {
+        remaining = min(remaining, msUntil(lastCalcTimeMs + METRICS_CALC_INTERVAL_MS, currentMillis));
+    }
+    return remaining;
+}
+
+// 使う組み合わせだけを実体化する
+template class BasicMetricsCalculator<TimerDrive, DefaultChairModel>;
+template class BasicMetricsCalculator<EventDrive, DefaultChairModel>;
+
+std::unique_ptr<MetricsCalculator> MetricsCalculator::create(DriveType type, PulseCounter& pc, Storage& storage, Clock& clock) {
+    if (type == DriveType::EVENT_DRIVEN)
+        return std::unique_ptr<MetricsCalculator>(new BasicMetricsCalculator<EventDrive, DefaultChairModel>(pc, storage, clock));
+    return std::unique_ptr<MetricsCalculator>(new BasicMetricsCalculator<TimerDrive, DefaultChairModel>(pc, storage, clock));
+}
@@ -0,0 +1,40 @@
+#include "ParsedUrl.hpp"
+
+bool ParsedUrl::parse(const String& url) {
+    int schemeEnd = url.indexOf("://");
+    if (schemeEnd <= 0)
+        return false;
+    scheme = url.substring(0, schemeEnd);
+    scheme.toLowerCase();
+
+    String rest = url.substring(schemeEnd + 3);
+    int pathStart = rest.indexOf('/');
+    String authority = pathStart >= 0 ? rest.substring(0, pathStart) : rest;
+    path = pathStart >= 0 ? rest.substring(pathStart) : String("/");
+
+    // user:pass@ は扱わない (Authorization は auth_header で指定する)
+    if (authority.indexOf('@') >= 0)
+        return false;
+
+    int colon = authority.indexOf(':');
+    if (colon >= 0) {
+        host = authority.substring(0, colon);
+        long parsedPort = authority.substring(colon + 1).toInt();
+        if (parsedPort <= 0 || parsedPort > 65535)
+            return false;
+        port = (uint16_t)parsedPort;
+    } else {
+        host = authority;
+        if (scheme == "https")
+            port = 443;
+        else if (scheme == "http")
+            port = 80;
+        else
+            return false; // udp:// はポート必須
+    }
+    return host.length() > 0;
+}
+
+bool ParsedUrl::isHttps() const {
+    return scheme == "https";
+}
@@ -0,0 +1,225 @@
+#include "PayloadEncoder.hpp"
+#include <ArduinoJson.h>
+#include <stdio.h>
+#include "MetricsAccumulator.hpp"
+
+static const size_t LINE_PROTOCOL_MAX_LEN = 512; // 1行の最大長 (余裕を持たせた値。セッション要約の行が最も長い)
+static const size_t STATSD_MAX_LEN = 512;        // StatsD 1サンプル分の最大長
+
+void PayloadEncoder::encode(PayloadFormat format, const TrackerData& data, uint64_t timestampMs,
+                            const char* deviceId, String& out) {
+    switch (format) {
+        case PayloadFormat::INFLUX_LINE: {
+            char line[LINE_PROTOCOL_MAX_LEN];
+            size_t len = encodeLineProtocol(data, timestampMs, deviceId, line, sizeof(line));
+            out = len > 0 ? line : "";
+            break;
+        }
+        case PayloadFormat::STATSD: {
+            char lines[STATSD_MAX_LEN];
+            size_t len = encodeStatsd(data, deviceId, lines, sizeof(lines));
+            out = len > 0 ? lines : "";
+            break;
+        }
+        case PayloadFormat::JSON:
+        default:
+            encodeJson(data, timestampMs, deviceId, out);
+            break;
+    }
+}
+
+void PayloadEncoder::encodeJson(const TrackerData& data, uint64_t timestampMs, const char* deviceId, String& out) {
+    StaticJsonDocument<1024> doc;
+    JsonObject root = doc.to<JsonObject>();
+    root["timestamp_ms"] = timestampMs;
+    fillJson(root, data);
+    root["device_id"] = deviceId;
+
+    out = "";
+    serializeJson(doc, out);
+}
+
+void PayloadEncoder::fillJson(JsonObject obj, const TrackerData& data) {
+    obj["session_time_s"] = data.sessionElapsedTimeMs / 1000.0;
+    obj["session_dist_km"] = data.sessionDistanceKm;
+    obj["session_cal_kcal"] = data.sessionCaloriesKcal;
+    obj["rpm"] = data.currentRpm;
+    obj["speed_kmh"] = data.currentSpeedKmh;
+    obj["mets"] = data.currentMets;
+    obj["total_time_s"] = (double)data.cumulativeTimeMs / 1000.0;
+    obj["total_dist_km"] = data.cumulativeDistanceKm;
+    obj["total_cal_kcal"] = data.cumulativeCaloriesKcal;
+}
+
+void PayloadEncoder::encodeBatch(PayloadFormat format, const TrackerData* channels, size_t channelCount,
+                                 uint64_t timestampMs, const char* deviceId, String& out) {
+    if (channelCount <= 1) {
+        encode(format, channels[0], timestampMs, deviceId, out);
+        return;
+    }
+    out = "";
+    switch (format) {
+        case PayloadFormat::INFLUX_LINE:
+        case PayloadFormat::STATSD: {
+            // チャンネルごとの行を改行でつなぐ (どちらの形式も1行1レコード)
+            char lines[STATSD_MAX_LEN];
+            out.reserve(channelCount * LINE_PROTOCOL_MAX_LEN / 2);
+            for (size_t i = 0; i < channelCount; i++) {
+                size_t len = format == PayloadFormat::STATSD
+                    ? encodeStatsd(channels[i], deviceId, lines, sizeof(lines), (int)i)
+                    : encodeLineProtocol(channels[i], timestampMs, deviceId, lines, sizeof(lines), (int)i);
+                if (len == 0)
+                    continue;
+                if (out.length() > 0)
+                    out += '\n';
+                out += lines;
+            }
+            break;
+        }
+        case PayloadFormat::JSON:
+        default: {
+            // {"timestamp_ms":..,"device_id":..,"channels":[{"channel":0,...},...]}
+            DynamicJsonDocument doc(256 + channelCount * 256);
+            doc["timestamp_ms"] = timestampMs;
+            doc["device_id"] = deviceId;
+            JsonArray array = doc.createNestedArray("channels");
+            for (size_t i = 0; i < channelCount; i++) {
+                JsonObject obj = array.createNestedObject();
+                obj["channel"] = i;
+                fillJson(obj, channels[i]);
+            }
+            serializeJson(doc, out);
+            break;
+        }
+    }
+}
+
+size_t PayloadEncoder::encodeLineProtocol(const TrackerData& data, uint64_t timestampMs, const char* deviceId,
+                                          char* buf, size_t bufSize, int channel) {
+    // measurement,tag field=...,field=... timestamp
+    char channelTag[16] = "";
+    if (channel >= 0)
+        snprintf(channelTag, sizeof(channelTag), ",channel=%d", channel);
+    int len = snprintf(buf, bufSize,
+                       "fit2go,device=%s%s "
+                       "rpm=%.1f,speed_kmh=%.2f,mets=%.1f,"
+                       "session_time_s=%.1f,session_dist_km=%.4f,session_cal_kcal=%.2f,"
+                       "total_time_s=%.3f,total_dist_km=%.4f,total_cal_kcal=%.2f "
+                       "%llu",
+                       deviceId, channelTag,
+                       data.currentRpm, data.currentSpeedKmh, data.currentMets,
+                       data.sessionElapsedTimeMs / 1000.0, data.sessionDistanceKm, data.sessionCaloriesKcal,
+                       (double)data.cumulativeTimeMs / 1000.0, data.cumulativeDistanceKm, data.cumulativeCaloriesKcal,
+                       (unsigned long long)timestampMs);
+    if (len < 0 || (size_t)len >= bufSize)
+        return 0;
+    return (size_t)len;
+}
+
+size_t PayloadEncoder::encodeStatsd(const TrackerData& data, const char* deviceId, char* buf, size_t bufSize, int channel) {
+    // StatsD はタイムスタンプを持たない (受信時刻が使われる)
+    // 名前の前半 fit2go.<device>[.ch<n>]
+    char prefix[64];
+    if (channel >= 0)
+        snprintf(prefix, sizeof(prefix), "fit2go.%s.ch%d", deviceId, channel);
+    else
+        snprintf(prefix, sizeof(prefix), "fit2go.%s", deviceId);
+    int len = snprintf(buf, bufSize,
+                       "%s.rpm:%.1f|g\n"
+                       "%s.speed_kmh:%.2f|g\n"
+                       "%s.mets:%.1f|g\n"
+                       "%s.session_dist_km:%.4f|g\n"
+                       "%s.session_cal_kcal:%.2f|g\n"
+                       "%s.total_dist_km:%.4f|g\n"
+                       "%s.total_cal_kcal:%.2f|g",
+                       prefix, data.currentRpm,
+                       prefix, data.currentSpeedKmh,
+                       prefix, data.currentMets,
+                       prefix, data.sessionDistanceKm,
+                       prefix, data.sessionCaloriesKcal,
+                       prefix, data.cumulativeDistanceKm,
+                       prefix, data.cumulativeCaloriesKcal);
+    if (len < 0 || (size_t)len >= bufSize)
+        return 0;
+    return (size_t)len;
+}
+
+void PayloadEncoder::encodeSession(PayloadFormat format, const SessionSummary& summary, const char* deviceId, String& out) {
+    switch (format) {
+        case PayloadFormat::INFLUX_LINE: {
+            char line[LINE_PROTOCOL_MAX_LEN];
+            size_t len = encodeSessionLineProtocol(summary, deviceId, line, sizeof(line));
+            out = len > 0 ? line : "";
+            break;
+        }
+        case PayloadFormat::STATSD:
+            out = ""; // ゲージは「今の値」なので、終わったセッションの記録には向かない
+            break;
+        case PayloadFormat::JSON:
+        default:
+            encodeSessionJson(summary, deviceId, out);
+            break;
+    }
+}
+
+void PayloadEncoder::encodeSessionJson(const SessionSummary& summary, const char* deviceId, String& out) {
+    StaticJsonDocument<768> doc;
+    doc["event"] = "session_end";
+    doc["channel"] = summary.channel;
+    doc["start_ms"] = (unsigned long long)summary.startWallMs;
+    doc["end_ms"] = (unsigned long long)summary.endWallMs;
+    doc["time_synced"] = summary.wallClockSynced;
+    doc["active_time_ms"] = (unsigned long long)summary.activeTimeMs;
+    doc["dist_um"] = (unsigned long long)summary.distanceUm;
+    doc["dist_km"] = MetricsAccumulator::toKm(summary.distanceUm);
+    doc["cal_mcal"] = (unsigned long long)summary.caloriesMcal;
+    doc["cal_kcal"] = MetricsAccumulator::toKcal(summary.caloriesMcal);
+    doc["pulses"] = summary.pulses;
+    doc["avg_rpm"] = summary.avgRpm;
+    doc["max_rpm"] = summary.maxRpm;
+    doc["tw_rpm"] = summary.timeWeightedRpm;
+    JsonArray zones = doc.createNestedArray("zone_ms");
+    for (size_t i = 0; i < CADENCE_ZONE_COUNT; i++)
+        zones.add(summary.zoneMs[i]);
+    doc["intervals"] = summary.workIntervals;
+    doc["boundaries"] = summary.boundaries;
+    if (deviceId != nullptr)
+        doc["device_id"] = deviceId;
+
+    out = "";
+    serializeJson(doc, out);
+}
+
+size_t PayloadEncoder::encodeSessionLineProtocol(const SessionSummary& summary, const char* deviceId,
+                                                 char* buf, size_t bufSize) {
+    // タイムスタンプはセッションの終了時刻。時刻が未同期なら起動からのmsなので time_synced で見分ける
+    int len = snprintf(buf, bufSize,
+                       "fit2go_session,device=%s,channel=%u "
+                       "start_ms=%llui,active_time_s=%.3f,dist_km=%.4f,cal_kcal=%.2f,pulses=%lui,"
+                       "avg_rpm=%.1f,max_rpm=%.1f,tw_rpm=%.1f,time_synced=%s,intervals=%ui,boundaries=%ui",
+                       deviceId, (unsigned)summary.channel,
+                       (unsigned long long)summary.startWallMs, (double)summary.activeTimeMs / 1000.0,
+                       MetricsAccumulator::toKm(summary.distanceUm), MetricsAccumulator::toKcal(summary.caloriesMcal),
+                       (unsigned long)summary.pulses,
+                       summary.avgRpm, summary.maxRpm, summary.timeWeightedRpm,
+                       summary.wallClockSynced ? "true" : "false",
+                       (unsigned)summary.workIntervals, (unsigned)summary.boundaries);
+    // ゾーンごとの時間 (zone0_s 〜) とタイムスタンプを続ける
+    for (size_t i = 0; i < CADENCE_ZONE_COUNT && len >= 0 && (size_t)len < bufSize; i++) {
+        len += snprintf(buf + len, bufSize - len, ",zone%u_s=%.1f", (unsigned)i, summary.zoneMs[i] / 1000.0);
+    }
+    if (len >= 0 && (size_t)len < bufSize)
+        len += snprintf(buf + len, bufSize - len, " %llu", (unsigned long long)summary.endWallMs);
+    if (len < 0 || (size_t)len >= bufSize)
+        return 0;
+    return (size_t)len;
+}
+
+const char* PayloadEncoder::contentType(PayloadFormat format) {
+    switch (format) {
+        case PayloadFormat::INFLUX_LINE:
+        case PayloadFormat::STATSD:      return "text/plain; charset=utf-8";
+        case PayloadFormat::JSON:
+        default:                         return "application/json";
+    }
+}
@@ -0,0 +1,51 @@
+#include "Profiler.hpp"
+
+#if FIT2GO_PROFILING
+
+LatencyHistogram Profiler::histograms[(size_t)ProfileStage::COUNT];
+
+void Profiler::reset() {
+    for (LatencyHistogram& histogram : histograms)
+        histogram.reset();
+}
+
+const LatencyHistogram& Profiler::get(ProfileStage stage) {
+    return histograms[(size_t)stage];
+}
+
+const char* Profiler::stageName(ProfileStage stage) {
+    switch (stage) {
+        case ProfileStage::PULSE_ISR:             return "pulse_isr";
+        case ProfileStage::METRICS_UPDATE:        return "metrics_update";
+        case ProfileStage::STATE_IDLE:            return "state_idle";
+        case ProfileStage::STATE_TRACKING:        return "state_tracking";
+        case ProfileStage::STATE_STOPPING:        return "state_stopping";
+        case ProfileStage::STATE_WIFI_SETUP:      return "state_wifi_setup";
+        case ProfileStage::STATE_WIFI_CONNECTING: return "state_wifi_connecting";
+        case ProfileStage::STATE_WIFI_SCANNING:   return "state_wifi_scanning";
+        case ProfileStage::STATE_AP_CONFIG:       return "state_ap_config";
+        case ProfileStage::DISPLAY_UPDATE:        return "display_update";
+        case ProfileStage::PUBLISH_DNS:           return "publish_dns";
+        case ProfileStage::PUBLISH_CONNECT:       return "publish_connect";
+        case ProfileStage::PUBLISH_TLS:           return "publish_tls";
+        case ProfileStage::PUBLISH_SEND:          return "publish_send";
+        case ProfileStage::PUBLISH_RESPONSE:      return "publish_response";
+        case ProfileStage::SD_WRITE:              return "sd_write";
+        default:                                  return "?";
+    }
+}
+
+void Profiler::report(Print& out) {
+    out.printf("%-22s %10s %10s %10s %10s  (us @ %u MHz)\n", "stage", "count", "p50", "p99", "max", PROFILE_CPU_MHZ);
+    for (size_t i = 0; i < (size_t)ProfileStage::COUNT; i++) {
+        const LatencyHistogram& histogram = histograms[i];
+        if (histogram.getCount() == 0)
+            continue;
+        out.printf("%-22s %10u %10.1f %10.1f %10.1f\n", stageName((ProfileStage)i), histogram.getCount(),
+                   histogram.percentile(500) / (float)PROFILE_CPU_MHZ,
+                   histogram.percentile(990) / (float)PROFILE_CPU_MHZ,
+                   histogram.getMax() / (float)PROFILE_CPU_MHZ);
+    }
+}
+
+#endif // FIT2GO_PROFILING
@@ -0,0 +1,166 @@
+#include "PublishScheduler.hpp"
+#include <math.h>
+
+// --- スケジューラ内部パラメータ ---
+static const float RPM_RATE_FULL_SCALE = 20.0f;   // この変化率(rpm/s)以上で最短間隔
+static const float SPEED_RATE_FULL_SCALE = 5.0f;  // この変化率(km/h/s)以上で最短間隔
+static const float ACTIVITY_DECAY_MS = 3000.0f;   // 変化率EMAの減衰時定数 (上昇は即時)
+static const float RTT_EMA_ALPHA = 0.125f;        // RTT平滑化係数 (TCPのSRTTと同じ)
+static const float PAYLOAD_EMA_ALPHA = 0.2f;      // ペイロードサイズ平滑化係数
+static const float RTT_HEADROOM = 1.5f;           // 送信間隔はRTTのこの倍率以上空ける
+static const float BUDGET_BURST_SEC = 2.0f;       // トークンバケットの容量 (予算の秒数分)
+
+PublishScheduler::PublishScheduler() :
+    minIntervalMs(0),
+    heartbeatMs(0),
+    budgetBytesPerSec(0),
+    lastObserveMs(0),
+    lastPublishMs(0),
+    lastRefillMs(0),
+    lastRpm(0.0f),
+    lastSpeedKmh(0.0f),
+    activity(0.0f),
+    smoothedRttMs(0.0f),
+    avgPayloadBytes(0.0f),
+    tokens(0.0f),
+    hasObservation(false),
+    hasPublished(false)
+{}
+
+void PublishScheduler::begin(unsigned long minInterval, unsigned long heartbeat, uint32_t budget) {
+    minIntervalMs = minInterval;
+    heartbeatMs = heartbeat > minInterval ? heartbeat : minInterval;
+    budgetBytesPerSec = budget;
+    activity = 0.0f;
+    smoothedRttMs = 0.0f;
+    avgPayloadBytes = 0.0f;
+    tokens = budgetBytesPerSec * BUDGET_BURST_SEC; // 最初は満タン
+    hasObservation = false;
+    hasPublished = false;
+}
+
+void PublishScheduler::observe(uint64_t nowMs, float rpm, float speedKmh) {
+    if (!hasObservation) {
+        lastObserveMs = nowMs;
+        lastRpm = rpm;
+        lastSpeedKmh = speedKmh;
+        hasObservation = true;
+        return;
+    }
+    unsigned long dt = (unsigned long)(nowMs - lastObserveMs);
+    if (dt == 0)
+        return;
+
+    // 単位時間あたりの変化量を正規化 (1.0 で最短間隔に張り付く)
+    float rpmRate = fabsf(rpm - lastRpm) * 1000.0f / dt;
+    float speedRate = fabsf(speedKmh - lastSpeedKmh) * 1000.0f / dt;
+    float instant = rpmRate / RPM_RATE_FULL_SCALE;
+    if (speedRate / SPEED_RATE_FULL_SCALE > instant)
+        instant = speedRate / SPEED_RATE_FULL_SCALE;
+    if (instant > 1.0f)
+        instant = 1.0f;
+
+    // 急変には即座に追従し、定常に戻るときはゆっくり減衰させる
+    if (instant > activity) {
+        activity = instant;
+    } else {
+        float alpha = dt / (dt + ACTIVITY_DECAY_MS);
+        activity += (instant - activity) * alpha;
+    }
+
+    lastObserveMs = nowMs;
+    lastRpm = rpm;
+    lastSpeedKmh = speedKmh;
+}
+
+unsigned long PublishScheduler::msUntilDue(uint64_t nowMs) const {
+    if (!hasPublished)
+        return 0;
+    uint64_t elapsed = nowMs - lastPublishMs;
+    unsigned long interval = getTargetIntervalMs();
+    unsigned long remaining = elapsed < interval ? (unsigned long)(interval - elapsed) : 0;
+    // 予算が足りない分は、トークンが貯まるまでの時間を待つ
+    if (budgetBytesPerSec > 0) {
+        float projected = tokens + budgetBytesPerSec * (float)(nowMs - lastRefillMs) / 1000.0f;
+        if (projected < avgPayloadBytes) {
+            unsigned long refillMs = (unsigned long)((avgPayloadBytes - projected) * 1000.0f / budgetBytesPerSec) + 1;
+            if (refillMs > remaining)
+                remaining = refillMs;
+        }
+    }
+    return remaining;
+}
+
+void PublishScheduler::refillTokens(uint64_t nowMs) {
+    if (budgetBytesPerSec == 0)
+        return; // 予算なし = 無制限
+    float capacity = budgetBytesPerSec * BUDGET_BURST_SEC;
+    if (capacity < avgPayloadBytes)
+        capacity = avgPayloadBytes; // 1回分は必ず貯められるようにする
+    tokens += budgetBytesPerSec * (float)(nowMs - lastRefillMs) / 1000.0f;
+    if (tokens > capacity)
+        tokens = capacity;
+    lastRefillMs = nowMs;
+}
+
+unsigned long PublishScheduler::getTargetIntervalMs() const {
+    // 変化が大きいほど最短間隔に近づける (対数補間: 小さな変化でも素早く間隔が縮む)
+    float interval = heartbeatMs;
+    if (minIntervalMs > 0)
+        interval = heartbeatMs * powf((float)minIntervalMs / heartbeatMs, activity);
+
+    // リンクが運べる以上には詰めない (RTTにヘッドルームを乗せた値が下限)
+    float rttFloor = smoothedRttMs * RTT_HEADROOM;
+    if (interval < rttFloor)
+        interval = rttFloor;
+
+    // 平均ペイロードを帯域予算で割った値も下限
+    if (budgetBytesPerSec > 0) {
+        float budgetFloor = avgPayloadBytes * 1000.0f / budgetBytesPerSec;
+        if (interval < budgetFloor)
+            interval = budgetFloor;
+    }
+    return (unsigned long)interval;
+}
+
+bool PublishScheduler::shouldPublish(uint64_t nowMs) {
+    if (!hasPublished) {
+        lastRefillMs = nowMs;
+        return true; // 初回は即送信
+    }
+    refillTokens(nowMs);
+    if (nowMs - lastPublishMs < getTargetIntervalMs())
+        return false;
+    // 予算が足りなければハートビートであっても待つ
+    if (budgetBytesPerSec > 0 && tokens < avgPayloadBytes)
+        return false;
+    return true;
+}
+
+void PublishScheduler::onPublished(uint64_t nowMs, size_t payloadBytes, unsigned long rttMs) {
+    refillTokens(nowMs);
+    if (budgetBytesPerSec > 0)
+        tokens -= payloadBytes; // 失敗しても電波は使っているので消費する
+
+    if (avgPayloadBytes == 0.0f)
+        avgPayloadBytes = payloadBytes;
+    else
+        avgPayloadBytes += (payloadBytes - avgPayloadBytes) * PAYLOAD_EMA_ALPHA;
+
+    // タイムアウトも含めて、実際にかかった時間をRTTとして扱う
+    if (smoothedRttMs == 0.0f)
+        smoothedRttMs = rttMs;
+    else
+        smoothedRttMs += (rttMs - smoothedRttMs) * RTT_EMA_ALPHA;
+
+    lastPublishMs = nowMs;
+    hasPublished = true;
+}
+
+unsigned long PublishScheduler::getSmoothedRttMs() const {
+    return (unsigned long)smoothedRttMs;
+}
+
+float PublishScheduler::getActivity() const {
+    return activity;
+}
@@ -4,37 +4,105 @@
 #include "esp_err.h"
 #include "soc/pcnt_struct.h" // ★ PCNTレジスタ定義ヘッダー (int_clrアクセス用)
 #include "driver/gpio.h"
+#include "esp_timer.h"
+#include "MetricRegistry.hpp"
+#include "Profiler.hpp"
+#include "Trace.hpp"
 
-// staticメンバー変数の実体定義と初期化
-volatile unsigned long PulseCounter::pulseCountSoftware = 0;
-volatile unsigned long PulseCounter::lastPulseTimestamp = 0;
+// staticメンバー変数の実体定義と初期化 (channels は静的領域なので0で始まる)
+PulseCounter::ChannelState PulseCounter::channels[PULSE_MAX_CHANNELS];
+std::atomic<uint32_t> PulseCounter::activeUnitMask(0);
+pcnt_isr_handle_t PulseCounter::isrHandle = NULL;
+portMUX_TYPE PulseCounter::writeMux = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t volatile PulseCounter::notifyTask = NULL;
 volatile bool PulseCounter::led_state = false;
 
 static const char *TAG_PCNT = "PulseCounter"; // ログ用タグ
+static const uint32_t PCNT_STATUS_THRES1 = PCNT_EVT_THRES_1; // status_unit レジスタのしきい値1到達ビット
+static MetricCounter pulseInterrupts("fit2go_pulse_interrupts_total", "PCNT interrupts handled (all channels).");
 
-PulseCounter::PulseCounter(int pulse_pin) :
+PulseCounter::PulseCounter(int pulse_pin, uint8_t channel, uint16_t filter) :
     pulsePin(pulse_pin),
-    pcntUnit(PCNT_UNIT),
+    channel(channel),
+    filterValue(filter),
+    pcntUnit((pcnt_unit_t)(PCNT_UNIT + channel)),
     pcntChannel(PCNT_CHANNEL)
 {}
 
+// 全チャンネル共通のISR
+// 割り込み状態レジスタを1回読み、ビットの立っているユニットだけを処理する。止まっているチャンネルには触れない
 void IRAM_ATTR PulseCounter::pcnt_intr_handler(void *arg) {
-    uint32_t status = 0;
-    pcnt_get_event_status(PCNT_UNIT, &status);
-    led_state = !led_state;
-    gpio_set_level((gpio_num_t)DEBUG_LED_PIN, led_state);
-
-    if (status & PCNT_EVT_THRES_1) {
-        pulseCountSoftware++;
-        lastPulseTimestamp = millis();
+    PROFILE_SCOPE(ProfileStage::PULSE_ISR);
+    uint32_t pending = PCNT.int_st.val & activeUnitMask.load(std::memory_order_relaxed);
+    if (pending == 0)
+        return;
+    TRACE_ISR(TraceEvent::PULSE, pending);
+    pulseInterrupts.increment();
+    int64_t nowUs = esp_timer_get_time(); // 同時に来たパルスは同じ時刻とする
+    bool pulsed = false;
+    for (uint32_t bits = pending; bits != 0; bits &= bits - 1) {
+        uint32_t unit = __builtin_ctz(bits);
+        if (PCNT.status_unit[unit].val & PCNT_STATUS_THRES1) {
+            recordPulse(channels[unit - PCNT_UNIT], nowUs);
+            pulsed = true;
+        }
     }
-    PCNT.int_clr.val = (1 << PCNT_UNIT);
+    PCNT.int_clr.val = pending;
+
+    if (pulsed) {
+        led_state = !led_state;
+        gpio_set_level((gpio_num_t)DEBUG_LED_PIN, led_state);
+        // 計測タスクを起こす (ポーリングせずにパルス直後に計算させる)。何チャンネル分でも通知は1回
+        TaskHandle_t task = notifyTask;
+        if (task != NULL) {
+            BaseType_t higherPriorityTaskWoken = pdFALSE;
+            vTaskNotifyGiveFromISR(task, &higherPriorityTaskWoken);
+            if (higherPriorityTaskWoken == pdTRUE) {
+                portYIELD_FROM_ISR();
+            }
+        }
+    }
+}
+
+// 1チャンネル分のパルスを記録する (ISRから)
+void IRAM_ATTR PulseCounter::recordPulse(ChannelState& ch, int64_t nowUs) {
+    // 書き手同士 (ISR と resetPulseCount) の排他。読み手はここで止まらない
+    portENTER_CRITICAL_ISR(&writeMux);
+    ch.seqLock.beginWrite();
+    ch.pulseCountSoftware.store(ch.pulseCountSoftware.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    int64_t elapsedUs = ch.lastPulseUs > 0 ? nowUs - ch.lastPulseUs : 0;
+    uint32_t periodUs = elapsedUs < (int64_t)UINT32_MAX ? (uint32_t)elapsedUs : UINT32_MAX; // 約71分以上空いたら飽和
+    ch.lastPulsePeriodUs.store(periodUs, std::memory_order_relaxed);
+    uint64_t nowMs = (uint64_t)nowUs / 1000; // SystemClock::nowMs() と同じ時間軸
+    ch.lastPulseMs.store(nowMs);
+    ch.lastPulseUs = nowUs;
+    ch.seqLock.endWrite();
+    portEXIT_CRITICAL_ISR(&writeMux);
+
+    // 間隔を待ち行列へ (一杯なら新しい方を捨てる。読み手の位置はISRから動かさない)
+    uint32_t head = ch.periodHead.load(std::memory_order_relaxed);
+    if (head - ch.periodTail.load(std::memory_order_acquire) < PULSE_PERIOD_RING_SIZE) {
+        ch.periodRing[head % PULSE_PERIOD_RING_SIZE] = periodUs;
+        ch.periodHead.store(head + 1, std::memory_order_release);
+    } else {
+        ch.periodOverruns.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint8_t PulseCounter::getChannel() const {
+    return channel;
+}
+
+int PulseCounter::getPin() const {
+    return pulsePin;
 }
 
 bool PulseCounter::begin() {
-    ESP_LOGI(TAG_PCNT, "Initializing PCNT for GPIO %d", pulsePin);
-    pcnt_isr_service_uninstall();
-    ESP_LOGI(TAG_PCNT, "Attempted to uninstall existing ISR service.");
+    ESP_LOGI(TAG_PCNT, "Initializing PCNT unit %d (channel %u) for GPIO %d", pcntUnit, channel, pulsePin);
+    if (channel >= PULSE_MAX_CHANNELS || pcntUnit >= PCNT_UNIT_MAX) {
+        ESP_LOGE(TAG_PCNT, "Channel %u is out of range.", channel);
+        return false;
+    }
 
     // --- GPIO設定 ---
     gpio_config_t io_conf;
@@ -50,19 +118,21 @@ bool PulseCounter::begin() {
     }
     ESP_LOGI(TAG_PCNT, "GPIO %d configured as INPUT PULLUP", pulsePin);
 
-    gpio_config_t debug_led_io_conf;
-    debug_led_io_conf.intr_type = GPIO_INTR_DISABLE;
-    debug_led_io_conf.mode = GPIO_MODE_OUTPUT;
-    debug_led_io_conf.pin_bit_mask = (1ULL << DEBUG_LED_PIN);
-    debug_led_io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
-    debug_led_io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
-    err = gpio_config(&debug_led_io_conf);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG_PCNT, "Debug LED GPIO config failed: %s", esp_err_to_name(err));
-        // Continue even if LED fails
-    } else {
-        ESP_LOGI(TAG_PCNT, "Debug LED GPIO %d configured as OUTPUT", DEBUG_LED_PIN);
-        gpio_set_level((gpio_num_t)DEBUG_LED_PIN, 0); // 初期状態はOFF
+    if (channel == 0) { // デバッグLEDは1回だけ設定する
+        gpio_config_t debug_led_io_conf;
+        debug_led_io_conf.intr_type = GPIO_INTR_DISABLE;
+        debug_led_io_conf.mode = GPIO_MODE_OUTPUT;
+        debug_led_io_conf.pin_bit_mask = (1ULL << DEBUG_LED_PIN);
+        debug_led_io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+        debug_led_io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+        err = gpio_config(&debug_led_io_conf);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG_PCNT, "Debug LED GPIO config failed: %s", esp_err_to_name(err));
+            // Continue even if LED fails
+        } else {
+            ESP_LOGI(TAG_PCNT, "Debug LED GPIO %d configured as OUTPUT", DEBUG_LED_PIN);
+            gpio_set_level((gpio_num_t)DEBUG_LED_PIN, 0); // 初期状態はOFF
+        }
     }
 
     // --- PCNT設定 ---
@@ -85,21 +155,23 @@ bool PulseCounter::begin() {
     }
 
     // --- PCNTフィルタ設定 ---
-    pcnt_set_filter_value(pcntUnit, PCNT_FILTER_VALUE);
+    pcnt_set_filter_value(pcntUnit, filterValue);
     pcnt_filter_enable(pcntUnit);
-    ESP_LOGI(TAG_PCNT, "PCNT filter enabled with value %d", PCNT_FILTER_VALUE);
+    ESP_LOGI(TAG_PCNT, "PCNT filter enabled with value %d", filterValue);
 
     // --- PCNT割り込み設定 ---
     pcnt_counter_pause(pcntUnit);
     pcnt_counter_clear(pcntUnit);
 
-    // ISRサービスをインストール (まだなら)
-    err = pcnt_isr_service_install(0);
-     if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
-        ESP_LOGE(TAG_PCNT, "PCNT ISR service install failed: %s", esp_err_to_name(err));
-        return false;
-    } else {
-        ESP_LOGI(TAG_PCNT, "PCNT ISR service installed or already present.");
+    // 共有ISRを登録 (まだなら)。ユニットごとのハンドラを呼び分けるISRサービスは使わない
+    // (サービスは毎回全ユニットを調べるので、チャンネルを増やすとパルスごとの処理が増える)
+    if (isrHandle == NULL) {
+        err = pcnt_isr_register(PulseCounter::pcnt_intr_handler, NULL, 0, &isrHandle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG_PCNT, "PCNT ISR register failed: %s", esp_err_to_name(err));
+            return false;
+        }
+        ESP_LOGI(TAG_PCNT, "Shared PCNT ISR registered.");
     }
 
     // 割り込みイベント (しきい値1到達)
@@ -111,45 +183,79 @@ bool PulseCounter::begin() {
     pcnt_intr_enable(pcntUnit);
     ESP_LOGI(TAG_PCNT, "PCNT interrupt capability enabled.");
 
-    // ISRハンドラをPCNTユニットに登録
-    // ★★★ 引数を修正 (最後のハンドルポインタを削除) ★★★
-    pcnt_isr_handler_remove(pcntUnit);
-    ESP_LOGI(TAG_PCNT, "Attempted to remove existing ISR handler.");
-    err = pcnt_isr_handler_add(pcntUnit, PulseCounter::pcnt_intr_handler, NULL);
-     if (err != ESP_OK) {
-        ESP_LOGE(TAG_PCNT, "PCNT ISR handler add failed: %s", esp_err_to_name(err));
-        // 失敗したらサービスもアンインストールした方が良いかも
-        pcnt_isr_service_uninstall();
-        return false;
-    }
-    ESP_LOGI(TAG_PCNT, "PCNT ISR handler added successfully.");
+    activeUnitMask.fetch_or(1UL << pcntUnit); // ISRがこのユニットを見るようにする
 
     pcnt_counter_resume(pcntUnit); // カウント再開
     ESP_LOGI(TAG_PCNT, "PCNT setup complete.");
     return true;
 }
 
+void PulseCounter::end() {
+    if (channel >= PULSE_MAX_CHANNELS || pcntUnit >= PCNT_UNIT_MAX)
+        return;
+    activeUnitMask.fetch_and(~(1UL << pcntUnit)); // 先に外す (止めている間に来た割り込みは無視される)
+    pcnt_intr_disable(pcntUnit);
+    pcnt_event_disable(pcntUnit, PCNT_EVT_THRES_1);
+    pcnt_counter_pause(pcntUnit);
+    pcnt_counter_clear(pcntUnit);
+    resetPulseCount();
+    ChannelState& ch = state();
+    ch.periodTail.store(ch.periodHead.load(std::memory_order_acquire), std::memory_order_release);
+    ESP_LOGI(TAG_PCNT, "PCNT unit %d (channel %u) stopped.", pcntUnit, channel);
+}
+
+// シーケンスロックで一貫した値を読む
+PulseSnapshot PulseCounter::snapshot() const {
+    const ChannelState& ch = state();
+    PulseSnapshot snap;
+    uint32_t start;
+    do {
+        start = ch.seqLock.beginRead();
+        snap.count = ch.pulseCountSoftware.load(std::memory_order_relaxed);
+        snap.lastPulseMs = ch.lastPulseMs.load();
+        snap.periodUs = ch.lastPulsePeriodUs.load(std::memory_order_relaxed);
+    } while (ch.seqLock.retryRead(start)); // 書き込み中 or 読んでいる間に書き換わった
+    return snap;
+}
+
+void PulseCounter::setNotifyTask(TaskHandle_t task) {
+    notifyTask = task;
+}
+
 unsigned long PulseCounter::getPulseCount() {
-    noInterrupts();
-    unsigned long count = pulseCountSoftware;
-    interrupts();
-    return count;
+    return snapshot().count;
 }
 
-unsigned long PulseCounter::getLastPulseTime() {
-    noInterrupts();
-    unsigned long timestamp = lastPulseTimestamp;
-    interrupts();
-    return timestamp;
+uint64_t PulseCounter::getLastPulseTime() {
+    return snapshot().lastPulseMs;
 }
 
 void PulseCounter::resetPulseCount() {
-    noInterrupts();
-    pulseCountSoftware = 0;
-    lastPulseTimestamp = 0;
-    interrupts();
+    ChannelState& ch = state();
+    portENTER_CRITICAL(&writeMux);
+    ch.seqLock.beginWrite();
+    ch.pulseCountSoftware.store(0, std::memory_order_relaxed);
+    ch.lastPulseMs.store(0);
+    ch.lastPulsePeriodUs.store(0, std::memory_order_relaxed);
+    ch.lastPulseUs = 0;
+    ch.seqLock.endWrite();
+    portEXIT_CRITICAL(&writeMux);
     /* pcnt_counter_pause(pcntUnit);
     pcnt_counter_clear(pcntUnit);
     pcnt_counter_resume(pcntUnit); */
     ESP_LOGI(TAG_PCNT, "Software and Hardware pulse counters reset.");
-}
\ No newline at end of file
+}
+
+bool PulseCounter::popPeriod(uint32_t& periodUs) {
+    ChannelState& ch = state();
+    uint32_t tail = ch.periodTail.load(std::memory_order_relaxed);
+    if (tail == ch.periodHead.load(std::memory_order_acquire))
+        return false;
+    periodUs = ch.periodRing[tail % PULSE_PERIOD_RING_SIZE];
+    ch.periodTail.store(tail + 1, std::memory_order_release);
+    return true;
+}
+
+uint32_t PulseCounter::getPeriodOverruns() const {
+    return state().periodOverruns.load(std::memory_order_relaxed);
+}
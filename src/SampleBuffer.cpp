@@ -0,0 +1,232 @@
+#include "SampleBuffer.hpp"
+
+SampleBuffer::SampleBuffer() {
+    clear();
+}
+
+void SampleBuffer::clear() {
+    for (RiceState& state : rice)
+        state = RiceState();
+    oldestBlock = 0;
+    blockCount = 0;
+    sampleCount = 0;
+    droppedSamples = 0;
+    last = Sample();
+    lastTimeDelta = 0;
+    lastPulseDelta = 0;
+}
+
+void SampleBuffer::append(const Sample& sample) {
+    if (blockCount == 0) {
+        startBlock(sample);
+        return;
+    }
+    size_t current = blockIndex(blockCount - 1);
+    uint32_t bitPos = info[current].bitLength;
+    if (bitPos + MAX_SAMPLE_BITS > BLOCK_BITS || info[current].sampleCount == UINT16_MAX) {
+        startBlock(sample); // 最悪の長さが入らなければ次のブロックへ
+        return;
+    }
+
+    uint8_t* data = blocks[current];
+    int64_t timeDelta = (int64_t)(sample.timestampMs - last.timestampMs);
+    int64_t pulseDelta = (int64_t)sample.pulses - (int64_t)last.pulses;
+    writeRice(data, bitPos, timeDelta - lastTimeDelta, rice[COLUMN_TIME]);
+    writeRice(data, bitPos, pulseDelta - lastPulseDelta, rice[COLUMN_PULSES]);
+    writeRice(data, bitPos, (int64_t)sample.rpm - (int64_t)last.rpm, rice[COLUMN_RPM]);
+    writeRice(data, bitPos, (int64_t)sample.speed - (int64_t)predictSpeed(last, sample.rpm), rice[COLUMN_SPEED]);
+    info[current].bitLength = (uint16_t)bitPos;
+    info[current].sampleCount++;
+    sampleCount++;
+
+    last = sample;
+    lastTimeDelta = timeDelta;
+    lastPulseDelta = pulseDelta;
+}
+
+// 新しいブロックを始め、先頭のサンプルは生の値で書く (一杯なら最も古いブロックを捨てる)
+void SampleBuffer::startBlock(const Sample& sample) {
+    if (blockCount == SAMPLE_BUFFER_BLOCKS) {
+        droppedSamples += releaseOldestBlock();
+    }
+    size_t current = blockIndex(blockCount);
+    blockCount++;
+    uint32_t bitPos = 0;
+    writeBits(blocks[current], bitPos, sample.timestampMs, 64);
+    writeBits(blocks[current], bitPos, sample.rpm, 16);
+    writeBits(blocks[current], bitPos, sample.speed, 16);
+    writeBits(blocks[current], bitPos, sample.pulses, 32);
+    info[current].bitLength = (uint16_t)bitPos;
+    info[current].sampleCount = 1;
+    sampleCount++;
+
+    last = sample;
+    lastTimeDelta = 0;
+    lastPulseDelta = 0;
+    for (RiceState& state : rice)
+        state = RiceState();
+}
+
+size_t SampleBuffer::releaseOldestBlock() {
+    if (blockCount == 0)
+        return 0;
+    size_t released = info[oldestBlock].sampleCount;
+    sampleCount -= released;
+    oldestBlock = (oldestBlock + 1) % SAMPLE_BUFFER_BLOCKS;
+    blockCount--;
+    return released;
+}
+
+uint32_t SampleBuffer::getSampleCount() const {
+    return sampleCount;
+}
+
+size_t SampleBuffer::getBlockCount() const {
+    return blockCount;
+}
+
+size_t SampleBuffer::getBytesUsed() const {
+    size_t bits = 0;
+    for (size_t i = 0; i < blockCount; i++)
+        bits += info[blockIndex(i)].bitLength;
+    return (bits + 7) / 8;
+}
+
+uint32_t SampleBuffer::getDroppedSamples() const {
+    return droppedSamples;
+}
+
+// 速度は RPM に比例するので、前のサンプルの比をそのまま使って予測する (RPMが0なら前の速度)
+uint16_t SampleBuffer::predictSpeed(const Sample& previous, uint16_t rpm) {
+    if (previous.rpm == 0)
+        return previous.speed;
+    uint32_t predicted = ((uint32_t)rpm * previous.speed + previous.rpm / 2) / previous.rpm;
+    return predicted > UINT16_MAX ? UINT16_MAX : (uint16_t)predicted;
+}
+
+// 上位ビットから順に詰める
+void SampleBuffer::writeBits(uint8_t* data, uint32_t& bitPos, uint64_t value, uint8_t width) {
+    for (int bit = width - 1; bit >= 0; bit--) {
+        uint32_t byte = bitPos >> 3;
+        uint8_t mask = (uint8_t)(0x80 >> (bitPos & 7));
+        if ((value >> bit) & 1)
+            data[byte] |= mask;
+        else
+            data[byte] &= (uint8_t)~mask;
+        bitPos++;
+    }
+}
+
+uint64_t SampleBuffer::readBits(const uint8_t* data, uint32_t& bitPos, uint8_t width) {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < width; i++) {
+        value = (value << 1) | ((data[bitPos >> 3] >> (7 - (bitPos & 7))) & 1);
+        bitPos++;
+    }
+    return value;
+}
+
+// 値の大きさに合わせて k を選ぶ (JPEG-LS と同じ: 平均 ≒ 2^k)。列ごとの直近の平均を追う
+uint8_t SampleBuffer::RiceState::k() const {
+    uint8_t bits = 0;
+    while (((uint32_t)count << bits) < sum && bits < 32)
+        bits++;
+    return bits;
+}
+
+void SampleBuffer::RiceState::update(uint64_t zigzag) {
+    sum += zigzag < RICE_SUM_CAP ? (uint32_t)zigzag : RICE_SUM_CAP;
+    count++;
+    if (count >= RICE_RESET_COUNT) { // 古い値の重みを半分にして、ペースの変化に追従する
+        sum >>= 1;
+        count >>= 1;
+    }
+}
+
+// 符号付きの値を zigzag で0以上にし、Rice 符号 (商を unary、余りを k ビット) で書く
+// 商が RICE_ESCAPE 以上になる大きな値は、RICE_ESCAPE 個の1の後に64ビットそのまま
+void SampleBuffer::writeRice(uint8_t* data, uint32_t& bitPos, int64_t value, RiceState& state) {
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    uint8_t k = state.k();
+    uint64_t quotient = zigzag >> k;
+    if (quotient < RICE_ESCAPE) {
+        for (uint64_t i = 0; i < quotient; i++)
+            writeBits(data, bitPos, 1, 1);
+        writeBits(data, bitPos, 0, 1);
+        writeBits(data, bitPos, zigzag, k);
+    } else {
+        for (uint8_t i = 0; i < RICE_ESCAPE; i++)
+            writeBits(data, bitPos, 1, 1);
+        writeBits(data, bitPos, zigzag, 64);
+    }
+    state.update(zigzag);
+}
+
+int64_t SampleBuffer::readRice(const uint8_t* data, uint32_t& bitPos, RiceState& state) {
+    uint8_t k = state.k();
+    uint64_t quotient = 0;
+    while (quotient < RICE_ESCAPE && readBits(data, bitPos, 1) == 1)
+        quotient++;
+    uint64_t zigzag;
+    if (quotient < RICE_ESCAPE)
+        zigzag = (quotient << k) | readBits(data, bitPos, k);
+    else
+        zigzag = readBits(data, bitPos, 64);
+    state.update(zigzag);
+    return (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+}
+
+
+// --- 読み手 ---
+
+SampleBuffer::Reader::Reader(const SampleBuffer& buffer) :
+    buffer(buffer),
+    blockOffset(0),
+    blocksDone(0),
+    sampleInBlock(0),
+    bitPos(0),
+    previousTimeDelta(0),
+    previousPulseDelta(0)
+{}
+
+bool SampleBuffer::Reader::next(Sample& out) {
+    while (blockOffset < buffer.blockCount) {
+        size_t block = buffer.blockIndex(blockOffset);
+        const BlockInfo& blockInfo = buffer.info[block];
+        const uint8_t* data = buffer.blocks[block];
+        if (sampleInBlock >= blockInfo.sampleCount) {
+            // このブロックは読み終えた。書き込み中の最新ブロックは、後で追加された分を読めるよう位置を残す
+            if (blockOffset + 1 == buffer.blockCount)
+                return false;
+            blockOffset++;
+            blocksDone++;
+            sampleInBlock = 0;
+            bitPos = 0;
+            continue;
+        }
+
+        if (sampleInBlock == 0) {
+            out.timestampMs = readBits(data, bitPos, 64);
+            out.rpm = (uint16_t)readBits(data, bitPos, 16);
+            out.speed = (uint16_t)readBits(data, bitPos, 16);
+            out.pulses = (uint32_t)readBits(data, bitPos, 32);
+            previousTimeDelta = 0;
+            previousPulseDelta = 0;
+            for (RiceState& state : rice)
+                state = RiceState();
+        } else {
+            int64_t timeDelta = previousTimeDelta + readRice(data, bitPos, rice[COLUMN_TIME]);
+            int64_t pulseDelta = previousPulseDelta + readRice(data, bitPos, rice[COLUMN_PULSES]);
+            out.timestampMs = previous.timestampMs + (uint64_t)timeDelta;
+            out.pulses = (uint32_t)((int64_t)previous.pulses + pulseDelta);
+            out.rpm = (uint16_t)((int64_t)previous.rpm + readRice(data, bitPos, rice[COLUMN_RPM]));
+            out.speed = (uint16_t)((int64_t)predictSpeed(previous, out.rpm) + readRice(data, bitPos, rice[COLUMN_SPEED]));
+            previousTimeDelta = timeDelta;
+            previousPulseDelta = pulseDelta;
+        }
+        previous = out;
+        sampleInBlock++;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,64 @@
+#include "SessionSummary.hpp"
+
+SessionSummaryBuilder::SessionSummaryBuilder() :
+    open(false),
+    startMs(0),
+    pulses(0),
+    rpmSamples(0),
+    milliRpmSum(0),
+    milliRpmMsSum(0),
+    weightedMs(0),
+    maxMilliRpm(0)
+{}
+
+void SessionSummaryBuilder::start(uint64_t sessionStartMs) {
+    open = true;
+    startMs = sessionStartMs;
+    pulses = 0;
+    rpmSamples = 0;
+    milliRpmSum = 0;
+    milliRpmMsSum = 0;
+    weightedMs = 0;
+    maxMilliRpm = 0;
+}
+
+bool SessionSummaryBuilder::isOpen() const {
+    return open;
+}
+
+void SessionSummaryBuilder::addInterval(uint32_t intervalMs, uint32_t milliRpm, uint32_t intervalPulses, bool active) {
+    if (!open)
+        return;
+    pulses += intervalPulses;
+    if (!active)
+        return;
+    rpmSamples++;
+    milliRpmSum += milliRpm;
+    milliRpmMsSum += (uint64_t)milliRpm * intervalMs;
+    weightedMs += intervalMs;
+    if (milliRpm > maxMilliRpm)
+        maxMilliRpm = milliRpm;
+}
+
+SessionSummary SessionSummaryBuilder::finish(uint64_t endMs, const MetricsAccumulator::Totals& sessionTotals,
+                                             const CadenceAnalysis& cadence) {
+    SessionSummary summary;
+    summary.startMs = startMs;
+    summary.activeTimeMs = sessionTotals.timeMs;
+    // タイマーは最後のパルスの少し後まで動くので、終了はそこまで延ばす (終了 - 開始 >= 動作時間 になるように)
+    uint64_t timedEndMs = startMs + summary.activeTimeMs;
+    summary.endMs = endMs > timedEndMs ? endMs : timedEndMs;
+    summary.distanceUm = sessionTotals.distanceUm;
+    summary.caloriesMcal = sessionTotals.caloriesMcal;
+    summary.pulses = pulses;
+    // 割り算は最後に1回だけ (float にするのも最後)
+    summary.avgRpm = rpmSamples > 0 ? (float)(milliRpmSum / rpmSamples) * 0.001f : 0.0f;
+    summary.maxRpm = maxMilliRpm * 0.001f;
+    summary.timeWeightedRpm = weightedMs > 0 ? (float)(milliRpmMsSum / weightedMs) * 0.001f : 0.0f;
+    for (size_t i = 0; i < CADENCE_ZONE_COUNT; i++)
+        summary.zoneMs[i] = cadence.zoneMs[i];
+    summary.workIntervals = cadence.workIntervals;
+    summary.boundaries = cadence.boundaries;
+    open = false;
+    return summary;
+}
@@ -1,14 +1,30 @@
 #include "Storage.hpp"
 #include <M5Stack.h> // Serial用
+#include "MetricsAccumulator.hpp" // 距離・カロリーの単位換算
+#include "PayloadEncoder.hpp"     // セッション要約の1行 (送信する session_end と同じ形)
+#include "MetricRegistry.hpp"
+#include "Profiler.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
 
 // ★ getCurrentTimestampMs 関数のプロトタイプ宣言 (main.cpp で定義) ★
 // これにより、Storage.cpp 内からこの関数を呼び出せるようになる
 extern uint64_t getCurrentTimestampMs();
 
+// /metrics 用 (書き込みタスクのキュー経由の分だけ数える)
+static MetricHistogram sdWriteDuration("fit2go_sd_write_duration_seconds", "Time spent on one queued SD card write.",
+                                       METRIC_SD_WRITE_BUCKETS_US, METRIC_SD_WRITE_BUCKET_COUNT);
+static MetricCounter sdWriteFailures("fit2go_sd_write_failures_total", "Queued SD card writes that failed.");
+static MetricCounter sdWritesDropped("fit2go_sd_writes_dropped_total", "SD card write requests dropped because the queue was full.");
+
 Storage::Storage() : 
     sdCardOk(false),
     configLoaded(false),
-    drive_type(DriveType::TIMER_DRIVEN)
+    drive_type(DriveType::TIMER_DRIVEN),
+    pulseChannels(1),
+    writeQueue(nullptr),
+    droppedWrites(0),
+    pendingSessionHeld(false)
 {}
 
 // begin
@@ -20,6 +36,9 @@ bool Storage::begin() {
         Serial.printf("NVS Initialized OK. Namespace: %s\n", NVS_NAMESPACE);
         preferences.end();
     }
+    if (writeQueue == nullptr) {
+        writeQueue = xQueueCreate(STORAGE_QUEUE_DEPTH, sizeof(WriteRequest));
+    }
     sdCardOk = SD.begin(TFCARD_CS_PIN, SPI, 40000000);
     if (!sdCardOk) {
         Serial.println("SD Card Mount Failed!");
@@ -65,7 +84,7 @@ String Storage::readFileContent(const char* path) {
 // JSONファイルを読み込み、パースして結果をメンバー変数に格納
 bool Storage::loadConfigFromJson() {
     configLoaded = false;
-    endpointUrlFromJson = "";
+    endpoints.clear();
     wifiCredentials.clear();
 
     if (!sdCardOk) return false;
@@ -101,12 +120,88 @@ bool Storage::loadConfigFromJson() {
             drive_type = DriveType::TIMER_DRIVEN;
     }
 
-    // エンドポイントURL
+    // ケイデンス推定 (省略時は config.hpp の既定値)
+    if (doc["cadence"].is<JsonObject>()) {
+        JsonObject cadence = doc["cadence"].as<JsonObject>();
+        if (cadence["enabled"].is<bool>())
+            cadenceConfig.enabled = cadence["enabled"].as<bool>();
+        if (cadence["window"].is<unsigned int>())
+            cadenceConfig.window = (uint8_t)min(cadence["window"].as<unsigned int>(), (unsigned int)CADENCE_MAX_WINDOW);
+        if (cadence["response_ms"].is<unsigned long>())
+            cadenceConfig.responseMs = cadence["response_ms"].as<unsigned long>();
+        if (cadence["hampel_k"].is<float>())
+            cadenceConfig.hampelK = cadence["hampel_k"].as<float>();
+        Serial.printf("Cadence: %s, window %u, response %lu ms, k %.1f\n", cadenceConfig.enabled ? "on" : "off",
+                      cadenceConfig.window, (unsigned long)cadenceConfig.responseMs, cadenceConfig.hampelK);
+    }
+
+    // 入力チャンネル (1台で複数の椅子を数える場合)。省略時は PULSE_INPUT_PIN の1チャンネル
+    if (doc["channels"].is<JsonArray>()) {
+        std::vector<PulseChannelConfig> parsed;
+        for (JsonObject entry : doc["channels"].as<JsonArray>()) {
+            if (parsed.size() >= PULSE_MAX_CHANNELS) {
+                Serial.printf("Warning: Only %d channels are supported. Ignoring the rest.\n", (int)PULSE_MAX_CHANNELS);
+                break;
+            }
+            if (!entry || !entry["pin"].is<int>()) {
+                Serial.println("Warning: Invalid channel entry format in JSON.");
+                continue;
+            }
+            PulseChannelConfig channel;
+            channel.pin = entry["pin"].as<int>();
+            if (entry["filter"].is<unsigned int>())
+                channel.filter = (uint16_t)min(entry["filter"].as<unsigned int>(), 1023u);
+            parsed.push_back(channel);
+            Serial.printf("Channel %d: GPIO %d, filter %u\n", (int)parsed.size() - 1, channel.pin, channel.filter);
+        }
+        if (!parsed.empty())
+            pulseChannels = parsed;
+    }
+
+    // エンドポイントURL (従来の単一指定)
     if (doc["endpoint_url"].is<const char*>()) {
-        endpointUrlFromJson = doc["endpoint_url"].as<String>();
-        Serial.printf("Endpoint URL from JSON: %s\n", endpointUrlFromJson.c_str());
-    } else {
-        Serial.println("Warning: 'endpoint_url' not found or not a string in JSON.");
+        EndpointConfig endpoint;
+        endpoint.url = doc["endpoint_url"].as<String>();
+        endpoints.push_back(endpoint);
+        Serial.printf("Endpoint URL from JSON: %s\n", endpoint.url.c_str());
+    }
+
+    // 送信先 (配列): 形式・間隔・認証ヘッダーを送信先ごとに指定できる
+    if (doc["endpoints"].is<JsonArray>()) {
+        JsonArray endpointArray = doc["endpoints"].as<JsonArray>();
+        for (JsonObject entry : endpointArray) {
+            if (endpoints.size() >= MAX_ENDPOINTS) {
+                Serial.printf("Warning: Only %d endpoints are supported. Ignoring the rest.\n", (int)MAX_ENDPOINTS);
+                break;
+            }
+            if (!entry || !entry["url"].is<const char*>()) {
+                Serial.println("Warning: Invalid endpoint entry format in JSON.");
+                continue;
+            }
+            EndpointConfig endpoint;
+            endpoint.url = entry["url"].as<String>();
+            if (entry["format"].is<const char*>()) {
+                String format = entry["format"].as<String>();
+                if (format == "influx")
+                    endpoint.format = PayloadFormat::INFLUX_LINE;
+                else if (format == "statsd")
+                    endpoint.format = PayloadFormat::STATSD;
+                else if (format != "json")
+                    Serial.printf("Warning: Unknown format '%s'. Using json.\n", format.c_str());
+            }
+            if (entry["interval_ms"].is<unsigned long>()) {
+                endpoint.minIntervalMs = entry["interval_ms"].as<unsigned long>();
+            }
+            if (entry["auth_header"].is<const char*>()) {
+                endpoint.authHeader = entry["auth_header"].as<String>();
+            }
+            endpoints.push_back(endpoint);
+            Serial.printf("Loaded endpoint: %s (interval %lu ms)\n", endpoint.url.c_str(), endpoint.minIntervalMs);
+        }
+    }
+
+    if (endpoints.size() == 0) {
+        Serial.println("Warning: Neither 'endpoint_url' nor 'endpoints' found in JSON.");
     }
 
     // ネットワーク情報 (配列)
@@ -137,7 +232,7 @@ bool Storage::loadConfigFromJson() {
         Serial.println("Warning: 'networks' key not found or not an Array in JSON.");
     }
 
-    if (endpointUrlFromJson.length() > 0 || wifiCredentials.size() > 0) {
+    if (endpoints.size() > 0 || wifiCredentials.size() > 0) {
          Serial.println("JSON parsing finished.");
          configLoaded = true;
          return true;
@@ -159,10 +254,10 @@ bool Storage::getWifiCredential(int index, String& ssid, String& pass) {
     return true;
 }
 
-// JSONパース結果からURLを取得
-String Storage::getEndpointUrl() {
+// JSONパース結果から送信先一覧を取得
+const std::vector<EndpointConfig>& Storage::getEndpoints() const {
     // begin()でロード試行済みのはずなので、ロード状態を再チェックしない
-    return endpointUrlFromJson;
+    return endpoints;
 }
 
 // JSONパース結果のWiFi情報数を取得
@@ -175,6 +270,14 @@ DriveType Storage::getDriveType(){
     return drive_type;
 }
 
+const CadenceConfig& Storage::getCadenceConfig() const {
+    return cadenceConfig;
+}
+
+const std::vector<PulseChannelConfig>& Storage::getPulseChannels() const {
+    return pulseChannels;
+}
+
 // --- NVS 関連 (WiFi用) ---
 bool Storage::loadCredentialsFromNVS(String& ssid, String& pass) {
     if (!preferences.begin(NVS_NAMESPACE, true)) {
@@ -202,22 +305,68 @@ bool Storage::saveWiFiCredentialsToNVS(const String& ssid, const String& pass) {
      else { Serial.println("Failed to save WiFi credentials to NVS."); return false; }
 }
 
+// 入力チャンネルは PulseChannelConfig の配列をそのままバイト列で持つ (同じファームウェアの中でだけ読み書きする)
+bool Storage::loadPulseChannelsFromNVS(std::vector<PulseChannelConfig>& channels) {
+    channels.clear();
+    if (!preferences.begin(NVS_NAMESPACE, true)) {
+        Serial.println("[loadChannelsNVS] NVS begin (readOnly) failed.");
+        return false;
+    }
+    PulseChannelConfig stored[PULSE_MAX_CHANNELS];
+    size_t length = preferences.getBytesLength(NVS_KEY_PULSE_CHANNELS);
+    size_t count = 0;
+    if (length > 0 && length <= sizeof(stored) && length % sizeof(PulseChannelConfig) == 0) {
+        preferences.getBytes(NVS_KEY_PULSE_CHANNELS, stored, length);
+        count = length / sizeof(PulseChannelConfig);
+    }
+    preferences.end();
+    channels.assign(stored, stored + count);
+    return count > 0;
+}
+bool Storage::savePulseChannelsToNVS(const std::vector<PulseChannelConfig>& channels) {
+    if (channels.empty() || channels.size() > PULSE_MAX_CHANNELS)
+        return false;
+    if (!preferences.begin(NVS_NAMESPACE, false)) {
+        Serial.println("[saveChannelsNVS] NVS begin (readWrite) failed.");
+        return false;
+    }
+    size_t length = channels.size() * sizeof(PulseChannelConfig);
+    bool saved = preferences.putBytes(NVS_KEY_PULSE_CHANNELS, channels.data(), length) == length;
+    preferences.end();
+    Serial.printf(saved ? "Pulse channels saved to NVS (%u).\n" : "Failed to save pulse channels to NVS (%u).\n",
+                  (unsigned)channels.size());
+    return saved;
+}
+
 // --- 累積データ関連 (SDカード - JSON形式) ---
 
+// チャンネルごとの最新累積データのパス (チャンネル0は従来のファイル名のまま)
+void Storage::latestDataPath(uint8_t channel, char* path, size_t size) {
+    if (channel == 0) {
+        snprintf(path, size, "%s", LATEST_DATA_JSON_PATH);
+    } else {
+        snprintf(path, size, LATEST_DATA_CHANNEL_JSON_PATH_FORMAT, (unsigned)channel);
+    }
+}
+
 // cumulative_latest.json からデータを読み込む
-bool Storage::loadCumulativeDataFromSD(TrackerData& data) {
+bool Storage::loadCumulativeDataFromSD(TrackerData& data, uint8_t channel) {
     // デフォルト値を設定
     data.cumulativeTimeMs = 0;
     data.cumulativeDistanceKm = 0.0f;
     data.cumulativeCaloriesKcal = 0.0f;
+    data.cumulativeDistanceUm = 0;
+    data.cumulativeCaloriesMcal = 0;
 
     if (!sdCardOk) {
         Serial.println("[LoadLatestSD] SD Card not available.");
         return false;
     }
 
-    Serial.printf("[LoadLatestSD] Reading latest data from: %s\n", LATEST_DATA_JSON_PATH);
-    String jsonContent = readFileContent(LATEST_DATA_JSON_PATH);
+    char path[40];
+    latestDataPath(channel, path, sizeof(path));
+    Serial.printf("[LoadLatestSD] Reading latest data from: %s\n", path);
+    String jsonContent = readFileContent(path);
     if (jsonContent.length() == 0) {
         Serial.println("[LoadLatestSD] File not found or empty. Using default zero values.");
         return false; // ファイルがない場合はデフォルト値 (読み込み失敗ではない)
@@ -246,8 +395,19 @@ bool Storage::loadCumulativeDataFromSD(TrackerData& data) {
          }
     }
 
-    data.cumulativeDistanceKm = doc["dist_km"] | 0.0f; // float
-    data.cumulativeCaloriesKcal = doc["cal_kcal"] | 0.0f; // float
+    // 距離・カロリーは整数 (µm / mcal) を正とする。整数が無い古いファイルは float から換算
+    if (doc["dist_um"].is<unsigned long long>()) {
+         data.cumulativeDistanceUm = doc["dist_um"].as<unsigned long long>();
+    } else {
+         data.cumulativeDistanceUm = MetricsAccumulator::fromKm(doc["dist_km"] | 0.0f);
+    }
+    if (doc["cal_mcal"].is<unsigned long long>()) {
+         data.cumulativeCaloriesMcal = doc["cal_mcal"].as<unsigned long long>();
+    } else {
+         data.cumulativeCaloriesMcal = MetricsAccumulator::fromKcal(doc["cal_kcal"] | 0.0f);
+    }
+    data.cumulativeDistanceKm = MetricsAccumulator::toKm(data.cumulativeDistanceUm);
+    data.cumulativeCaloriesKcal = MetricsAccumulator::toKcal(data.cumulativeCaloriesMcal);
 
     Serial.printf("[LoadLatestSD] Parsed data: Time=%llu ms, Dist=%.4f km, Cal=%.2f kcal\n",
                    data.cumulativeTimeMs, data.cumulativeDistanceKm, data.cumulativeCaloriesKcal);
@@ -256,7 +416,9 @@ bool Storage::loadCumulativeDataFromSD(TrackerData& data) {
 }
 
 // cumulative_latest.json へデータを保存 (上書き)
-bool Storage::saveLatestDataToSD(const TrackerData& data) {
+bool Storage::saveLatestDataToSD(const TrackerData& data, uint8_t channel) {
+    PROFILE_SCOPE(ProfileStage::SD_WRITE);
+    TRACE_SPAN(TraceEvent::SD_WRITE, SdWriteKind::LATEST);
      if (!sdCardOk) {
         Serial.println("[SaveLatestSD] SD Card not available.");
         return false;
@@ -269,8 +431,10 @@ bool Storage::saveLatestDataToSD(const TrackerData& data) {
     // ★ uint64_t はそのままではシリアライズできない場合があるので注意 ★
     // ArduinoJson v6 では unsigned long long が使えるはず
     doc["time_ms"] = (unsigned long long)data.cumulativeTimeMs;
-    doc["dist_km"] = data.cumulativeDistanceKm; // float はそのまま
+    doc["dist_km"] = data.cumulativeDistanceKm; // float はそのまま (人が読む用・古い版との互換用)
     doc["cal_kcal"] = data.cumulativeCaloriesKcal; // float はそのまま
+    doc["dist_um"] = (unsigned long long)data.cumulativeDistanceUm; // 読み込みはこちらを優先
+    doc["cal_mcal"] = (unsigned long long)data.cumulativeCaloriesMcal;
 
     String outputBuffer;
     // ★ シリアライズサイズをチェック（オプション）★
@@ -279,9 +443,11 @@ bool Storage::saveLatestDataToSD(const TrackerData& data) {
     serializeJson(doc, outputBuffer);
 
     // ファイルを開いて書き込み (上書き)
-    File file = SD.open(LATEST_DATA_JSON_PATH, FILE_WRITE);
+    char path[40];
+    latestDataPath(channel, path, sizeof(path));
+    File file = SD.open(path, FILE_WRITE);
     if (!file) {
-        Serial.printf("[SaveLatestSD] Failed to open '%s' for writing.\n", LATEST_DATA_JSON_PATH);
+        Serial.printf("[SaveLatestSD] Failed to open '%s' for writing.\n", path);
         return false;
     }
 
@@ -298,7 +464,9 @@ bool Storage::saveLatestDataToSD(const TrackerData& data) {
 }
 
 // ★ cumulative_history.jsonl へデータを追記 (タイムスタンプ取得方法を変更) ★
-bool Storage::appendHistoryDataToSD(const TrackerData& data) {
+bool Storage::appendHistoryDataToSD(const TrackerData& data, uint8_t channel) {
+    PROFILE_SCOPE(ProfileStage::SD_WRITE);
+    TRACE_SPAN(TraceEvent::SD_WRITE, SdWriteKind::HISTORY);
     if (!sdCardOk) {
         Serial.println("[AppendHistSD] SD Card not available.");
         return false;
@@ -312,10 +480,15 @@ bool Storage::appendHistoryDataToSD(const TrackerData& data) {
     // ★★★ getCurrentTimestampMs() でタイムスタンプを取得 ★★★
     uint64_t timestampMs = getCurrentTimestampMs();
     entryDoc["timestamp_ms"] = timestampMs; // ★ キー名を変更し、取得した値を使用 ★
+    if (channel != 0) {
+        entryDoc["channel"] = channel; // チャンネル0は従来どおり付けない
+    }
 
     entryDoc["time_ms"] = (unsigned long long)data.cumulativeTimeMs;
     entryDoc["dist_km"] = data.cumulativeDistanceKm;
     entryDoc["cal_kcal"] = data.cumulativeCaloriesKcal;
+    entryDoc["dist_um"] = (unsigned long long)data.cumulativeDistanceUm;
+    entryDoc["cal_mcal"] = (unsigned long long)data.cumulativeCaloriesMcal;
 
     String entryBuffer;
     serializeJson(entryDoc, entryBuffer);
@@ -339,4 +512,147 @@ bool Storage::appendHistoryDataToSD(const TrackerData& data) {
          Serial.printf("[AppendHistSD] File append failed (written bytes: %d, expected: ~%d).\n", written, entryBuffer.length()+1);
         return false;
     }
-}
\ No newline at end of file
+}
+
+// sessions.jsonl へセッション要約を1行追記
+bool Storage::appendSessionToSD(const SessionSummary& summary) {
+    PROFILE_SCOPE(ProfileStage::SD_WRITE);
+    TRACE_SPAN(TraceEvent::SD_WRITE, SdWriteKind::SESSION);
+    if (!sdCardOk) {
+        Serial.println("[AppendSessionSD] SD Card not available.");
+        return false;
+    }
+    String line;
+    PayloadEncoder::encodeSessionJson(summary, nullptr, line);
+
+    File file = SD.open(SESSIONS_JSONL_PATH, FILE_APPEND);
+    if (!file) {
+        Serial.printf("[AppendSessionSD] Failed to open '%s' for appending.\n", SESSIONS_JSONL_PATH);
+        return false;
+    }
+    size_t written = file.println(line);
+    file.close();
+    if (written < line.length() + 1) {
+        Serial.printf("[AppendSessionSD] File append failed (written bytes: %d, expected: ~%d).\n", written, line.length() + 1);
+        return false;
+    }
+    return true;
+}
+
+bool Storage::saveTraceToSD() {
+#if FIT2GO_TRACING
+    if (!sdCardOk) {
+        Serial.println("[SaveTraceSD] SD Card not available.");
+        return false;
+    }
+    File file = SD.open(TRACE_DUMP_PATH, FILE_WRITE);
+    if (!file) {
+        Serial.printf("[SaveTraceSD] Failed to open '%s' for writing.\n", TRACE_DUMP_PATH);
+        return false;
+    }
+    Trace::dump(file);
+    size_t written = file.size();
+    file.close();
+    if (written == 0) {
+        Serial.println("[SaveTraceSD] Nothing written.");
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+// 最新累積データの保存を要求する (キューに積むだけ)
+bool Storage::requestSaveLatest(const TrackerData& data, uint8_t channel) {
+    if (writeQueue == nullptr) {
+        return saveLatestDataToSD(data, channel); // キューが無ければその場で書く
+    }
+    WriteRequest request;
+    request.type = WriteType::SAVE_LATEST;
+    request.channel = channel;
+    request.data = data;
+    if (xQueueSend(writeQueue, &request, 0) != pdTRUE) {
+        // 上書き保存なので、後から来る要求が同じ内容を含む。古い要求が詰まっていても失うものは少ない
+        droppedWrites++;
+        sdWritesDropped.increment();
+        LOG_W("[Storage] Write queue full. Request dropped (total %u).", droppedWrites);
+        return false;
+    }
+    return true;
+}
+
+// セッション要約の追記を要求する
+// 上書き保存と違って後の要求に含まれないので、キューが一杯なら捨てずに1件預かる
+// (計測タスクを待たせないよう、ここでは決してブロックしない)
+bool Storage::requestAppendSession(const SessionSummary& summary) {
+    if (writeQueue == nullptr) {
+        return appendSessionToSD(summary);
+    }
+    retryPendingSession(); // 先に預かっている分を積んで順序を保つ
+    WriteRequest request;
+    request.type = WriteType::APPEND_SESSION;
+    request.session = summary;
+    if (!pendingSessionHeld.load() && xQueueSend(writeQueue, &request, 0) == pdTRUE) {
+        return true;
+    }
+    if (!pendingSessionHeld.load()) {
+        pendingSession = summary;
+        pendingSessionHeld.store(true);
+        return true;
+    }
+    droppedWrites++;
+    sdWritesDropped.increment();
+    LOG_W("[Storage] Write queue full. Session record dropped (total %u).", droppedWrites);
+    return false;
+}
+
+// 預かっているセッション要約をキューへ積み直す
+bool Storage::retryPendingSession() {
+    if (!pendingSessionHeld.load())
+        return true;
+    WriteRequest request;
+    request.type = WriteType::APPEND_SESSION;
+    request.session = pendingSession;
+    if (xQueueSend(writeQueue, &request, 0) != pdTRUE)
+        return false;
+    pendingSessionHeld.store(false);
+    return true;
+}
+
+bool Storage::hasPendingSession() const {
+    return pendingSessionHeld.load();
+}
+
+// 書き込み要求が来るまで待つ
+bool Storage::waitForPendingWrites(TickType_t waitTicks) {
+    if (writeQueue == nullptr)
+        return false;
+    WriteRequest request;
+    return xQueuePeek(writeQueue, &request, waitTicks) == pdTRUE;
+}
+
+// 溜まっている書き込み要求を処理する
+size_t Storage::processPendingWrites() {
+    if (writeQueue == nullptr)
+        return 0;
+    size_t processed = 0;
+    WriteRequest request;
+    while (xQueueReceive(writeQueue, &request, 0) == pdTRUE) {
+        uint32_t startUs = micros();
+        bool ok = false;
+        switch (request.type) {
+            case WriteType::SAVE_LATEST:
+                ok = saveLatestDataToSD(request.data, request.channel);
+                break;
+            case WriteType::APPEND_SESSION:
+                ok = appendSessionToSD(request.session);
+                break;
+        }
+        sdWriteDuration.observeUs(micros() - startUs);
+        if (!ok)
+            sdWriteFailures.increment();
+        processed++;
+    }
+    return processed;
+}
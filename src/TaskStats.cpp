@@ -0,0 +1,81 @@
+#include "TaskStats.hpp"
+#include "config.hpp"
+#include "HeapStats.hpp"
+#include "Log.hpp"
+
+TaskStats::TaskStats(const char* taskName) :
+    name(taskName),
+    handle(nullptr),
+    startUs(0),
+    iterations(0),
+    lastUs(0),
+    maxUs(0),
+    windowSumUs(0),
+    windowCount(0),
+    loopDuration("fit2go_loop_duration_seconds", "Processing time of one task loop iteration (waits excluded).",
+                 METRIC_LOOP_BUCKETS_US, METRIC_LOOP_BUCKET_COUNT, metricLabels),
+    heapAllocations(HeapStats::ALLOCATIONS_METRIC, HeapStats::ALLOCATIONS_HELP, metricLabels),
+    heapAllocatedBytes(HeapStats::BYTES_METRIC, HeapStats::BYTES_HELP, metricLabels)
+{
+    snprintf(metricLabels, sizeof(metricLabels), "task=\"%s\"", taskName);
+}
+
+void TaskStats::attach(TaskHandle_t taskHandle) {
+    handle = taskHandle;
+    HeapStats::registerTask(taskHandle, *this);
+}
+
+void TaskStats::beginIteration() {
+    startUs = micros();
+}
+
+void TaskStats::endIteration() {
+    uint32_t elapsed = micros() - startUs;
+    lastUs = elapsed;
+    if (elapsed > maxUs)
+        maxUs = elapsed;
+    windowSumUs += elapsed;
+    windowCount++;
+    iterations++;
+    loopDuration.observeUs(elapsed);
+}
+
+void TaskStats::resetWindow() {
+    maxUs = 0;
+    windowSumUs = 0;
+    windowCount = 0;
+}
+
+const char* TaskStats::getName() const {
+    return name;
+}
+
+uint32_t TaskStats::getIterations() const {
+    return iterations;
+}
+
+uint32_t TaskStats::getLastUs() const {
+    return lastUs;
+}
+
+uint32_t TaskStats::getMaxUs() const {
+    return maxUs;
+}
+
+uint32_t TaskStats::getAverageUs() const {
+    return windowCount > 0 ? windowSumUs / windowCount : 0;
+}
+
+uint32_t TaskStats::getHeapAllocations() const {
+    return heapAllocations.get();
+}
+
+uint32_t TaskStats::getStackHighWaterMark() const {
+    // ESP-IDF の FreeRTOS はスタックをバイト単位で扱う
+    return handle != nullptr ? uxTaskGetStackHighWaterMark(handle) : 0;
+}
+
+void TaskStats::print() const {
+    LOG_I("[Task] %-8s runs:%u last:%uus avg:%uus max:%uus stackFree:%uB allocs:%u",
+          name, iterations, lastUs, getAverageUs(), maxUs, getStackHighWaterMark(), getHeapAllocations());
+}
@@ -0,0 +1,310 @@
+#include "TimeSeriesStore.hpp"
+#include <stdio.h>
+#include <string.h>
+
+TimeSeriesStore::TimeSeriesStore() {
+    SeriesBucket* slots[] = { secondSlots, minuteSlots, hourSlots };
+    const SeriesTier kinds[] = { SeriesTier::SECONDS, SeriesTier::MINUTES, SeriesTier::HOURS };
+    for (size_t i = 0; i < 3; i++) {
+        tiers[i].slots = slots[i];
+        tiers[i].capacity = capacity(kinds[i]);
+        tiers[i].resolutionMs = resolutionMs(kinds[i]);
+    }
+    clear();
+}
+
+void TimeSeriesStore::clear() {
+    for (Tier& tier : tiers) {
+        clearTier(tier);
+    }
+}
+
+void TimeSeriesStore::clearTier(Tier& tier) {
+    for (size_t i = 0; i < tier.capacity; i++)
+        tier.slots[i] = SeriesBucket();
+    tier.open = Accumulator();
+    tier.newestIndex = 0;
+    tier.slotShift = 0;
+    tier.hasData = false;
+}
+
+void TimeSeriesStore::append(uint64_t nowMs, float rpm, float speedKmh) {
+    uint16_t rpmFixed = toFixed(rpm);
+    uint16_t speedFixed = toFixed(speedKmh);
+    for (Tier& tier : tiers) {
+        add(tier, nowMs, rpmFixed, speedFixed);
+    }
+}
+
+void TimeSeriesStore::add(Tier& tier, uint64_t nowMs, uint16_t rpm, uint16_t speed) {
+    uint64_t index = nowMs / tier.resolutionMs;
+    if (tier.hasData && index < tier.newestIndex)
+        return; // 時刻が戻った (Clock は単調なので通常は起きない)
+
+    if (!tier.hasData || index > tier.newestIndex) {
+        // 新しい区間へ進む。飛ばした区間には古い集計が残っているので空にする (最大で1周分)
+        if (tier.hasData) {
+            uint64_t skipped = index - tier.newestIndex;
+            if (skipped > tier.capacity)
+                skipped = tier.capacity;
+            for (uint64_t i = 1; i <= skipped; i++) {
+                slotAt(tier, tier.newestIndex + i) = SeriesBucket();
+            }
+        } else {
+            slotAt(tier, index) = SeriesBucket();
+        }
+        tier.newestIndex = index;
+        tier.hasData = true;
+        tier.open = Accumulator();
+    }
+
+    // 開いている区間の集計を更新し、そのままスロットにも書く (問い合わせは途中の区間もそのまま読める)
+    Accumulator& open = tier.open;
+    if (open.count == 0) {
+        open.rpmMin = open.rpmMax = rpm;
+        open.speedMin = open.speedMax = speed;
+    } else {
+        if (rpm < open.rpmMin) open.rpmMin = rpm;
+        if (rpm > open.rpmMax) open.rpmMax = rpm;
+        if (speed < open.speedMin) open.speedMin = speed;
+        if (speed > open.speedMax) open.speedMax = speed;
+    }
+    // 件数は16bitで頭打ち (1時間に毎秒18回を超える場合)。それ以降は最小・最大だけ反映する
+    if (open.count < UINT16_MAX) {
+        open.count++;
+        open.rpmSum += rpm;
+        open.speedSum += speed;
+    }
+
+    SeriesBucket& slot = slotAt(tier, index);
+    slot.count = (uint16_t)open.count;
+    slot.rpmMin = open.rpmMin;
+    slot.rpmMax = open.rpmMax;
+    slot.rpmMean = (uint16_t)((open.rpmSum + open.count / 2) / open.count);
+    slot.speedMin = open.speedMin;
+    slot.speedMax = open.speedMax;
+    slot.speedMean = (uint16_t)((open.speedSum + open.count / 2) / open.count);
+}
+
+size_t TimeSeriesStore::query(SeriesTier which, uint64_t fromMs, uint64_t toMs, SeriesPoint* out, size_t maxCount) const {
+    const Tier& tier = tierFor(which);
+    if (!tier.hasData || toMs <= fromMs || maxCount == 0)
+        return 0;
+
+    // リングに残っている区間番号の範囲と、問い合わせ範囲の重なり
+    uint64_t oldestIndex = tier.newestIndex + 1 > tier.capacity ? tier.newestIndex + 1 - tier.capacity : 0;
+    uint64_t first = fromMs / tier.resolutionMs;
+    uint64_t last = (toMs - 1) / tier.resolutionMs;
+    if (first < oldestIndex)
+        first = oldestIndex;
+    if (last > tier.newestIndex)
+        last = tier.newestIndex;
+
+    size_t written = 0;
+    for (uint64_t index = first; index <= last && written < maxCount; index++) {
+        const SeriesBucket& slot = slotAt(tier, index);
+        if (slot.count == 0)
+            continue;
+        out[written].startMs = index * tier.resolutionMs;
+        out[written].bucket = slot;
+        written++;
+    }
+    return written;
+}
+
+bool TimeSeriesStore::latest(SeriesTier which, SeriesPoint& out) const {
+    const Tier& tier = tierFor(which);
+    if (!tier.hasData)
+        return false;
+    out.startMs = tier.newestIndex * tier.resolutionMs;
+    out.bucket = slotAt(tier, tier.newestIndex);
+    return out.bucket.count > 0;
+}
+
+// 区間番号だけを変え、slotShift で同じスロットを指し続ける (配列は動かさない)
+void TimeSeriesStore::rebase(int64_t deltaMs) {
+    for (Tier& tier : tiers) {
+        if (!tier.hasData)
+            continue;
+        int64_t resolution = tier.resolutionMs;
+        int64_t shift = (deltaMs >= 0 ? deltaMs + resolution / 2 : deltaMs - resolution / 2) / resolution;
+        if (shift < 0 && (uint64_t)-shift > tier.newestIndex) {
+            clearTier(tier); // 0 より前へはずらせない (起きないはずの大きな巻き戻し)
+            continue;
+        }
+        tier.newestIndex += shift;
+        int64_t capacity = (int64_t)tier.capacity;
+        int64_t wrapped = ((shift % capacity) + capacity) % capacity;
+        tier.slotShift = (uint32_t)((tier.slotShift + capacity - wrapped) % capacity);
+    }
+}
+
+// 並び: magic, checksum, 分の段の状態, 時の段の状態, 分の段のスロット, 時の段のスロット
+void TimeSeriesStore::save(uint8_t* out) const {
+    uint8_t* p = out + 2 * sizeof(uint32_t);
+    const Tier* coarse[] = { &tiers[(size_t)SeriesTier::MINUTES], &tiers[(size_t)SeriesTier::HOURS] };
+    for (const Tier* tier : coarse) {
+        memcpy(p, &tier->newestIndex, sizeof(uint64_t)); p += sizeof(uint64_t);
+        memcpy(p, &tier->slotShift, sizeof(uint32_t));   p += sizeof(uint32_t);
+        *p++ = tier->hasData ? 1 : 0;
+        memcpy(p, &tier->open, sizeof(Accumulator));     p += sizeof(Accumulator);
+    }
+    for (const Tier* tier : coarse) {
+        memcpy(p, tier->slots, tier->capacity * sizeof(SeriesBucket));
+        p += tier->capacity * sizeof(SeriesBucket);
+    }
+    uint32_t magic = RETAINED_MAGIC;
+    uint32_t sum = checksum(out + 2 * sizeof(uint32_t), retainedBytes() - 2 * sizeof(uint32_t));
+    memcpy(out, &magic, sizeof(uint32_t));
+    memcpy(out + sizeof(uint32_t), &sum, sizeof(uint32_t));
+}
+
+bool TimeSeriesStore::restore(const uint8_t* in) {
+    uint32_t magic, sum;
+    memcpy(&magic, in, sizeof(uint32_t));
+    memcpy(&sum, in + sizeof(uint32_t), sizeof(uint32_t));
+    if (magic != RETAINED_MAGIC || sum != checksum(in + 2 * sizeof(uint32_t), retainedBytes() - 2 * sizeof(uint32_t)))
+        return false;
+    // 先に状態を読んで確かめてから書き込む (途中で失敗しても今の中身を壊さない)
+    const uint8_t* p = in + 2 * sizeof(uint32_t);
+    Tier* coarse[] = { &tiers[(size_t)SeriesTier::MINUTES], &tiers[(size_t)SeriesTier::HOURS] };
+    uint64_t newestIndex[2];
+    uint32_t slotShift[2];
+    bool hasData[2];
+    Accumulator open[2];
+    for (size_t i = 0; i < 2; i++) {
+        memcpy(&newestIndex[i], p, sizeof(uint64_t)); p += sizeof(uint64_t);
+        memcpy(&slotShift[i], p, sizeof(uint32_t));   p += sizeof(uint32_t);
+        hasData[i] = *p++ != 0;
+        memcpy(&open[i], p, sizeof(Accumulator));     p += sizeof(Accumulator);
+        if (slotShift[i] >= coarse[i]->capacity)
+            return false;
+    }
+    for (size_t i = 0; i < 2; i++) {
+        Tier& tier = *coarse[i];
+        memcpy(tier.slots, p, tier.capacity * sizeof(SeriesBucket));
+        p += tier.capacity * sizeof(SeriesBucket);
+        tier.newestIndex = newestIndex[i];
+        tier.slotShift = slotShift[i];
+        tier.hasData = hasData[i];
+        tier.open = open[i];
+    }
+    clearTier(tiers[(size_t)SeriesTier::SECONDS]);
+    return true;
+}
+
+// FNV-1a (RTCメモリの電源投入直後のごみ・書きかけと見分けられればよい)
+uint32_t TimeSeriesStore::checksum(const uint8_t* data, size_t length) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t TimeSeriesStore::resolutionMs(SeriesTier tier) {
+    switch (tier) {
+        case SeriesTier::SECONDS: return 1000;
+        case SeriesTier::MINUTES: return 60UL * 1000;
+        default:                  return 60UL * 60 * 1000;
+    }
+}
+
+size_t TimeSeriesStore::capacity(SeriesTier tier) {
+    switch (tier) {
+        case SeriesTier::SECONDS: return SERIES_SECONDS_CAPACITY;
+        case SeriesTier::MINUTES: return SERIES_MINUTES_CAPACITY;
+        default:                  return SERIES_HOURS_CAPACITY;
+    }
+}
+
+const char* TimeSeriesStore::tierName(SeriesTier tier) {
+    switch (tier) {
+        case SeriesTier::SECONDS: return "second";
+        case SeriesTier::MINUTES: return "minute";
+        default:                  return "hour";
+    }
+}
+
+bool TimeSeriesStore::parseTier(const char* name, SeriesTier& out) {
+    const SeriesTier kinds[] = { SeriesTier::SECONDS, SeriesTier::MINUTES, SeriesTier::HOURS };
+    for (SeriesTier kind : kinds) {
+        if (strcmp(name, tierName(kind)) == 0) {
+            out = kind;
+            return true;
+        }
+    }
+    return false;
+}
+
+// 1/100 単位に丸める (負の値は0、655.35 を超える値は頭打ち)
+uint16_t TimeSeriesStore::toFixed(float value) {
+    if (!(value > 0.0f))
+        return 0;
+    float scaled = value * 100.0f + 0.5f;
+    return scaled >= (float)UINT16_MAX ? UINT16_MAX : (uint16_t)scaled;
+}
+
+
+// --- CSV ---
+
+SeriesCsvWriter::SeriesCsvWriter(Query query, SeriesTier tier, uint64_t fromMs, uint64_t toMs) :
+    query(query),
+    tier(tier),
+    nextFromMs(fromMs),
+    toMs(toMs),
+    pageCount(0),
+    pagePosition(0),
+    headerDone(false),
+    finished(false),
+    lineLength(0),
+    linePosition(0)
+{
+    line[0] = '\0';
+}
+
+size_t SeriesCsvWriter::read(uint8_t* buffer, size_t maxLength) {
+    size_t written = 0;
+    while (written < maxLength) {
+        if (linePosition == lineLength && !nextLine())
+            break;
+        size_t chunk = lineLength - linePosition;
+        if (chunk > maxLength - written)
+            chunk = maxLength - written; // 入りきらない分は次の呼び出しで
+        memcpy(buffer + written, line + linePosition, chunk);
+        linePosition += chunk;
+        written += chunk;
+    }
+    return written;
+}
+
+bool SeriesCsvWriter::nextLine() {
+    int length;
+    if (!headerDone) {
+        length = snprintf(line, sizeof(line), "start_ms,count,rpm_min,rpm_mean,rpm_max,kmh_min,kmh_mean,kmh_max\n");
+        headerDone = true;
+    } else {
+        if (pagePosition == pageCount) {
+            // 前のページの続きから問い合わせる (その間に追加された区間も拾う)
+            if (finished || nextFromMs >= toMs)
+                return false;
+            pageCount = query(tier, nextFromMs, toMs, page, PAGE_POINTS);
+            pagePosition = 0;
+            if (pageCount < PAGE_POINTS)
+                finished = true;
+            if (pageCount == 0)
+                return false;
+            nextFromMs = page[pageCount - 1].startMs + TimeSeriesStore::resolutionMs(tier);
+        }
+        const SeriesPoint& point = page[pagePosition++];
+        const SeriesBucket& b = point.bucket;
+        length = snprintf(line, sizeof(line), "%llu,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n",
+                          (unsigned long long)point.startMs, (unsigned)b.count,
+                          TimeSeriesStore::toRpm(b.rpmMin), TimeSeriesStore::toRpm(b.rpmMean), TimeSeriesStore::toRpm(b.rpmMax),
+                          TimeSeriesStore::toKmh(b.speedMin), TimeSeriesStore::toKmh(b.speedMean), TimeSeriesStore::toKmh(b.speedMax));
+    }
+    lineLength = length > 0 ? ((size_t)length < sizeof(line) ? (size_t)length : sizeof(line) - 1) : 0;
+    linePosition = 0;
+    return true;
+}
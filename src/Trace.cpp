@@ -0,0 +1,147 @@
+#include "Trace.hpp"
+
+#if FIT2GO_TRACING
+
+#include <string.h>
+
+TraceBuffer Trace::buffer;
+TaskHandle_t Trace::tasks[TRACE_MAX_TASKS] = {};
+const char* Trace::taskNames[TRACE_MAX_TASKS] = {};
+size_t Trace::taskCount = 0;
+
+static const uint8_t TRACE_FORMAT_VERSION = 1;
+static const uint16_t TRACE_END_MARKER = 0xFFFF;
+
+void Trace::registerTask(TaskHandle_t handle, const char* name) {
+    if (handle == NULL || taskCount >= TRACE_MAX_TASKS)
+        return;
+    taskNames[taskCount] = name;
+    tasks[taskCount] = handle; // 名前を先に入れる (currentTrack() は handle で探す)
+    taskCount++;
+}
+
+// 登録したタスクなら1から始まる番号、それ以外は TRACK_OTHER
+uint8_t Trace::currentTrack() {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (size_t i = 0; i < taskCount; i++) {
+        if (tasks[i] == self)
+            return (uint8_t)(i + 1);
+    }
+    return TRACK_OTHER;
+}
+
+const char* Trace::eventName(TraceEvent event) {
+    switch (event) {
+        case TraceEvent::PULSE:            return "pulse";
+        case TraceEvent::STATE:            return "state";
+        case TraceEvent::METRICS_UPDATE:   return "metrics_update";
+        case TraceEvent::DISPLAY_UPDATE:   return "display_update";
+        case TraceEvent::PUBLISH:          return "publish";
+        case TraceEvent::PUBLISH_DNS:      return "publish_dns";
+        case TraceEvent::PUBLISH_CONNECT:  return "publish_connect";
+        case TraceEvent::PUBLISH_TLS:      return "publish_tls";
+        case TraceEvent::PUBLISH_SEND:     return "publish_send";
+        case TraceEvent::PUBLISH_RESPONSE: return "publish_response";
+        case TraceEvent::SD_WRITE:         return "sd_write";
+        case TraceEvent::NTP_SYNC:         return "ntp_sync";
+        case TraceEvent::WIFI_LINK:        return "wifi_link";
+        case TraceEvent::SESSION_END:      return "session_end";
+        default:                           return "?";
+    }
+}
+
+static void writeU8(Print& out, uint8_t value) {
+    out.write(value);
+}
+
+static void writeU16(Print& out, uint16_t value) {
+    uint8_t bytes[2] = { (uint8_t)value, (uint8_t)(value >> 8) };
+    out.write(bytes, sizeof(bytes));
+}
+
+static void writeU32(Print& out, uint32_t value) {
+    uint8_t bytes[4] = { (uint8_t)value, (uint8_t)(value >> 8), (uint8_t)(value >> 16), (uint8_t)(value >> 24) };
+    out.write(bytes, sizeof(bytes));
+}
+
+static void writeName(Print& out, const char* name) {
+    size_t length = strlen(name);
+    if (length > 255)
+        length = 255;
+    writeU8(out, (uint8_t)length);
+    out.write((const uint8_t*)name, length);
+}
+
+static void writeRecord(Print& out, const TraceRecord& record) {
+    writeU32(out, record.timeUs);
+    writeU16(out, record.event);
+    writeU8(out, record.phase);
+    writeU8(out, record.track);
+    writeU32(out, record.arg);
+}
+
+// 書き出している間も記録は続くので、書き出し開始時点までの分だけを古い順に出す
+void Trace::dump(Print& out) {
+    uint32_t written = buffer.getWritten();
+    uint32_t oldest = buffer.getOldest();
+
+    out.write((const uint8_t*)"F2GT", 4);
+    writeU8(out, TRACE_FORMAT_VERSION);
+    writeU8(out, (uint8_t)sizeof(TraceRecord));
+    writeU16(out, (uint16_t)TraceEvent::COUNT);
+    writeU32(out, written);
+    for (uint16_t i = 0; i < (uint16_t)TraceEvent::COUNT; i++)
+        writeName(out, eventName((TraceEvent)i));
+    writeU8(out, (uint8_t)taskCount);
+    for (size_t i = 0; i < taskCount; i++) {
+        writeU8(out, (uint8_t)(i + 1));
+        writeName(out, taskNames[i]);
+    }
+
+    uint32_t lost = 0;
+    TraceRecord record;
+    for (uint32_t index = oldest; index != written; index++) {
+        if (buffer.read(index, record))
+            writeRecord(out, record);
+        else
+            lost++;
+    }
+    TraceRecord end = {};
+    end.event = TRACE_END_MARKER;
+    end.arg = lost;
+    writeRecord(out, end);
+}
+
+// 1バイトずつ16進の文字にして、一定の長さごとに改行する
+class HexLinePrint : public Print {
+public:
+    explicit HexLinePrint(Print& out) : out(out), column(0) {}
+    size_t write(uint8_t value) override {
+        static const char digits[] = "0123456789abcdef";
+        char text[2] = { digits[value >> 4], digits[value & 0x0F] };
+        out.write((const uint8_t*)text, sizeof(text));
+        if (++column == BYTES_PER_LINE)
+            finishLine();
+        return 1;
+    }
+    void finishLine() {
+        if (column > 0)
+            out.println();
+        column = 0;
+    }
+
+private:
+    static const size_t BYTES_PER_LINE = 32;
+    Print& out;
+    size_t column;
+};
+
+void Trace::dumpHex(Print& out) {
+    out.println("TRACE-DUMP-BEGIN");
+    HexLinePrint hex(out);
+    dump(hex);
+    hex.finishLine();
+    out.println("TRACE-DUMP-END");
+}
+
+#endif // FIT2GO_TRACING
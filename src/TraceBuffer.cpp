@@ -0,0 +1,27 @@
+#include "TraceBuffer.hpp"
+
+TraceBuffer::TraceBuffer() :
+    head(0)
+{
+    for (Slot& slot : slots)
+        slot.sequence.store(EMPTY, std::memory_order_relaxed);
+}
+
+uint32_t TraceBuffer::getWritten() const {
+    return head.load(std::memory_order_acquire);
+}
+
+uint32_t TraceBuffer::getOldest() const {
+    uint32_t written = getWritten();
+    return written > CAPACITY ? written - (uint32_t)CAPACITY : 0;
+}
+
+bool TraceBuffer::read(uint32_t index, TraceRecord& out) const {
+    const Slot& slot = slots[index & (CAPACITY - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != index)
+        return false;
+    out = slot.record;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    // コピーの間に上書きが始まっていたら番号が変わっている
+    return slot.sequence.load(std::memory_order_relaxed) == index;
+}
@@ -0,0 +1,78 @@
+#include "UdpTelemetry.hpp"
+#include "Log.hpp"
+
+UdpTelemetry::UdpTelemetry() :
+    port(0),
+    resolver(nullptr),
+    firstPendingMs(0),
+    datagramsSent(0),
+    sendErrors(0)
+{}
+
+bool UdpTelemetry::begin(const ParsedUrl& url, HostResolver& hostResolver) {
+    if (url.scheme != "udp" || url.port == 0) {
+        Serial.printf("[UDP] Invalid target (expected udp://host:port): %s\n", url.host.c_str());
+        return false;
+    }
+    port = url.port;
+    resolver = &hostResolver;
+    packer.begin(UDP_MAX_DATAGRAM_SIZE);
+    Serial.printf("[UDP] Telemetry target %s:%u\n", url.host.c_str(), port);
+    return true;
+}
+
+void UdpTelemetry::add(const String& text, uint64_t nowMs) {
+    if (port == 0 || text.length() == 0)
+        return;
+    if (!packer.fits(text.length())) {
+        flush(); // 入りきらないので溜まっている分を先に送る
+    }
+    if (packer.empty()) {
+        firstPendingMs = nowMs;
+    }
+    if (!packer.append(text.c_str(), text.length())) {
+        LOG_W("[UDP] Sample too large for one datagram (%u bytes). Dropped.", text.length());
+    }
+}
+
+void UdpTelemetry::flushIfDue(uint64_t nowMs) {
+    if (!packer.empty() && nowMs - firstPendingMs >= UDP_FLUSH_INTERVAL_MS) {
+        flush();
+    }
+}
+
+unsigned long UdpTelemetry::msUntilFlush(uint64_t nowMs) const {
+    if (packer.empty())
+        return ULONG_MAX;
+    uint64_t elapsed = nowMs - firstPendingMs;
+    return elapsed < UDP_FLUSH_INTERVAL_MS ? (unsigned long)(UDP_FLUSH_INTERVAL_MS - elapsed) : 0;
+}
+
+void UdpTelemetry::flush() {
+    if (packer.empty())
+        return;
+    bool sent = false;
+    IPAddress address;
+    // 未解決なら待たずに捨てる (解決は DataPublisher::maintain で進む)
+    if (resolver != nullptr && resolver->getAddress(address) && udp.beginPacket(address, port) == 1) {
+        udp.write((const uint8_t*)packer.data(), packer.size());
+        sent = udp.endPacket() == 1;
+    }
+    if (sent) {
+        datagramsSent++;
+    } else {
+        sendErrors++;
+        if (resolver != nullptr)
+            resolver->invalidate(); // 次回は名前解決からやり直す
+    }
+    // 投げっぱなしなので、失敗しても溜め直さずに捨てる
+    packer.clear();
+}
+
+uint32_t UdpTelemetry::getDatagramsSent() const {
+    return datagramsSent;
+}
+
+uint32_t UdpTelemetry::getSendErrors() const {
+    return sendErrors;
+}
@@ -1,10 +1,23 @@
 #include "WifiManager.hpp"
 #include <M5Stack.h> // For Serial
+#include "MetricRegistry.hpp"
 // #include <ArduinoJson.h> // 不要
 
+// /metrics 用
+static MetricCounter wifiConnects("fit2go_wifi_connects_total", "Wi-Fi station connections (first connect and reconnects).");
+static float readRssi() {
+    return WiFi.status() == WL_CONNECTED ? (float)WiFi.RSSI() : 0.0f;
+}
+static float readConnected() {
+    return WiFi.status() == WL_CONNECTED ? 1.0f : 0.0f;
+}
+static MetricGauge wifiRssi("fit2go_wifi_rssi_dbm", "Received signal strength of the connected access point (0 when disconnected).", readRssi);
+static MetricGauge wifiConnected("fit2go_wifi_connected", "1 while the Wi-Fi station is connected.", readConnected);
+
 // コンストラクタ
-WifiManager::WifiManager(Storage& storage) :
+WifiManager::WifiManager(Storage& storage, Clock& clock) :
     storage(storage),
+    clock(clock),
     lastStatus(WL_IDLE_STATUS),
     connectAttemptTime(0),
     isConnecting(false),
@@ -17,35 +30,32 @@ void WifiManager::begin() {
     delay(100);
     Serial.println("WiFi Manager initialized.");
     currentStatus = "WiFi Idle";
-    // 起動時の自動接続 (NVS -> YAML[0])
-    if (!connect()) {
-         // Serial.println("Initial auto-connect failed or no credentials.");
-    }
+    // 起動時の自動接続 (NVS -> YAML[0]) は呼び出し側が connect() で行う (config.json を読み終えてから)
 }
 
 // 自動接続 (NVS優先、次にYAMLの最初の設定)
 bool WifiManager::connect() {
     if (isConnected()) {
-        currentStatus = "Connected: " + WiFi.SSID();
+        currentStatus.assignf("Connected: %s", WiFi.SSID().c_str());
         return true;
     }
-    if (isConnecting && (millis() - connectAttemptTime < WIFI_CONNECT_TIMEOUT_MS)) {
-         currentStatus = "Connecting to " + currentSSID + "...";
+    if (isConnecting && (clock.nowMs() - connectAttemptTime < WIFI_CONNECT_TIMEOUT_MS)) {
+         currentStatus.assignf("Connecting to %s...", currentSSID.c_str());
          return false;
     }
 
     String ssid, pass;
     // まずNVSから試す
     if (storage.loadCredentialsFromNVS(ssid, pass)) {
-        if (isConnecting && currentSSID == ssid) {
-             currentStatus = "Connecting to " + currentSSID + "... (retrying)";
+        if (isConnecting && currentSSID == ssid.c_str()) {
+             currentStatus.assignf("Connecting to %s... (retrying)", currentSSID.c_str());
              return false;
         }
-        currentSSID = ssid;
+        currentSSID = ssid.c_str();
         Serial.printf("Attempting to connect to SSID: %s (from NVS)\n", ssid.c_str());
-        currentStatus = "Connecting(NVS) " + ssid + "...";
+        currentStatus.assignf("Connecting(NVS) %s...", ssid.c_str());
         isConnecting = true;
-        connectAttemptTime = millis();
+        connectAttemptTime = clock.nowMs();
         WiFi.begin(ssid.c_str(), pass.c_str());
         return false; // 接続試行開始
     } else {
@@ -58,26 +68,26 @@ bool WifiManager::connect() {
 // ★ YAMLの指定indexで接続試行 ★
 bool WifiManager::connectFromYaml(int index) {
      if (isConnected()) {
-        currentStatus = "Connected: " + WiFi.SSID();
+        currentStatus.assignf("Connected: %s", WiFi.SSID().c_str());
         return true;
     }
-     if (isConnecting && (millis() - connectAttemptTime < WIFI_CONNECT_TIMEOUT_MS)) {
-         currentStatus = "Connecting to " + currentSSID + "...";
+     if (isConnecting && (clock.nowMs() - connectAttemptTime < WIFI_CONNECT_TIMEOUT_MS)) {
+         currentStatus.assignf("Connecting to %s...", currentSSID.c_str());
          return false; // 前回の接続試行中
     }
 
     String ssid, pass;
     // storageのメソッドでYAMLから指定indexの情報を取得
     if (storage.getWifiCredential(index, ssid, pass)) {
-         if (isConnecting && currentSSID == ssid) { // 同じSSIDへの再試行は避ける
-             currentStatus = "Connecting to " + currentSSID + "... (retrying)";
+         if (isConnecting && currentSSID == ssid.c_str()) { // 同じSSIDへの再試行は避ける
+             currentStatus.assignf("Connecting to %s... (retrying)", currentSSID.c_str());
              return false;
          }
-         currentSSID = ssid;
+         currentSSID = ssid.c_str();
          Serial.printf("Attempting to connect using YAML[%d] to SSID: %s\n", index, ssid.c_str());
-         currentStatus = "Connecting(YAML) " + ssid + "...";
+         currentStatus.assignf("Connecting(YAML) %s...", ssid.c_str());
          isConnecting = true;
-         connectAttemptTime = millis();
+         connectAttemptTime = clock.nowMs();
 
          WiFi.begin(ssid.c_str(), pass.c_str());
          // ★ YAMLから読めたらNVSにも保存しておく ★
@@ -85,8 +95,8 @@ bool WifiManager::connectFromYaml(int index) {
          return false; // 接続試行開始
 
     } else {
-        currentStatus = "Could not read WiFi from YAML[" + String(index) + "]";
-        Serial.println(currentStatus);
+        currentStatus.assignf("Could not read WiFi from YAML[%d]", index);
+        Serial.println(currentStatus.c_str());
         isConnecting = false;
         return false;
     }
@@ -97,8 +107,8 @@ void WifiManager::disconnect() {
     delay(100);
     currentStatus = "Disconnected.";
     isConnecting = false;
-    currentSSID = "";
-    Serial.println(currentStatus);
+    currentSSID.clear();
+    Serial.println(currentStatus.c_str());
 }
 
 bool WifiManager::isConnected() {
@@ -114,35 +124,37 @@ void WifiManager::updateStatus() {
     if (isConnecting) {
         if (current_wl_status == WL_CONNECTED) {
             Serial.println("\nWiFi connected!");
+            wifiConnects.increment();
             Serial.print("IP address: "); Serial.println(WiFi.localIP());
-            currentStatus = "Connected: " + WiFi.SSID() + "\nIP: " + WiFi.localIP().toString();
+            setConnectedStatus();
             isConnecting = false;
-        } else if (millis() - connectAttemptTime > WIFI_CONNECT_TIMEOUT_MS) {
+        } else if (clock.nowMs() - connectAttemptTime > WIFI_CONNECT_TIMEOUT_MS) {
             Serial.println("\nConnection Timeout.");
-            currentStatus = "Timeout connecting to " + currentSSID;
+            currentStatus.assignf("Timeout connecting to %s", currentSSID.c_str());
             WiFi.disconnect(true); // タイムアウトしたら切断
             isConnecting = false;
-            currentSSID = ""; // 試行中SSIDクリア
+            currentSSID.clear(); // 試行中SSIDクリア
         } else {
              // isConnecting が true の間は Connecting... メッセージを維持
-             currentStatus = "Connecting to " + currentSSID + "...";
+             currentStatus.assignf("Connecting to %s...", currentSSID.c_str());
         }
     } else { // isConnecting == false
         if (current_wl_status != lastStatus) {
              if (current_wl_status == WL_CONNECTED && lastStatus != WL_CONNECTED) {
-                  currentStatus = "Connected: " + WiFi.SSID() + "\nIP: " + WiFi.localIP().toString();
+                  setConnectedStatus();
                   Serial.println("WiFi (re)connected.");
+                  wifiConnects.increment();
              } else if (current_wl_status != WL_CONNECTED && lastStatus == WL_CONNECTED) {
                   currentStatus = "Connection Lost.";
-                  Serial.println(currentStatus);
+                  Serial.println(currentStatus.c_str());
              } else if (current_wl_status == WL_NO_SSID_AVAIL || current_wl_status == WL_CONNECT_FAILED){
                   currentStatus = "Connect Failed";
-                  Serial.println(currentStatus);
+                  Serial.println(currentStatus.c_str());
              } else if (current_wl_status == WL_DISCONNECTED || current_wl_status == WL_IDLE_STATUS) {
                  // 最後に接続されていた状態から切断された場合のみメッセージ変更
                  if (lastStatus == WL_CONNECTED) {
                      currentStatus = "Disconnected.";
-                     Serial.println(currentStatus);
+                     Serial.println(currentStatus.c_str());
                  } else if (lastStatus != WL_DISCONNECTED && lastStatus != WL_IDLE_STATUS) {
                      // 接続中でもなく、最後に接続されていたわけでもなければ Idle
                      currentStatus = "WiFi Idle";
@@ -151,10 +163,10 @@ void WifiManager::updateStatus() {
         }
          // デフォルトの状態表示を更新 (タイムアウトや失敗メッセージがない場合)
          if (!isConnected() && !isConnecting && !scanning &&
-             currentStatus.indexOf("Timeout") == -1 && currentStatus.indexOf("Failed") == -1 &&
-             currentStatus.indexOf("No WiFi") == -1 && currentStatus.indexOf("Lost") == -1 &&
-             currentStatus.indexOf("read") == -1 && currentStatus.indexOf("Scanning") == -1 &&
-             currentStatus.indexOf("Disconnected") == -1) // Disconnectedメッセージも上書きしない
+             !currentStatus.contains("Timeout") && !currentStatus.contains("Failed") &&
+             !currentStatus.contains("No WiFi") && !currentStatus.contains("Lost") &&
+             !currentStatus.contains("read") && !currentStatus.contains("Scanning") &&
+             !currentStatus.contains("Disconnected")) // Disconnectedメッセージも上書きしない
          {
                 currentStatus = "WiFi Idle";
          }
@@ -169,6 +181,12 @@ IPAddress WifiManager::getLocalIP() {
     return WiFi.localIP();
 }
 
+// 接続したときの表示 (状態が変わったときだけ呼ぶ。SSID と IP の文字列化はここだけ)
+void WifiManager::setConnectedStatus() {
+    IPAddress ip = WiFi.localIP();
+    currentStatus.assignf("Connected: %s\nIP: %u.%u.%u.%u", WiFi.SSID().c_str(), ip[0], ip[1], ip[2], ip[3]);
+}
+
 
 // ★★★ Wi-Fiスキャン関連メソッドの実装 (変更なし) ★★★
 int WifiManager::scanNetworks() {
@@ -176,20 +194,18 @@ int WifiManager::scanNetworks() {
     Serial.println("Starting WiFi Scan...");
     currentStatus = "Scanning...";
     scanning = true;
-    scanResults.clear();
+    scanResultCount = 0;
     int n = WiFi.scanNetworks(false, true); // 非同期=false, ShowHidden=true
     scanning = false;
-    lastScanTime = millis();
+    lastScanTime = clock.nowMs();
     if (n < 0) { Serial.printf("WiFi Scan failed! Error code: %d\n", n); currentStatus = "Scan failed"; }
     else if (n == 0) { Serial.println("No networks found"); currentStatus = "No networks found"; }
     else {
         Serial.printf("%d networks found:\n", n);
-        currentStatus = String(n) + " networks found";
-        scanResults.reserve(n); // メモリ確保
-        for (int i = 0; i < n; ++i) {
-            WiFiScanInfo info;
-            info.ssid = WiFi.SSID(i); info.rssi = WiFi.RSSI(i); info.encryptionType = WiFi.encryptionType(i);
-            scanResults.push_back(info);
+        currentStatus.assignf("%d networks found", n);
+        for (int i = 0; i < n && i < (int)WIFI_SCAN_MAX_RESULTS; ++i) {
+            WiFiScanInfo& info = scanResults[scanResultCount++];
+            info.ssid = WiFi.SSID(i).c_str(); info.rssi = WiFi.RSSI(i); info.encryptionType = WiFi.encryptionType(i);
             Serial.printf("  %d: %s (%d dBm) %s\n", i + 1, info.ssid.c_str(), info.rssi, (info.encryptionType == WIFI_AUTH_OPEN) ? " " : "*");
         }
         // SSIDでソートなどしても良いかも
@@ -197,18 +213,19 @@ int WifiManager::scanNetworks() {
     return n;
 }
 
-int WifiManager::getScanResultCount() const { return scanResults.size(); }
+int WifiManager::getScanResultCount() const { return scanResultCount; }
 
-WiFiScanInfo WifiManager::getScanResult(int index) const {
-    if (index >= 0 && index < scanResults.size()) { return scanResults[index]; }
-    else { return WiFiScanInfo{"Index Err", 0, WIFI_AUTH_OPEN}; }
+const WiFiScanInfo& WifiManager::getScanResult(int index) const {
+    static const WiFiScanInfo INVALID_RESULT = { "Index Err", 0, WIFI_AUTH_OPEN };
+    if (index >= 0 && index < scanResultCount) { return scanResults[index]; }
+    else { return INVALID_RESULT; }
 }
 
 // getStatusMessage (APモード部分削除済み)
-String WifiManager::getStatusMessage() {
+const char* WifiManager::getStatusMessage() {
     if (scanning) { return "Scanning..."; }
-    else if (isConnecting) { return "Connecting to " + currentSSID + "..."; }
-    return currentStatus;
+    else if (isConnecting) { return currentStatus.assignf("Connecting to %s...", currentSSID.c_str()).c_str(); }
+    return currentStatus.c_str();
 }
 
 // --- APモード関連メソッドはすべて削除 ---
\ No newline at end of file
@@ -3,13 +3,17 @@
 // --- 設定ファイルパス (SDカード) ---
 const char* CONFIG_JSON_PATH = "/config.json";
 const char* LATEST_DATA_JSON_PATH = "/cumulative_latest.json"; // .json
+const char* LATEST_DATA_CHANNEL_JSON_PATH_FORMAT = "/cumulative_latest_ch%u.json"; // チャンネル1以降
 const char* HISTORY_DATA_JSONL_PATH = "/cumulative_history.jsonl"; // .jsonl
+const char* SESSIONS_JSONL_PATH = "/sessions.jsonl"; // セッション要約 (.jsonl)
+const char* TRACE_DUMP_PATH = "/trace.bin";           // イベントトレース (trace_to_chrome.py で変換)
 const char* ROOT_CA_PEM_PATH = "/root_ca.pem"; // ★ ルートCAファイルパス定義 ★
 
 // --- NVS 設定 (不揮発メモリ) ---
 const char* NVS_NAMESPACE = "tracker";
 const char* NVS_KEY_WIFI_SSID = "wifiSSID";
 const char* NVS_KEY_WIFI_PASS = "wifiPASS";
+const char* NVS_KEY_PULSE_CHANNELS = "channels";
 
 // --- APモード設定 ---
 const char* AP_SETUP_SSID = "M5Stack_Setup";
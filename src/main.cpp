@@ -13,26 +13,156 @@
 #include "driver/pcnt.h" // デバッグログ用
 #include <time.h>        // ★ NTP関連で追加 ★
 #include <sys/time.h>    // ★ gettimeofday で追加 ★
+#include <atomic>
+#include "TripleBuffer.hpp"
+#include "TaskStats.hpp"
+#include "DeadlineScheduler.hpp"
+#include "Clock.hpp"
+#include "TimeSeriesStore.hpp"
+#include "SampleBuffer.hpp"
+#include "SessionSummary.hpp"
+#include "Profiler.hpp"
+#include "DiagnosticsServer.hpp"
+#include "MetricRegistry.hpp"
+#include "HeapStats.hpp"
+#include "BootProfiler.hpp"
+#include "Trace.hpp"
+#include "Log.hpp"
+#include "esp_pm.h"
+#include "freertos/semphr.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
 
 
 // --- Global Objects ---
+SystemClock systemClock; // 時刻は全てここから取る (64bit msなので約49日での一周が無い)
 Storage storage;
-PulseCounter pulseCounter(PULSE_INPUT_PIN);
-MetricsCalculator metrics(pulseCounter, storage);
+// 入力チャンネル (椅子) ごとに PCNT ユニット1つと計算1つ。数とピンは config.json の channels で決め、setup() で作る
+std::vector<std::unique_ptr<PulseCounter>> pulseCounters;
+std::vector<std::unique_ptr<MetricsCalculator>> channelMetrics;
+MetricsCalculator* metrics = nullptr; // チャンネル0 (画面・履歴・状態遷移はこのチャンネルで判断する)
 Display display;
-WifiManager wifi(storage);
-DataPublisher publisher(wifi);
+WifiManager wifi(storage, systemClock);
+DataPublisher publisher(wifi, systemClock);
 APConfigPortal apPortal(storage, wifi); // APConfigPortal オブジェクト生成
+DiagnosticsServer diagnostics; // /metrics と (プロファイル時は) 処理時間のヒストグラムを HTTP で読む
 
 // --- Global State ---
-AppState currentState = AppState::INITIALIZING;
+// currentState は UIタスクだけが書き、通信タスクが読む
+std::atomic<AppState> currentState(AppState::INITIALIZING);
 DriveType drive_type = DriveType::TIMER_DRIVEN;
 // bool sessionActive = false; // ★ 削除: currentState で管理 ★
-unsigned long lastDebugPrintTime = 0;
-bool timeSynchronized = false; // ★ NTP同期済みフラグを追加 ★
-unsigned long lastNtpSyncAttempt = 0; // ★ 前回のNTP同期試行時刻 ★
+uint64_t lastDebugPrintTime = 0;
+uint64_t lastTaskStatsPrintTime = 0;
+std::atomic<bool> timeSynchronized(false); // ★ NTP同期済みフラグ (通信タスクが書き、各タスクが読む) ★
+uint64_t lastNtpSyncAttempt = 0; // ★ 前回のNTP同期試行時刻 ★
 const unsigned long NTP_SYNC_INTERVAL_MS = 60 * 60 * 1000; // 例: 1時間ごとに再同期試行
 
+// --- タスク間の受け渡し ---
+// 計測タスク → UI/通信タスク: 最新の計測結果 (読み手ごとに三重バッファを1つずつ持つ)
+TripleBuffer<MetricsSnapshot> uiSnapshots;
+TripleBuffer<MetricsSnapshot> networkSnapshots;
+// UIタスクが最後に取り込んだスナップショット (UIタスク専用。次の acquire() まで内容は変わらない)
+inline const MetricsSnapshot& uiSnapshot() { return uiSnapshots.read(); }
+// UIタスク → 計測タスク: MetricsCalculator への操作要求 (ビットの組み合わせ)
+const uint32_t METRICS_CMD_RESET_SESSION = 1 << 0;
+const uint32_t METRICS_CMD_STOPPING_UPDATE = 1 << 1;
+std::atomic<uint32_t> pendingMetricsCommands(0);
+// 計測タスク → 通信タスク: スケジューラに関係なく今すぐ送る (停止イベント)
+std::atomic<bool> forcePublishRequested(false);
+// 計測タスク → 各タスク: RPM・速度の履歴 (書くのは計測タスクだけ。読み書きとも historyMutex の中で)
+// 時刻の軸は NTP で合うまでは起動からのms、合った後は UNIX 時刻のms (履歴の時刻 = 起動からのms + historyOffsetMs)
+// 時刻はディープスリープ中も RTC タイマーで進むので、一度合えば起きた後も UNIX 時刻のまま使え、
+// 分・時の段を RTC メモリに写して持ち越せる (電源を切ると RTC メモリごと消える)
+TimeSeriesStore history;
+int64_t historyOffsetMs = 0;
+RTC_DATA_ATTR bool historyWallClock = false; // 履歴の時刻が UNIX 時刻か
+RTC_DATA_ATTR uint8_t retainedHistory[TimeSeriesStore::retainedBytes()]; // スリープ中の分・時の段
+SampleBuffer samples;        // 送信待ちの1秒ごとのサンプル (圧縮して保持)
+uint64_t lastSampleSecond = 0; // 最後に samples へ入れた秒 (計測タスク専用)
+SemaphoreHandle_t historyMutex = NULL;
+// 計測タスク → 通信タスク: 終わったセッションの要約 (Wi-Fiがつながるまでここで待つ。SDには別途残す)
+QueueHandle_t sessionEvents = NULL;
+// キューに積んでから publishSessionSummary() が戻るまでの要約の数 (取り出し後の送信中も含む)
+std::atomic<uint32_t> sessionEventsInFlight(0);
+
+// --- /metrics (機器全体の値。各モジュールの値はそれぞれのファイルで登録する。ヒープは HeapStats) ---
+RTC_DATA_ATTR uint32_t deepSleepWakeCount = 0; // ディープスリープから起きた回数 (RTCメモリなので電源を切るまで残る)
+float readUptime() { return systemClock.nowMs() / 1000.0f; }
+MetricGauge uptimeMetric("fit2go_uptime_seconds", "Time since boot.", readUptime);
+MetricCounter deepSleepWakesMetric("fit2go_deep_sleep_wakes_total", "Wake-ups from deep sleep since power-on.");
+
+// --- タスク ---
+TaskStats sensingStats("sensing");
+TaskStats networkStats("network");
+TaskStats uiStats("ui");
+TaskStats storageStats("storage");
+TaskStats logStats("log");
+TaskHandle_t sensingTaskHandle = NULL;
+TaskHandle_t networkTaskHandle = NULL;
+TaskHandle_t uiTaskHandle = NULL;
+
+// --- UIタスクのタイマー (DeadlineScheduler のID) ---
+enum UiTimer : size_t {
+    UI_TIMER_POLL,          // ボタン押下中・通知直後・Wi-Fi設定画面などの短周期ポーリング
+    UI_TIMER_DISPLAY,       // Wi-Fi/AP画面の定期再描画
+    UI_TIMER_SLEEP,         // IDLEからディープスリープへ移る時刻
+    UI_TIMER_DEBUG_PRINT,   // デバッグ用シリアル出力
+    UI_TIMER_TASK_STATS     // タスク統計のシリアル出力
+};
+DeadlineScheduler uiScheduler;
+DeadlineScheduler networkScheduler;
+enum NetworkTimer : size_t {
+    NET_TIMER_LINK,         // Wi-Fi状態・NTP・名前解決の確認
+    NET_TIMER_PUBLISH       // 次に送信できる時刻
+};
+const unsigned long DEBUG_PRINT_INTERVAL_MS = 2000;
+std::atomic<bool> buttonEventPending(false); // ボタン割り込みがあったか (UIタスクが消費)
+
+// --- ボタン割り込み: 眠っているUIタスクを起こす ---
+void IRAM_ATTR onButtonInterrupt() {
+    buttonEventPending = true;
+    if (uiTaskHandle != NULL) {
+        BaseType_t higherPriorityTaskWoken = pdFALSE;
+        vTaskNotifyGiveFromISR(uiTaskHandle, &higherPriorityTaskWoken);
+        if (higherPriorityTaskWoken == pdTRUE) {
+            portYIELD_FROM_ISR();
+        }
+    }
+}
+
+// --- 残りms → 待ちtick (NO_DEADLINE なら無期限) ---
+TickType_t waitTicksFor(unsigned long waitMs) {
+    if (waitMs == DeadlineScheduler::NO_DEADLINE)
+        return portMAX_DELAY;
+    TickType_t ticks = pdMS_TO_TICKS(waitMs);
+    if (waitMs > 0 && ticks == 0)
+        ticks = 1; // 1tick未満の残りは切り上げ
+    return ticks;
+}
+
+// --- 電源管理 ---
+// 待ち時間はすべてタスクのブロックなので、アイドル中はFreeRTOSのアイドルタスクがCPUを止める。
+// 電源管理が有効なビルドでは、さらにアイドル中のCPUクロックを下げる。
+// 自動ライトスリープは使わない: ライトスリープ中は APB クロックが止まり、PCNT がパルスを数えられず、
+// ボタンの GPIO 割り込みも届かないため
+void configurePowerManagement() {
+#if CONFIG_PM_ENABLE
+    esp_pm_config_esp32_t pmConfig;
+    pmConfig.max_freq_mhz = 240;
+    pmConfig.min_freq_mhz = 80;         // APB を 80MHz に保つ (PCNT のフィルタ時間が変わらない)
+    pmConfig.light_sleep_enable = false;
+    esp_err_t err = esp_pm_configure(&pmConfig);
+    if (err != ESP_OK) {
+        Serial.printf("Warning: esp_pm_configure failed: %s\n", esp_err_to_name(err));
+    } else {
+        Serial.println("Power management: dynamic frequency scaling enabled (80-240 MHz).");
+    }
+#else
+    Serial.println("Power management: not enabled in this build (CONFIG_PM_ENABLE).");
+#endif
+}
+
 // --- Deep Sleep Wakeup Stub ---
 void IRAM_ATTR pulseWakeupISR() {}
 
@@ -43,51 +173,104 @@ void goToDeepSleep() {
     delay(100);
     // スリープ前に最新の累積データをSDに追記（JSON Lines形式）
     Serial.println("Appending history data before sleep...");
-    if (!storage.appendHistoryDataToSD(metrics.getData())) {
-        Serial.println("Failed to append history data!");
+    // (SD の FAT ドライバはタスク間で排他されるので、ストレージタスクと同時でも安全)
+    const MetricsSnapshot& lastSnapshot = uiSnapshot();
+    for (uint8_t channel = 0; channel < lastSnapshot.channelCount; channel++) {
+        if (!storage.appendHistoryDataToSD(lastSnapshot.channels[channel], channel)) {
+            Serial.printf("Failed to append history data (ch %u)!\n", channel);
+        }
     }
     delay(100); // 書き込み待機
+    // 履歴の分・時の段を RTC メモリへ (時刻が UNIX 時刻のときだけ。起動からのmsは起きた後に意味を持たない)
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    if (historyWallClock) {
+        history.save(retainedHistory);
+    } else {
+        memset(retainedHistory, 0, sizeof(retainedHistory));
+    }
+    xSemaphoreGive(historyMutex);
+    // 終わったばかりのセッション要約を失わないよう、SDへの追記を済ませ、送信も少しだけ待つ
+    // (計測タスクがキュー満杯で預けている分は、積み直されるまで待ってから書く)
+    uint64_t flushStartMs = systemClock.nowMs();
+    while (true) {
+        bool held = storage.hasPendingSession(); // 処理の前に見る: 見た後に積まれた分も下で書かれる
+        storage.processPendingWrites();
+        if (!held || systemClock.nowMs() - flushStartMs >= SESSION_EVENT_FLUSH_TIMEOUT_MS)
+            break;
+        delay(STORAGE_SESSION_RETRY_MS);
+    }
+    // キューが空になっただけでは送信中かもしれないので、publishSessionSummary() が戻るのを待つ
+    while (sessionEventsInFlight.load() > 0 && wifi.isConnected() &&
+           systemClock.nowMs() - flushStartMs < SESSION_EVENT_FLUSH_TIMEOUT_MS) {
+        if (networkTaskHandle != NULL)
+            xTaskNotifyGive(networkTaskHandle);
+        delay(50);
+    }
     M5.Lcd.sleep(); // LCDをスリープ
 
     // --- Wakeup Source Configuration ---
     esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL); // 全てのソースを無効化
-    Serial.printf("Configuring GPIO %d for LOW level wakeup.\n", PULSE_INPUT_PIN);
+    // EXT0 で見られるピンは1本だけなので、チャンネル0のピンで起動する
+    // (EXT1 の「どれかがLow」は ESP32 では使えない。他のチャンネルだけ漕がれても起きない)
+    int wakePin = pulseCounters.empty() ? PULSE_INPUT_PIN : pulseCounters[0]->getPin();
+    Serial.printf("Configuring GPIO %d for LOW level wakeup.\n", wakePin);
     // EXT0: 指定したピンのレベル(0=Low, 1=High)で起動
-    esp_err_t err = esp_sleep_enable_ext0_wakeup((gpio_num_t)PULSE_INPUT_PIN, 0); // Lowレベルで起動
+    esp_err_t err = esp_sleep_enable_ext0_wakeup((gpio_num_t)wakePin, 0); // Lowレベルで起動
     if(err != ESP_OK){ Serial.printf("Failed to enable EXT0 wakeup: %s\n", esp_err_to_name(err)); }
     else { Serial.println("EXT0 Wakeup Enabled on LOW level."); }
 
     // 他の起動要因も必要なら設定 (例: タイマー)
     // esp_sleep_enable_timer_wakeup(10 * 1000000); // 10秒後
 
-    Serial.flush(); // シリアル出力完了待ち
+    Log::flush(LOG_FLUSH_TIMEOUT_MS); // 溜まっているログとシリアル出力の完了待ち
     esp_deep_sleep_start(); // ディープスリープ開始
 }
 
 
+void alignHistoryToWallClock();
+
 // ★★★ NTP同期を開始する関数 ★★★
 void initNtp() {
     // まだ同期していない、または前回の試行から一定時間経過した場合のみ実行
-    if (!timeSynchronized || millis() - lastNtpSyncAttempt > NTP_SYNC_INTERVAL_MS) {
+    if (!timeSynchronized || systemClock.nowMs() - lastNtpSyncAttempt > NTP_SYNC_INTERVAL_MS) {
          Serial.println("Configuring time using NTP...");
          // configTime(GMTオフセット秒, 夏時間オフセット秒, NTPサーバー1, NTPサーバー2)
          configTime(GMT_OFFSET_SEC, DAYLIGHT_OFFSET_SEC, NTP_SERVER1, NTP_SERVER2);
-         lastNtpSyncAttempt = millis();
+         lastNtpSyncAttempt = systemClock.nowMs();
 
          // 同期を確認 (少し待つ)
          struct tm timeinfo;
          // getLocalTime は configTime で設定されたタイムゾーン情報を考慮する
-         if(!getLocalTime(&timeinfo, 5000)){ // 5秒待っても同期できなければ失敗
+         TRACE_BEGIN(TraceEvent::NTP_SYNC, 0);
+         bool synced = getLocalTime(&timeinfo, 5000); // 5秒待っても同期できなければ失敗
+         TRACE_END(TraceEvent::NTP_SYNC, synced);
+         if(!synced){
              Serial.println("Failed to obtain time from NTP");
              timeSynchronized = false; // 同期失敗
          } else {
              Serial.println("Time synchronized via NTP");
              Serial.printf("Current time (JST): %s", asctime(&timeinfo)); // asctime はローカルタイム文字列を生成
              timeSynchronized = true; // 同期成功
+             alignHistoryToWallClock();
          }
     }
 }
 
+
+// ★★★ 履歴の時刻を UNIX 時刻に合わせる (NTP 同期のたび、と起動時) ★★★
+// 起動からのmsで溜めた区間は、時刻の差だけずらして付け替える (再同期のときは差が小さい)
+void alignHistoryToWallClock() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    uint64_t wallMs = (uint64_t)tv.tv_sec * 1000 + (uint64_t)tv.tv_usec / 1000;
+    int64_t offsetMs = (int64_t)(wallMs - systemClock.nowMs());
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    history.rebase(offsetMs - historyOffsetMs);
+    historyOffsetMs = offsetMs;
+    historyWallClock = true;
+    xSemaphoreGive(historyMutex);
+}
+
 // ★★★ 現在のタイムスタンプ(ms)を取得する関数 ★★★
 uint64_t getCurrentTimestampMs() {
     if (wifi.isConnected() && timeSynchronized) {
@@ -97,23 +280,128 @@ uint64_t getCurrentTimestampMs() {
         uint64_t time_ms = (uint64_t)tv.tv_sec * 1000 + (uint64_t)tv.tv_usec / 1000;
         return time_ms;
     } else {
-        // Wi-Fi未接続またはNTP未同期の場合は millis() を返す
-        return millis();
+        // Wi-Fi未接続またはNTP未同期の場合は起動からの経過msを返す
+        return systemClock.nowMs();
     }
 }
 
 
+// ★★★ 起動からのmsを時刻(ms)に直す (未同期なら起動からのmsのまま。synced で見分ける) ★★★
+uint64_t toWallClockMs(uint64_t monotonicMs, bool& synced) {
+    synced = wifi.isConnected() && timeSynchronized;
+    if (!synced)
+        return monotonicMs;
+    uint64_t nowMs = systemClock.nowMs();
+    uint64_t age = nowMs > monotonicMs ? nowMs - monotonicMs : 0;
+    return getCurrentTimestampMs() - age;
+}
+
+
+void startTasks(); // タスク起動 (setup の最後に呼ぶ)
+void requestMetricsCommand(uint32_t command);
+void publishMetricsSnapshot();
+size_t queryHistory(SeriesTier tier, uint64_t fromMs, uint64_t toMs, SeriesPoint* out, size_t maxCount);
+bool latestHistory(SeriesTier tier, SeriesPoint& out);
+bool isHistoryWallClock();
+
+// --- 起動時の初期化 ---
+// 時間のかかる初期化 (LCD, SD と config.json, Wi-Fi) はそれぞれ別のタスクで同時に進める
+// setup() はその間に PCNT を始めておき、全部そろうのを bootEvents で待つ
+EventGroupHandle_t bootEvents = NULL;
+const EventBits_t BOOT_DISPLAY_DONE = 1 << 0;
+const EventBits_t BOOT_STORAGE_DONE = 1 << 1;
+const EventBits_t BOOT_WIFI_DONE = 1 << 2;
+bool storageReady = false; // storage.begin() の結果 (BOOT_STORAGE_DONE の後に読む)
+
+struct InitJob {
+    void (*run)();
+    EventBits_t doneBit;
+};
+
+void initDisplay() {
+    M5.Lcd.begin();
+    display.begin();
+    display.showMessage("Initializing...", 2, true);
+    BootProfiler::mark(BootPhase::DISPLAY_READY);
+}
+
+void initStorage() {
+    storageReady = storage.begin(); // SDのマウントと config.json の読み込み
+    BootProfiler::mark(BootPhase::STORAGE_READY);
+}
+
+// 無線の起動は SD と並行し、接続先 (NVS と config.json) を読むのは Storage の準備ができてから
+// (Storage の NVS は1つの Preferences を使い回すので、storage.begin() と同時には触らない)
+void initWifi() {
+    wifi.begin();
+    xEventGroupWaitBits(bootEvents, BOOT_STORAGE_DONE, pdFALSE, pdTRUE, portMAX_DELAY);
+    wifi.connect(); // 自動接続試行 (NVS -> JSON[0])
+    BootProfiler::mark(BootPhase::WIFI_READY);
+}
+
+void initTask(void* param) {
+    const InitJob* job = static_cast<const InitJob*>(param);
+    job->run();
+    xEventGroupSetBits(bootEvents, job->doneBit);
+    vTaskDelete(NULL);
+}
+
+// 入力チャンネルごとに PCNT を始める (pulseCounters に追加する)。失敗したチャンネルがあれば false
+bool startPulseCounters(const std::vector<PulseChannelConfig>& configs) {
+    bool ok = true;
+    for (size_t i = 0; i < configs.size(); i++) {
+        std::unique_ptr<PulseCounter> counter(new PulseCounter(configs[i].pin, (uint8_t)i, configs[i].filter));
+        if (!counter->begin()) {
+            Serial.printf("PCNT init failed for channel %u (GPIO %d)\n", (unsigned)i, configs[i].pin);
+            ok = false;
+        }
+        pulseCounters.push_back(std::move(counter));
+    }
+    BootProfiler::mark(BootPhase::PCNT_READY);
+    return ok;
+}
+
 // --- Arduino Setup ---
 void setup() {
-    M5.begin(true, true, true, false); // LCD, SD, Serial, I2C=false
+    BootProfiler::begin();
+    M5.begin(false, false, false, false); // ボタンとスピーカーだけ。LCD と SD は初期化タスクで
     Serial.begin(115200);
     Serial.println("\n\n=== Fitness Tracker Booting ===");
 
-    display.begin();
-    display.showMessage("Initializing...", 2, true);
+    // 最初にパルスを数え始める。入力チャンネルは前回 config.json から NVS に写したもの
+    // (無ければ初回の起動なので、config.json を読むまで待つ)
+    std::vector<PulseChannelConfig> earlyChannels;
+    bool pcntOk = true;
+    if (storage.loadPulseChannelsFromNVS(earlyChannels)) {
+        pcntOk = startPulseCounters(earlyChannels);
+        Serial.printf("Pulse counting started before SD (%u channels from NVS)\n", (unsigned)earlyChannels.size());
+    }
 
-    // Storage初期化 (JSONロード含む)
-    if (!storage.begin()) {
+    // LCD と SD は同じ SPI バスを使う。両方のタスクが begin() する前に1回だけ始めておく (2回目以降の begin() は何もしない)
+    // バスの取り合いは SPI のトランザクションのロックで順番になる (起動後の UI タスクと SD 書き込みタスクと同じ)
+    SPI.begin(SPI_SCK_PIN, SPI_MISO_PIN, SPI_MOSI_PIN);
+    bootEvents = xEventGroupCreate();
+    static const InitJob INIT_JOBS[] = {
+        { initDisplay, BOOT_DISPLAY_DONE },
+        { initStorage, BOOT_STORAGE_DONE },
+        { initWifi,    BOOT_WIFI_DONE },
+    };
+    static const char* const INIT_TASK_NAMES[] = { "initDisplay", "initStorage", "initWifi" };
+    const uint32_t initStacks[] = { UI_TASK_STACK, STORAGE_TASK_STACK, NETWORK_TASK_STACK };
+    const UBaseType_t initPriorities[] = { UI_TASK_PRIORITY, STORAGE_TASK_PRIORITY, NETWORK_TASK_PRIORITY };
+    const BaseType_t initCores[] = { UI_TASK_CORE, STORAGE_TASK_CORE, NETWORK_TASK_CORE };
+    for (size_t i = 0; i < sizeof(INIT_JOBS) / sizeof(INIT_JOBS[0]); i++) {
+        const InitJob& job = INIT_JOBS[i];
+        if (xTaskCreatePinnedToCore(initTask, INIT_TASK_NAMES[i], initStacks[i], (void*)&job,
+                                    initPriorities[i], NULL, initCores[i]) != pdPASS) {
+            Serial.printf("Error: Failed to create task '%s', running it here\n", INIT_TASK_NAMES[i]);
+            job.run();
+            xEventGroupSetBits(bootEvents, job.doneBit);
+        }
+    }
+    xEventGroupWaitBits(bootEvents, BOOT_DISPLAY_DONE | BOOT_STORAGE_DONE | BOOT_WIFI_DONE, pdFALSE, pdTRUE, portMAX_DELAY);
+
+    if (!storageReady) {
         // SDカードが無くても動作は継続するかもしれないが、警告表示
         display.showMessage("SD Card FAIL!", 2);
         Serial.println("WARNING: SD Card initialization failed. Config/Data saving will fail.");
@@ -122,20 +410,54 @@ void setup() {
 
     drive_type = storage.getDriveType();
 
-    // PublisherにURLを渡す (Storageから取得)
-    String endpointUrl = storage.getEndpointUrl();
-    publisher.begin(endpointUrl, drive_type); // URLが空でもエラーにはならない
+    // Publisherに送信先一覧を渡す (Storageから取得)
+    publisher.begin(storage.getEndpoints(), drive_type); // 送信先が空でもエラーにはならない
 
-    if (!pulseCounter.begin()) { display.showMessage("PCNT Init FAIL!", 2); delay(3000); /* 必要なら停止 */ }
+    // config.json の入力チャンネルが先に始めたものと違えば (初回の起動・設定の変更)、始め直して NVS に写す
+    // SD が読めなかったときは、NVS の写し (最後に読めた config.json の設定) をそのまま使う
+    const std::vector<PulseChannelConfig>& channelConfigs =
+        storageReady || earlyChannels.empty() ? storage.getPulseChannels() : earlyChannels;
+    if (channelConfigs != earlyChannels) {
+        for (std::unique_ptr<PulseCounter>& counter : pulseCounters)
+            counter->end();
+        pulseCounters.clear();
+        pcntOk = startPulseCounters(channelConfigs);
+        if (storageReady)
+            storage.savePulseChannelsToNVS(channelConfigs);
+    }
+    if (!pcntOk) {
+        display.showMessage("PCNT Init FAIL!", 2); delay(3000); /* 必要なら停止 */
+    }
 
-    metrics.begin(drive_type); // 累積データロード (SDから) & セッションリセット
+    // チャンネルごとに計算を作る
+    // 駆動方式はここで1回だけ選ぶ (計算の中では実行時に判定しない)
+    // 計算を作るまでに来たパルスもカウントには入っているので、最初の更新で動き出しとして扱われる
+    for (const std::unique_ptr<PulseCounter>& counter : pulseCounters) {
+        std::unique_ptr<MetricsCalculator> calculator = MetricsCalculator::create(drive_type, *counter, storage, systemClock);
+        calculator->begin(); // 累積データロード (SDから) & セッションリセット
+        channelMetrics.push_back(std::move(calculator));
+    }
+    metrics = channelMetrics[0].get();
+    Serial.printf("Pulse channels: %u\n", (unsigned)channelMetrics.size());
+    BootProfiler::mark(BootPhase::CHANNELS_READY);
 
-    wifi.begin();    // WiFi初期化 (自動接続試行 NVS->JSON[0])
+    // 履歴 (/history で読むので診断サーバーより先に用意する)
+    historyMutex = xSemaphoreCreateMutex();
+    if (esp_sleep_get_wakeup_cause() != ESP_SLEEP_WAKEUP_UNDEFINED && historyWallClock) {
+        // ディープスリープ前の分・時の段を戻す (時刻はスリープ中も進んでいるので UNIX 時刻のまま続けられる)
+        alignHistoryToWallClock();
+        if (history.restore(retainedHistory)) {
+            Serial.println("History restored from RTC memory");
+        }
+    }
+
+    diagnostics.begin(queryHistory, isHistoryWallClock);
 
     // 起動要因を確認
     esp_sleep_wakeup_cause_t wakeup_reason = esp_sleep_get_wakeup_cause();
     if (wakeup_reason == ESP_SLEEP_WAKEUP_EXT0) {
         Serial.println("Wake up from Deep Sleep (EXT0 - Pulse)");
+        deepSleepWakeCount++;
         currentState = AppState::IDLE_DISPLAY; // ディープスリープ復帰時はアイドルから
         M5.Lcd.wakeup(); M5.Lcd.setBrightness(100); // LCD復帰
         M5.Speaker.tone(500, 100); // 復帰音
@@ -145,159 +467,614 @@ void setup() {
         M5.Lcd.setBrightness(100); // 輝度設定
     }
 
-    display.showMessage("Setup Complete", 2, true); delay(1000);
-    Serial.println("Setup Complete. Entering main loop...");
+    deepSleepWakesMetric.set(deepSleepWakeCount);
+
+    // 計測結果の受け渡し箱を用意し、起動直後の状態を入れておく
+    publishMetricsSnapshot();
+    uiSnapshots.acquire();
+
+    configurePowerManagement();
+
+    // 画面はすぐに UI タスクが描くので、完了の表示で待たない
+    Serial.println("Setup Complete. Starting tasks...");
+    startTasks();
+    BootProfiler::mark(BootPhase::TASKS_STARTED);
+    BootProfiler::print();
 }
 
 
 // --- 状態別ハンドラ関数プロトタイプ ---
-void handleIdleState(unsigned long currentMillis);
-void handleTrackingState(unsigned long currentMillis);
-void handleStoppingState(unsigned long currentMillis); // ★ 追加 ★
-void handleWifiSetupState(unsigned long currentMillis);
-void handleWifiConnectingState(unsigned long currentMillis);
-void handleWifiScanningState(unsigned long currentMillis);
-void handleAPConfigState(unsigned long currentMillis);
+void handleIdleState(uint64_t currentMillis);
+void handleTrackingState(uint64_t currentMillis);
+void handleStoppingState(uint64_t currentMillis); // ★ 追加 ★
+void handleWifiSetupState(uint64_t currentMillis);
+void handleWifiConnectingState(uint64_t currentMillis);
+void handleWifiScanningState(uint64_t currentMillis);
+void handleAPConfigState(uint64_t currentMillis);
 
 
 // --- Arduino Loop ---
+// 処理はすべてタスクで行うので、loop タスク自体は不要
 void loop() {
-    unsigned long currentMillis = millis();
-    M5.update(); // ボタン状態更新は最初に
+    vTaskDelete(NULL);
+}
 
-    // --- APモードがアクティブなら専用処理 ---
-    if (apPortal.isActive()) {
-        handleAPConfigState(currentMillis); // APモードハンドラ呼び出し
-    } else {
-        // --- APモードでない場合の通常処理 ---
-        wifi.updateStatus(); // WiFi接続状態更新 (STAモード時)
-        bool data_updated = metrics.update(currentMillis); // 計測データ更新 (isMoving, isTimerRunning がここで更新される)
 
-        // ★★★ Wi-Fi接続時にNTP同期を試みる ★★★
-        if (wifi.isConnected()) {
-             initNtp(); // 同期済み or 一定時間経過していたら再同期を試みる
-        } else {
-             // Wi-Fiが切断されたら、同期フラグをリセット
-             if (timeSynchronized) {
-                 Serial.println("WiFi disconnected, NTP sync status reset.");
-                 timeSynchronized = false;
-             }
+// ★★★ MetricsCalculator への操作を計測タスクに依頼し、反映されるまで待つ (UIタスクから呼ぶ) ★★★
+// 反映前の古いスナップショットで状態遷移を判定しないよう、反映後のスナップショットを取り直す
+void requestMetricsCommand(uint32_t command) {
+    pendingMetricsCommands.fetch_or(command);
+    if (sensingTaskHandle != NULL) {
+        xTaskNotifyGive(sensingTaskHandle); // 次の期限まで眠っている計測タスクを起こす
+    }
+    for (int waited = 0; (pendingMetricsCommands.load() & command) != 0 && waited < 100; waited++) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    uiSnapshots.acquire();
+}
+
+
+// ★★★ 計測結果をすべての読み手に公開する (計測タスクから呼ぶ) ★★★
+void publishMetricsSnapshot() {
+    MetricsSnapshot& snapshot = uiSnapshots.writeBuffer();
+    metrics->fillSnapshot(snapshot);
+    // 状態はどれか1つのチャンネルでも動いていれば動作中とみなす
+    snapshot.channelCount = (uint8_t)channelMetrics.size();
+    snapshot.channels[0] = snapshot.data;
+    for (size_t i = 1; i < channelMetrics.size(); i++) {
+        const MetricsCalculator& channel = *channelMetrics[i];
+        snapshot.channels[i] = channel.getData();
+        snapshot.moving |= channel.isMoving();
+        snapshot.timerRunning |= channel.isTimerRunning();
+        if (channel.getLastPulseObservedMs() > snapshot.lastPulseObservedMs)
+            snapshot.lastPulseObservedMs = channel.getLastPulseObservedMs();
+        snapshot.updateSequence += channel.getUpdateSequence();
+    }
+    networkSnapshots.writeBuffer() = snapshot;
+    uiSnapshots.commit();
+    networkSnapshots.commit();
+    // 読み手を起こす (どちらも次の期限まで眠っている)
+    if (uiTaskHandle != NULL)
+        xTaskNotifyGive(uiTaskHandle);
+    if (networkTaskHandle != NULL)
+        xTaskNotifyGive(networkTaskHandle);
+}
+
+
+// ★★★ 履歴の読み出し (どのタスクからでも呼べる) ★★★
+// 結果は呼び出し側のバッファへコピーするので、ロックを持つのはコピーの間だけ
+// (計測タスクが待たされても、mutex の優先度継承で読み手がすぐに終わらせる)
+size_t queryHistory(SeriesTier tier, uint64_t fromMs, uint64_t toMs, SeriesPoint* out, size_t maxCount) {
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    size_t count = history.query(tier, fromMs, toMs, out, maxCount);
+    xSemaphoreGive(historyMutex);
+    return count;
+}
+
+bool latestHistory(SeriesTier tier, SeriesPoint& out) {
+    xSemaphoreTake(historyMutex, portMAX_DELAY);
+    bool found = history.latest(tier, out);
+    xSemaphoreGive(historyMutex);
+    return found;
+}
+
+bool isHistoryWallClock() {
+    return historyWallClock;
+}
+
+
+// ★★★ 計測タスク (最優先) ★★★
+// パルスの集計とメトリクス計算だけを行う。SD書き込みや通信はここでは待たない
+// 周期的には動かず、パルス (ISRからの通知)・UIからの依頼・次の期限 のいずれかで起きる
+void sensingTask(void* param) {
+    PulseCounter::setNotifyTask(xTaskGetCurrentTaskHandle()); // 全チャンネル共通の割り込みから起こされる
+    while (true) {
+        sensingStats.beginIteration();
+        uint64_t currentMillis = systemClock.nowMs();
+
+        // UIタスクからの操作要求を反映
+        uint32_t commands = pendingMetricsCommands.load();
+        // 全チャンネルを更新する (ボタン操作は全チャンネルに効く)。履歴とサンプルはチャンネル0のもの
+        bool calculated = false;
+        for (size_t i = 0; i < channelMetrics.size(); i++) {
+            MetricsCalculator& channel = *channelMetrics[i];
+            if (commands & METRICS_CMD_RESET_SESSION) {
+                channel.resetSession();
+            }
+            bool channelCalculated;
+            {
+                PROFILE_SCOPE(ProfileStage::METRICS_UPDATE);
+                TRACE_SPAN(TraceEvent::METRICS_UPDATE, i);
+                channelCalculated = channel.update(currentMillis);
+            }
+            if (i == 0)
+                calculated = channelCalculated;
+            if (commands & METRICS_CMD_STOPPING_UPDATE) {
+                channel.stoppingDataUpdate();
+            }
+        }
+        // タイマー動作中の計算結果を履歴へ (TIMER駆動なら毎秒1件、EVENT駆動ならパルスごと)
+        if (calculated && metrics->isTimerRunning()) {
+            const TrackerData& data = metrics->getData();
+            uint64_t second = currentMillis / 1000;
+            xSemaphoreTake(historyMutex, portMAX_DELAY);
+            history.append(currentMillis + historyOffsetMs, data.currentRpm, data.currentSpeedKmh);
+            if (second != lastSampleSecond) {
+                // 1秒に1件。時刻を秒の頭にそろえると、時刻の列はほぼ1bit/件で済む
+                samples.append(Sample::fromMetrics(second * 1000, data.currentRpm, DefaultChairModel::KMH_PER_RPM,
+                                                   data.sessionPulseCount));
+                lastSampleSecond = second;
+            }
+            xSemaphoreGive(historyMutex);
         }
 
-        // ★ 状態遷移ロジックを各ハンドラに移動 ★
-        // 状態別ハンドラ呼び出し
-        switch (currentState) {
-            case AppState::IDLE_DISPLAY:
-                handleIdleState(currentMillis);
-                break;
-            case AppState::TRACKING_DISPLAY:
-                handleTrackingState(currentMillis);
-                break;
-            case AppState::STOPPING:
-                handleStoppingState(currentMillis);  // ★ STOPPINGハンドラ呼び出し ★
-                break;
-            case AppState::WIFI_SETUP:
-                handleWifiSetupState(currentMillis);
-                break;
-            case AppState::WIFI_CONNECTING:
-                handleWifiConnectingState(currentMillis);
-                break;
-            case AppState::WIFI_SCANNING:
-                handleWifiScanningState(currentMillis);
-                break;
-            // WIFI_AP_CONFIG は isActive() で処理される
-            case AppState::SLEEPING:          /* スリープ移行処理は loop の最後で */
-                break;
-            case AppState::INITIALIZING:      /* 通常ここには来ない */
-                break;
-            default:
-                 // 不明な状態になったらアイドルに戻すなど
-                 Serial.printf("Warning: Unknown AppState %d. Resetting to IDLE.\n", (int)currentState);
-                 currentState = AppState::IDLE_DISPLAY;
-                 break;
+        // 終わったセッションの要約: SDへ追記し、通信タスクに送らせる
+        storage.retryPendingSession(); // 前回キュー満杯で預けた分を先に積む
+        for (const std::unique_ptr<MetricsCalculator>& channel : channelMetrics) {
+            SessionSummary summary;
+            if (!channel->takeFinishedSession(summary))
+                continue;
+            TRACE_INSTANT(TraceEvent::SESSION_END, summary.channel);
+            bool endSynced = false;
+            summary.startWallMs = toWallClockMs(summary.startMs, summary.wallClockSynced);
+            summary.endWallMs = toWallClockMs(summary.endMs, endSynced);
+            summary.wallClockSynced = summary.wallClockSynced && endSynced;
+            storage.requestAppendSession(summary);
+            sessionEventsInFlight++; // 積む前に数える (通信タスクが先に取り出しても 0 を下回らない)
+            if (xQueueSend(sessionEvents, &summary, 0) != pdTRUE) {
+                sessionEventsInFlight--;
+                LOG_W("Session event queue full. Summary kept on SD only.");
+            } else if (networkTaskHandle != NULL) {
+                xTaskNotifyGive(networkTaskHandle);
+            }
         }
 
-        // ★ データ送信条件を TRACKING_DISPLAY のみに変更 ★
-        if (currentState == AppState::TRACKING_DISPLAY && wifi.isConnected()) {
-            if (drive_type == DriveType::EVENT_DRIVEN)
-                if (data_updated){
-                    publisher.publishIfNeeded(metrics.getData());
-                    data_updated = false;
+        publishMetricsSnapshot();
+        if (commands != 0) {
+            // スナップショットを出した後でフラグを落とす (UIタスクは反映済みの値を読める)
+            pendingMetricsCommands.fetch_and(~commands);
+            if (commands & METRICS_CMD_STOPPING_UPDATE) {
+                forcePublishRequested = true; // 停止イベントはスケジューラに関係なく送る
+                if (networkTaskHandle != NULL)
+                    xTaskNotifyGive(networkTaskHandle);
+            }
+        }
+        sensingStats.endIteration();
+
+        // 次の期限まで眠る (期限が無ければパルスか依頼が来るまで)。期限は全チャンネルで最も近いもの
+        uint64_t deadlineBaseMs = systemClock.nowMs();
+        unsigned long nextDeadlineMs = MetricsCalculator::NO_DEADLINE;
+        for (const std::unique_ptr<MetricsCalculator>& channel : channelMetrics) {
+            unsigned long ms = channel->msUntilNextDeadline(deadlineBaseMs);
+            if (ms < nextDeadlineMs)
+                nextDeadlineMs = ms;
+        }
+        if (storage.hasPendingSession() && STORAGE_SESSION_RETRY_MS < nextDeadlineMs)
+            nextDeadlineMs = STORAGE_SESSION_RETRY_MS; // 預けたセッション要約の積み直し
+        ulTaskNotifyTake(pdTRUE, waitTicksFor(nextDeadlineMs));
+    }
+}
+
+
+// ★★★ 通信タスク (コア0) ★★★
+// NTP同期・名前解決・データ送信。HTTPの応答待ちで止まっても計測と画面には影響しない
+// 新しいスナップショットの通知か、次の送信時刻・リンク確認の期限で起きる
+void networkTask(void* param) {
+    uint32_t lastPublishedSequence = 0;
+    // EVENT駆動は計算結果が更新されたときだけ送る (駆動方式は起動後に変わらないので先に決めておく)
+    const bool publishOnlyNewData = drive_type == DriveType::EVENT_DRIVEN;
+    bool linkUp = false; // 前の周のWi-Fi接続状態 (変化をトレースに残す)
+    while (true) {
+        networkStats.beginIteration();
+        uint64_t currentMillis = systemClock.nowMs();
+        bool connected = wifi.isConnected();
+        if (connected != linkUp) {
+            TRACE_INSTANT(TraceEvent::WIFI_LINK, connected);
+            linkUp = connected;
+        }
+
+        if (apPortal.isActive()) {
+            // APモード中は送信しない
+        } else if (wifi.isConnected()) {
+            // ★★★ Wi-Fi接続時にNTP同期を試みる ★★★
+            initNtp(); // 同期済み or 一定時間経過していたら再同期を試みる
+            publisher.maintain(currentMillis); // 送信先の名前解決を先に済ませておく
+
+            // 終わったセッションの要約は、送信中の状態や送信間隔に関係なく送る
+            SessionSummary summary;
+            while (xQueueReceive(sessionEvents, &summary, 0) == pdTRUE) {
+                publisher.publishSessionSummary(summary);
+                sessionEventsInFlight--;
+            }
+
+            networkSnapshots.acquire();
+            const MetricsSnapshot& snapshot = networkSnapshots.read();
+            if (forcePublishRequested.exchange(false)) {
+                publisher.publishIfNeeded(snapshot.channels, snapshot.channelCount, true);
+                lastPublishedSequence = snapshot.updateSequence;
+            } else if (currentState == AppState::TRACKING_DISPLAY) {
+                // ★ データ送信は TRACKING_DISPLAY のみ ★
+                if (publishOnlyNewData) {
+                    if (snapshot.updateSequence != lastPublishedSequence) {
+                        publisher.publishIfNeeded(snapshot.channels, snapshot.channelCount);
+                        lastPublishedSequence = snapshot.updateSequence;
+                    }
+                } else {
+                    publisher.publishIfNeeded(snapshot.channels, snapshot.channelCount);
                 }
-            if (drive_type == DriveType::TIMER_DRIVEN){
-                // Serial.printf("Timer driven publish.\n");
-                publisher.publishIfNeeded(metrics.getData());
+            }
+        } else {
+            // Wi-Fiが切断されたら、同期フラグをリセット
+            forcePublishRequested = false;
+            if (timeSynchronized) {
+                LOG_I("WiFi disconnected, NTP sync status reset.");
+                timeSynchronized = false;
             }
         }
+        networkStats.endIteration();
 
-        // スリープ移行判定 (Idle状態でのみ)
-        if (currentState == AppState::IDLE_DISPLAY) {
-             unsigned long lastPulseTime = metrics.getLastPulseObservedMs();
-             bool shouldSleep = false;
-             // 起動直後などで lastPulseTime が 0 の場合も考慮
-             if (lastPulseTime > 0) { // 過去にペダルを漕いだことがある場合
-                 if (currentMillis - lastPulseTime > SLEEP_TIMEOUT_MS) {
-                     shouldSleep = true;
-                     // Serial.println("Main: Idle & Sleep Timeout after last pulse.");
+        // 次の期限を決めて眠る
+        currentMillis = systemClock.nowMs();
+        networkScheduler.setAfter(NET_TIMER_LINK, currentMillis, NETWORK_LINK_CHECK_INTERVAL_MS);
+        unsigned long publishMs = DeadlineScheduler::NO_DEADLINE;
+        if (!apPortal.isActive() && wifi.isConnected() && currentState == AppState::TRACKING_DISPLAY) {
+            // EVENT駆動で新しい計算結果が無ければ、送信時期が来ていても送らない (次の計算結果の通知で起きる)
+            bool newData = !publishOnlyNewData || networkSnapshots.read().updateSequence != lastPublishedSequence;
+            publishMs = publisher.msUntilNextWork(currentMillis, newData);
+        }
+        if (publishMs != DeadlineScheduler::NO_DEADLINE)
+            networkScheduler.setAfter(NET_TIMER_PUBLISH, currentMillis, publishMs);
+        else
+            networkScheduler.clear(NET_TIMER_PUBLISH);
+        bool notified = ulTaskNotifyTake(pdTRUE, waitTicksFor(networkScheduler.prepareSleep(currentMillis))) > 0;
+        networkScheduler.onWake(systemClock.nowMs(), notified);
+    }
+}
+
+
+// ★★★ 状態遷移をトレースに残す (UIタスクから1周に1回呼ぶ。状態を変えるのはほぼUIタスクなので取りこぼさない) ★★★
+void traceStateChange() {
+#if FIT2GO_TRACING
+    static AppState traced = AppState::INITIALIZING;
+    AppState state = currentState;
+    if (state != traced) {
+        TRACE_INSTANT(TraceEvent::STATE, ((uint32_t)traced << 8) | (uint32_t)state);
+        traced = state;
+    }
+#endif
+}
+
+
+#if FIT2GO_PROFILING || FIT2GO_TRACING
+// ★★★ シリアルからのコマンド (UIタスクから呼ぶ。読めるだけ読んで戻り、待たない) ★★★
+//   prof        処理時間のヒストグラムを表示 (FIT2GO_PROFILING)
+//   prof reset  表示してから空にする
+//   trace       イベントトレースを16進でシリアルへ (FIT2GO_TRACING。tools/trace_to_chrome.py でログから取り出せる)
+//   trace sd    イベントトレースをSDの TRACE_DUMP_PATH へ
+// UIタスクは次の期限まで眠るので、反応は最大で DEBUG_PRINT_INTERVAL_MS 遅れる
+void handleSerialCommands() {
+    static char line[32];
+    static size_t length = 0;
+    while (Serial.available() > 0) {
+        int c = Serial.read();
+        if (c != '\n' && c != '\r') {
+            if (length < sizeof(line) - 1)
+                line[length++] = (char)c;
+            continue;
+        }
+        if (length == 0)
+            continue;
+        line[length] = '\0';
+        length = 0;
+#if FIT2GO_PROFILING
+        if (strcmp(line, "prof") == 0 || strcmp(line, "prof reset") == 0) {
+            Profiler::report(Serial);
+            if (strcmp(line, "prof reset") == 0) {
+                Profiler::reset();
+                Serial.println("[Profile] reset");
+            }
+            continue;
+        }
+#endif
+#if FIT2GO_TRACING
+        if (strcmp(line, "trace") == 0) {
+            Trace::dumpHex(Serial);
+            continue;
+        }
+        if (strcmp(line, "trace sd") == 0) {
+            Serial.printf("[Trace] %s to %s\n", storage.saveTraceToSD() ? "Saved" : "Failed to save", TRACE_DUMP_PATH);
+            continue;
+        }
+#endif
+        Serial.printf("Unknown command: %s\n", line);
+    }
+}
+#endif
+
+
+// ★★★ UIタスク ★★★
+// ボタン・状態遷移・画面表示・デバッグ出力
+// 一定周期では動かず、ボタン割り込み・新しいスナップショット・期限 (スリープ判定やデバッグ出力) で起きる。
+// 画面は内容が変わったときだけ描き直す
+void uiTask(void* param) {
+    const int buttonPins[] = { BUTTON_A_PIN, BUTTON_B_PIN, BUTTON_C_PIN };
+    for (int pin : buttonPins) {
+        attachInterrupt(digitalPinToInterrupt(pin), onButtonInterrupt, CHANGE);
+    }
+    AppState lastDrawnState = AppState::INITIALIZING;
+    TrackerData lastDrawnData;
+    bool lastDrawnWifi = false;
+    uint64_t lastActivityMs = 0; // 最後にボタン操作や計測結果の更新があった時刻
+    bool notified = true;
+
+    while (true) {
+        uiStats.beginIteration();
+        uint64_t currentMillis = systemClock.nowMs();
+        M5.update(); // ボタン状態更新は最初に (ブザーの停止もここで行われる)
+        bool buttonEvent = buttonEventPending.exchange(false);
+        bool freshSnapshot = uiSnapshots.acquire(); // このタスクでは次の周期までこのスナップショットだけを見る
+        if (notified || buttonEvent) {
+            lastActivityMs = currentMillis;
+        }
+
+        // --- APモードがアクティブなら専用処理 ---
+        if (apPortal.isActive()) {
+            PROFILE_SCOPE(ProfileStage::STATE_AP_CONFIG);
+            handleAPConfigState(currentMillis); // APモードハンドラ呼び出し
+        } else {
+            // --- APモードでない場合の通常処理 ---
+            wifi.updateStatus(); // WiFi接続状態更新 (STAモード時)
+
+            // ★ 状態遷移ロジックを各ハンドラに移動 ★
+            // 状態別ハンドラ呼び出し
+            switch (currentState.load()) {
+                case AppState::IDLE_DISPLAY: {
+                    PROFILE_SCOPE(ProfileStage::STATE_IDLE);
+                    handleIdleState(currentMillis);
+                    break;
+                }
+                case AppState::TRACKING_DISPLAY: {
+                    PROFILE_SCOPE(ProfileStage::STATE_TRACKING);
+                    handleTrackingState(currentMillis);
+                    break;
+                }
+                case AppState::STOPPING: {
+                    PROFILE_SCOPE(ProfileStage::STATE_STOPPING);
+                    handleStoppingState(currentMillis);  // ★ STOPPINGハンドラ呼び出し ★
+                    break;
+                }
+                case AppState::WIFI_SETUP: {
+                    PROFILE_SCOPE(ProfileStage::STATE_WIFI_SETUP);
+                    handleWifiSetupState(currentMillis);
+                    break;
+                }
+                case AppState::WIFI_CONNECTING: {
+                    PROFILE_SCOPE(ProfileStage::STATE_WIFI_CONNECTING);
+                    handleWifiConnectingState(currentMillis);
+                    break;
+                }
+                case AppState::WIFI_SCANNING: {
+                    PROFILE_SCOPE(ProfileStage::STATE_WIFI_SCANNING);
+                    handleWifiScanningState(currentMillis);
+                    break;
+                }
+                // WIFI_AP_CONFIG は isActive() で処理される
+                case AppState::SLEEPING:          /* スリープ移行処理は最後で */
+                    break;
+                case AppState::INITIALIZING:      /* 通常ここには来ない */
+                    break;
+                default:
+                     // 不明な状態になったらアイドルに戻すなど
+                     LOG_W("Warning: Unknown AppState %d. Resetting to IDLE.", (int)currentState.load());
+                     currentState = AppState::IDLE_DISPLAY;
+                     break;
+            }
+
+            // スリープ移行判定 (Idle状態でのみ)
+            if (currentState == AppState::IDLE_DISPLAY) {
+                 uint64_t lastPulseTime = uiSnapshot().lastPulseObservedMs;
+                 bool shouldSleep = false;
+                 // 起動直後などで lastPulseTime が 0 の場合も考慮
+                 if (lastPulseTime > 0) { // 過去にペダルを漕いだことがある場合
+                     if (currentMillis > lastPulseTime + SLEEP_TIMEOUT_MS) {
+                         shouldSleep = true;
+                         // Serial.println("Main: Idle & Sleep Timeout after last pulse.");
+                     }
+                 } else { // まだ一度も漕いでいない場合
+                     if (currentMillis > SLEEP_TIMEOUT_MS) { // 起動後、一定時間操作がなければスリープ
+                          shouldSleep = true;
+                          // Serial.println("Main: Idle & Sleep Timeout since boot.");
+                     }
                  }
-             } else { // まだ一度も漕いでいない場合
-                 if (currentMillis > SLEEP_TIMEOUT_MS) { // 起動後、一定時間操作がなければスリープ
-                      shouldSleep = true;
-                      // Serial.println("Main: Idle & Sleep Timeout since boot.");
+                 if (shouldSleep) {
+                     LOG_I("Main: Preparing deep sleep.");
+                     currentState = AppState::SLEEPING;
                  }
+            }
+
+             // --- デバッグ用シリアル出力 (★NTP同期状態追加★) ---
+             if (currentMillis - lastDebugPrintTime > DEBUG_PRINT_INTERVAL_MS) {
+                 unsigned long currentSwCount = uiSnapshot().pulseCount;
+                 uint64_t lastPulseTimestampFromCounter = pulseCounters[0]->getLastPulseTime();
+                 uint64_t lastPulseTimestampFromMetrics = uiSnapshot().lastPulseObservedMs;
+                 int16_t hardware_count = 0;
+                 // pcnt_get_counter_value はユニットを指定する必要がある
+                 esp_err_t err = pcnt_get_counter_value(PCNT_UNIT, &hardware_count); // PCNT_UNIT_0 を使う
+                 uint64_t currentTs = getCurrentTimestampMs(); // 現在時刻取得テスト
+
+                 if (err == ESP_OK) {
+                     LOG_I("[%llu] HW:%d SW:%lu LastPulse(PC):%llu LastPulse(Met):%llu State:%d WiFi:%d NTP:%d",
+                             currentTs, hardware_count, currentSwCount,
+                             (unsigned long long)lastPulseTimestampFromCounter, (unsigned long long)lastPulseTimestampFromMetrics,
+                             (int)currentState.load(), wifi.isConnected(), timeSynchronized.load());
+                 } else {
+                         LOG_I("[%llu] SW:%lu LastPulse(PC):%llu LastPulse(Met):%llu State:%d WiFi:%d NTP:%d",
+                             currentTs, currentSwCount,
+                             (unsigned long long)lastPulseTimestampFromCounter, (unsigned long long)lastPulseTimestampFromMetrics,
+                             (int)currentState.load(), wifi.isConnected(), timeSynchronized.load());
+                 }
+                 SeriesPoint minute;
+                 if (latestHistory(SeriesTier::MINUTES, minute)) {
+                     LOG_I("[History] minute@%llu n:%u rpm %.1f/%.1f/%.1f kmh %.1f/%.1f/%.1f (min/mean/max)",
+                           (unsigned long long)minute.startMs, minute.bucket.count,
+                           TimeSeriesStore::toRpm(minute.bucket.rpmMin), TimeSeriesStore::toRpm(minute.bucket.rpmMean),
+                           TimeSeriesStore::toRpm(minute.bucket.rpmMax), TimeSeriesStore::toKmh(minute.bucket.speedMin),
+                           TimeSeriesStore::toKmh(minute.bucket.speedMean), TimeSeriesStore::toKmh(minute.bucket.speedMax));
+                 }
+                 xSemaphoreTake(historyMutex, portMAX_DELAY);
+                 uint32_t sampleCount = samples.getSampleCount();
+                 size_t sampleBytes = samples.getBytesUsed();
+                 uint32_t droppedSamples = samples.getDroppedSamples();
+                 xSemaphoreGive(historyMutex);
+                 if (sampleCount > 0) {
+                     LOG_I("[Samples] %u samples in %u bytes (%.1f bits each), dropped %u", sampleCount,
+                           (unsigned)sampleBytes, sampleBytes * 8.0f / sampleCount, droppedSamples);
+                 }
+                 lastDebugPrintTime = currentMillis;
              }
-             if (shouldSleep) {
-                 Serial.println("Main: Preparing deep sleep.");
-                 currentState = AppState::SLEEPING;
-             }
+
+        } // end if (!apPortal.isActive())
+
+#if FIT2GO_PROFILING || FIT2GO_TRACING
+        handleSerialCommands();
+#endif
+
+        // --- タスクごとの処理時間とスタック残量 ---
+        if (currentMillis - lastTaskStatsPrintTime > TASK_STATS_PRINT_INTERVAL_MS) {
+            TaskStats* allStats[] = { &sensingStats, &networkStats, &uiStats, &storageStats, &logStats };
+            for (TaskStats* stats : allStats) {
+                stats->print();
+                stats->resetWindow();
+            }
+            LOG_I("[Task] wakeups ui:%u (event %u, max late %lums) network:%u (event %u, max late %lums)",
+                  uiScheduler.getWakeups(), uiScheduler.getEventWakeups(), uiScheduler.getMaxLatenessMs(),
+                  networkScheduler.getWakeups(), networkScheduler.getEventWakeups(), networkScheduler.getMaxLatenessMs());
+            HeapStats::print();
+            lastTaskStatsPrintTime = currentMillis;
         }
 
+        traceStateChange();
 
-         // --- デバッグ用シリアル出力 (★NTP同期状態追加★) ---
-         if (currentMillis - lastDebugPrintTime > 2000) {
-             unsigned long currentSwCount = pulseCounter.getPulseCount();
-             unsigned long lastPulseTimestampFromCounter = pulseCounter.getLastPulseTime();
-             unsigned long lastPulseTimestampFromMetrics = metrics.getLastPulseObservedMs();
-             int16_t hardware_count = 0;
-             // pcnt_get_counter_value はユニットを指定する必要がある
-             esp_err_t err = pcnt_get_counter_value(PCNT_UNIT, &hardware_count); // PCNT_UNIT_0 を使う
-             uint64_t currentTs = getCurrentTimestampMs(); // 現在時刻取得テスト
-
-             if (err == ESP_OK) {
-                 Serial.printf("[%llu] HW:%d SW:%lu LastPulse(PC):%lu LastPulse(Met):%lu State:%d WiFi:%d NTP:%d\n",
-                                 currentTs, hardware_count, currentSwCount,
-                                 lastPulseTimestampFromCounter, lastPulseTimestampFromMetrics,
-                                 (int)currentState, wifi.isConnected(), timeSynchronized);
-             } else {
-                     Serial.printf("[%llu] SW:%lu LastPulse(PC):%lu LastPulse(Met):%lu State:%d WiFi:%d NTP:%d\n",
-                                 currentTs, currentSwCount,
-                                 lastPulseTimestampFromCounter, lastPulseTimestampFromMetrics,
-                                 (int)currentState, wifi.isConnected(), timeSynchronized);
-             }
-             lastDebugPrintTime = currentMillis;
-         }
+        // --- 画面表示更新 (変化があったときだけ) ---
+        AppState state = currentState;
+        bool settingsScreen = apPortal.isActive() || state == AppState::WIFI_SETUP ||
+                              state == AppState::WIFI_CONNECTING || state == AppState::WIFI_SCANNING;
+        bool wifiConnected = wifi.isConnected();
+        bool redraw = state != lastDrawnState || buttonEvent || wifiConnected != lastDrawnWifi ||
+                      (freshSnapshot && uiSnapshot().data != lastDrawnData) ||
+                      (settingsScreen && uiScheduler.isDue(UI_TIMER_DISPLAY, currentMillis));
+        if (redraw) {
+            PROFILE_SCOPE(ProfileStage::DISPLAY_UPDATE);
+            TRACE_SPAN(TraceEvent::DISPLAY_UPDATE, 0);
+            display.update(uiSnapshot().data, uiSnapshot().cadence, state, wifi, apPortal);
+            lastDrawnState = state;
+            lastDrawnData = uiSnapshot().data;
+            lastDrawnWifi = wifiConnected;
+            uiScheduler.setAfter(UI_TIMER_DISPLAY, currentMillis, DISPLAY_REFRESH_INTERVAL_MS);
+        }
+
+        // --- スリープ実行 ---
+        if (currentState == AppState::SLEEPING) {
+            goToDeepSleep();
+        }
+        uiStats.endIteration();
+
+        // --- 次の期限を決めて眠る ---
+        currentMillis = systemClock.nowMs();
+        state = currentState;
+        bool buttonHeld = M5.BtnA.isPressed() || M5.BtnB.isPressed() || M5.BtnC.isPressed();
+        // 押しっぱなし (長押し判定・チャタリング) や通知直後 (ブザーの停止) は短周期で見る。
+        // Wi-Fi接続中・APモードも接続状況やWebサーバーを見るため短周期
+        if (buttonHeld || currentMillis - lastActivityMs < UI_ACTIVE_POLL_MS ||
+            state == AppState::WIFI_CONNECTING || apPortal.isActive()) {
+            uiScheduler.setAfter(UI_TIMER_POLL, currentMillis, UI_TASK_PERIOD_MS);
+        } else {
+            uiScheduler.clear(UI_TIMER_POLL);
+        }
+        if (!settingsScreen)
+            uiScheduler.clear(UI_TIMER_DISPLAY);
+        if (state == AppState::IDLE_DISPLAY) {
+            // 判定は「しきい値を超えたら」なので1ms後
+            uiScheduler.set(UI_TIMER_SLEEP, uiSnapshot().lastPulseObservedMs + SLEEP_TIMEOUT_MS + 1);
+        } else {
+            uiScheduler.clear(UI_TIMER_SLEEP);
+        }
+        uiScheduler.set(UI_TIMER_DEBUG_PRINT, lastDebugPrintTime + DEBUG_PRINT_INTERVAL_MS + 1);
+        uiScheduler.set(UI_TIMER_TASK_STATS, lastTaskStatsPrintTime + TASK_STATS_PRINT_INTERVAL_MS + 1);
 
-    } // end if (!apPortal.isActive())
+        notified = ulTaskNotifyTake(pdTRUE, waitTicksFor(uiScheduler.prepareSleep(currentMillis))) > 0;
+        uiScheduler.onWake(systemClock.nowMs(), notified);
+    }
+}
 
 
-    // --- 画面表示更新 ---
-    display.update(metrics.getData(), currentState, wifi, apPortal);
+// ★★★ ストレージタスク (最低優先度) ★★★
+// 計測タスクから依頼されたSD書き込みを順に処理する
+void storageTask(void* param) {
+    while (true) {
+        // 要求が来るまで眠る (統計には書き込みにかかった時間だけを数える)
+        if (!storage.waitForPendingWrites(portMAX_DELAY))
+            continue;
+        storageStats.beginIteration();
+        storage.processPendingWrites();
+        storageStats.endIteration();
+    }
+}
 
 
-    // --- スリープ実行 ---
-    if (currentState == AppState::SLEEPING) {
-        goToDeepSleep();
+// ★★★ ログタスク (最低優先度) ★★★
+// 各タスクが LOG_x で溜めたメッセージを書式化してシリアルへ出す。UARTの送信待ちはこのタスクだけが負う
+void logTask(void* param) {
+    while (true) {
+        logStats.beginIteration();
+        Log::drain(Serial);
+        logStats.endIteration();
+        Log::waitForMessages();
     }
+}
+
 
-    delay(10); // Main loop delay
+// ★★★ タスク起動 ★★★
+void startTasks() {
+    sessionEvents = xQueueCreate(SESSION_EVENT_QUEUE_DEPTH, sizeof(SessionSummary));
+    struct TaskDef {
+        TaskFunction_t function;
+        const char* name;
+        uint32_t stack;
+        UBaseType_t priority;
+        BaseType_t core;
+        TaskStats& stats;
+    };
+    TaskDef defs[] = {
+        { sensingTask, "sensing", SENSING_TASK_STACK, SENSING_TASK_PRIORITY, SENSING_TASK_CORE, sensingStats },
+        { networkTask, "network", NETWORK_TASK_STACK, NETWORK_TASK_PRIORITY, NETWORK_TASK_CORE, networkStats },
+        { uiTask,      "ui",      UI_TASK_STACK,      UI_TASK_PRIORITY,      UI_TASK_CORE,      uiStats },
+        { storageTask, "storage", STORAGE_TASK_STACK, STORAGE_TASK_PRIORITY, STORAGE_TASK_CORE, storageStats },
+        { logTask,     "log",     LOG_TASK_STACK,     LOG_TASK_PRIORITY,     LOG_TASK_CORE,     logStats },
+    };
+    for (TaskDef& def : defs) {
+        TaskHandle_t handle = NULL;
+        if (xTaskCreatePinnedToCore(def.function, def.name, def.stack, NULL, def.priority, &handle, def.core) != pdPASS) {
+            Serial.printf("Error: Failed to create task '%s'\n", def.name);
+            continue;
+        }
+        def.stats.attach(handle);
+        TRACE_REGISTER_TASK(handle, def.name);
+        if (def.function == sensingTask)
+            sensingTaskHandle = handle;
+        else if (def.function == networkTask)
+            networkTaskHandle = handle;
+        else if (def.function == uiTask)
+            uiTaskHandle = handle;
+    }
 }
 
 // --- 状態別ハンドラ関数の実装 ---
 
-void handleIdleState(unsigned long currentMillis) {
+void handleIdleState(uint64_t currentMillis) {
     // ★ 動き出したら TRACKING に遷移 ★
-    if (metrics.isMoving()) { // isMoving()は SLEEP_TIMEOUT 以内かを見る
-        Serial.println("Main: Movement detected from IDLE. Entering TRACKING.");
+    if (uiSnapshot().moving) { // moving は SLEEP_TIMEOUT 以内かを見る
+        LOG_I("Main: Movement detected from IDLE. Entering TRACKING.");
         currentState = AppState::TRACKING_DISPLAY;
         M5.Lcd.wakeup(); M5.Lcd.setBrightness(100);
         // セッションリセットはしない（MetricsCalculator::update内で新規開始時に処理）
@@ -307,36 +1084,36 @@ void handleIdleState(unsigned long currentMillis) {
     // ボタン処理
     if (M5.BtnB.wasPressed() || M5.BtnC.wasPressed()) { // B or C でWiFi設定へ
         currentState = AppState::WIFI_SETUP;
-        Serial.println("Main: Entering WiFi Setup Mode from Idle.");
+        LOG_I("Main: Entering WiFi Setup Mode from Idle.");
     }
 }
 
-void handleTrackingState(unsigned long currentMillis) {
+void handleTrackingState(uint64_t currentMillis) {
     // ★ タイマーが停止したら STOPPING に遷移 ★
-    if (!metrics.isTimerRunning()) { // isTimerRunning()は TIMER_STOP_DELAY 以内かを見る
-        Serial.println("Main: Timer stopped in TRACKING. Entering STOPPING.");
-        metrics.stoppingDataUpdate();
-        publisher.publishIfNeeded(metrics.getData());
+    if (!uiSnapshot().timerRunning) { // timerRunning は TIMER_STOP_DELAY 以内かを見る
+        LOG_I("Main: Timer stopped in TRACKING. Entering STOPPING.");
+        // 速度表示を0にしてから停止イベントを送る (送信は計測タスク経由で通信タスクが行う)
+        requestMetricsCommand(METRICS_CMD_STOPPING_UPDATE);
         currentState = AppState::STOPPING;
         return; // 状態遷移
     }
 
     // ボタン処理
     if (M5.BtnB.pressedFor(1000)) { // B長押しでセッションリセット -> IDLE へ
-        Serial.println("Main: Manual Session Reset requested during TRACKING.");
-        metrics.resetSession(); // セッションデータとパルスカウンタ基準値をリセット
+        LOG_I("Main: Manual Session Reset requested during TRACKING.");
+        requestMetricsCommand(METRICS_CMD_RESET_SESSION); // セッションデータとパルスカウンタ基準値をリセット
         currentState = AppState::IDLE_DISPLAY;
     } else if (M5.BtnC.wasPressed()) { // CでWiFi設定へ
         currentState = AppState::WIFI_SETUP;
-        Serial.println("Main: Entering WiFi Setup Mode from Tracking.");
+        LOG_I("Main: Entering WiFi Setup Mode from Tracking.");
     }
 }
 
 // ★★★ STOPPING 状態のハンドラ ★★★
-void handleStoppingState(unsigned long currentMillis) {
+void handleStoppingState(uint64_t currentMillis) {
     // ★ 動きが完全に止まったら(SLEEP_TIMEOUT経過) IDLE に遷移 ★
-    if (!metrics.isMoving()) {
-        Serial.println("Main: Movement stopped in STOPPING. Entering IDLE.");
+    if (!uiSnapshot().moving) {
+        LOG_I("Main: Movement stopped in STOPPING. Entering IDLE.");
         // セッション終了処理（MetricsCalculator内で実施済みのはず）
         currentState = AppState::IDLE_DISPLAY;
         return; // 状態遷移
@@ -345,8 +1122,8 @@ void handleStoppingState(unsigned long currentMillis) {
     // ★ 停止中に再度動き出したら TRACKING に戻る ★
     // metrics.update() 内で isMoving=true の時に hadRecentPulse があれば
     // isTimerRunning() も true に戻るはず。それをここで検知する。
-    if (metrics.isTimerRunning()){ // isMoving は true のはず
-        Serial.println("Main: Movement resumed from STOPPING. Entering TRACKING.");
+    if (uiSnapshot().timerRunning){ // isMoving は true のはず
+        LOG_I("Main: Movement resumed from STOPPING. Entering TRACKING.");
         currentState = AppState::TRACKING_DISPLAY;
         return; // 状態遷移
     }
@@ -354,21 +1131,21 @@ void handleStoppingState(unsigned long currentMillis) {
 
     // ボタン処理 (TRACKING と同様)
     if (M5.BtnB.pressedFor(1000)) { // B長押しでセッションリセット -> IDLE へ
-        Serial.println("Main: Manual Session Reset requested during STOPPING.");
-        metrics.resetSession();
+        LOG_I("Main: Manual Session Reset requested during STOPPING.");
+        requestMetricsCommand(METRICS_CMD_RESET_SESSION);
         currentState = AppState::IDLE_DISPLAY;
     } else if (M5.BtnC.wasPressed()) { // CでWiFi設定へ
         currentState = AppState::WIFI_SETUP;
-        Serial.println("Main: Entering WiFi Setup Mode from Stopping.");
+        LOG_I("Main: Entering WiFi Setup Mode from Stopping.");
     }
 }
 
-void handleWifiSetupState(unsigned long currentMillis) {
+void handleWifiSetupState(uint64_t currentMillis) {
      // トリガー1: NVSに設定がなければAPモード起動を試みる
      if (!apPortal.isActive()) {
           String temp_ssid, temp_pass;
           if (!storage.loadCredentialsFromNVS(temp_ssid, temp_pass)) {
-               Serial.println("Main: No WiFi creds in NVS. Starting AP Portal automatically.");
+               LOG_I("Main: No WiFi creds in NVS. Starting AP Portal automatically.");
                if (apPortal.start()) {
                     currentState = AppState::WIFI_AP_CONFIG;
                     return;
@@ -379,24 +1156,24 @@ void handleWifiSetupState(unsigned long currentMillis) {
      }
     // ボタン操作
     if (M5.BtnA.wasPressed()) { // スキャン開始
-        Serial.println("Main: Scan requested...");
+        LOG_I("Main: Scan requested...");
         display.showMessage("Scanning WiFi...", 1, false);
         int networksFound = wifi.scanNetworks();
         currentState = AppState::WIFI_SCANNING;
-        Serial.printf("Main: Scan complete, %d networks found.\n", networksFound);
+        LOG_I("Main: Scan complete, %d networks found.", networksFound);
     } else if (M5.BtnC.wasPressed()) { // 戻る
          // 遷移元が TRACKING or STOPPING だった可能性も考慮
-         if (metrics.isMoving()){ //まだスリープタイムアウト前なら
-              currentState = metrics.isTimerRunning() ? AppState::TRACKING_DISPLAY : AppState::STOPPING;
+         if (uiSnapshot().moving){ //まだスリープタイムアウト前なら
+              currentState = uiSnapshot().timerRunning ? AppState::TRACKING_DISPLAY : AppState::STOPPING;
          } else { // 完全に停止していたら
               currentState = AppState::IDLE_DISPLAY;
          }
-         Serial.println("Main: Exiting WiFi Setup via BtnC.");
+         LOG_I("Main: Exiting WiFi Setup via BtnC.");
     }
      // JSONからの接続試行ボタンなどをBtnB長押しなどに割り当てることも可能
      else if (M5.BtnB.pressedFor(1000)) { // 例: B長押しでJSON[0]に接続試行
          if (storage.getWifiCredentialCount() > 0) {
-             Serial.println("Main: Attempting WiFi connection from JSON[0]...");
+             LOG_I("Main: Attempting WiFi connection from JSON[0]...");
              display.showMessage("Connecting(JSON)...", 1, false);
              currentState = AppState::WIFI_CONNECTING;
              // wifi.connectFromYaml(0); // 古い名前だった
@@ -409,38 +1186,38 @@ void handleWifiSetupState(unsigned long currentMillis) {
      }
 }
 
-void handleWifiConnectingState(unsigned long currentMillis) {
+void handleWifiConnectingState(uint64_t currentMillis) {
     // 接続試行中の処理
     if (!wifi.isAttemptingConnection()) { // 試行完了
         if (wifi.isConnected()) {
             // 接続成功したら元の状態（TRACKING/STOPPING/IDLE）に戻る
-            if (metrics.isMoving()){
-                 currentState = metrics.isTimerRunning() ? AppState::TRACKING_DISPLAY : AppState::STOPPING;
+            if (uiSnapshot().moving){
+                 currentState = uiSnapshot().timerRunning ? AppState::TRACKING_DISPLAY : AppState::STOPPING;
             } else {
                  currentState = AppState::IDLE_DISPLAY;
             }
-            Serial.println("Main: WiFi Connected.");
+            LOG_I("Main: WiFi Connected.");
             display.showMessage("Connected!", 2, true); delay(1000);
         } else { // 接続失敗
             currentState = AppState::WIFI_SETUP; // 設定画面に戻る
-            Serial.println("Main: WiFi Connection Failed/Timeout.");
+            LOG_W("Main: WiFi Connection Failed/Timeout.");
             display.showMessage("Connect FAIL!", 2, true); delay(1500);
         }
     } else if (M5.BtnC.wasPressed()) { // 接続試行中にキャンセル
-          Serial.println("Main: Cancelling WiFi connection attempt.");
+          LOG_I("Main: Cancelling WiFi connection attempt.");
           wifi.disconnect(); // 接続試行を中断
           currentState = AppState::WIFI_SETUP; // 設定画面に戻る
      }
 }
 
-void handleWifiScanningState(unsigned long currentMillis) {
+void handleWifiScanningState(uint64_t currentMillis) {
     // スキャン結果表示中の処理
     if (M5.BtnA.wasPressed()) {
         // TODO: ネットワーク選択UI
-        Serial.println("Network selection (TODO)");
+        LOG_I("Network selection (TODO)");
         display.showMessage("Select TODO", 1, false); delay(1000);
     } else if (M5.BtnB.wasPressed()) { // トリガー2: APモード開始
-        Serial.println("Main: Starting AP Config Portal after scan via BtnB...");
+        LOG_I("Main: Starting AP Config Portal after scan via BtnB...");
         if (apPortal.start()) {
             currentState = AppState::WIFI_AP_CONFIG;
         } else {
@@ -448,28 +1225,29 @@ void handleWifiScanningState(unsigned long currentMillis) {
         }
     } else if (M5.BtnC.wasPressed()) { // 戻る (WiFi設定メニューへ)
         currentState = AppState::WIFI_SETUP;
-        Serial.println("Main: Exiting WiFi Scan results via BtnC.");
+        LOG_I("Main: Exiting WiFi Scan results via BtnC.");
     }
 }
 
-void handleAPConfigState(unsigned long currentMillis) {
+void handleAPConfigState(uint64_t currentMillis) {
     // APモード中の処理
     apPortal.handleClient(); // Webサーバー/DNS処理
 
     // 設定が保存されたかチェック
     if (apPortal.wereCredentialsSaved()) {
-        Serial.println("Main: Credentials saved via AP detected. Restarting...");
+        LOG_I("Main: Credentials saved via AP detected. Restarting...");
         display.showMessage("Saved! Restarting...", 2, true);
         apPortal.resetCredentialsSavedFlag(); // フラグリセット
         delay(1500);
         apPortal.stop();
         delay(100);
+        Log::flush(LOG_FLUSH_TIMEOUT_MS);
         ESP.restart(); // ★ 再起動して新しい設定で接続 ★
     }
 
     // BtnCでのキャンセル
      if (M5.BtnC.wasPressed()) {
-          Serial.println("Main: Canceling AP Config Portal via BtnC.");
+          LOG_I("Main: Canceling AP Config Portal via BtnC.");
           apPortal.stop();
           currentState = AppState::WIFI_SETUP; // WiFi設定画面に戻る
      }
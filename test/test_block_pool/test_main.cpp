@@ -0,0 +1,136 @@
+// BlockPool / PoolAllocator のホストテスト (pio test -e native)
+// プールが空になったらヒープに逃げること、返すときに owns() でプールとヒープを振り分けることを確かめる
+#include <unity.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "BlockPool.hpp"
+
+typedef BlockPool<64, 3> SmallPool;
+
+void setUp() {}
+void tearDown() {}
+
+void test_pool_hands_out_each_block_once() {
+    SmallPool pool;
+    TEST_ASSERT_EQUAL_UINT32(3, pool.getAvailable());
+    void* a = pool.allocate();
+    void* b = pool.allocate();
+    void* c = pool.allocate();
+    TEST_ASSERT_NOT_NULL(a);
+    TEST_ASSERT_NOT_NULL(b);
+    TEST_ASSERT_NOT_NULL(c);
+    TEST_ASSERT_TRUE(a != b && b != c && a != c);
+    TEST_ASSERT_EQUAL_UINT32(0, (uintptr_t)a % alignof(std::max_align_t));
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getAvailable());
+
+    // 空なら nullptr を返して数える
+    TEST_ASSERT_NULL(pool.allocate());
+    TEST_ASSERT_EQUAL_UINT32(1, pool.getExhausted());
+
+    // 返したブロックがまた使われる
+    pool.release(b);
+    TEST_ASSERT_EQUAL_UINT32(1, pool.getAvailable());
+    TEST_ASSERT_EQUAL_PTR(b, pool.allocate());
+    pool.release(a);
+    pool.release(b);
+    pool.release(c);
+    TEST_ASSERT_EQUAL_UINT32(3, pool.getAvailable());
+}
+
+void test_owns_only_pool_blocks() {
+    SmallPool pool;
+    void* block = pool.allocate();
+    TEST_ASSERT_TRUE(pool.owns(block));
+    TEST_ASSERT_TRUE(pool.owns(static_cast<unsigned char*>(block) + 63));
+    int onStack = 0;
+    TEST_ASSERT_FALSE(pool.owns(&onStack));
+    std::unique_ptr<int> onHeap(new int(0));
+    TEST_ASSERT_FALSE(pool.owns(onHeap.get()));
+    TEST_ASSERT_FALSE(pool.owns(&pool + 1)); // 領域の直後
+    pool.release(block);
+}
+
+void test_allocator_falls_back_to_heap_when_exhausted() {
+    SmallPool pool;
+    PoolAllocator<uint64_t, SmallPool> allocator(pool);
+    std::vector<uint64_t*> taken;
+    for (int i = 0; i < 5; i++) {
+        uint64_t* value = allocator.allocate(1);
+        TEST_ASSERT_NOT_NULL(value);
+        *value = (uint64_t)i;
+        taken.push_back(value);
+    }
+    // 3個目まではプール、残りはヒープ
+    for (int i = 0; i < 5; i++)
+        TEST_ASSERT_EQUAL(i < 3, pool.owns(taken[i]));
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getAvailable());
+    TEST_ASSERT_EQUAL_UINT32(2, pool.getExhausted());
+
+    // ヒープから取った分は delete され、プールの空きには数えない
+    allocator.deallocate(taken[4], 1);
+    allocator.deallocate(taken[3], 1);
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getAvailable());
+    for (int i = 0; i < 3; i++) {
+        TEST_ASSERT_EQUAL_UINT64((uint64_t)i, *taken[i]); // ヒープの解放でプールの中身が壊れていない
+        allocator.deallocate(taken[i], 1);
+    }
+    TEST_ASSERT_EQUAL_UINT32(3, pool.getAvailable());
+}
+
+void test_allocator_uses_heap_for_arrays_and_large_types() {
+    SmallPool pool;
+    PoolAllocator<uint32_t, SmallPool> small(pool);
+    uint32_t* array = small.allocate(4);
+    TEST_ASSERT_FALSE(pool.owns(array));
+    small.deallocate(array, 4);
+
+    struct Large { unsigned char bytes[128]; };
+    PoolAllocator<Large, SmallPool> large(small); // 同じプールを指す別の型
+    TEST_ASSERT_TRUE(small == large);
+    Large* object = large.allocate(1);
+    TEST_ASSERT_FALSE(pool.owns(object));
+    large.deallocate(object, 1);
+
+    TEST_ASSERT_EQUAL_UINT32(3, pool.getAvailable());
+    TEST_ASSERT_EQUAL_UINT32(0, pool.getExhausted()); // 大きさで断った分は空きなしと数えない
+}
+
+void test_allocate_shared_round_trip() {
+    // DataPublisher と同じ使い方: 制御ブロックごと1ブロックに収まる
+    typedef BlockPool<sizeof(std::string) + 64, 2> StringPool;
+    StringPool pool;
+    PoolAllocator<std::string, StringPool> allocator(pool);
+    {
+        std::shared_ptr<std::string> first = std::allocate_shared<std::string>(allocator, "first");
+        std::shared_ptr<std::string> second = std::allocate_shared<std::string>(allocator, "second");
+        TEST_ASSERT_TRUE(pool.owns(first.get()));
+        TEST_ASSERT_TRUE(pool.owns(second.get()));
+        TEST_ASSERT_EQUAL_UINT32(0, pool.getAvailable());
+
+        // プールが空でも作れる (ヒープから)
+        std::shared_ptr<std::string> third = std::allocate_shared<std::string>(allocator, "third");
+        TEST_ASSERT_FALSE(pool.owns(third.get()));
+        TEST_ASSERT_EQUAL_STRING("third", third->c_str());
+        TEST_ASSERT_EQUAL_UINT32(1, pool.getExhausted());
+
+        // 別のタスクに渡したつもりで、コピーが最後に消えたときに返る
+        std::shared_ptr<std::string> copy = first;
+        first.reset();
+        TEST_ASSERT_EQUAL_UINT32(0, pool.getAvailable());
+        copy.reset();
+        TEST_ASSERT_EQUAL_UINT32(1, pool.getAvailable());
+        TEST_ASSERT_EQUAL_STRING("second", second->c_str());
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, pool.getAvailable());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pool_hands_out_each_block_once);
+    RUN_TEST(test_owns_only_pool_blocks);
+    RUN_TEST(test_allocator_falls_back_to_heap_when_exhausted);
+    RUN_TEST(test_allocator_uses_heap_for_arrays_and_large_types);
+    RUN_TEST(test_allocate_shared_round_trip);
+    return UNITY_END();
+}
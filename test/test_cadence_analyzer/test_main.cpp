@@ -0,0 +1,145 @@
+// CadenceAnalyzer のホストテスト (pio test -e native)
+// 段差のある合成 RPM 列を流し、CUSUM が変化点を検出する時刻と位置、短い区間のまとめ方を確かめる
+#include <unity.h>
+#include "CadenceAnalyzer.hpp"
+
+static const uint32_t STEP_MS = 1000; // TIMER 駆動の計算間隔
+
+// 段差の列を作る: rpm を durationMs だけ続ける区間の並び
+struct Phase {
+    uint32_t rpm;
+    uint32_t durationMs;
+};
+
+struct Replay {
+    CadenceAnalyzer analyzer;
+    uint64_t nowMs = 0;
+    uint64_t firstDetectionMs = 0; // 最初に変化点が増えた時刻
+
+    Replay() { analyzer.reset(0); }
+
+    void run(const Phase* phases, size_t count) {
+        for (size_t p = 0; p < count; p++) {
+            for (uint32_t t = 0; t < phases[p].durationMs; t += STEP_MS) {
+                uint16_t before = analyzer.getAnalysis().boundaries;
+                nowMs += STEP_MS;
+                analyzer.add(nowMs, STEP_MS, phases[p].rpm * 1000, true);
+                if (before == 0 && analyzer.getAnalysis().boundaries == 1)
+                    firstDetectionMs = nowMs;
+            }
+        }
+    }
+};
+
+// 段差 stepRpm を CUSUM で検出するまでの時間 (ms): (段差 - 許容ずれ) × 時間 が閾値を超えるまで
+static uint64_t expectedDelayMs(uint32_t stepRpm) {
+    uint32_t perStep = (stepRpm - CADENCE_CPD_DRIFT_RPM) * STEP_MS / 1000;
+    uint32_t steps = CADENCE_CPD_THRESHOLD_RPM_S / perStep + 1;
+    return (uint64_t)steps * STEP_MS;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_step_up_is_detected_at_change_point() {
+    Replay replay;
+    const Phase phases[] = {{60, 60000}, {90, 60000}};
+    replay.run(phases, 2);
+    const CadenceAnalysis& analysis = replay.analyzer.getAnalysis();
+    TEST_ASSERT_EQUAL_UINT16(1, analysis.boundaries);
+    // 区間の始まりは検出した時刻ではなく、段差の位置
+    TEST_ASSERT_EQUAL_UINT64(60000, analysis.segmentStartMs);
+    // 30rpm の段差は約4秒で検出する
+    TEST_ASSERT_EQUAL_UINT64(60000 + expectedDelayMs(30), replay.firstDetectionMs);
+    TEST_ASSERT_EQUAL_UINT64(64000, replay.firstDetectionMs);
+    // 新しい区間の平均は段差の後の値だけから求める
+    TEST_ASSERT_EQUAL_UINT32(90000, analysis.segmentMilliRpm);
+}
+
+void test_step_down_is_detected_at_change_point() {
+    Replay replay;
+    const Phase phases[] = {{90, 60000}, {40, 60000}};
+    replay.run(phases, 2);
+    const CadenceAnalysis& analysis = replay.analyzer.getAnalysis();
+    TEST_ASSERT_EQUAL_UINT16(1, analysis.boundaries);
+    TEST_ASSERT_EQUAL_UINT64(60000, analysis.segmentStartMs);
+    TEST_ASSERT_EQUAL_UINT64(60000 + expectedDelayMs(50), replay.firstDetectionMs);
+    TEST_ASSERT_EQUAL_UINT32(40000, analysis.segmentMilliRpm);
+}
+
+void test_drift_within_allowance_is_not_a_change() {
+    Replay replay;
+    // 許容ずれ (6rpm) より小さい揺れを10分続ける
+    for (int i = 0; i < 600; i++) {
+        Phase phase = {(uint32_t)(60 + (i % 11) - 5), STEP_MS};
+        replay.run(&phase, 1);
+    }
+    TEST_ASSERT_EQUAL_UINT16(0, replay.analyzer.getAnalysis().boundaries);
+    TEST_ASSERT_UINT32_WITHIN(1000, 60000, replay.analyzer.getAnalysis().segmentMilliRpm);
+}
+
+void test_short_segment_is_merged() {
+    Replay replay;
+    // 90rpm は10秒しか続かない: CADENCE_MIN_SEGMENT_MS (20秒) 未満なので戻りを区切らない
+    const Phase phases[] = {{60, 60000}, {90, 10000}, {60, 60000}};
+    replay.run(phases, 3);
+    const CadenceAnalysis& analysis = replay.analyzer.getAnalysis();
+    TEST_ASSERT_EQUAL_UINT16(1, analysis.boundaries);
+    TEST_ASSERT_EQUAL_UINT64(60000, analysis.segmentStartMs);
+    // 平均は戻った後の値からやり直している
+    TEST_ASSERT_EQUAL_UINT32(60000, analysis.segmentMilliRpm);
+    // 区間が十分長ければ次の変化は区切る
+    const Phase next[] = {{20, 60000}};
+    replay.run(next, 1);
+    TEST_ASSERT_EQUAL_UINT16(2, replay.analyzer.getAnalysis().boundaries);
+    TEST_ASSERT_EQUAL_UINT64(130000, replay.analyzer.getAnalysis().segmentStartMs);
+}
+
+void test_work_intervals_and_zones() {
+    Replay replay;
+    // 休み → 運動 → 休み → 運動 (インターバル走)
+    const Phase phases[] = {{0, 60000}, {70, 60000}, {10, 60000}, {70, 60000}};
+    replay.run(phases, 4);
+    const CadenceAnalysis& analysis = replay.analyzer.getAnalysis();
+    TEST_ASSERT_EQUAL_UINT16(3, analysis.boundaries);
+    TEST_ASSERT_EQUAL_UINT16(2, analysis.workIntervals);
+    TEST_ASSERT_TRUE(analysis.working);
+    TEST_ASSERT_EQUAL_UINT64(180000, analysis.segmentStartMs);
+    // ゾーン別の時間: 0rpm と 10rpm は 0..20、70rpm は 60..80
+    TEST_ASSERT_EQUAL_UINT32(120000, analysis.zoneMs[0]);
+    TEST_ASSERT_EQUAL_UINT32(120000, analysis.zoneMs[CadenceAnalyzer::zoneOf(70000)]);
+    TEST_ASSERT_EQUAL_UINT8(CadenceAnalyzer::zoneOf(70000), analysis.currentZone);
+}
+
+void test_zone_boundaries() {
+    TEST_ASSERT_EQUAL_UINT8(0, CadenceAnalyzer::zoneOf(0));
+    TEST_ASSERT_EQUAL_UINT8(0, CadenceAnalyzer::zoneOf(19999));
+    TEST_ASSERT_EQUAL_UINT8(1, CadenceAnalyzer::zoneOf(20000));
+    TEST_ASSERT_EQUAL_UINT8(4, CadenceAnalyzer::zoneOf(99999));
+    TEST_ASSERT_EQUAL_UINT8(CADENCE_ZONE_COUNT - 1, CadenceAnalyzer::zoneOf(100000));
+    TEST_ASSERT_EQUAL_UINT8(CADENCE_ZONE_COUNT - 1, CadenceAnalyzer::zoneOf(UINT32_MAX));
+}
+
+void test_inactive_time_is_not_zoned() {
+    CadenceAnalyzer analyzer;
+    analyzer.reset(0);
+    analyzer.add(1000, 1000, 60000, true);
+    analyzer.add(2000, 1000, 0, false); // タイマー停止中
+    analyzer.add(2000, 0, 60000, true); // 長さ0の区間は無視
+    uint32_t total = 0;
+    for (size_t i = 0; i < CADENCE_ZONE_COUNT; i++)
+        total += analyzer.getAnalysis().zoneMs[i];
+    TEST_ASSERT_EQUAL_UINT32(1000, total);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_step_up_is_detected_at_change_point);
+    RUN_TEST(test_step_down_is_detected_at_change_point);
+    RUN_TEST(test_drift_within_allowance_is_not_a_change);
+    RUN_TEST(test_short_segment_is_merged);
+    RUN_TEST(test_work_intervals_and_zones);
+    RUN_TEST(test_zone_boundaries);
+    RUN_TEST(test_inactive_time_is_not_zoned);
+    return UNITY_END();
+}
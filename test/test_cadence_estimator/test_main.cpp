@@ -0,0 +1,136 @@
+// CadenceEstimator のホストテスト (pio test -e native)
+// パルス間隔の列を流し、外れ値の置き換え・ノイズパルスの繋ぎ直し・平滑化の応答時間を確かめる
+#include <unity.h>
+#include "CadenceEstimator.hpp"
+
+static const uint32_t MIN_PERIOD_US = 200000;                         // 300rpm 超えはノイズ
+static const uint32_t MAX_PERIOD_US = CADENCE_MAX_PERIOD_MS * 1000;   // 10rpm 未満は休止
+
+static CadenceEstimator makeEstimator(uint32_t responseMs = CADENCE_RESPONSE_MS_DEFAULT) {
+    CadenceConfig config;
+    config.responseMs = responseMs;
+    CadenceEstimator estimator;
+    estimator.begin(config, 1, MIN_PERIOD_US, MAX_PERIOD_US);
+    return estimator;
+}
+
+static void feed(CadenceEstimator& estimator, uint32_t periodUs, int count) {
+    for (int i = 0; i < count; i++)
+        TEST_ASSERT_TRUE(estimator.addPeriod(periodUs));
+}
+
+static float rpmNow(const CadenceEstimator& estimator) {
+    return estimator.getMilliRpm(0) / 1000.0f;
+}
+
+// 60rpm から periodUs のペースに変えたとき、変化量の63%に届くまでの時間 (ms)
+static uint32_t stepResponseMs(uint32_t responseMs, uint32_t periodUs) {
+    CadenceEstimator estimator = makeEstimator(responseMs);
+    feed(estimator, 1000000, 20);
+    float target = 60000000.0f / periodUs;
+    float threshold = 60.0f + (target - 60.0f) * 0.632f;
+    uint32_t elapsedMs = 0;
+    while (rpmNow(estimator) < threshold && elapsedMs < 60000) {
+        estimator.addPeriod(periodUs);
+        elapsedMs += periodUs / 1000;
+    }
+    return elapsedMs;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_steady_pace() {
+    CadenceEstimator estimator = makeEstimator();
+    TEST_ASSERT_EQUAL_UINT32(0, estimator.getMilliRpm(0)); // 推定前
+    TEST_ASSERT_TRUE(estimator.addPeriod(0));              // 最初のパルスは間隔が無い
+    feed(estimator, 1000000, 10);
+    TEST_ASSERT_EQUAL_UINT32(60000, estimator.getMilliRpm(0));
+    TEST_ASSERT_EQUAL_UINT32(0, estimator.getOutlierCount());
+}
+
+void test_hampel_replaces_single_outliers() {
+    CadenceEstimator estimator = makeEstimator();
+    feed(estimator, 1000000, 10);
+    // 取りこぼし (2倍の間隔) と早すぎるパルス (ノイズほどではない) を1つずつ
+    TEST_ASSERT_TRUE(estimator.addPeriod(2000000));
+    feed(estimator, 1000000, 3);
+    TEST_ASSERT_TRUE(estimator.addPeriod(400000));
+    feed(estimator, 1000000, 3);
+    TEST_ASSERT_EQUAL_UINT32(2, estimator.getOutlierCount());
+    // 中央値に置き換えたので、推定は揺れない
+    TEST_ASSERT_EQUAL_UINT32(60000, estimator.getMilliRpm(0));
+}
+
+void test_hampel_tolerates_small_jitter() {
+    CadenceEstimator estimator = makeEstimator();
+    // ±2% の揺れは外れ値にしない (MAD の下限 = 中央値/32)
+    const uint32_t jitter[] = {1000000, 1020000, 980000, 1010000, 990000};
+    for (int i = 0; i < 50; i++)
+        TEST_ASSERT_TRUE(estimator.addPeriod(jitter[i % 5]));
+    TEST_ASSERT_EQUAL_UINT32(0, estimator.getOutlierCount());
+    TEST_ASSERT_UINT32_WITHIN(1000, 60000, estimator.getMilliRpm(0));
+}
+
+void test_short_interval_is_carried_to_next_pulse() {
+    CadenceEstimator estimator = makeEstimator();
+    feed(estimator, 1000000, 10);
+    // 1秒の間隔の途中にノイズパルス: 50ms + 950ms に割れる
+    TEST_ASSERT_FALSE(estimator.addPeriod(50000));
+    TEST_ASSERT_EQUAL_UINT32(1, estimator.getRejectedCount());
+    TEST_ASSERT_TRUE(estimator.addPeriod(950000));
+    // 繋ぎ直すと元の1秒になるので、外れ値にもならない
+    TEST_ASSERT_EQUAL_UINT32(0, estimator.getOutlierCount());
+    TEST_ASSERT_EQUAL_UINT32(60000, estimator.getMilliRpm(0));
+    // ノイズが続いても、合計が最短間隔を超えるまで繋ぐ
+    TEST_ASSERT_FALSE(estimator.addPeriod(100000));
+    TEST_ASSERT_FALSE(estimator.addPeriod(50000));
+    TEST_ASSERT_TRUE(estimator.addPeriod(850000));
+    TEST_ASSERT_EQUAL_UINT32(3, estimator.getRejectedCount());
+    TEST_ASSERT_EQUAL_UINT32(60000, estimator.getMilliRpm(0));
+}
+
+void test_ema_response_time_follows_config() {
+    // 外れ値判定が追いつくまで (window 5 なら3パルス) + 時定数ほどで63%に届く
+    uint32_t slow = stepResponseMs(1500, 500000);
+    uint32_t fast = stepResponseMs(500, 500000);
+    TEST_ASSERT_UINT32_WITHIN(1000, 1500 + 1500, slow);
+    TEST_ASSERT_UINT32_WITHIN(500, 500 + 1500, fast);
+    TEST_ASSERT_LESS_THAN_UINT32(slow, fast);
+}
+
+void test_ema_response_time_is_rate_independent() {
+    // 重みを間隔に比例させているので、パルスの速さが違っても時間で見た応答はほぼ同じ
+    // (外れ値判定の3パルス分を除いて比べる)
+    uint32_t to120 = stepResponseMs(3000, 500000) - 3 * 500;
+    uint32_t to90 = stepResponseMs(3000, 666667) - 3 * 666;
+    TEST_ASSERT_UINT32_WITHIN(500, to120, to90);
+    TEST_ASSERT_UINT32_WITHIN(1000, 3000, to120);
+}
+
+void test_rpm_falls_when_pulses_stop() {
+    CadenceEstimator estimator = makeEstimator();
+    feed(estimator, 500000, 10); // 120rpm
+    TEST_ASSERT_EQUAL_UINT32(120000, estimator.getMilliRpm(0));
+    // 次のパルスが2秒来ない → 少なくとも30rpm以下
+    TEST_ASSERT_EQUAL_UINT32(30000, estimator.getMilliRpm(2000000));
+    // 休止より長く空いたら0
+    TEST_ASSERT_EQUAL_UINT32(0, estimator.getMilliRpm((uint64_t)MAX_PERIOD_US + 1));
+    // 休止明けは前の推定を捨ててやり直す
+    TEST_ASSERT_TRUE(estimator.addPeriod(MAX_PERIOD_US + 1));
+    TEST_ASSERT_EQUAL_UINT32(0, estimator.getMilliRpm(0));
+    TEST_ASSERT_TRUE(estimator.addPeriod(1000000));
+    TEST_ASSERT_EQUAL_UINT32(60000, estimator.getMilliRpm(0));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_pace);
+    RUN_TEST(test_hampel_replaces_single_outliers);
+    RUN_TEST(test_hampel_tolerates_small_jitter);
+    RUN_TEST(test_short_interval_is_carried_to_next_pulse);
+    RUN_TEST(test_ema_response_time_follows_config);
+    RUN_TEST(test_ema_response_time_is_rate_independent);
+    RUN_TEST(test_rpm_falls_when_pulses_stop);
+    return UNITY_END();
+}
@@ -0,0 +1,113 @@
+// Clock (VirtualClock) と、時刻を受け取るモジュールの32bit一周境界のホストテスト (pio test -e native)
+// 生のus刻みを VirtualClock に直接与え、millis() (32bit ms) や 32bit us が一周する時刻をまたがせる
+#include <unity.h>
+#include "Clock.hpp"
+#include "DeadlineScheduler.hpp"
+#include "PublishScheduler.hpp"
+#include "EndpointHealth.hpp"
+
+static const uint64_t WRAP32 = 0x100000000ull;
+static const uint64_t MILLIS_WRAP_US = WRAP32 * 1000; // millis() が一周する時刻 (約49.7日)
+
+void setUp() {}
+void tearDown() {}
+
+void test_ms_is_continuous_across_32bit_us_and_ms() {
+    // 32bit us (約71.6分) と 32bit ms (約49.7日) の両方の境界を、素数刻みでまたぐ
+    const uint64_t starts[] = {WRAP32 - 5000, MILLIS_WRAP_US - 5000000};
+    for (uint64_t startUs : starts) {
+        VirtualClock clock(startUs);
+        uint64_t previousUs = clock.nowUs();
+        uint64_t previousMs = clock.nowMs();
+        for (int i = 0; i < 10000; i++) {
+            clock.advanceUs(997);
+            uint64_t us = clock.nowUs();
+            uint64_t ms = clock.nowMs();
+            TEST_ASSERT_EQUAL_UINT64(previousUs + 997, us);
+            TEST_ASSERT_EQUAL_UINT64(us / 1000, ms);
+            TEST_ASSERT_TRUE(ms >= previousMs);
+            TEST_ASSERT_TRUE(ms - previousMs <= 1);
+            previousUs = us;
+            previousMs = ms;
+        }
+        TEST_ASSERT_TRUE(clock.nowUs() - startUs > 5000000); // 境界の向こうまで進んだ
+    }
+    // 32bitに切り詰めた時刻なら、境界の後で「後の時刻 < 前の時刻」になる (壊れ方の確認)
+    VirtualClock clock(MILLIS_WRAP_US - 1000);
+    uint64_t before = clock.nowMs();
+    clock.advanceMs(2);
+    TEST_ASSERT_TRUE(clock.nowMs() > before);
+    TEST_ASSERT_TRUE((uint32_t)clock.nowMs() < (uint32_t)before);
+}
+
+void test_set_and_advance_ms() {
+    VirtualClock clock;
+    clock.setMs(WRAP32 - 1);
+    TEST_ASSERT_EQUAL_UINT64((WRAP32 - 1) * 1000, clock.nowUs());
+    clock.advanceMs(1);
+    TEST_ASSERT_EQUAL_UINT64(WRAP32, clock.nowMs());
+}
+
+void test_deadline_across_millis_rollover() {
+    VirtualClock clock;
+    clock.setMs(WRAP32 - 1000);
+    DeadlineScheduler scheduler;
+    scheduler.setAfter(0, clock.nowMs(), 3000); // 期限は一周の2秒後
+    TEST_ASSERT_EQUAL_UINT32(3000, scheduler.msUntilNext(clock.nowMs()));
+    clock.advanceMs(1500); // 境界をまたいだ直後
+    TEST_ASSERT_FALSE(scheduler.isDue(0, clock.nowMs()));
+    TEST_ASSERT_EQUAL_UINT32(1500, scheduler.prepareSleep(clock.nowMs()));
+    clock.advanceMs(1500);
+    scheduler.onWake(clock.nowMs(), false);
+    TEST_ASSERT_TRUE(scheduler.isDue(0, clock.nowMs()));
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getMaxLatenessMs());
+}
+
+void test_publish_heartbeat_across_millis_rollover() {
+    VirtualClock clock;
+    clock.setMs(WRAP32 - 12000);
+    PublishScheduler scheduler;
+    scheduler.begin(500, 5000, 0);
+    // 定常のまま境界をまたいでも、ハートビート間隔のまま送り続ける
+    uint64_t lastPublishMs = 0;
+    int publishes = 0;
+    for (int step = 0; step < 600; step++) { // 50ms × 600 = 30秒
+        uint64_t now = clock.nowMs();
+        scheduler.observe(now, 60.0f, 12.0f);
+        if (scheduler.shouldPublish(now)) {
+            if (publishes > 0)
+                TEST_ASSERT_EQUAL_UINT64(5000, now - lastPublishMs);
+            scheduler.onPublished(now, 200, 20);
+            lastPublishMs = now;
+            publishes++;
+        }
+        clock.advanceMs(50);
+    }
+    TEST_ASSERT_EQUAL_INT(6, publishes);
+    TEST_ASSERT_TRUE(lastPublishMs > WRAP32);
+}
+
+void test_circuit_breaker_retry_across_millis_rollover() {
+    VirtualClock clock;
+    clock.setMs(WRAP32 - 100);
+    EndpointHealth health;
+    health.begin(1, 1000, 1000, 7);
+    health.recordFailure(clock.nowMs());
+    unsigned long retryIn = health.getRetryInMs(clock.nowMs());
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(500, retryIn);
+    // 境界をまたいでも、期限までは遮断し続け、期限で試験送信を許す
+    clock.advanceMs(retryIn - 1);
+    TEST_ASSERT_FALSE(health.allowRequest(clock.nowMs()));
+    clock.advanceMs(1);
+    TEST_ASSERT_TRUE(health.allowRequest(clock.nowMs()));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_ms_is_continuous_across_32bit_us_and_ms);
+    RUN_TEST(test_set_and_advance_ms);
+    RUN_TEST(test_deadline_across_millis_rollover);
+    RUN_TEST(test_publish_heartbeat_across_millis_rollover);
+    RUN_TEST(test_circuit_breaker_retry_across_millis_rollover);
+    return UNITY_END();
+}
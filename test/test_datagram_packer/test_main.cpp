@@ -0,0 +1,195 @@
+// DatagramPacker のホストテスト (pio test -e native)
+#include <unity.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "DatagramPacker.hpp"
+#if defined(__unix__) || defined(__APPLE__)
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#define HAVE_POSIX_SOCKETS 1
+#endif
+
+void setUp() {}
+void tearDown() {}
+
+static size_t countLines(const DatagramPacker& packer) {
+    size_t lines = packer.empty() ? 0 : 1;
+    for (size_t i = 0; i < packer.size(); i++) {
+        if (packer.data()[i] == '\n')
+            lines++;
+    }
+    return lines;
+}
+
+void test_lines_are_joined_with_single_newline() {
+    DatagramPacker packer;
+    packer.begin(DatagramPacker::MAX_DATAGRAM_SIZE);
+    TEST_ASSERT_TRUE(packer.empty());
+    TEST_ASSERT_TRUE(packer.append("a=1", 3));
+    // 末尾の改行は落とし、区切りの改行だけを付ける
+    TEST_ASSERT_TRUE(packer.append("b=2\n", 4));
+    TEST_ASSERT_TRUE(packer.append("c=3\n\n", 5));
+    std::string packed(packer.data(), packer.size());
+    TEST_ASSERT_EQUAL_STRING("a=1\nb=2\nc=3", packed.c_str());
+    TEST_ASSERT_EQUAL_UINT32(3, packer.getSampleCount());
+    packer.clear();
+    TEST_ASSERT_TRUE(packer.empty());
+    TEST_ASSERT_EQUAL_UINT32(0, packer.getSampleCount());
+}
+
+void test_empty_lines_are_rejected() {
+    DatagramPacker packer;
+    packer.begin(64);
+    TEST_ASSERT_FALSE(packer.fits(0));
+    TEST_ASSERT_FALSE(packer.append("\n", 1));
+    TEST_ASSERT_TRUE(packer.empty());
+}
+
+void test_mtu_boundary() {
+    const size_t maxSize = 16;
+    DatagramPacker packer;
+    packer.begin(maxSize);
+    // ちょうど上限まで入り、1バイトでも超えると入らない
+    TEST_ASSERT_TRUE(packer.fits(maxSize));
+    TEST_ASSERT_FALSE(packer.fits(maxSize + 1));
+    std::string first(10, 'x');
+    TEST_ASSERT_TRUE(packer.append(first.c_str(), first.size()));
+    // 残り6バイト: 区切りの改行を含めて 1 + 5 まで
+    TEST_ASSERT_TRUE(packer.fits(5));
+    TEST_ASSERT_FALSE(packer.fits(6));
+    // 入らない追加は何も変えない
+    std::string tooLong(6, 'y');
+    TEST_ASSERT_FALSE(packer.append(tooLong.c_str(), tooLong.size()));
+    TEST_ASSERT_EQUAL_UINT32(10, packer.size());
+    TEST_ASSERT_EQUAL_UINT32(1, packer.getSampleCount());
+    std::string last(5, 'z');
+    TEST_ASSERT_TRUE(packer.append(last.c_str(), last.size()));
+    TEST_ASSERT_EQUAL_UINT32(maxSize, packer.size());
+    TEST_ASSERT_FALSE(packer.fits(1));
+}
+
+void test_begin_clamps_to_datagram_size() {
+    DatagramPacker packer;
+    packer.begin(DatagramPacker::MAX_DATAGRAM_SIZE + 100);
+    TEST_ASSERT_TRUE(packer.fits(DatagramPacker::MAX_DATAGRAM_SIZE));
+    TEST_ASSERT_FALSE(packer.fits(DatagramPacker::MAX_DATAGRAM_SIZE + 1));
+    packer.begin(0);
+    TEST_ASSERT_TRUE(packer.fits(DatagramPacker::MAX_DATAGRAM_SIZE));
+}
+
+void test_packs_line_protocol_samples_into_one_datagram() {
+    // 送信している line protocol 1件分 (約200バイト)
+    const char* line = "fit2go,device=AABBCCDDEEFF rpm=65.0,speed_kmh=17.20,mets=4.0,session_time_s=600.5,"
+                       "session_dist_km=2.1000,session_cal_kcal=55.20,total_time_s=1234567.890,"
+                       "total_dist_km=123.4500,total_cal_kcal=1234.50 1678886400000\n";
+    size_t len = strlen(line);
+    DatagramPacker packer;
+    packer.begin(DatagramPacker::MAX_DATAGRAM_SIZE);
+    size_t packed = 0;
+    while (packer.append(line, len))
+        packed++;
+    // 改行を除いた1行 + 区切り1文字で割った数だけ入る
+    size_t perLine = len - 1;
+    size_t expected = (DatagramPacker::MAX_DATAGRAM_SIZE + 1) / (perLine + 1);
+    TEST_ASSERT_EQUAL_UINT32(expected, packed);
+    TEST_ASSERT_EQUAL_UINT32(packed, packer.getSampleCount());
+    TEST_ASSERT_EQUAL_UINT32(packed, countLines(packer));
+    TEST_ASSERT_EQUAL_UINT32(packed * perLine + (packed - 1), packer.size());
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(DatagramPacker::MAX_DATAGRAM_SIZE, packer.size());
+    // 末尾に改行は無い
+    TEST_ASSERT_TRUE(packer.data()[packer.size() - 1] != '\n');
+}
+
+#if HAVE_POSIX_SOCKETS
+// 127.0.0.1 の UDP で受けた1データグラム (タイムアウトなら空)
+static std::string receiveDatagram(int socketFd) {
+    char buffer[DatagramPacker::MAX_DATAGRAM_SIZE + 1];
+    ssize_t received = recv(socketFd, buffer, sizeof(buffer), 0);
+    return received > 0 ? std::string(buffer, (size_t)received) : std::string();
+}
+#endif
+
+// UdpTelemetry と同じ使い方 (入らなくなったら送って空にする) で詰めたデータグラムを
+// ループバックの UDP で実際に送り、受け取った行が追加した行と同じ順で過不足なく並ぶかを見る
+void test_loopback_datagrams_carry_every_line() {
+#if HAVE_POSIX_SOCKETS
+    int receiver = socket(AF_INET, SOCK_DGRAM, 0);
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    TEST_ASSERT_TRUE(receiver >= 0 && sender >= 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0; // 空いているポート
+    TEST_ASSERT_EQUAL_INT(0, bind(receiver, (sockaddr*)&address, sizeof(address)));
+    socklen_t addressLength = sizeof(address);
+    TEST_ASSERT_EQUAL_INT(0, getsockname(receiver, (sockaddr*)&address, &addressLength));
+    timeval timeout = { 1, 0 };
+    setsockopt(receiver, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    DatagramPacker packer;
+    packer.begin(DatagramPacker::MAX_DATAGRAM_SIZE);
+    std::vector<std::string> appended;
+    std::vector<std::string> received;
+    size_t datagrams = 0;
+    auto flush = [&]() {
+        TEST_ASSERT_EQUAL_INT((int)packer.size(),
+                              (int)sendto(sender, packer.data(), packer.size(), 0, (sockaddr*)&address, sizeof(address)));
+        std::string datagram = receiveDatagram(receiver);
+        TEST_ASSERT_EQUAL_UINT32(packer.size(), datagram.size());
+        // 改行で区切り直す (1行 = 1サンプル)
+        size_t start = 0;
+        while (start <= datagram.size()) {
+            size_t end = datagram.find('\n', start);
+            if (end == std::string::npos)
+                end = datagram.size();
+            received.push_back(datagram.substr(start, end - start));
+            start = end + 1;
+        }
+        packer.clear();
+        datagrams++;
+    };
+    // 長さの違う行 (line protocol と StatsD 相当) を混ぜる
+    for (int i = 0; i < 300; i++) {
+        char line[256];
+        int length;
+        if (i % 3 == 0) {
+            length = snprintf(line, sizeof(line), "fit2go.rpm:%d|g\n", 40 + i % 50);
+        } else {
+            length = snprintf(line, sizeof(line),
+                              "fit2go,device=AABBCCDDEEFF,ch=%d rpm=%d.5,speed_kmh=%d.25,session_dist_km=%d.1000 %llu\n",
+                              i % 4, 50 + i % 40, 10 + i % 9, i, 1678886400000ULL + i * 1000ULL);
+        }
+        if (!packer.fits((size_t)length))
+            flush();
+        TEST_ASSERT_TRUE(packer.append(line, (size_t)length));
+        appended.push_back(std::string(line, (size_t)length - 1)); // 送られるのは改行を除いた本文
+    }
+    if (!packer.empty())
+        flush();
+    close(sender);
+    close(receiver);
+
+    TEST_ASSERT_GREATER_THAN_UINT32(1, datagrams); // 複数のデータグラムに分かれた
+    TEST_ASSERT_EQUAL_UINT32(appended.size(), received.size());
+    for (size_t i = 0; i < appended.size(); i++)
+        TEST_ASSERT_EQUAL_STRING(appended[i].c_str(), received[i].c_str());
+#else
+    TEST_IGNORE_MESSAGE("POSIX sockets are not available on this host");
+#endif
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_lines_are_joined_with_single_newline);
+    RUN_TEST(test_empty_lines_are_rejected);
+    RUN_TEST(test_mtu_boundary);
+    RUN_TEST(test_begin_clamps_to_datagram_size);
+    RUN_TEST(test_packs_line_protocol_samples_into_one_datagram);
+    RUN_TEST(test_loopback_datagrams_carry_every_line);
+    return UNITY_END();
+}
@@ -0,0 +1,107 @@
+// DeadlineScheduler のホストテスト (pio test -e native)
+// 時刻は偽の時計で進め、眠った時間と起きた回数・遅れを確かめる
+#include <unity.h>
+#include "DeadlineScheduler.hpp"
+
+// 偽の時計: prepareSleep() の時間だけ進め、oversleepMs だけ余計に寝坊する
+struct FakeClock {
+    uint64_t nowMs = 0;
+    unsigned long oversleepMs = 0;
+    void sleep(unsigned long ms) { nowMs += ms + oversleepMs; }
+};
+
+static const size_t TIMER_FAST = 0; // 2秒ごと
+static const size_t TIMER_SLOW = 1; // 5秒ごと
+
+void setUp() {}
+void tearDown() {}
+
+void test_no_deadline_when_nothing_armed() {
+    DeadlineScheduler scheduler;
+    TEST_ASSERT_EQUAL_UINT32(DeadlineScheduler::NO_DEADLINE, scheduler.msUntilNext(1000));
+    TEST_ASSERT_EQUAL_UINT32(DeadlineScheduler::NO_DEADLINE, scheduler.prepareSleep(1000));
+    scheduler.setAfter(TIMER_FAST, 1000, 250);
+    TEST_ASSERT_EQUAL_UINT32(250, scheduler.msUntilNext(1000));
+    scheduler.clear(TIMER_FAST);
+    TEST_ASSERT_FALSE(scheduler.isArmed(TIMER_FAST));
+    TEST_ASSERT_EQUAL_UINT32(DeadlineScheduler::NO_DEADLINE, scheduler.msUntilNext(1000));
+}
+
+void test_nearest_deadline_and_overdue() {
+    DeadlineScheduler scheduler;
+    scheduler.set(TIMER_FAST, 3000);
+    scheduler.set(TIMER_SLOW, 1500);
+    TEST_ASSERT_EQUAL_UINT32(500, scheduler.msUntilNext(1000));
+    TEST_ASSERT_FALSE(scheduler.isDue(TIMER_SLOW, 1499));
+    TEST_ASSERT_TRUE(scheduler.isDue(TIMER_SLOW, 1500));
+    // 過ぎた期限は 0 (すぐ起きる)
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.msUntilNext(2000));
+    // 範囲外のIDは無視する
+    scheduler.set(DeadlineScheduler::MAX_TIMERS, 10);
+    TEST_ASSERT_FALSE(scheduler.isArmed(DeadlineScheduler::MAX_TIMERS));
+}
+
+// 2秒と5秒の周期タイマーだけのタスクは、期限の和集合の回数しか起きない
+static void runPeriodicTimers(FakeClock& clock, DeadlineScheduler& scheduler, uint64_t endMs) {
+    scheduler.setAfter(TIMER_FAST, clock.nowMs, 2000);
+    scheduler.setAfter(TIMER_SLOW, clock.nowMs, 5000);
+    while (true) {
+        unsigned long sleepMs = scheduler.prepareSleep(clock.nowMs);
+        if (clock.nowMs + sleepMs > endMs)
+            break;
+        clock.sleep(sleepMs);
+        scheduler.onWake(clock.nowMs, false);
+        if (scheduler.isDue(TIMER_FAST, clock.nowMs))
+            scheduler.setAfter(TIMER_FAST, clock.nowMs, 2000);
+        if (scheduler.isDue(TIMER_SLOW, clock.nowMs))
+            scheduler.setAfter(TIMER_SLOW, clock.nowMs, 5000);
+    }
+}
+
+void test_wakes_only_at_deadlines() {
+    FakeClock clock;
+    DeadlineScheduler scheduler;
+    runPeriodicTimers(clock, scheduler, 20000);
+    // 2秒ごと10回 + 5秒ごと4回 - 重なり(10秒, 20秒)2回 = 12回 (10msポーリングなら2000回)
+    TEST_ASSERT_EQUAL_UINT32(12, scheduler.getWakeups());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getEventWakeups());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getMaxLatenessMs());
+}
+
+void test_lateness_is_measured_from_planned_wake() {
+    FakeClock clock;
+    clock.oversleepMs = 3; // ティック丸めやより高い優先度のタスクによる寝坊
+    DeadlineScheduler scheduler;
+    runPeriodicTimers(clock, scheduler, 20000);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, scheduler.getWakeups());
+    TEST_ASSERT_EQUAL_UINT32(3, scheduler.getMaxLatenessMs());
+}
+
+void test_event_wakeup_does_not_count_as_late() {
+    FakeClock clock;
+    DeadlineScheduler scheduler;
+    scheduler.setAfter(TIMER_FAST, clock.nowMs, 2000);
+    scheduler.prepareSleep(clock.nowMs);
+    // 期限より後に通知で起きても、それは遅れではない
+    clock.nowMs = 2500;
+    scheduler.onWake(clock.nowMs, true);
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.getWakeups());
+    TEST_ASSERT_EQUAL_UINT32(1, scheduler.getEventWakeups());
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getMaxLatenessMs());
+    // 期限が無いまま眠った後は、どれだけ後に起きても遅れにしない
+    scheduler.clear(TIMER_FAST);
+    scheduler.prepareSleep(clock.nowMs);
+    clock.nowMs = 60000;
+    scheduler.onWake(clock.nowMs, false);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.getMaxLatenessMs());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_no_deadline_when_nothing_armed);
+    RUN_TEST(test_nearest_deadline_and_overdue);
+    RUN_TEST(test_wakes_only_at_deadlines);
+    RUN_TEST(test_lateness_is_measured_from_planned_wake);
+    RUN_TEST(test_event_wakeup_does_not_count_as_late);
+    return UNITY_END();
+}
@@ -0,0 +1,268 @@
+// EndpointHealth (サーキットブレーカー) のホストテスト (pio test -e native)
+#include <unity.h>
+#include <limits.h>
+#include <deque>
+#include <string>
+#include <vector>
+#include "EndpointHealth.hpp"
+
+static const uint16_t THRESHOLD = 3;
+static const unsigned long BASE_BACKOFF_MS = 1000;
+static const unsigned long MAX_BACKOFF_MS = 30000;
+
+typedef EndpointHealth::State State;
+
+// しきい値まで失敗させて OPEN にする
+static void failUntilOpen(EndpointHealth& health, uint64_t nowMs) {
+    while (health.getState() != State::OPEN) {
+        TEST_ASSERT_TRUE(health.allowRequest(nowMs));
+        health.recordFailure(nowMs);
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_closed_to_open_after_threshold() {
+    EndpointHealth health;
+    health.begin(THRESHOLD, BASE_BACKOFF_MS, MAX_BACKOFF_MS, 1);
+    for (uint16_t i = 1; i < THRESHOLD; i++) {
+        TEST_ASSERT_TRUE(health.allowRequest(0));
+        health.recordFailure(0);
+        TEST_ASSERT_TRUE(health.getState() == State::CLOSED);
+        TEST_ASSERT_EQUAL_UINT16(i, health.getConsecutiveFailures());
+    }
+    health.recordFailure(0);
+    TEST_ASSERT_TRUE(health.getState() == State::OPEN);
+    TEST_ASSERT_EQUAL_UINT32(1, health.getOpenCount());
+    TEST_ASSERT_FALSE(health.allowRequest(0));
+    TEST_ASSERT_GREATER_THAN_UINT32(0, health.getRetryInMs(0));
+}
+
+void test_success_resets_failure_count() {
+    EndpointHealth health;
+    health.begin(THRESHOLD, BASE_BACKOFF_MS, MAX_BACKOFF_MS, 1);
+    health.recordFailure(0);
+    health.recordFailure(0);
+    health.recordSuccess(0);
+    TEST_ASSERT_EQUAL_UINT16(0, health.getConsecutiveFailures());
+    health.recordFailure(0);
+    health.recordFailure(0);
+    TEST_ASSERT_TRUE(health.getState() == State::CLOSED);
+}
+
+void test_open_to_half_open_probe_at_retry_time() {
+    EndpointHealth health;
+    health.begin(THRESHOLD, BASE_BACKOFF_MS, MAX_BACKOFF_MS, 1);
+    failUntilOpen(health, 1000);
+    unsigned long retryIn = health.getRetryInMs(1000);
+    uint64_t retryAt = 1000 + retryIn;
+    // 期限の1ms前までは遮断したまま
+    TEST_ASSERT_FALSE(health.allowRequest(retryAt - 1));
+    TEST_ASSERT_EQUAL_UINT32(1, health.getRetryInMs(retryAt - 1));
+    // 期限で試験送信を1回だけ許す
+    TEST_ASSERT_TRUE(health.allowRequest(retryAt));
+    TEST_ASSERT_TRUE(health.getState() == State::HALF_OPEN);
+    TEST_ASSERT_FALSE(health.allowRequest(retryAt));
+    TEST_ASSERT_EQUAL_UINT32(0, health.getRetryInMs(retryAt));
+    // 試験送信が成功すれば CLOSED に戻る
+    health.recordSuccess(retryAt);
+    TEST_ASSERT_TRUE(health.getState() == State::CLOSED);
+    TEST_ASSERT_TRUE(health.allowRequest(retryAt));
+}
+
+void test_half_open_failure_reopens_immediately() {
+    EndpointHealth health;
+    health.begin(THRESHOLD, BASE_BACKOFF_MS, MAX_BACKOFF_MS, 1);
+    failUntilOpen(health, 0);
+    uint64_t retryAt = health.getRetryInMs(0);
+    TEST_ASSERT_TRUE(health.allowRequest(retryAt));
+    // しきい値を待たず、1回の失敗で再び OPEN
+    health.recordFailure(retryAt);
+    TEST_ASSERT_TRUE(health.getState() == State::OPEN);
+    TEST_ASSERT_EQUAL_UINT32(2, health.getOpenCount());
+}
+
+void test_backoff_doubles_up_to_cap_with_jitter() {
+    EndpointHealth health;
+    health.begin(THRESHOLD, BASE_BACKOFF_MS, MAX_BACKOFF_MS, 12345);
+    uint64_t now = 0;
+    failUntilOpen(health, now);
+    unsigned long expected = BASE_BACKOFF_MS;
+    for (int round = 0; round < 12; round++) {
+        unsigned long delay = health.getRetryInMs(now);
+        // ジッタは [backoff/2, backoff]
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(expected / 2, delay);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(expected, delay);
+        // 試験送信も失敗させる
+        now += delay;
+        TEST_ASSERT_TRUE(health.allowRequest(now));
+        health.recordFailure(now);
+        expected = expected * 2 > MAX_BACKOFF_MS ? MAX_BACKOFF_MS : expected * 2;
+    }
+    // 上限に張り付いている
+    TEST_ASSERT_EQUAL_UINT32(MAX_BACKOFF_MS, expected);
+    // 成功したらバックオフは初期値から数え直す
+    now += health.getRetryInMs(now);
+    TEST_ASSERT_TRUE(health.allowRequest(now));
+    health.recordSuccess(now);
+    failUntilOpen(health, now);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(BASE_BACKOFF_MS, health.getRetryInMs(now));
+}
+
+void test_jitter_spreads_over_range() {
+    // 種を変えた多数の機器が同時に OPEN になっても、再試行時刻がばらける
+    const int devices = 1000;
+    unsigned long minDelay = ULONG_MAX;
+    unsigned long maxDelay = 0;
+    int lowerHalf = 0;
+    for (int seed = 1; seed <= devices; seed++) {
+        EndpointHealth health;
+        health.begin(1, 8000, 8000, (uint32_t)seed * 2654435761u);
+        health.recordFailure(0);
+        unsigned long delay = health.getRetryInMs(0);
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(4000, delay);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(8000, delay);
+        if (delay < minDelay)
+            minDelay = delay;
+        if (delay > maxDelay)
+            maxDelay = delay;
+        if (delay < 6000)
+            lowerHalf++;
+    }
+    // 範囲の両端近くまで使い、おおよそ一様
+    TEST_ASSERT_LESS_THAN_UINT32(4200, minDelay);
+    TEST_ASSERT_GREATER_THAN_UINT32(7800, maxDelay);
+    TEST_ASSERT_INT_WITHIN(100, devices / 2, lowerHalf);
+}
+
+// --- DataPublisher と同じ送信手順 (sendThroughBreaker) を偽のサーバーに向けて動かす ---
+
+// 台本どおりの応答を返す偽のHTTPサーバー (負の値は接続失敗。HTTPClient のエラーコードと同じ扱い)
+struct FakeServer {
+    std::vector<int> script;        // 応答を順に返す (使い切ったら最後の応答を繰り返す)
+    std::vector<std::string> posted; // 受け取ったペイロード
+    unsigned long latencyMs = 20;
+
+    int operator()(const std::string& payload, uint64_t& doneMs) {
+        posted.push_back(payload);
+        doneMs += latencyMs;
+        size_t index = posted.size() - 1;
+        return script[index < script.size() ? index : script.size() - 1];
+    }
+};
+
+static const int CONNECT_FAILED = -1; // HTTPC_ERROR_CONNECTION_REFUSED
+
+static SendOutcome sendOnce(EndpointHealth& health, std::deque<std::string>& queue, FakeServer& server, uint64_t nowMs,
+                            bool due = true) {
+    return sendThroughBreaker(health, queue, nowMs, due,
+                              [&](const std::string& payload, uint64_t& doneMs) { return server(payload, doneMs); });
+}
+
+void test_server_errors_and_connect_failures_open_breaker() {
+    EndpointHealth health;
+    health.begin(THRESHOLD, BASE_BACKOFF_MS, MAX_BACKOFF_MS, 1);
+    FakeServer server;
+    server.script = { 503, CONNECT_FAILED, 500 };
+    std::deque<std::string> queue = { "a", "b" };
+
+    for (int i = 0; i < 3; i++) {
+        SendOutcome outcome = sendOnce(health, queue, server, 1000 * i);
+        TEST_ASSERT_TRUE(outcome.attempted);
+        TEST_ASSERT_FALSE(outcome.delivered);
+    }
+    // 5xx と接続失敗は障害: しきい値で遮断し、ペイロードは再送のために残す
+    TEST_ASSERT_TRUE(health.getState() == State::OPEN);
+    TEST_ASSERT_EQUAL_UINT32(2, queue.size());
+    TEST_ASSERT_EQUAL_STRING("a", server.posted[2].c_str()); // 同じ先頭を送り直している
+
+    // 遮断中は送信時期が来ていても接続しない
+    uint64_t blockedMs = 2000 + 20;
+    TEST_ASSERT_TRUE(health.getRetryInMs(blockedMs) > 0);
+    SendOutcome outcome = sendOnce(health, queue, server, blockedMs);
+    TEST_ASSERT_FALSE(outcome.attempted);
+    TEST_ASSERT_EQUAL_UINT32(3, server.posted.size());
+}
+
+void test_client_errors_count_as_alive_and_are_dropped() {
+    EndpointHealth health;
+    health.begin(THRESHOLD, BASE_BACKOFF_MS, MAX_BACKOFF_MS, 1);
+    FakeServer server;
+    server.script = { 500, 500, 400, 404, 422, 413, 200 };
+    std::deque<std::string> queue = { "a", "b", "c", "d", "e", "f" };
+
+    // 2回の 5xx の後の 4xx: サーバーは応答している = 生きているので、連続失敗は 0 に戻る
+    sendOnce(health, queue, server, 0);
+    sendOnce(health, queue, server, 100);
+    TEST_ASSERT_EQUAL_UINT16(2, health.getConsecutiveFailures());
+    SendOutcome outcome = sendOnce(health, queue, server, 200);
+    TEST_ASSERT_TRUE(outcome.attempted);
+    TEST_ASSERT_FALSE(outcome.delivered);
+    TEST_ASSERT_EQUAL_INT(400, outcome.httpCode);
+    TEST_ASSERT_EQUAL_UINT16(0, health.getConsecutiveFailures());
+    // 4xx は再送しても通らないので捨て、次のペイロードへ進む
+    TEST_ASSERT_EQUAL_STRING("b", queue.front().c_str());
+
+    // 4xx が何回続いても遮断しない
+    for (int i = 0; i < 3; i++)
+        sendOnce(health, queue, server, 300 + 100 * i);
+    TEST_ASSERT_TRUE(health.getState() == State::CLOSED);
+    TEST_ASSERT_EQUAL_UINT32(2, health.getTotalFailures()); // 最初の 5xx の2回だけ
+    TEST_ASSERT_EQUAL_STRING("e", queue.front().c_str());
+
+    outcome = sendOnce(health, queue, server, 1000);
+    TEST_ASSERT_TRUE(outcome.delivered);
+    TEST_ASSERT_EQUAL_UINT32(1, queue.size());
+}
+
+void test_half_open_probe_closes_breaker() {
+    EndpointHealth health;
+    health.begin(THRESHOLD, BASE_BACKOFF_MS, MAX_BACKOFF_MS, 1);
+    FakeServer server;
+    server.script = { 503, 503, 503, CONNECT_FAILED, 201 };
+    std::deque<std::string> queue = { "summary", "sample" };
+    for (int i = 0; i < 3; i++)
+        sendOnce(health, queue, server, 0);
+    TEST_ASSERT_TRUE(health.getState() == State::OPEN);
+
+    // バックオフ明けの試験送信は送信時期 (due) を問わない。失敗すれば再び OPEN で、ペイロードは残る
+    uint64_t retryAt = 60 + health.getRetryInMs(60);
+    SendOutcome outcome = sendOnce(health, queue, server, retryAt, false);
+    TEST_ASSERT_TRUE(outcome.attempted);
+    TEST_ASSERT_TRUE(health.getState() == State::OPEN);
+    TEST_ASSERT_EQUAL_UINT32(2, queue.size());
+
+    // 次の試験送信が成功すれば CLOSED に戻り、そのペイロードは送れたので外す
+    retryAt = retryAt + 20 + health.getRetryInMs(retryAt + 20);
+    outcome = sendOnce(health, queue, server, retryAt, false);
+    TEST_ASSERT_TRUE(outcome.attempted);
+    TEST_ASSERT_TRUE(outcome.delivered);
+    TEST_ASSERT_TRUE(health.getState() == State::CLOSED);
+    TEST_ASSERT_EQUAL_UINT32(1, queue.size());
+    TEST_ASSERT_EQUAL_STRING("sample", queue.front().c_str());
+    TEST_ASSERT_EQUAL_UINT32(5, server.posted.size());
+
+    // CLOSED に戻った後は、送信時期が来るまで送らない
+    outcome = sendOnce(health, queue, server, retryAt + 100, false);
+    TEST_ASSERT_FALSE(outcome.attempted);
+    outcome = sendOnce(health, queue, server, retryAt + 100, true);
+    TEST_ASSERT_TRUE(outcome.delivered);
+    TEST_ASSERT_TRUE(queue.empty());
+    // 空なら何もしない
+    TEST_ASSERT_FALSE(sendOnce(health, queue, server, retryAt + 200).attempted);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_closed_to_open_after_threshold);
+    RUN_TEST(test_success_resets_failure_count);
+    RUN_TEST(test_open_to_half_open_probe_at_retry_time);
+    RUN_TEST(test_half_open_failure_reopens_immediately);
+    RUN_TEST(test_backoff_doubles_up_to_cap_with_jitter);
+    RUN_TEST(test_jitter_spreads_over_range);
+    RUN_TEST(test_server_errors_and_connect_failures_open_breaker);
+    RUN_TEST(test_client_errors_count_as_alive_and_are_dropped);
+    RUN_TEST(test_half_open_probe_closes_breaker);
+    return UNITY_END();
+}
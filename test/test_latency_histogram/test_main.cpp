@@ -0,0 +1,135 @@
+// LatencyHistogram のホストテスト (pio test -e native)
+// 値とビンの対応 (ビンの境目)、百分位の誤差の上限、リセット、複数スレッドからの記録を確かめる
+#include <unity.h>
+#include <stdio.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "LatencyHistogram.hpp"
+
+static LatencyHistogram histogram; // ビンの配列が大きいので静的に持つ
+
+void setUp() {
+    histogram.reset();
+}
+void tearDown() {}
+
+void test_bucket_of_small_values_is_identity() {
+    for (uint32_t value = 0; value < LatencyHistogram::SUB_BUCKETS; value++) {
+        TEST_ASSERT_EQUAL_UINT32(value, LatencyHistogram::bucketOf(value));
+        TEST_ASSERT_EQUAL_UINT32(value, LatencyHistogram::bucketUpper(value));
+    }
+    // 4 から先は2倍ごとに4つのビン: 4,5,6,7 はまだ幅1、8-9 から幅2
+    TEST_ASSERT_EQUAL_UINT32(4, LatencyHistogram::bucketOf(4));
+    TEST_ASSERT_EQUAL_UINT32(7, LatencyHistogram::bucketOf(7));
+    TEST_ASSERT_EQUAL_UINT32(8, LatencyHistogram::bucketOf(8));
+    TEST_ASSERT_EQUAL_UINT32(8, LatencyHistogram::bucketOf(9));
+    TEST_ASSERT_EQUAL_UINT32(9, LatencyHistogram::bucketOf(10));
+}
+
+void test_bucket_edges_are_contiguous() {
+    // ビンの上端の次の値は次のビンに入り、ビン番号は値とともに1つずつしか増えない
+    for (size_t index = 0; index + 1 < LatencyHistogram::BUCKET_COUNT; index++) {
+        uint32_t upper = LatencyHistogram::bucketUpper(index);
+        TEST_ASSERT_EQUAL_UINT32(index, LatencyHistogram::bucketOf(upper));
+        TEST_ASSERT_EQUAL_UINT32(index + 1, LatencyHistogram::bucketOf(upper + 1));
+    }
+    // 最後のビンは 32bit の最大値まで覆う
+    TEST_ASSERT_EQUAL_UINT32(LatencyHistogram::BUCKET_COUNT - 1, LatencyHistogram::bucketOf(UINT32_MAX));
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, LatencyHistogram::bucketUpper(LatencyHistogram::BUCKET_COUNT - 1));
+    TEST_ASSERT_EQUAL_UINT32(LatencyHistogram::BUCKET_COUNT - 4, LatencyHistogram::bucketOf(0x80000000UL));
+}
+
+void test_bucket_upper_error_is_bounded() {
+    // ビンの上端は値以上で、値の 1 + 1/SUB_BUCKETS 倍 (25%) を超えない
+    for (uint64_t next = 1; next <= UINT32_MAX; next = next * 3 / 2 + 1) {
+        uint32_t value = (uint32_t)next;
+        uint64_t upper = LatencyHistogram::bucketUpper(LatencyHistogram::bucketOf(value));
+        TEST_ASSERT_TRUE(upper >= value);
+        TEST_ASSERT_TRUE(upper * LatencyHistogram::SUB_BUCKETS <= (uint64_t)value * (LatencyHistogram::SUB_BUCKETS + 1));
+    }
+}
+
+// 百分位の真の値 (1件目から数えた順位の値) と比べる
+static void assertPercentileWithinBound(const std::vector<uint32_t>& sorted, uint32_t permille) {
+    size_t rank = (sorted.size() * permille + 999) / 1000;
+    uint32_t exact = sorted[rank == 0 ? 0 : rank - 1];
+    uint32_t estimate = histogram.percentile(permille);
+    char message[80];
+    snprintf(message, sizeof(message), "p%u: exact %u, estimate %u", (unsigned)permille, (unsigned)exact, (unsigned)estimate);
+    TEST_ASSERT_TRUE_MESSAGE(estimate >= exact, message);
+    TEST_ASSERT_TRUE_MESSAGE((uint64_t)estimate * 4 <= (uint64_t)exact * 5, message);
+}
+
+void test_percentiles_stay_within_error_bound() {
+    // 1〜10000 の一様な値と、長い裾 (1% が 100倍遅い)
+    std::vector<uint32_t> values;
+    for (uint32_t i = 1; i <= 10000; i++)
+        values.push_back(i % 100 == 0 ? i * 100 : 1000 + i % 997);
+    for (uint32_t value : values)
+        histogram.record(value);
+    std::vector<uint32_t> sorted = values;
+    std::sort(sorted.begin(), sorted.end());
+
+    TEST_ASSERT_EQUAL_UINT32(values.size(), histogram.getCount());
+    TEST_ASSERT_EQUAL_UINT32(sorted.back(), histogram.getMax());
+    assertPercentileWithinBound(sorted, 500);
+    assertPercentileWithinBound(sorted, 900);
+    assertPercentileWithinBound(sorted, 990);
+    assertPercentileWithinBound(sorted, 999);
+    // 最大値のビンでは上端ではなく正確な最大値を返す
+    TEST_ASSERT_EQUAL_UINT32(sorted.back(), histogram.percentile(1000));
+}
+
+void test_percentile_of_single_value_is_exact() {
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.percentile(500)); // 記録が無ければ0
+    histogram.record(1234);
+    TEST_ASSERT_EQUAL_UINT32(1234, histogram.percentile(0));
+    TEST_ASSERT_EQUAL_UINT32(1234, histogram.percentile(500));
+    TEST_ASSERT_EQUAL_UINT32(1234, histogram.percentile(990));
+}
+
+void test_reset_clears_everything() {
+    for (uint32_t i = 0; i < 1000; i++)
+        histogram.record(i * 7919);
+    histogram.reset();
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getCount());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.getMax());
+    TEST_ASSERT_EQUAL_UINT32(0, histogram.percentile(500));
+    // リセット後の記録は前の分と混ざらない
+    histogram.record(10);
+    TEST_ASSERT_EQUAL_UINT32(1, histogram.getCount());
+    TEST_ASSERT_EQUAL_UINT32(10, histogram.percentile(990));
+}
+
+void test_concurrent_records_are_all_counted() {
+    // 記録は複数のタスクから同時に行ってよい: 件数と最大値が欠けない
+    const uint32_t THREADS = 4;
+    const uint32_t PER_THREAD = 100000;
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < THREADS; t++) {
+        threads.emplace_back([t]() {
+            for (uint32_t i = 0; i < PER_THREAD; i++)
+                histogram.record(i * THREADS + t);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+    TEST_ASSERT_EQUAL_UINT32(THREADS * PER_THREAD, histogram.getCount());
+    TEST_ASSERT_EQUAL_UINT32(THREADS * PER_THREAD - 1, histogram.getMax());
+    uint32_t median = histogram.percentile(500);
+    TEST_ASSERT_TRUE(median >= THREADS * PER_THREAD / 2 - 1);
+    TEST_ASSERT_TRUE((uint64_t)median * 4 <= (uint64_t)THREADS * PER_THREAD / 2 * 5);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_bucket_of_small_values_is_identity);
+    RUN_TEST(test_bucket_edges_are_contiguous);
+    RUN_TEST(test_bucket_upper_error_is_bounded);
+    RUN_TEST(test_percentiles_stay_within_error_bound);
+    RUN_TEST(test_percentile_of_single_value_is_exact);
+    RUN_TEST(test_reset_clears_everything);
+    RUN_TEST(test_concurrent_records_are_all_counted);
+    return UNITY_END();
+}
@@ -0,0 +1,167 @@
+// LogBuffer のホストテスト (pio test -e native)
+// 引数を詰めて取り出し、書式化した結果が printf と同じになるか (切り詰め・型の不一致・64bit・%%・引数の溢れ) を確かめる
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include "LogBuffer.hpp"
+
+static LogBuffer buffer; // 64件分あるのでスタックに置かない
+
+// push → pop → format を通した1行
+template <typename... Args>
+static std::string render(const char* format, const Args&... args) {
+    TEST_ASSERT_TRUE(buffer.push(1234, LogLevel::INFO, 0, format, args...));
+    LogRecord record;
+    TEST_ASSERT_TRUE(buffer.pop(record));
+    TEST_ASSERT_EQUAL_UINT32(1234, record.timeMs);
+    char line[256];
+    LogBuffer::format(record, line, sizeof(line));
+    return line;
+}
+
+void setUp() {
+    LogRecord record;
+    while (buffer.pop(record)) {
+    }
+}
+void tearDown() {}
+
+void test_integers_match_printf() {
+    TEST_ASSERT_EQUAL_STRING("ch 3 pin 36", render("ch %u pin %d", (uint8_t)3, 36).c_str());
+    TEST_ASSERT_EQUAL_STRING("[  42] -7 0x1f", render("[%4d] %d 0x%x", 42, -7, 31u).c_str());
+    TEST_ASSERT_EQUAL_STRING("A", render("%c", 'A').c_str());
+}
+
+void test_unsigned_conversion_of_negative_int32() {
+    // printf と同じく32bitの符号なしとして出す
+    int32_t negative = -1;
+    TEST_ASSERT_EQUAL_STRING("4294967295", render("%u", negative).c_str());
+    TEST_ASSERT_EQUAL_STRING("ffffffff", render("%x", negative).c_str());
+    TEST_ASSERT_EQUAL_STRING("-1", render("%d", negative).c_str());
+    TEST_ASSERT_EQUAL_STRING("4294967294", render("%lu", (int16_t)-2).c_str()); // 狭い型も int32 として詰める
+}
+
+void test_64bit_arguments() {
+    TEST_ASSERT_EQUAL_STRING("18446744073709551615", render("%llu", UINT64_MAX).c_str());
+    TEST_ASSERT_EQUAL_STRING("-9223372036854775808", render("%lld", INT64_MIN).c_str());
+    TEST_ASSERT_EQUAL_STRING("4294967296 ms", render("%llu ms", (uint64_t)1 << 32).c_str());
+    // 書式の長さ修飾子が型とずれていても、詰めた型で出す
+    TEST_ASSERT_EQUAL_STRING("5000000000", render("%u", (uint64_t)5000000000ull).c_str());
+    TEST_ASSERT_EQUAL_STRING("1.50 -2.3e+03", render("%.2f %.1e", 1.5, -2300.0f).c_str());
+}
+
+void test_percent_literal() {
+    TEST_ASSERT_EQUAL_STRING("100% done", render("100%% done").c_str());
+    TEST_ASSERT_EQUAL_STRING("rssi 50% (-60 dBm)", render("rssi %d%% (%d dBm)", 50, -60).c_str());
+}
+
+void test_string_arguments_are_copied() {
+    char temporary[16];
+    strcpy(temporary, "portal");
+    TEST_ASSERT_TRUE(buffer.push(0, LogLevel::WARN, 0, "[%s] %s", temporary, (const char*)nullptr));
+    strcpy(temporary, "XXXXXX"); // 詰めた後に元の文字列が変わっても影響しない
+    LogRecord record;
+    TEST_ASSERT_TRUE(buffer.pop(record));
+    char line[64];
+    LogBuffer::format(record, line, sizeof(line));
+    TEST_ASSERT_EQUAL_STRING("[portal] (null)", line);
+    TEST_ASSERT_EQUAL_STRING("[   abc|abc   ]", render("[%6s|%-6s]", "abc", "abc").c_str());
+}
+
+void test_string_precision_and_truncation() {
+    TEST_ASSERT_EQUAL_STRING("abc", render("%.3s", "abcdef").c_str());
+    // '*' の精度・幅は次の引数から取る
+    TEST_ASSERT_EQUAL_STRING("abcd|", render("%.*s|", 4, "abcdefgh").c_str());
+    TEST_ASSERT_EQUAL_STRING("  ab|", render("%*.*s|", 4, 2, "abcdefgh").c_str());
+    TEST_ASSERT_EQUAL_STRING("abcdefgh", render("%.*s", -1, "abcdefgh").c_str());
+    TEST_ASSERT_EQUAL_STRING("[   7]", render("[%*d]", 4, 7).c_str());
+    // LOG_ARG_BYTES に入らない文字列は入るところまでで切って "..." を付ける
+    std::string longText(200, 'x');
+    std::string rendered = render("%s", longText.c_str());
+    size_t kept = LOG_ARG_BYTES - 2; // 印と長さの2バイトを除いた分
+    TEST_ASSERT_EQUAL_STRING((std::string(kept, 'x') + "...").c_str(), rendered.c_str());
+    // 前の引数の分だけ短くなる
+    rendered = render("%u %s", 7u, longText.c_str());
+    TEST_ASSERT_EQUAL_STRING(("7 " + std::string(kept - 5, 'x') + "...").c_str(), rendered.c_str());
+}
+
+void test_arguments_beyond_capacity_become_question_marks() {
+    // 64bit の引数は1つ9バイト: 96バイトには10個まで
+    uint64_t v = 1;
+    std::string rendered = render("%llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %s",
+                                  v, v, v, v, v, v, v, v, v, v, v, v, "tail");
+    // 入らなかった引数から後は、間が詰まらないよう全部 "?" にする
+    TEST_ASSERT_EQUAL_STRING("1 1 1 1 1 1 1 1 1 1 ? ? ?", rendered.c_str());
+    // 書式より引数が少ないときも "?"
+    TEST_ASSERT_EQUAL_STRING("1 ?", render("%d %d", 1).c_str());
+}
+
+void test_full_ring_drops_and_counts() {
+    uint32_t droppedBefore = buffer.getDropped();
+    for (size_t i = 0; i < LogBuffer::CAPACITY; i++)
+        TEST_ASSERT_TRUE(buffer.push(0, LogLevel::DEBUG, 0, "%u", (uint32_t)i));
+    TEST_ASSERT_FALSE(buffer.push(0, LogLevel::DEBUG, 0, "dropped"));
+    TEST_ASSERT_EQUAL_UINT32(droppedBefore + 1, buffer.getDropped());
+    // 古い順に出てくる
+    LogRecord record;
+    char line[16];
+    for (size_t i = 0; i < LogBuffer::CAPACITY; i++) {
+        TEST_ASSERT_TRUE(buffer.pop(record));
+        LogBuffer::format(record, line, sizeof(line));
+        TEST_ASSERT_EQUAL_STRING(std::to_string(i).c_str(), line);
+    }
+    TEST_ASSERT_TRUE(buffer.isEmpty());
+}
+
+void test_output_is_cut_to_line_size() {
+    TEST_ASSERT_TRUE(buffer.push(0, LogLevel::INFO, 0, "value=%u and more text", 123456u));
+    LogRecord record;
+    TEST_ASSERT_TRUE(buffer.pop(record));
+    char line[10];
+    size_t length = LogBuffer::format(record, line, sizeof(line));
+    TEST_ASSERT_EQUAL_UINT32(9, length);
+    TEST_ASSERT_EQUAL_STRING("value=123", line);
+}
+
+// 1回の呼び出しにかかる時間 (書き手側の push と、ログタスク側の pop + format を分けて測る)
+void test_benchmark_per_call() {
+    const int calls = 200000;
+    const char* host = "api.example.com";
+    LogRecord record;
+    char line[160];
+    double pushNs = 0.0;
+    double formatNs = 0.0;
+    for (int i = 0; i < calls; i += (int)LogBuffer::CAPACITY) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t j = 0; j < LogBuffer::CAPACITY; j++)
+            buffer.push((uint32_t)j, LogLevel::INFO, 0, "[HTTP] POST %s -> %d in %lu ms (%llu bytes)", host, 200, 42ul, (uint64_t)j);
+        auto pushed = std::chrono::steady_clock::now();
+        while (buffer.pop(record))
+            LogBuffer::format(record, line, sizeof(line));
+        auto formatted = std::chrono::steady_clock::now();
+        pushNs += std::chrono::duration<double, std::nano>(pushed - start).count();
+        formatNs += std::chrono::duration<double, std::nano>(formatted - pushed).count();
+    }
+    int rounded = (calls / (int)LogBuffer::CAPACITY + 1) * (int)LogBuffer::CAPACITY;
+    char message[128];
+    snprintf(message, sizeof(message), "push %.1f ns/call (caller), pop+format %.1f ns/call (log task)",
+             pushNs / rounded, formatNs / rounded);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_STRING("[HTTP] POST api.example.com -> 200 in 42 ms (63 bytes)", line);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_integers_match_printf);
+    RUN_TEST(test_unsigned_conversion_of_negative_int32);
+    RUN_TEST(test_64bit_arguments);
+    RUN_TEST(test_percent_literal);
+    RUN_TEST(test_string_arguments_are_copied);
+    RUN_TEST(test_string_precision_and_truncation);
+    RUN_TEST(test_arguments_beyond_capacity_become_question_marks);
+    RUN_TEST(test_full_ring_drops_and_counts);
+    RUN_TEST(test_output_is_cut_to_line_size);
+    RUN_TEST(test_benchmark_per_call);
+    return UNITY_END();
+}
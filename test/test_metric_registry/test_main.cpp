@@ -0,0 +1,87 @@
+// MetricRegistry / MetricWriter のホストテスト (pio test -e native)
+// 登録した値を小さなバッファで少しずつ読み出し、Prometheus のテキスト形式 (HELP/TYPE、ラベル、
+// ヒストグラムの _bucket/_sum/_count と le="+Inf") になっていること、読み方によらず同じ出力になることを確かめる
+#include <unity.h>
+#include <string>
+#include "MetricRegistry.hpp"
+
+// 一覧はプログラム全体で1つなので、値はグローバルに置く (宣言順に登録される)
+static MetricCounter sentA("fit2go_publish_total", "Payloads sent", "target=\"a\"");
+static MetricGauge heapFree("fit2go_heap_free_bytes", "Free heap", []() { return 12345.0f; });
+// 同じ名前の2つ目は、間に別の値があっても1つ目の後ろに並び、HELP と TYPE は1回だけ出る
+static MetricCounter sentB("fit2go_publish_total", "Payloads sent", "target=\"b\"");
+static const uint32_t LATENCY_BOUNDS_US[] = { 1000, 10000, 100000 };
+static MetricHistogram latency("fit2go_publish_seconds", "Publish latency", LATENCY_BOUNDS_US, 3, "target=\"a\"");
+static MetricHistogram loop("fit2go_loop_seconds", "Loop time", LATENCY_BOUNDS_US, 1);
+
+static const char* const EXPECTED =
+    "# HELP fit2go_publish_total Payloads sent\n"
+    "# TYPE fit2go_publish_total counter\n"
+    "fit2go_publish_total{target=\"a\"} 3\n"
+    "fit2go_publish_total{target=\"b\"} 4294967295\n"
+    "# HELP fit2go_heap_free_bytes Free heap\n"
+    "# TYPE fit2go_heap_free_bytes gauge\n"
+    "fit2go_heap_free_bytes 12345\n"
+    "# HELP fit2go_publish_seconds Publish latency\n"
+    "# TYPE fit2go_publish_seconds histogram\n"
+    "fit2go_publish_seconds_bucket{target=\"a\",le=\"0.001\"} 2\n"
+    "fit2go_publish_seconds_bucket{target=\"a\",le=\"0.01\"} 3\n"
+    "fit2go_publish_seconds_bucket{target=\"a\",le=\"0.1\"} 4\n"
+    "fit2go_publish_seconds_bucket{target=\"a\",le=\"+Inf\"} 5\n"
+    "fit2go_publish_seconds_sum{target=\"a\"} 0.557500\n"
+    "fit2go_publish_seconds_count{target=\"a\"} 5\n"
+    "# HELP fit2go_loop_seconds Loop time\n"
+    "# TYPE fit2go_loop_seconds histogram\n"
+    "fit2go_loop_seconds_bucket{le=\"0.001\"} 0\n"
+    "fit2go_loop_seconds_bucket{le=\"+Inf\"} 1\n"
+    "fit2go_loop_seconds_sum 2.000000\n"
+    "fit2go_loop_seconds_count 1\n";
+
+// read() を chunkSize ずつ呼んで全体をつなげる (バッファの外へ書いていないことも見る)
+static std::string readAll(size_t chunkSize) {
+    MetricWriter writer;
+    std::string text;
+    uint8_t buffer[4096 + 1];
+    for (int calls = 0; calls < 100000; calls++) {
+        buffer[chunkSize] = 0xA5;
+        size_t length = writer.read(buffer, chunkSize);
+        TEST_ASSERT_EQUAL_UINT8(0xA5, buffer[chunkSize]);
+        TEST_ASSERT_TRUE(length <= chunkSize);
+        if (length == 0)
+            break;
+        text.append((const char*)buffer, length);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, writer.read(buffer, chunkSize)); // 書き終えた後は0のまま
+    return text;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_exposition_format() {
+    TEST_ASSERT_EQUAL_STRING(EXPECTED, readAll(4096).c_str());
+}
+
+void test_tiny_chunks_give_same_output() {
+    // チャンク転送の残り容量が行より短くても、行の途中から続きを書く
+    const size_t sizes[] = { 1, 2, 3, 7, 16, 61 };
+    for (size_t size : sizes)
+        TEST_ASSERT_EQUAL_STRING(EXPECTED, readAll(size).c_str());
+}
+
+int main() {
+    sentA.increment(2);
+    sentA.increment();
+    sentB.set(UINT32_MAX);
+    latency.observeUs(500);
+    latency.observeUs(1000);   // 区切りちょうどはその区切りに入る (le は「以下」)
+    latency.observeUs(6000);
+    latency.observeUs(50000);
+    latency.observeUs(500000); // どの区切りも超える → +Inf だけ
+    loop.observeUs(2000000);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_exposition_format);
+    RUN_TEST(test_tiny_chunks_give_same_output);
+    return UNITY_END();
+}
@@ -0,0 +1,138 @@
+// MetricsAccumulator のホストテスト (pio test -e native)
+// 長いセッションを流し、µm / mcal の整数積算を厳密値 (128bit整数) と double の参照値に突き合わせる
+#include <unity.h>
+#include "MetricsAccumulator.hpp"
+#include "ChairModel.hpp"
+
+// 端数の繰り越しが効く機種: 3パルスで1回転、1回転の距離は3で割り切れない
+struct ThreePulseChair {
+    static constexpr uint32_t PULSES_PER_REV = 3;
+    static constexpr uint32_t REV_DISTANCE_UM = 4446601;
+    static constexpr uint32_t CALORIES_K1_E8 = 113889;
+    static constexpr uint32_t MAX_RPM = 300;
+};
+
+typedef unsigned __int128 uint128;
+
+void setUp() {}
+void tearDown() {}
+
+// 5年間、1日1時間、1秒ごとに区間を足す (約70rpm: 6秒で7パルス)
+void test_long_session_has_zero_drift() {
+    const uint64_t intervals = 5ull * 365 * 3600;
+    MetricsAccumulator accumulator;
+    uint64_t pulses = 0;
+    uint128 exactCalorieNumerator = 0; // 10^-8 mcal 単位
+    double referenceKm = 0.0;
+    double referenceKcal = 0.0;
+    for (uint64_t i = 0; i < intervals; i++) {
+        uint32_t intervalPulses = (i % 6 == 0) ? 2 : 1;
+        uint32_t milliRpm = accumulator.addInterval<DefaultChairModel>(intervalPulses, 1000);
+        TEST_ASSERT_EQUAL_UINT32(intervalPulses * 60000, milliRpm);
+        pulses += intervalPulses;
+        exactCalorieNumerator += (uint128)DefaultChairModel::CALORIES_K1_E8 * milliRpm * 1000;
+        referenceKm += intervalPulses * (DefaultChairModel::REV_DISTANCE_UM / 1e9);
+        referenceKcal += DefaultChairModel::CALORIES_K1_E8 / 1e8 * (milliRpm / 1000.0);
+    }
+    const MetricsAccumulator::Totals& totals = accumulator.cumulative();
+    // 整数では厳密値と1単位も違わない (端数は繰り越されて消えない)
+    TEST_ASSERT_EQUAL_UINT64(pulses * DefaultChairModel::REV_DISTANCE_UM, totals.distanceUm);
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)(exactCalorieNumerator / 100000000u), totals.caloriesMcal);
+    // double の参照値とも合う (差は double 側の丸め)
+    TEST_ASSERT_DOUBLE_WITHIN(1e-6, referenceKm, totals.distanceUm / 1e9);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-3, referenceKcal, totals.caloriesMcal / 1e6);
+    TEST_ASSERT_EQUAL_UINT64(totals.distanceUm, accumulator.session().distanceUm);
+}
+
+void test_float_accumulation_would_drift() {
+    // 比較用: 同じ区間を float の累積値に足すと、数千kmで1区間分 (4.4m) が丸めで消える
+    float km = 5000.0f;
+    float before = km;
+    km += DefaultChairModel::REV_DISTANCE_UM / 1e9f;
+    TEST_ASSERT_EQUAL_FLOAT(before, km);
+    // 整数なら同じ状況でも増分がそのまま残る
+    MetricsAccumulator accumulator;
+    MetricsAccumulator::Totals restored;
+    restored.distanceUm = MetricsAccumulator::fromKm(5000.0f);
+    accumulator.restoreCumulative(restored);
+    accumulator.addInterval<DefaultChairModel>(1, 1000);
+    TEST_ASSERT_EQUAL_UINT64(restored.distanceUm + DefaultChairModel::REV_DISTANCE_UM, accumulator.cumulative().distanceUm);
+}
+
+void test_distance_remainder_is_carried() {
+    // 区間の切り方によらず、距離は 合計パルス × 1回転 / 3 の切り捨てに一致する
+    MetricsAccumulator accumulator;
+    uint64_t pulses = 0;
+    for (uint32_t i = 0; i < 100000; i++) {
+        uint32_t intervalPulses = i % 5; // 0..4 パルス
+        accumulator.addInterval<ThreePulseChair>(intervalPulses, 1000);
+        pulses += intervalPulses;
+        TEST_ASSERT_EQUAL_UINT64(pulses * ThreePulseChair::REV_DISTANCE_UM / 3, accumulator.cumulative().distanceUm);
+    }
+}
+
+void test_calorie_remainder_is_carried_for_short_intervals() {
+    // 1ms区間は1回では1mcalに満たないが、繰り越しで失われない
+    const uint32_t milliRpm = 60000;
+    MetricsAccumulator accumulator;
+    uint128 exact = 0;
+    for (uint32_t i = 0; i < 1000000; i++) {
+        accumulator.addIntervalAtRpm<DefaultChairModel>(0, 1, milliRpm);
+        exact += (uint128)DefaultChairModel::CALORIES_K1_E8 * milliRpm;
+    }
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)(exact / 100000000u), accumulator.cumulative().caloriesMcal);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, (uint32_t)accumulator.cumulative().caloriesMcal);
+}
+
+void test_long_interval_is_chunked_without_overflow() {
+    // 2^28 ms を超える区間も64bitで溢れず、短く分けて足した場合と同じになる
+    const uint32_t longMs = (1u << 30) + 12345;
+    const uint32_t milliRpm = 300000;
+    MetricsAccumulator whole;
+    whole.addIntervalAtRpm<DefaultChairModel>(0, longMs, milliRpm);
+    MetricsAccumulator split;
+    for (uint32_t remaining = longMs; remaining > 0;) {
+        uint32_t ms = remaining > 1000000 ? 1000000 : remaining;
+        split.addIntervalAtRpm<DefaultChairModel>(0, ms, milliRpm);
+        remaining -= ms;
+    }
+    uint128 exact = (uint128)DefaultChairModel::CALORIES_K1_E8 * milliRpm * longMs;
+    TEST_ASSERT_EQUAL_UINT64((uint64_t)(exact / 100000000u), whole.cumulative().caloriesMcal);
+    TEST_ASSERT_EQUAL_UINT64(whole.cumulative().caloriesMcal, split.cumulative().caloriesMcal);
+}
+
+void test_rpm_above_limit_uses_last_valid() {
+    MetricsAccumulator accumulator;
+    TEST_ASSERT_EQUAL_UINT32(60000, accumulator.addInterval<DefaultChairModel>(1, 1000));
+    TEST_ASSERT_FALSE(accumulator.wasRpmSubstituted());
+    // 1秒に10パルス = 600rpm は上限超え
+    TEST_ASSERT_EQUAL_UINT32(60000, accumulator.addInterval<DefaultChairModel>(10, 1000));
+    TEST_ASSERT_TRUE(accumulator.wasRpmSubstituted());
+    // 距離は実際のパルス数で数える
+    TEST_ASSERT_EQUAL_UINT64(11ull * DefaultChairModel::REV_DISTANCE_UM, accumulator.cumulative().distanceUm);
+}
+
+void test_session_reset_keeps_cumulative() {
+    MetricsAccumulator accumulator;
+    accumulator.addInterval<ThreePulseChair>(2, 1000);
+    accumulator.addActiveTime(1000);
+    accumulator.resetSession();
+    TEST_ASSERT_EQUAL_UINT64(0, accumulator.session().distanceUm);
+    TEST_ASSERT_EQUAL_UINT64(0, accumulator.session().timeMs);
+    TEST_ASSERT_EQUAL_UINT64(1000, accumulator.cumulative().timeMs);
+    // 端数はリセットをまたいで繰り越す
+    accumulator.addInterval<ThreePulseChair>(1, 1000);
+    TEST_ASSERT_EQUAL_UINT64(3ull * ThreePulseChair::REV_DISTANCE_UM / 3, accumulator.cumulative().distanceUm);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_long_session_has_zero_drift);
+    RUN_TEST(test_float_accumulation_would_drift);
+    RUN_TEST(test_distance_remainder_is_carried);
+    RUN_TEST(test_calorie_remainder_is_carried_for_short_intervals);
+    RUN_TEST(test_long_interval_is_chunked_without_overflow);
+    RUN_TEST(test_rpm_above_limit_uses_last_valid);
+    RUN_TEST(test_session_reset_keeps_cumulative);
+    return UNITY_END();
+}
@@ -0,0 +1,77 @@
+// 計算の中核 (MetricsAccumulator::addInterval) をホスト上で流す (pio test -e native -f test_metrics_benchmark)
+// テンプレート化する前の計算 (係数を実行時に double で畳み込む) も同じ入力で流し、距離の正確さと1区間あたりの時間を並べる。
+// 駆動方式の切り替えや update() 全体の速さを測るものではない (update() は PulseCounter (PCNT) を読むので実機でしか測れない:
+// m5stack-core-esp32-profiling 環境で "prof" の metrics_update を見る)
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include "MetricsAccumulator.hpp"
+#include "ChairModel.hpp"
+
+static const uint32_t INTERVALS = 2000000;
+
+// テンプレート化前の計算。係数は設定から実行時に読む (volatile で定数畳み込みを止める)
+struct RuntimeChairCalculator {
+    volatile int pulsesPerRev = PULSES_PER_REVOLUTION;
+    volatile float distancePerRevM = DISTANCE_PER_REV_M;
+    volatile float caloriesK1 = CALORIES_RPM_K1_FACTOR;
+    volatile uint32_t maxRpm = MAX_VALID_RPM;
+    float distanceKm = 0.0f;
+    float caloriesKcal = 0.0f;
+    float lastValidRpm = 0.0f;
+
+    float add(uint32_t pulses, uint32_t intervalMs) {
+        double seconds = intervalMs / 1000.0;
+        float rpm = (float)((double)pulses / pulsesPerRev / seconds * 60.0);
+        if (rpm > maxRpm)
+            rpm = lastValidRpm;
+        lastValidRpm = rpm;
+        distanceKm += (float)((double)pulses / pulsesPerRev * distancePerRevM / 1000.0);
+        caloriesKcal += (float)((double)caloriesK1 * rpm * seconds);
+        return rpm;
+    }
+};
+
+template <typename Fn>
+static double nsPerCall(Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < INTERVALS; i++)
+        fn(i);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / INTERVALS;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_benchmark_add_interval() {
+    MetricsAccumulator accumulator;
+    RuntimeChairCalculator runtime;
+    volatile uint32_t sink = 0;
+    // 約70rpm: 6秒で7パルス
+    double specializedNs = nsPerCall([&](uint32_t i) {
+        sink = accumulator.addInterval<DefaultChairModel>((i % 6 == 0) ? 2 : 1, 1000);
+    });
+    double runtimeNs = nsPerCall([&](uint32_t i) {
+        sink = (uint32_t)runtime.add((i % 6 == 0) ? 2 : 1, 1000);
+    });
+    (void)sink;
+
+    // 距離の厳密値は 合計パルス × 1回転 (1パルス1回転)。float の累積はここで既に0.6%ほどずれる
+    uint64_t pulses = INTERVALS + (INTERVALS + 5) / 6;
+    double exactKm = pulses * (DefaultChairModel::REV_DISTANCE_UM / 1e9);
+    char message[160];
+    snprintf(message, sizeof(message),
+             "addInterval<DefaultChairModel>: %.1f ns/interval (%.3f km), runtime double: %.1f ns/interval (%.3f km), exact %.3f km",
+             specializedNs, MetricsAccumulator::toKm(accumulator.cumulative().distanceUm), runtimeNs, runtime.distanceKm, exactKm);
+    TEST_MESSAGE(message);
+
+    TEST_ASSERT_EQUAL_UINT64(pulses * DefaultChairModel::REV_DISTANCE_UM, accumulator.cumulative().distanceUm);
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, runtime.lastValidRpm, accumulator.getMilliRpm() / 1000.0f);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_benchmark_add_interval);
+    return UNITY_END();
+}
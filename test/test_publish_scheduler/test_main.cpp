@@ -0,0 +1,178 @@
+// PublishScheduler のホストテスト (pio test -e native)
+// rpm/速度とRTTの時系列を observe → shouldPublish → onPublished の順に流し、送信間隔と帯域予算を確かめる
+#include <unity.h>
+#include <limits.h>
+#include <vector>
+#include "PublishScheduler.hpp"
+
+static const unsigned long MIN_INTERVAL_MS = 500;
+static const unsigned long HEARTBEAT_MS = 5000;
+static const unsigned long STEP_MS = 50; // 計測タスクの更新間隔に相当
+
+// 1ステップ分の入力
+struct TracePoint {
+    float rpm;
+    float speedKmh;
+};
+
+// 送信の記録
+struct ReplayResult {
+    std::vector<uint64_t> publishTimesMs;
+    size_t bytesSent = 0;
+};
+
+// durationMs の間 trace(t) を流す。送信したら payloadBytes, rttMs を返したことにする
+template <typename TraceFn>
+static ReplayResult replay(PublishScheduler& scheduler, uint64_t durationMs, TraceFn trace,
+                           size_t payloadBytes, unsigned long rttMs) {
+    ReplayResult result;
+    for (uint64_t now = 0; now <= durationMs; now += STEP_MS) {
+        TracePoint point = trace(now);
+        scheduler.observe(now, point.rpm, point.speedKmh);
+        if (scheduler.shouldPublish(now)) {
+            scheduler.onPublished(now, payloadBytes, rttMs);
+            result.publishTimesMs.push_back(now);
+            result.bytesSent += payloadBytes;
+        }
+    }
+    return result;
+}
+
+static unsigned long minGapMs(const ReplayResult& result) {
+    unsigned long gap = ULONG_MAX;
+    for (size_t i = 1; i < result.publishTimesMs.size(); i++) {
+        unsigned long d = (unsigned long)(result.publishTimesMs[i] - result.publishTimesMs[i - 1]);
+        if (d < gap)
+            gap = d;
+    }
+    return gap;
+}
+
+static unsigned long maxGapMs(const ReplayResult& result) {
+    unsigned long gap = 0;
+    for (size_t i = 1; i < result.publishTimesMs.size(); i++) {
+        unsigned long d = (unsigned long)(result.publishTimesMs[i] - result.publishTimesMs[i - 1]);
+        if (d > gap)
+            gap = d;
+    }
+    return gap;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_steady_pace_uses_heartbeat() {
+    PublishScheduler scheduler;
+    scheduler.begin(MIN_INTERVAL_MS, HEARTBEAT_MS, 0);
+    ReplayResult result = replay(scheduler, 60000, [](uint64_t) { return TracePoint{60.0f, 12.0f}; }, 200, 20);
+    // 初回は即送信、以降はハートビートごと
+    TEST_ASSERT_EQUAL_UINT64(0, result.publishTimesMs.front());
+    TEST_ASSERT_EQUAL_UINT32(13, result.publishTimesMs.size());
+    TEST_ASSERT_EQUAL_UINT32(HEARTBEAT_MS, minGapMs(result));
+    TEST_ASSERT_EQUAL_UINT32(HEARTBEAT_MS, maxGapMs(result));
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 0.0f, scheduler.getActivity());
+}
+
+void test_interval_stays_within_bounds() {
+    PublishScheduler scheduler;
+    scheduler.begin(MIN_INTERVAL_MS, HEARTBEAT_MS, 0);
+    // 漕ぎ始め → 加速 → 定常 → 停止 を繰り返す
+    auto trace = [](uint64_t now) {
+        uint64_t phase = now % 40000;
+        float rpm;
+        if (phase < 10000)
+            rpm = 0.0f;
+        else if (phase < 15000)
+            rpm = (phase - 10000) * 0.02f; // 5秒で100rpmまで
+        else if (phase < 35000)
+            rpm = 100.0f;
+        else
+            rpm = 100.0f - (phase - 35000) * 0.02f;
+        return TracePoint{rpm, rpm * 0.2f};
+    };
+    uint64_t now = 0;
+    for (; now <= 200000; now += STEP_MS) {
+        TracePoint point = trace(now);
+        scheduler.observe(now, point.rpm, point.speedKmh);
+        unsigned long interval = scheduler.getTargetIntervalMs();
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(MIN_INTERVAL_MS, interval);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32(HEARTBEAT_MS, interval);
+        if (scheduler.shouldPublish(now))
+            scheduler.onPublished(now, 200, 20);
+    }
+    // 加速中は最短間隔まで詰まる
+    PublishScheduler accelerating;
+    accelerating.begin(MIN_INTERVAL_MS, HEARTBEAT_MS, 0);
+    ReplayResult result = replay(accelerating, 5000,
+        [](uint64_t now) { return TracePoint{now * 0.02f, now * 0.004f}; }, 200, 20);
+    TEST_ASSERT_EQUAL_UINT32(MIN_INTERVAL_MS, minGapMs(result));
+    TEST_ASSERT_EQUAL_UINT32(MIN_INTERVAL_MS, accelerating.getTargetIntervalMs());
+}
+
+void test_activity_decays_back_to_heartbeat() {
+    PublishScheduler scheduler;
+    scheduler.begin(MIN_INTERVAL_MS, HEARTBEAT_MS, 0);
+    // 1秒だけ急変し、その後は定常
+    replay(scheduler, 30000,
+        [](uint64_t now) { return TracePoint{now < 1000 ? now * 0.1f : 100.0f, 20.0f}; }, 200, 20);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, scheduler.getActivity());
+    TEST_ASSERT_UINT32_WITHIN(100, HEARTBEAT_MS, scheduler.getTargetIntervalMs());
+}
+
+void test_rtt_sets_the_floor() {
+    PublishScheduler scheduler;
+    scheduler.begin(MIN_INTERVAL_MS, HEARTBEAT_MS, 0);
+    // 急変し続けても、RTT 2秒のリンクには RTT*1.5 より詰めない
+    ReplayResult result = replay(scheduler, 60000,
+        [](uint64_t now) { return TracePoint{(now / 100) % 2 ? 100.0f : 20.0f, 10.0f}; }, 200, 2000);
+    TEST_ASSERT_EQUAL_UINT32(2000, scheduler.getSmoothedRttMs());
+    TEST_ASSERT_EQUAL_UINT32(3000, scheduler.getTargetIntervalMs());
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(3000, minGapMs(result));
+}
+
+void test_token_bucket_caps_bytes() {
+    const uint32_t budget = 200;       // bytes/s
+    const size_t payload = 400;        // 1回2秒分
+    const uint64_t durationMs = 120000;
+    PublishScheduler scheduler;
+    scheduler.begin(MIN_INTERVAL_MS, HEARTBEAT_MS, budget);
+    ReplayResult result = replay(scheduler, durationMs,
+        [](uint64_t now) { return TracePoint{(now / 100) % 2 ? 100.0f : 20.0f, 10.0f}; }, payload, 20);
+    // 送ったバイト数は 予算 × 時間 + バケット容量(2秒分) + 初回1回分 を超えない
+    size_t limit = budget * durationMs / 1000 + budget * 2 + payload;
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(limit, result.bytesSent);
+    // 予算の下限 (平均ペイロード / 予算 = 2秒) より詰めない
+    TEST_ASSERT_EQUAL_UINT32(2000, scheduler.getTargetIntervalMs());
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2000, minGapMs(result));
+    // 予算内ではちゃんと使い切る (9割以上)
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(budget * durationMs / 1000 * 9 / 10, result.bytesSent);
+}
+
+void test_msuntildue_matches_shouldpublish() {
+    PublishScheduler scheduler;
+    scheduler.begin(MIN_INTERVAL_MS, HEARTBEAT_MS, 300);
+    TEST_ASSERT_EQUAL_UINT32(0, scheduler.msUntilDue(0)); // 初回は今すぐ
+    scheduler.observe(0, 60.0f, 12.0f);
+    scheduler.observe(1000, 70.0f, 12.0f); // 変化率 0.5 → 間隔は最短とハートビートの間
+    // 新しい観測が無い間は、msUntilDue() の時刻ちょうどで送れる (間隔とトークンの両方を見ている)
+    uint64_t now = 1000;
+    for (int i = 0; i < 20; i++) {
+        TEST_ASSERT_TRUE(scheduler.shouldPublish(now));
+        scheduler.onPublished(now, 500, 40);
+        unsigned long due = scheduler.msUntilDue(now);
+        TEST_ASSERT_GREATER_THAN_UINT32(0, due);
+        TEST_ASSERT_FALSE(scheduler.shouldPublish(now + due - 1));
+        now += due;
+    }
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_steady_pace_uses_heartbeat);
+    RUN_TEST(test_interval_stays_within_bounds);
+    RUN_TEST(test_activity_decays_back_to_heartbeat);
+    RUN_TEST(test_rtt_sets_the_floor);
+    RUN_TEST(test_token_bucket_caps_bytes);
+    RUN_TEST(test_msuntildue_matches_shouldpublish);
+    return UNITY_END();
+}
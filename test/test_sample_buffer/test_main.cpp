@@ -0,0 +1,200 @@
+// SampleBuffer のホストテスト (pio test -e native)
+// 書いたサンプルがそのまま読み戻せること (負の差分・Rice 符号の境界・エスケープ) と、圧縮率を確かめる
+#include <unity.h>
+#include <stdio.h>
+#include <vector>
+#include "SampleBuffer.hpp"
+#include "CadenceEstimator.hpp"
+#include "ChairModel.hpp"
+
+static const size_t RAW_SAMPLE_BYTES = 8 + 2 + 2 + 4; // 生で持つと1サンプル16バイト
+
+static Sample makeSample(uint64_t timestampMs, uint16_t rpm, uint16_t speed, uint32_t pulses) {
+    Sample sample;
+    sample.timestampMs = timestampMs;
+    sample.rpm = rpm;
+    sample.speed = speed;
+    sample.pulses = pulses;
+    return sample;
+}
+
+// 全部書いてから全部読み、同じ列に戻ることを確かめる
+static void assertRoundTrip(const std::vector<Sample>& samples) {
+    static SampleBuffer buffer; // 32KB あるのでスタックに置かない
+    buffer.clear();
+    for (const Sample& sample : samples)
+        buffer.append(sample);
+    TEST_ASSERT_EQUAL_UINT32(samples.size(), buffer.getSampleCount());
+    SampleBuffer::Reader reader(buffer);
+    Sample out;
+    for (size_t i = 0; i < samples.size(); i++) {
+        TEST_ASSERT_TRUE(reader.next(out));
+        TEST_ASSERT_EQUAL_UINT64(samples[i].timestampMs, out.timestampMs);
+        TEST_ASSERT_EQUAL_UINT16(samples[i].rpm, out.rpm);
+        TEST_ASSERT_EQUAL_UINT16(samples[i].speed, out.speed);
+        TEST_ASSERT_EQUAL_UINT32(samples[i].pulses, out.pulses);
+    }
+    TEST_ASSERT_FALSE(reader.next(out));
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_round_trip_negative_deltas() {
+    std::vector<Sample> samples;
+    uint64_t t = 1000;
+    uint32_t pulses = 0;
+    // 減速 (RPM の差分が負)、間隔が縮む (時刻の差分の差分が負)、セッションのリセット (パルス数が0に戻る)
+    for (int i = 0; i < 300; i++) {
+        uint16_t rpm = (uint16_t)(12000 - i * 37);
+        t += (i % 7 == 0) ? 1500 : 1000 - (i % 3) * 10;
+        pulses = (i == 150) ? 0 : pulses + 1 + (i % 2);
+        samples.push_back(makeSample(t, rpm, (uint16_t)(rpm / 5 + (i % 5) - 2), pulses));
+    }
+    assertRoundTrip(samples);
+}
+
+void test_round_trip_rice_edges() {
+    std::vector<Sample> samples;
+    // 長く0が続いて k が0まで下がった直後に、最大の振れ (エスケープ) が来る
+    for (int i = 0; i < 100; i++)
+        samples.push_back(makeSample(1000ull * i, 6000, 1200, (uint32_t)i));
+    samples.push_back(makeSample(100000, UINT16_MAX, UINT16_MAX, UINT32_MAX));
+    samples.push_back(makeSample(100001, 0, 0, 0));
+    samples.push_back(makeSample(UINT64_MAX / 2, UINT16_MAX, 0, UINT32_MAX));
+    samples.push_back(makeSample(UINT64_MAX / 2 + 1, 1, UINT16_MAX, 1));
+    // 大きな値が続いた後で k が大きいまま、小さな値に戻る
+    for (int i = 0; i < 100; i++)
+        samples.push_back(makeSample(UINT64_MAX / 2 + 2 + 1000ull * i, (uint16_t)(i * 600), (uint16_t)(i * 120), (uint32_t)i * 1000));
+    // RPM が0 (速度の予測は前の速度のまま)
+    for (int i = 0; i < 20; i++)
+        samples.push_back(makeSample(UINT64_MAX / 2 + 200000 + 1000ull * i, 0, (uint16_t)(i % 2), 0));
+    assertRoundTrip(samples);
+}
+
+void test_rice_parameter_tracks_magnitude() {
+    SampleBuffer::RiceState state;
+    TEST_ASSERT_EQUAL_UINT8(2, state.k()); // 初期値: 平均4
+    for (int i = 0; i < 64; i++)
+        state.update(0);
+    TEST_ASSERT_EQUAL_UINT8(0, state.k()); // 0が続けば1bit/値
+    for (int i = 0; i < 64; i++)
+        state.update(1000);
+    TEST_ASSERT_EQUAL_UINT8(10, state.k()); // 平均 ≒ 2^k
+    // 巨大な値は上限で抑えるので、k は32を超えず、0に戻ればすぐに下がる
+    for (int i = 0; i < 64; i++)
+        state.update(UINT64_MAX);
+    uint8_t peak = state.k();
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(32, peak);
+    // 古い値の重みは16件ごとに半分になるので、数百件の0で元に戻る
+    for (int i = 0; i < 100; i++)
+        state.update(0);
+    TEST_ASSERT_LESS_THAN_UINT32(peak, state.k());
+    for (int i = 0; i < 400; i++)
+        state.update(0);
+    TEST_ASSERT_EQUAL_UINT8(0, state.k());
+}
+
+void test_from_metrics_rounds_rpm_and_derives_speed() {
+    Sample sample = Sample::fromMetrics(5000, 59.6f, 0.267f, 42);
+    TEST_ASSERT_EQUAL_UINT64(5000, sample.timestampMs);
+    TEST_ASSERT_EQUAL_UINT16(60, sample.rpm);
+    TEST_ASSERT_EQUAL_UINT16(1602, sample.speed); // 60rpm × 0.267 (59.6rpm の値ではない)
+    TEST_ASSERT_EQUAL_UINT32(42, sample.pulses);
+    TEST_ASSERT_EQUAL_UINT16(0, Sample::fromMetrics(0, 0.4f, 0.267f, 0).rpm);
+    TEST_ASSERT_EQUAL_UINT16(UINT16_MAX, Sample::fromMetrics(0, 1.0e6f, 0.267f, 0).speed);
+}
+
+// 合成したペダリング (1回転1パルス、間隔に ±5% の一様な揺れ、10分ごとにペースを変える) を
+// CadenceEstimator に通し、main.cpp と同じく Sample::fromMetrics で1秒に1件のサンプルにする
+static uint32_t appendPedalling(SampleBuffer& buffer, uint32_t seconds) {
+    CadenceEstimator estimator;
+    estimator.begin(CadenceConfig(), 1, 60000000UL / DefaultChairModel::MAX_RPM, 10000000UL);
+    uint32_t random = 12345;
+    uint32_t paceRpm = 60;
+    uint64_t lastPulseUs = 0;
+    uint64_t nextPulseUs = 1000000;
+    uint32_t pulses = 0;
+    for (uint32_t second = 1; second <= seconds; second++) {
+        if (second % 600 == 0)
+            paceRpm = 50 + (random >> 16) % 40;
+        uint64_t nowUs = (uint64_t)second * 1000000;
+        while (nextPulseUs <= nowUs) {
+            if (estimator.addPeriod(lastPulseUs == 0 ? 0 : (uint32_t)(nextPulseUs - lastPulseUs)))
+                pulses++;
+            lastPulseUs = nextPulseUs;
+            random = random * 1103515245u + 12345u;
+            int32_t jitterPermille = (int32_t)((random >> 16) % 101) - 50;
+            nextPulseUs += 60000000ULL * (1000 + jitterPermille) / (1000ULL * paceRpm);
+        }
+        float rpm = estimator.getMilliRpm(nowUs - lastPulseUs) / 1000.0f;
+        buffer.append(Sample::fromMetrics(1000ull * second, rpm, DefaultChairModel::KMH_PER_RPM, pulses));
+    }
+    return seconds;
+}
+
+void test_compression_ratio_for_steady_session() {
+    static SampleBuffer buffer;
+    buffer.clear();
+    // 1時間、1秒に1件
+    const uint32_t count = appendPedalling(buffer, 3600);
+    TEST_ASSERT_EQUAL_UINT32(count, buffer.getSampleCount());
+    TEST_ASSERT_EQUAL_UINT32(0, buffer.getDroppedSamples());
+    size_t bytes = buffer.getBytesUsed();
+    char message[128];
+    snprintf(message, sizeof(message), "%u samples in %u bytes (%.2f bits/sample, ratio %.1fx, %.1f KB/day)",
+             (unsigned)count, (unsigned)bytes, bytes * 8.0 / count, (double)count * RAW_SAMPLE_BYTES / bytes,
+             bytes * 24.0 / 1024);
+    TEST_MESSAGE(message);
+    // 1日分 (86400件) が 80KB 以内 (1サンプル約7.6bit 以下)
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(80 * 1024, bytes * 24);
+
+    // 完全に一定のペースなら4列とも0が続き、1サンプル5bit以下 (1列1bit + 最初の k が下がるまでの分)
+    buffer.clear();
+    for (uint32_t i = 0; i < count; i++)
+        buffer.append(makeSample(1000ull * i, 60, 1602, i));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(count * 5 / 8, buffer.getBytesUsed());
+}
+
+void test_full_buffer_drops_oldest_block() {
+    static SampleBuffer buffer;
+    buffer.clear();
+    // 速度がでたらめで圧縮が効かない列を、ブロックが一周するまで入れる
+    uint32_t state = 1;
+    uint32_t appended = 0;
+    while (buffer.getDroppedSamples() == 0) {
+        state = state * 1103515245u + 12345u;
+        buffer.append(makeSample(1000ull * appended, (uint16_t)(state >> 16), (uint16_t)state, appended));
+        appended++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(SAMPLE_BUFFER_BLOCKS, buffer.getBlockCount());
+    TEST_ASSERT_EQUAL_UINT32(appended, buffer.getSampleCount() + buffer.getDroppedSamples());
+    // 残っているのは新しい方の連続した列
+    SampleBuffer::Reader reader(buffer);
+    Sample out;
+    uint32_t expected = buffer.getDroppedSamples();
+    while (reader.next(out)) {
+        TEST_ASSERT_EQUAL_UINT32(expected, out.pulses);
+        TEST_ASSERT_EQUAL_UINT64(1000ull * expected, out.timestampMs);
+        expected++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(appended, expected);
+    // 読み終えたブロックを解放すると、書き込み中の最新ブロックだけが残る
+    size_t finished = reader.blocksFinished();
+    TEST_ASSERT_EQUAL_UINT32(SAMPLE_BUFFER_BLOCKS - 1, finished);
+    for (size_t i = 0; i < finished; i++)
+        buffer.releaseOldestBlock();
+    TEST_ASSERT_EQUAL_UINT32(1, buffer.getBlockCount());
+    TEST_ASSERT_GREATER_THAN_UINT32(0, buffer.getSampleCount());
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_negative_deltas);
+    RUN_TEST(test_round_trip_rice_edges);
+    RUN_TEST(test_rice_parameter_tracks_magnitude);
+    RUN_TEST(test_from_metrics_rounds_rpm_and_derives_speed);
+    RUN_TEST(test_compression_ratio_for_steady_session);
+    RUN_TEST(test_full_buffer_drops_oldest_block);
+    return UNITY_END();
+}
@@ -0,0 +1,102 @@
+// SeqLock / SplitUint64 のホストテスト (pio test -e native)
+// PulseCounter の ISR と同じ書き方をするスレッドと読み手のスレッドを回し、
+// 64bit時刻が2語の途中で読まれたり、カウントと時刻が別のパルスのものになったりしないことを確かめる
+#include <unity.h>
+#include <atomic>
+#include <stdio.h>
+#include <thread>
+#include "SeqLock.hpp"
+
+// PulseCounter::ChannelState と同じ形
+struct PulseState {
+    SeqLock seqLock;
+    std::atomic<uint32_t> count{0};
+    SplitUint64 lastPulseMs;
+};
+
+// n 番目のパルスの時刻。上下の語が毎回両方変わり、32bitの繰り上がりもまたぐ
+static uint64_t timestampFor(uint32_t count) {
+    return 0xFFFFFF00ull + ((uint64_t)count << 32) + count;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_split_uint64_round_trip() {
+    SplitUint64 value;
+    TEST_ASSERT_EQUAL_UINT64(0, value.load());
+    const uint64_t samples[] = {1, 0xFFFFFFFFull, 0x100000000ull, 0x123456789ABCDEF0ull, UINT64_MAX};
+    for (uint64_t sample : samples) {
+        value.store(sample);
+        TEST_ASSERT_EQUAL_UINT64(sample, value.load());
+    }
+}
+
+void test_read_retries_while_writing() {
+    SeqLock lock;
+    uint32_t start = lock.beginRead();
+    TEST_ASSERT_FALSE(lock.retryRead(start));
+    lock.beginWrite();
+    // 書き込み中に読み始めたら読み直す
+    uint32_t during = lock.beginRead();
+    TEST_ASSERT_TRUE(lock.retryRead(during));
+    lock.endWrite();
+    // 読んでいる間に書き込みが終わっていても読み直す
+    TEST_ASSERT_TRUE(lock.retryRead(start));
+    TEST_ASSERT_FALSE(lock.retryRead(lock.beginRead()));
+}
+
+void test_concurrent_reads_are_never_torn() {
+    const uint32_t pulses = 3000000;
+    PulseState state;
+    std::atomic<bool> done(false);
+
+    std::thread writer([&]() {
+        for (uint32_t n = 1; n <= pulses; n++) {
+            state.seqLock.beginWrite();
+            state.count.store(n, std::memory_order_relaxed);
+            state.lastPulseMs.store(timestampFor(n));
+            state.seqLock.endWrite();
+        }
+        done.store(true);
+    });
+
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    uint64_t retries = 0;
+    uint32_t lastCount = 0;
+    bool finished = false;
+    while (!finished) {
+        finished = done.load();
+        uint32_t count;
+        uint64_t timestamp;
+        uint32_t start;
+        do {
+            start = state.seqLock.beginRead();
+            count = state.count.load(std::memory_order_relaxed);
+            timestamp = state.lastPulseMs.load();
+            retries++;
+        } while (state.seqLock.retryRead(start));
+        retries--;
+        reads++;
+        if (count != 0 && timestamp != timestampFor(count))
+            torn++;
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(lastCount, count);
+        lastCount = count;
+    }
+    writer.join();
+
+    char message[96];
+    snprintf(message, sizeof(message), "%llu reads, %llu retries", (unsigned long long)reads, (unsigned long long)retries);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT64(0, torn);
+    TEST_ASSERT_EQUAL_UINT32(pulses, lastCount);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_split_uint64_round_trip);
+    RUN_TEST(test_read_retries_while_writing);
+    RUN_TEST(test_concurrent_reads_are_never_torn);
+    return UNITY_END();
+}
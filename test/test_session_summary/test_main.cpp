@@ -0,0 +1,147 @@
+// SessionSummaryBuilder のホストテスト (pio test -e native)
+// MetricsCalculator と同じ順で MetricsAccumulator / CadenceAnalyzer / SessionSummaryBuilder に区間を流し、
+// 台本どおりのパルス列から出た要約 (時間・距離・カロリー・RPM・ゾーン) を手計算の値と突き合わせる
+#include <unity.h>
+#include "SessionSummary.hpp"
+
+// 計算しやすい機種: 1パルスで1回転 = 2m、カロリーは 0.001 kcal/s/rpm
+struct ScriptChair {
+    static constexpr uint32_t PULSES_PER_REV = 1;
+    static constexpr uint32_t REV_DISTANCE_UM = 2000000;
+    static constexpr uint32_t CALORIES_K1_E8 = 100000;
+    static constexpr uint32_t MAX_RPM = 300;
+};
+
+// MetricsCalculator の1区間分 (BasicMetricsCalculator::update の計算部分と同じ順)
+struct Session {
+    MetricsAccumulator accumulator;
+    CadenceAnalyzer cadence;
+    SessionSummaryBuilder builder;
+    uint64_t nowMs = 0;
+    uint64_t lastPulseMs = 0;
+
+    void start() {
+        accumulator.resetSession();
+        cadence.reset(nowMs);
+        builder.start(nowMs);
+    }
+    // タイマー動作中に intervalMs の間に pulses 回
+    void pedal(uint32_t pulses, uint32_t intervalMs) {
+        nowMs += intervalMs;
+        accumulator.addInterval<ScriptChair>(pulses, intervalMs);
+        accumulator.addActiveTime(intervalMs);
+        builder.addInterval(intervalMs, accumulator.getMilliRpm(), pulses, true);
+        cadence.add(nowMs, intervalMs, accumulator.getMilliRpm(), true);
+        if (pulses > 0)
+            lastPulseMs = nowMs;
+    }
+    // タイマーが止まり、パルスも無い区間 (計算はせず、区間検出に 0rpm だけ入れる)
+    void rest(uint32_t intervalMs) {
+        nowMs += intervalMs;
+        cadence.add(nowMs, intervalMs, 0, false);
+    }
+    SessionSummary finish() {
+        return builder.finish(lastPulseMs, accumulator.session(), cadence.getAnalysis());
+    }
+};
+
+static Session session; // CadenceAnalyzer などを含むのでスタックに置かない
+
+void setUp() {
+    session = Session();
+}
+void tearDown() {}
+
+// 60rpm で1分、休み30秒、90rpm で2分 (2秒ごとに3パルス)
+static SessionSummary runScript() {
+    session.start();
+    for (int i = 0; i < 60; i++)
+        session.pedal(1, 1000);
+    for (int i = 0; i < 30; i++)
+        session.rest(1000);
+    for (int i = 0; i < 60; i++)
+        session.pedal(3, 2000);
+    return session.finish();
+}
+
+void test_totals_from_scripted_pulses() {
+    SessionSummary summary = runScript();
+    TEST_ASSERT_EQUAL_UINT64(0, summary.startMs);
+    TEST_ASSERT_EQUAL_UINT64(210000, summary.endMs);          // 最後のパルス
+    TEST_ASSERT_EQUAL_UINT64(180000, summary.activeTimeMs);    // 休みの30秒は入らない
+    TEST_ASSERT_EQUAL_UINT32(240, summary.pulses);
+    TEST_ASSERT_EQUAL_UINT64(240ull * 2000000, summary.distanceUm); // 480m
+    // カロリー = 0.001 kcal/s/rpm × (60rpm × 60s + 90rpm × 120s) = 14.4 kcal
+    TEST_ASSERT_EQUAL_UINT64(14400000, summary.caloriesMcal);
+}
+
+void test_cadence_statistics() {
+    SessionSummary summary = runScript();
+    // 単純平均は区間の数で割る: (60 × 60 + 60 × 90) / 120
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 75.0f, summary.avgRpm);
+    // 時間重み付き平均は長さで割る: (60 × 60s + 90 × 120s) / 180s
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 80.0f, summary.timeWeightedRpm);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 90.0f, summary.maxRpm);
+
+    // ゾーンの時間はタイマー動作中だけで、合計は動作時間と同じ
+    uint64_t zoneTotal = 0;
+    for (size_t i = 0; i < CADENCE_ZONE_COUNT; i++)
+        zoneTotal += summary.zoneMs[i];
+    TEST_ASSERT_EQUAL_UINT64(summary.activeTimeMs, zoneTotal);
+    TEST_ASSERT_EQUAL_UINT32(60000, summary.zoneMs[CadenceAnalyzer::zoneOf(60000)]);
+    TEST_ASSERT_EQUAL_UINT32(120000, summary.zoneMs[CadenceAnalyzer::zoneOf(90000)]);
+    // 運動 → 休み → 運動
+    TEST_ASSERT_EQUAL_UINT16(2, summary.workIntervals);
+    TEST_ASSERT_EQUAL_UINT16(2, summary.boundaries);
+}
+
+void test_end_covers_active_time() {
+    // タイマーは最後のパルスの後も少し動くので、終了は 開始 + 動作時間 まで延ばす
+    session.nowMs = 5000;
+    session.start();
+    session.pedal(1, 1000);
+    session.pedal(0, 3000); // パルスの無いまま止まるまでの時間
+    SessionSummary summary = session.finish();
+    TEST_ASSERT_EQUAL_UINT64(5000, summary.startMs);
+    TEST_ASSERT_EQUAL_UINT64(4000, summary.activeTimeMs);
+    TEST_ASSERT_EQUAL_UINT64(9000, summary.endMs);
+    TEST_ASSERT_EQUAL_UINT32(1, summary.pulses);
+    // 止まるまでの 0rpm の区間も平均に入る
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 30.0f, summary.avgRpm);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 15.0f, summary.timeWeightedRpm);
+}
+
+void test_closed_builder_ignores_intervals_and_restarts_clean() {
+    SessionSummaryBuilder builder;
+    TEST_ASSERT_FALSE(builder.isOpen());
+    builder.addInterval(1000, 60000, 1, true); // 開始前は数えない
+    builder.start(0);
+    TEST_ASSERT_TRUE(builder.isOpen());
+    builder.addInterval(1000, 120000, 2, true);
+    MetricsAccumulator::Totals totals;
+    CadenceAnalysis cadence;
+    SessionSummary first = builder.finish(1000, totals, cadence);
+    TEST_ASSERT_FALSE(builder.isOpen());
+    TEST_ASSERT_EQUAL_UINT32(2, first.pulses);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 120.0f, first.maxRpm);
+
+    // 次のセッションに前の値を持ち越さない
+    builder.addInterval(1000, 200000, 5, true); // 閉じた後も数えない
+    builder.start(10000);
+    builder.addInterval(1000, 30000, 1, true);
+    builder.addInterval(1000, 0, 0, false); // 停止中: パルスは数えるがRPMの平均には入れない
+    SessionSummary second = builder.finish(12000, totals, cadence);
+    TEST_ASSERT_EQUAL_UINT32(1, second.pulses);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 30.0f, second.avgRpm);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, 30.0f, second.maxRpm);
+    TEST_ASSERT_EQUAL_UINT64(10000, second.startMs);
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_totals_from_scripted_pulses);
+    RUN_TEST(test_cadence_statistics);
+    RUN_TEST(test_end_covers_active_time);
+    RUN_TEST(test_closed_builder_ignores_intervals_and_restarts_clean);
+    return UNITY_END();
+}
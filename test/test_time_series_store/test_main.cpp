@@ -0,0 +1,210 @@
+// TimeSeriesStore のホストテスト (pio test -e native)
+// 範囲問い合わせ、時刻の軸の付け替え (rebase)、ディープスリープ越しの保存と復元、CSV 出力を確かめる
+#include <unity.h>
+#include <string>
+#include <string.h>
+#include "TimeSeriesStore.hpp"
+
+static TimeSeriesStore store; // 約13KB あるのでスタックに置かない
+static TimeSeriesStore other;
+static uint8_t retained[TimeSeriesStore::retainedBytes()];
+
+static const uint64_t MINUTE_MS = 60UL * 1000;
+static const uint64_t HOUR_MS = 60 * MINUTE_MS;
+static const uint64_t UNIX_MS = 1760000000000ULL; // 2025年の UNIX 時刻 (ms)
+
+// startMs から毎秒1件、seconds 秒分のサンプルを足す
+static void fill(TimeSeriesStore& target, uint64_t startMs, uint32_t seconds, float rpm) {
+    for (uint32_t i = 0; i < seconds; i++)
+        target.append(startMs + i * 1000ULL, rpm, rpm / 10.0f);
+}
+
+void setUp() {
+    store.clear();
+    other.clear();
+}
+void tearDown() {}
+
+void test_query_returns_non_empty_buckets_in_range() {
+    fill(store, 0, 120, 60.0f);           // 0〜2分
+    fill(store, 5 * MINUTE_MS, 60, 30.0f); // 5分目 (3, 4分目は空)
+    SeriesPoint points[8];
+    size_t count = store.query(SeriesTier::MINUTES, 0, 10 * MINUTE_MS, points, 8);
+    TEST_ASSERT_EQUAL_UINT32(3, count);
+    TEST_ASSERT_EQUAL_UINT64(0, points[0].startMs);
+    TEST_ASSERT_EQUAL_UINT64(MINUTE_MS, points[1].startMs);
+    TEST_ASSERT_EQUAL_UINT64(5 * MINUTE_MS, points[2].startMs);
+    TEST_ASSERT_EQUAL_UINT32(60, points[2].bucket.count);
+    TEST_ASSERT_EQUAL_UINT32(3000, points[2].bucket.rpmMean);
+    TEST_ASSERT_EQUAL_UINT32(300, points[2].bucket.speedMean);
+    // 範囲の途中から、件数の上限つき
+    count = store.query(SeriesTier::MINUTES, MINUTE_MS + 1, 10 * MINUTE_MS, points, 1);
+    TEST_ASSERT_EQUAL_UINT32(1, count);
+    TEST_ASSERT_EQUAL_UINT64(MINUTE_MS, points[0].startMs); // 範囲に重なる区間
+    // 時の段は1区間にまとまる
+    count = store.query(SeriesTier::HOURS, 0, HOUR_MS, points, 8);
+    TEST_ASSERT_EQUAL_UINT32(1, count);
+    TEST_ASSERT_EQUAL_UINT32(180, points[0].bucket.count);
+    TEST_ASSERT_EQUAL_UINT32(3000, points[0].bucket.rpmMin);
+    TEST_ASSERT_EQUAL_UINT32(6000, points[0].bucket.rpmMax);
+}
+
+void test_ring_keeps_only_capacity() {
+    // 分の段の容量を超えて進むと、古い区間は問い合わせに出てこない
+    for (uint64_t minute = 0; minute < SERIES_MINUTES_CAPACITY + 10; minute++)
+        store.append(minute * MINUTE_MS, 50.0f, 5.0f);
+    static SeriesPoint points[SERIES_MINUTES_CAPACITY + 10];
+    size_t count = store.query(SeriesTier::MINUTES, 0, UINT64_MAX, points, SERIES_MINUTES_CAPACITY + 10);
+    TEST_ASSERT_EQUAL_UINT32(SERIES_MINUTES_CAPACITY, count);
+    TEST_ASSERT_EQUAL_UINT64(10 * MINUTE_MS, points[0].startMs);
+}
+
+void test_rebase_moves_buckets_to_wall_clock() {
+    // 起動から90秒分を溜めた後に NTP で時刻が合った
+    fill(store, 0, 90, 40.0f);
+    uint64_t offset = UNIX_MS + 12345; // 起動した瞬間の UNIX 時刻
+    store.rebase((int64_t)offset);
+
+    SeriesPoint points[4];
+    // 元の時刻では見つからず、ずらした時刻で見つかる (区間の長さに丸めてずらす)
+    TEST_ASSERT_EQUAL_UINT32(0, store.query(SeriesTier::SECONDS, 0, 90 * 1000, points, 4));
+    uint64_t second = offset - offset % 1000; // 12.345秒 → 12秒ずらす
+    size_t count = store.query(SeriesTier::SECONDS, second, second + 2000, points, 4);
+    TEST_ASSERT_EQUAL_UINT32(2, count);
+    TEST_ASSERT_EQUAL_UINT64(second, points[0].startMs);
+    count = store.query(SeriesTier::MINUTES, offset - MINUTE_MS, offset + 2 * MINUTE_MS, points, 4);
+    TEST_ASSERT_EQUAL_UINT32(2, count);
+    TEST_ASSERT_EQUAL_UINT32(60, points[0].bucket.count);
+    TEST_ASSERT_EQUAL_UINT32(30, points[1].bucket.count);
+
+    // その後の追加は UNIX 時刻で続く (開いていた区間にそのまま足される)
+    store.append(offset + 90 * 1000, 40.0f, 4.0f);
+    SeriesPoint latest;
+    TEST_ASSERT_TRUE(store.latest(SeriesTier::MINUTES, latest));
+    TEST_ASSERT_EQUAL_UINT32(31, latest.bucket.count);
+    TEST_ASSERT_EQUAL_UINT64(points[1].startMs, latest.startMs);
+
+    // 再同期の小さな補正 (戻る向き)
+    store.rebase(-2000);
+    TEST_ASSERT_TRUE(store.latest(SeriesTier::SECONDS, latest));
+    TEST_ASSERT_EQUAL_UINT64((offset + 88 * 1000) / 1000 * 1000, latest.startMs);
+}
+
+void test_save_and_restore_coarse_tiers() {
+    fill(store, UNIX_MS, 150, 45.0f);
+    store.append(UNIX_MS + 3 * HOUR_MS, 80.0f, 8.0f);
+    store.save(retained);
+
+    // 起きた後: 別のインスタンス (電源が入り直した RAM) に戻す
+    TEST_ASSERT_TRUE(other.restore(retained));
+    SeriesPoint before[8], after[8];
+    size_t count = store.query(SeriesTier::MINUTES, 0, UINT64_MAX, before, 8);
+    TEST_ASSERT_EQUAL_UINT32(count, other.query(SeriesTier::MINUTES, 0, UINT64_MAX, after, 8));
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT64(before[i].startMs, after[i].startMs);
+        TEST_ASSERT_EQUAL_MEMORY(&before[i].bucket, &after[i].bucket, sizeof(SeriesBucket));
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, other.query(SeriesTier::HOURS, 0, UINT64_MAX, after, 8));
+    // 秒の段は持ち越さない
+    TEST_ASSERT_EQUAL_UINT32(0, other.query(SeriesTier::SECONDS, 0, UINT64_MAX, after, 8));
+
+    // 開いていた区間の集計も戻るので、続けて足すと平均が正しい
+    other.append(UNIX_MS + 3 * HOUR_MS + 1000, 40.0f, 4.0f);
+    store.append(UNIX_MS + 3 * HOUR_MS + 1000, 40.0f, 4.0f);
+    SeriesPoint a, b;
+    TEST_ASSERT_TRUE(store.latest(SeriesTier::HOURS, a));
+    TEST_ASSERT_TRUE(other.latest(SeriesTier::HOURS, b));
+    TEST_ASSERT_EQUAL_UINT32(2, b.bucket.count);
+    TEST_ASSERT_EQUAL_UINT32(6000, b.bucket.rpmMean);
+    TEST_ASSERT_EQUAL_MEMORY(&a.bucket, &b.bucket, sizeof(SeriesBucket));
+}
+
+void test_restore_rejects_garbage() {
+    fill(store, UNIX_MS, 10, 45.0f);
+    SeriesPoint points[4];
+
+    // 電源投入直後の RTC メモリ (0) は読まない
+    memset(retained, 0, sizeof(retained));
+    TEST_ASSERT_FALSE(store.restore(retained));
+    TEST_ASSERT_EQUAL_UINT32(1, store.query(SeriesTier::MINUTES, 0, UINT64_MAX, points, 4)); // 今の中身はそのまま
+
+    // 1バイトでも壊れていれば読まない
+    other.append(UNIX_MS, 20.0f, 2.0f);
+    other.save(retained);
+    retained[sizeof(retained) / 2] ^= 0x40;
+    TEST_ASSERT_FALSE(store.restore(retained));
+    retained[sizeof(retained) / 2] ^= 0x40;
+    TEST_ASSERT_TRUE(store.restore(retained));
+}
+
+// 問い合わせ関数 (main.cpp の queryHistory と同じ形。ここではロックは要らない)
+static size_t queryStore(SeriesTier tier, uint64_t fromMs, uint64_t toMs, SeriesPoint* out, size_t maxCount) {
+    return store.query(tier, fromMs, toMs, out, maxCount);
+}
+
+// 小さなバッファで読み切った全体
+static std::string readAll(SeriesCsvWriter& writer, size_t chunk) {
+    std::string text;
+    uint8_t buffer[64];
+    size_t length;
+    while ((length = writer.read(buffer, chunk)) > 0)
+        text.append((const char*)buffer, length);
+    return text;
+}
+
+void test_csv_pages_through_range() {
+    // ページ (16件) をまたぐ 40分ぶん
+    for (uint64_t minute = 0; minute < 40; minute++)
+        store.append(UNIX_MS + minute * MINUTE_MS, 30.0f + minute, 3.0f);
+    SeriesCsvWriter writer(queryStore, SeriesTier::MINUTES, 0, UINT64_MAX);
+    std::string csv = readAll(writer, 7); // 行の途中で切れる大きさ
+    uint8_t rest[8];
+    TEST_ASSERT_EQUAL_UINT32(0, writer.read(rest, sizeof(rest))); // 読み終えた後も 0
+
+    size_t lines = 0;
+    for (char c : csv)
+        lines += c == '\n';
+    TEST_ASSERT_EQUAL_UINT32(41, lines); // 見出し + 40区間
+    TEST_ASSERT_EQUAL_INT(0, csv.find("start_ms,count,rpm_min,rpm_mean,rpm_max,kmh_min,kmh_mean,kmh_max\n"));
+    char first[96];
+    snprintf(first, sizeof(first), "\n%llu,1,30.00,30.00,30.00,3.00,3.00,3.00\n", (unsigned long long)(UNIX_MS - UNIX_MS % MINUTE_MS));
+    TEST_ASSERT_TRUE(csv.find(first) != std::string::npos);
+    char last[96];
+    snprintf(last, sizeof(last), "\n%llu,1,69.00,", (unsigned long long)(UNIX_MS - UNIX_MS % MINUTE_MS + 39 * MINUTE_MS));
+    TEST_ASSERT_TRUE(csv.find(last) != std::string::npos);
+
+    // 範囲を絞る: 10〜19分目
+    uint64_t base = UNIX_MS - UNIX_MS % MINUTE_MS;
+    SeriesCsvWriter ranged(queryStore, SeriesTier::MINUTES, base + 10 * MINUTE_MS, base + 20 * MINUTE_MS);
+    csv = readAll(ranged, 64);
+    lines = 0;
+    for (char c : csv)
+        lines += c == '\n';
+    TEST_ASSERT_EQUAL_UINT32(11, lines);
+
+    // 履歴が空なら見出しだけ
+    store.clear();
+    SeriesCsvWriter empty(queryStore, SeriesTier::HOURS, 0, UINT64_MAX);
+    TEST_ASSERT_EQUAL_STRING("start_ms,count,rpm_min,rpm_mean,rpm_max,kmh_min,kmh_mean,kmh_max\n", readAll(empty, 64).c_str());
+}
+
+void test_tier_names() {
+    SeriesTier tier;
+    TEST_ASSERT_TRUE(TimeSeriesStore::parseTier("hour", tier));
+    TEST_ASSERT_TRUE(tier == SeriesTier::HOURS);
+    TEST_ASSERT_TRUE(TimeSeriesStore::parseTier(TimeSeriesStore::tierName(SeriesTier::SECONDS), tier));
+    TEST_ASSERT_TRUE(tier == SeriesTier::SECONDS);
+    TEST_ASSERT_FALSE(TimeSeriesStore::parseTier("day", tier));
+}
+
+int main(int argc, char** argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_query_returns_non_empty_buckets_in_range);
+    RUN_TEST(test_ring_keeps_only_capacity);
+    RUN_TEST(test_rebase_moves_buckets_to_wall_clock);
+    RUN_TEST(test_save_and_restore_coarse_tiers);
+    RUN_TEST(test_restore_rejects_garbage);
+    RUN_TEST(test_csv_pages_through_range);
+    RUN_TEST(test_tier_names);
+    return UNITY_END();
+}
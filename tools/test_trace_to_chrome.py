@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""trace_to_chrome.py のテスト (python3 -m unittest discover -s tools)
+
+tools/testdata/trace_serial.log はシリアルのログに埋まった "trace" のダンプ (19件 + 終端)。
+時刻は途中で32ビットが一周し、始まりがリングから押し出された END、ISR のトラック2つ (コア0/1)、
+書き出した時点で終わっていない区間、状態遷移を含む。終端には書き出し中に失った件数 (2) が入っている
+"""
+
+import json
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import trace_to_chrome  # noqa: E402
+
+FIXTURE = os.path.join(os.path.dirname(os.path.abspath(__file__)), "testdata", "trace_serial.log")
+SCRIPT = os.path.join(os.path.dirname(os.path.abspath(__file__)), "trace_to_chrome.py")
+
+
+def load_fixture():
+    return trace_to_chrome.load_dump(FIXTURE)
+
+
+def span_events(result):
+    return [e for e in result["traceEvents"] if e["ph"] != "M"]
+
+
+class TraceToChromeTest(unittest.TestCase):
+    def setUp(self):
+        self.dump = load_fixture()
+        self.trace = trace_to_chrome.parse(self.dump)
+        self.result = trace_to_chrome.convert(self.trace)
+
+    def test_serial_log_is_extracted(self):
+        self.assertTrue(self.dump.startswith(trace_to_chrome.MAGIC))
+        self.assertEqual(19, len(self.trace["records"]))
+        self.assertEqual(1042, self.trace["written"])
+        self.assertEqual({1: "sensing", 2: "network", 3: "ui", 4: "storage"}, self.trace["tracks"])
+
+    def test_output_is_valid_chrome_trace_json(self):
+        result = json.loads(json.dumps(self.result))
+        self.assertEqual("ms", result["displayTimeUnit"])
+        for event in result["traceEvents"]:
+            self.assertIn(event["ph"], ("M", "B", "E", "i"))
+            self.assertEqual(trace_to_chrome.PID, event["pid"])
+            self.assertIsInstance(event["name"], str)
+            if event["ph"] != "M":
+                self.assertIsInstance(event["ts"], int)
+                self.assertIsInstance(event["tid"], int)
+            if event["ph"] == "i":
+                self.assertEqual("t", event["s"])
+
+    def test_begin_end_pairs_nest_per_track(self):
+        # 同じトラックの B と E は入れ子になり、E は対になる B より前に来ない
+        stacks = {}
+        for event in span_events(self.result):
+            stack = stacks.setdefault(event["tid"], [])
+            if event["ph"] == "B":
+                stack.append(event)
+            elif event["ph"] == "E":
+                self.assertTrue(stack, "E without B: %r" % event)
+                begin = stack.pop()
+                self.assertEqual(begin["name"], event["name"])
+                self.assertLessEqual(begin["ts"], event["ts"])
+        for tid, stack in stacks.items():
+            self.assertEqual([], stack, "unclosed spans on track %d" % tid)
+
+    def test_orphan_end_is_dropped_and_open_span_is_closed(self):
+        events = span_events(self.result)
+        self.assertFalse([e for e in events if e["name"] == "publish_send"])
+        last_ts = max(e["ts"] for e in events)
+        display = [e for e in events if e["name"] == "display_update" and e["ph"] == "E"]
+        self.assertEqual(2, len(display))
+        self.assertEqual(last_ts, display[-1]["ts"])
+
+    def test_times_are_unwrapped(self):
+        # 一周した後の時刻は 2^32 を足して、前の時刻より後に並ぶ
+        records = trace_to_chrome.unwrap_times(self.trace["records"])
+        times = [r[0] for r in records]
+        self.assertEqual(sorted(times), times)
+        self.assertGreater(times[-1], 1 << 32)
+        publish = [e for e in span_events(self.result) if e["name"] == "publish"]
+        self.assertEqual(["B", "E"], [e["ph"] for e in publish])
+        self.assertEqual(0x600 + 0x1000, publish[1]["ts"] - publish[0]["ts"])
+        self.assertEqual({"arg": 204}, publish[1]["args"])  # END の arg は HTTP ステータス
+
+    def test_isr_tracks_are_named_by_core(self):
+        names = {e["tid"]: e["args"]["name"] for e in self.result["traceEvents"] if e["name"] == "thread_name"}
+        self.assertEqual("isr core 0", names[trace_to_chrome.TRACK_ISR])
+        self.assertEqual("isr core 1", names[trace_to_chrome.TRACK_ISR | 1])
+        self.assertEqual("network", names[2])
+        self.assertEqual("state", names[trace_to_chrome.STATE_TRACK])
+        pulses = [e for e in span_events(self.result) if e["name"] == "pulse"]
+        self.assertEqual(3, len(pulses))
+        for pulse in pulses:
+            self.assertEqual("i", pulse["ph"])
+            self.assertTrue(pulse["tid"] & trace_to_chrome.TRACK_ISR)
+
+    def test_state_changes_become_spans(self):
+        states = [e for e in span_events(self.result) if e["tid"] == trace_to_chrome.STATE_TRACK]
+        self.assertEqual([("TRACKING_DISPLAY", "B"), ("TRACKING_DISPLAY", "E"), ("STOPPING", "B"), ("STOPPING", "E")],
+                         [(e["name"], e["ph"]) for e in states])
+        self.assertEqual({"from": "IDLE_DISPLAY"}, states[0]["args"])
+
+    def test_overflow_terminator(self):
+        # 終端の arg は書き出し中に上書きされた件数
+        self.assertEqual(2, self.trace["lost"])
+        self.assertEqual(2, self.result["otherData"]["lost_during_dump"])
+        self.assertEqual(19, self.result["otherData"]["records"])
+        # 終端が無い (途中で切れた) ダンプは lost が None になり、そこまでの記録は読める
+        truncated = trace_to_chrome.parse(self.dump[:-12])
+        self.assertIsNone(truncated["lost"])
+        self.assertEqual(19, len(truncated["records"]))
+        cut = trace_to_chrome.parse(self.dump[:-12 - 5])
+        self.assertEqual(18, len(cut["records"]))
+
+    def test_binary_input_and_command_line(self):
+        # SD の trace.bin と同じバイナリを渡しても同じ結果になる
+        with tempfile.TemporaryDirectory() as directory:
+            binary = os.path.join(directory, "trace.bin")
+            output = os.path.join(directory, "trace.json")
+            with open(binary, "wb") as f:
+                f.write(self.dump)
+            completed = subprocess.run([sys.executable, SCRIPT, binary, "-o", output],
+                                       stdout=subprocess.PIPE, stderr=subprocess.PIPE, universal_newlines=True)
+            self.assertEqual(0, completed.returncode, completed.stderr)
+            self.assertIn("2 records were overwritten", completed.stderr)
+            with open(output) as f:
+                self.assertEqual(json.loads(json.dumps(self.result)), json.load(f))
+
+    def test_bad_magic_is_rejected(self):
+        with self.assertRaises(ValueError):
+            trace_to_chrome.parse(b"XXXX" + self.dump[4:])
+        with self.assertRaises(ValueError):
+            trace_to_chrome.extract_hex_dump("no dump here\n")
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,228 @@
+#!/usr/bin/env python3
+"""fit2go のイベントトレースを Chrome のトレース形式 (JSON) に変換する
+
+入力は次のどちらか:
+  ・SDに書き出した /trace.bin (シリアルで "trace sd")
+  ・シリアルのログ (シリアルで "trace"。TRACE-DUMP-BEGIN と TRACE-DUMP-END の間の16進を取り出す)
+
+出力は chrome://tracing や https://ui.perfetto.dev でそのまま開ける
+
+  python3 tools/trace_to_chrome.py trace.bin -o trace.json
+  python3 tools/trace_to_chrome.py serial.log -o trace.json
+"""
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"F2GT"
+FORMAT_VERSION = 1
+END_MARKER = 0xFFFF
+TRACK_ISR = 0x80
+
+PHASE_INSTANT, PHASE_BEGIN, PHASE_END = 0, 1, 2
+
+# include/config.hpp の AppState と同じ順
+APP_STATES = [
+    "INITIALIZING", "IDLE_DISPLAY", "TRACKING_DISPLAY", "STOPPING", "WIFI_CONNECTING",
+    "WIFI_SCANNING", "WIFI_SETUP", "WIFI_AP_CONFIG", "SLEEPING",
+]
+STATE_TRACK = 0x100  # 状態遷移を区間として並べる仮のトラック (機器側のトラック番号と重ならない値)
+
+PID = 1
+
+
+def extract_hex_dump(text):
+    """シリアルのログから最後のダンプを取り出す (行頭にタイムスタンプなどが付いていてもよい)"""
+    dump = None
+    lines = None
+    for line in text.splitlines():
+        if "TRACE-DUMP-BEGIN" in line:
+            lines = []
+        elif "TRACE-DUMP-END" in line:
+            if lines is not None:
+                dump = bytes.fromhex("".join(lines))
+            lines = None
+        elif lines is not None:
+            word = line.strip().split()[-1] if line.strip() else ""
+            if word:
+                lines.append(word)
+    if dump is None:
+        raise ValueError("TRACE-DUMP-BEGIN ... TRACE-DUMP-END not found")
+    return dump
+
+
+def load_dump(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if data.startswith(MAGIC):
+        return data
+    return extract_hex_dump(data.decode("utf-8", errors="replace"))
+
+
+class Reader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, fmt):
+        values = struct.unpack_from("<" + fmt, self.data, self.pos)
+        self.pos += struct.calcsize("<" + fmt)
+        return values if len(values) > 1 else values[0]
+
+    def name(self):
+        length = self.take("B")
+        text = self.data[self.pos:self.pos + length].decode("utf-8", errors="replace")
+        self.pos += length
+        return text
+
+    def remaining(self):
+        return len(self.data) - self.pos
+
+
+def parse(data):
+    """ヘッダー・イベント名・トラック名・記録の並びを返す"""
+    r = Reader(data)
+    if r.take("4s") != MAGIC:
+        raise ValueError("not a fit2go trace (bad magic)")
+    version, record_size, event_count, written = r.take("BBHI")
+    if version != FORMAT_VERSION:
+        raise ValueError("unsupported trace version %d" % version)
+    if record_size != 12:
+        raise ValueError("unexpected record size %d" % record_size)
+    event_names = [r.name() for _ in range(event_count)]
+    tracks = {}
+    for _ in range(r.take("B")):
+        track = r.take("B")
+        tracks[track] = r.name()
+
+    records = []
+    lost = None
+    while r.remaining() >= record_size:
+        time_us, event, phase, track, arg = r.take("IHBBI")
+        if event == END_MARKER:
+            lost = arg
+            break
+        records.append((time_us, event, phase, track, arg))
+    return {
+        "written": written,
+        "event_names": event_names,
+        "tracks": tracks,
+        "records": records,
+        "lost": lost,  # None なら終端まで届いていない (書き出しの途中で切れた)
+    }
+
+
+def unwrap_times(records):
+    """32ビットのµsは約71分で一周するので、前の値より小さくなったら一周分を足す"""
+    offset = 0
+    previous = None
+    out = []
+    for time_us, event, phase, track, arg in records:
+        if previous is not None and time_us < previous and previous - time_us > 0x80000000:
+            offset += 1 << 32
+        previous = time_us
+        out.append((time_us + offset, event, phase, track, arg))
+    return out
+
+
+def track_name(track, tracks):
+    if track & TRACK_ISR:
+        return "isr core %d" % (track & 0x7F)
+    if track == 0:
+        return "other"
+    return tracks.get(track, "track %d" % track)
+
+
+def state_name(value):
+    return APP_STATES[value] if value < len(APP_STATES) else "state %d" % value
+
+
+def convert(trace):
+    names = trace["event_names"]
+    records = unwrap_times(trace["records"])
+    events = []
+    used_tracks = set()
+    open_spans = {}  # (track, event) -> 開いている数
+    last_ts = records[-1][0] if records else 0
+    state_event = names.index("state") if "state" in names else None
+    current_state = None
+
+    def name_of(event):
+        return names[event] if event < len(names) else "event %d" % event
+
+    for ts, event, phase, track, arg in records:
+        if event == state_event:
+            # 状態遷移は「旧 << 8 | 新」。状態ごとの区間にして専用のトラックへ
+            old, new = (arg >> 8) & 0xFF, arg & 0xFF
+            if current_state is not None:
+                events.append({"name": state_name(current_state), "ph": "E", "ts": ts, "pid": PID, "tid": STATE_TRACK})
+            events.append({"name": state_name(new), "ph": "B", "ts": ts, "pid": PID, "tid": STATE_TRACK,
+                           "args": {"from": state_name(old)}})
+            current_state = new
+            used_tracks.add(STATE_TRACK)
+            continue
+
+        used_tracks.add(track)
+        key = (track, event)
+        base = {"name": name_of(event), "ts": ts, "pid": PID, "tid": track, "args": {"arg": arg}}
+        if phase == PHASE_BEGIN:
+            open_spans[key] = open_spans.get(key, 0) + 1
+            base["ph"] = "B"
+        elif phase == PHASE_END:
+            if open_spans.get(key, 0) == 0:
+                continue  # 始まりがリングから押し出された区間は捨てる
+            open_spans[key] -= 1
+            base["ph"] = "E"
+        else:
+            base["ph"] = "i"
+            base["s"] = "t"
+        events.append(base)
+
+    # 終わっていない区間は最後の時刻で閉じる
+    for (track, event), count in open_spans.items():
+        for _ in range(count):
+            events.append({"name": name_of(event), "ph": "E", "ts": last_ts, "pid": PID, "tid": track})
+    if current_state is not None:
+        events.append({"name": state_name(current_state), "ph": "E", "ts": last_ts, "pid": PID, "tid": STATE_TRACK})
+
+    metadata = [{"name": "process_name", "ph": "M", "pid": PID, "args": {"name": "fit2go"}}]
+    for track in sorted(used_tracks):
+        name = "state" if track == STATE_TRACK else track_name(track, trace["tracks"])
+        metadata.append({"name": "thread_name", "ph": "M", "pid": PID, "tid": track, "args": {"name": name}})
+        metadata.append({"name": "thread_sort_index", "ph": "M", "pid": PID, "tid": track, "args": {"sort_index": track}})
+    return {
+        "traceEvents": metadata + events,
+        "displayTimeUnit": "ms",
+        "otherData": {
+            "records": len(records),
+            "written": trace["written"],
+            "lost_during_dump": trace["lost"],
+        },
+    }
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a fit2go trace dump to Chrome trace JSON")
+    parser.add_argument("input", help="trace.bin from the SD card, or a serial log containing a hex dump")
+    parser.add_argument("-o", "--output", help="output JSON file (default: stdout)")
+    args = parser.parse_args()
+
+    trace = parse(load_dump(args.input))
+    if trace["lost"] is None:
+        print("warning: dump is truncated (no end marker)", file=sys.stderr)
+    elif trace["lost"] > 0:
+        print("warning: %d records were overwritten while dumping" % trace["lost"], file=sys.stderr)
+    result = convert(trace)
+    print("%d records, %d written since boot" % (len(trace["records"]), trace["written"]), file=sys.stderr)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(result, f)
+    else:
+        json.dump(result, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()